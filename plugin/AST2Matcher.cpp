@@ -5,8 +5,7 @@
 
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "ASTMatcherP.h"
-
-ASTMakeMatcherVisitor ASTMakeMatcherVisitorInstance;
+#include "PathTrie.h"
 
 
 // Implementation of AbstractAST2Matcher
@@ -29,8 +28,11 @@ CallMatcher::CallMatcher(PointcutDeclaration* node, std::unique_ptr<DeclMatcher>
     : FuncMatcher(std::move(Matcher)), PointcutDeclarationMatcher<clang::Stmt>(node->name), AST(node) {}
 
 clang::ast_matchers::internal::Matcher<clang::Stmt> CallMatcher::getMatcher() const {
+    // Calls in template instantiations share their text with the template
+    // pattern, which is matched (and rewritten) on its own
     return clang::ast_matchers::callExpr(
-        clang::ast_matchers::callee(FuncMatcher->getMatcher())
+        clang::ast_matchers::callee(FuncMatcher->getMatcher()),
+        clang::ast_matchers::unless(clang::ast_matchers::isInTemplateInstantiation())
     ).bind(name);
 }
 
@@ -39,13 +41,21 @@ RunMatcher::RunMatcher(PointcutDeclaration* node, std::unique_ptr<DeclMatcher> M
     : FuncMatcher(std::move(Matcher)), PointcutDeclarationMatcher<clang::Decl>(node->name), AST(node) {}
 
 clang::ast_matchers::internal::Matcher<clang::Decl> RunMatcher::getMatcher() const {
-    return clang::ast_matchers::functionDecl(FuncMatcher->getMatcher()).bind(name);
+    // Like calls: an instantiation shares its text with the template pattern,
+    // the only one the bytecode engine visits
+    return clang::ast_matchers::functionDecl(
+        FuncMatcher->getMatcher(),
+        clang::ast_matchers::unless(clang::ast_matchers::isInstantiated())
+    ).bind(name);
 }
 
 // Implementation of FuncNameMatcher
 FuncNameMatcher::FuncNameMatcher(FuncExpression* node) : AST(node) {}
 
 clang::ast_matchers::internal::Matcher<clang::Decl> FuncNameMatcher::getMatcher() const {
+    if (hasWildcard(node->id)) {
+        return clang::ast_matchers::functionDecl(matchesQualifiedNamePattern(node->id.str()));
+    }
     return clang::ast_matchers::functionDecl(
         clang::ast_matchers::hasName(node->id)
     );
@@ -124,4 +134,115 @@ NotationAnalysisMatcher::NotationAnalysisMatcher(NotationAnalysisExprNode* node)
 
 clang::ast_matchers::internal::Matcher<clang::Decl> NotationAnalysisMatcher::getMatcher() const {
     return clang::ast_matchers::functionDecl(hasAnnotateTypeAttrWithValue(node->id));
-}
\ No newline at end of file
+}
+
+// Implementation of WithinFileMatcher
+WithinFileMatcher::WithinFileMatcher(WithinFileExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> WithinFileMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(isWithinFilePattern(node->id.str()));
+}
+
+// Implementation of WithinNamespaceMatcher
+WithinNamespaceMatcher::WithinNamespaceMatcher(WithinNamespaceExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> WithinNamespaceMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(isWithinNamespaceName(node->id.str()));
+}
+
+// Implementation of QualifierMatcher
+QualifierMatcher::QualifierMatcher(QualifierExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> QualifierMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(hasFunctionQualifier(functionQualifier(node->qualifier)));
+}
+
+// Implementation of ReturnsMatcher
+ReturnsMatcher::ReturnsMatcher(ReturnsExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> ReturnsMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(returnsTypeText(node->id.str()));
+}
+
+// Implementation of ParamsMatcher
+ParamsMatcher::ParamsMatcher(ParamsExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> ParamsMatcher::getMatcher() const {
+    std::vector<std::string> types(node->types.begin(), node->types.end());
+    return clang::ast_matchers::functionDecl(hasParamTypeTexts(std::move(types)));
+}
+
+// Implementation of ParamCountMatcher
+ParamCountMatcher::ParamCountMatcher(ParamCountExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> ParamCountMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(clang::ast_matchers::parameterCountIs(node->count));
+}
+
+// Implementation of MethodOfMatcher
+MethodOfMatcher::MethodOfMatcher(MethodOfExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> MethodOfMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(isMethodOfClass(node->id.str()));
+}
+
+// Implementation of InheritsMatcher
+InheritsMatcher::InheritsMatcher(InheritsExpression* node, std::shared_ptr<ClassHierarchy> Classes)
+    : Classes(std::move(Classes)), AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> InheritsMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(inheritsFromClass(node->id.str(), Classes));
+}
+
+// Implementation of CallsMatcher
+CallsMatcher::CallsMatcher(CallsExpression* node, std::shared_ptr<TUCallGraph> Graph)
+    : Graph(std::move(Graph)), AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> CallsMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(
+        callsFunctionMatching(CallGraphQuery{node->id.str(), node->depth}, Graph));
+}
+
+// Implementation of CalledByMatcher
+CalledByMatcher::CalledByMatcher(CalledByExpression* node, std::shared_ptr<TUCallGraph> Graph)
+    : Graph(std::move(Graph)), AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> CalledByMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(
+        isCalledByFunctionMatching(CallGraphQuery{node->id.str(), node->depth}, Graph));
+}
+
+// Implementation of BodySizeMatcher
+BodySizeMatcher::BodySizeMatcher(BodySizeExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> BodySizeMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(
+        hasBodySizeWithin(bodyMeasure(node->measure), std::make_pair(node->min, node->max)));
+}
+
+// Implementation of BodyFlagMatcher
+BodyFlagMatcher::BodyFlagMatcher(BodyFlagExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> BodyFlagMatcher::getMatcher() const {
+    return clang::ast_matchers::functionDecl(hasBodyFlag(bodyFlag(node->flag)));
+}
+
+// Implementation of PointcutRefMatcher
+PointcutRefMatcher::PointcutRefMatcher(PointcutRefExpression* node, std::unique_ptr<DeclMatcher> Matcher,
+                                       std::shared_ptr<PointcutRefResults> Results)
+    : TargetMatcher(std::move(Matcher)), Results(std::move(Results)), AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> PointcutRefMatcher::getMatcher() const {
+    return matchesPointcutRef(TargetMatcher->getMatcher(), Results);
+}
+
+// Implementation of ConstantMatcher
+ConstantMatcher::ConstantMatcher(ConstantExpression* node) : AST(node) {}
+
+clang::ast_matchers::internal::Matcher<clang::Decl> ConstantMatcher::getMatcher() const {
+    using namespace clang::ast_matchers;
+    if (node->value) {
+        return anything();
+    }
+    return unless(anything());
+}
@@ -14,8 +14,6 @@ struct AST {
     AST(T* node) : node(node) {}
 };
 
-extern ASTMakeMatcherVisitor ASTMakeMatcherVisitorInstance;
-
 struct AbstractAST2Matcher {
     AbstractAST2Matcher() = default;
     virtual ~AbstractAST2Matcher() = default;
@@ -115,4 +113,98 @@ struct NotationAnalysisMatcher : DeclMatcher, AST<NotationAnalysisExprNode> {
     NotationAnalysisMatcher(NotationAnalysisExprNode* node);
 
     clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
-};
\ No newline at end of file
+};
+
+struct WithinFileMatcher : DeclMatcher, AST<WithinFileExpression> {
+    WithinFileMatcher(WithinFileExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct WithinNamespaceMatcher : DeclMatcher, AST<WithinNamespaceExpression> {
+    WithinNamespaceMatcher(WithinNamespaceExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct QualifierMatcher : DeclMatcher, AST<QualifierExpression> {
+    QualifierMatcher(QualifierExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct ReturnsMatcher : DeclMatcher, AST<ReturnsExpression> {
+    ReturnsMatcher(ReturnsExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct ParamsMatcher : DeclMatcher, AST<ParamsExpression> {
+    ParamsMatcher(ParamsExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct ParamCountMatcher : DeclMatcher, AST<ParamCountExpression> {
+    ParamCountMatcher(ParamCountExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct MethodOfMatcher : DeclMatcher, AST<MethodOfExpression> {
+    MethodOfMatcher(MethodOfExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct InheritsMatcher : DeclMatcher, AST<InheritsExpression> {
+    std::shared_ptr<ClassHierarchy> Classes;
+
+    InheritsMatcher(InheritsExpression* node, std::shared_ptr<ClassHierarchy> Classes);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct CallsMatcher : DeclMatcher, AST<CallsExpression> {
+    std::shared_ptr<TUCallGraph> Graph;
+
+    CallsMatcher(CallsExpression* node, std::shared_ptr<TUCallGraph> Graph);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct CalledByMatcher : DeclMatcher, AST<CalledByExpression> {
+    std::shared_ptr<TUCallGraph> Graph;
+
+    CalledByMatcher(CalledByExpression* node, std::shared_ptr<TUCallGraph> Graph);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct BodySizeMatcher : DeclMatcher, AST<BodySizeExpression> {
+    BodySizeMatcher(BodySizeExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct BodyFlagMatcher : DeclMatcher, AST<BodyFlagExpression> {
+    BodyFlagMatcher(BodyFlagExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct PointcutRefMatcher : DeclMatcher, AST<PointcutRefExpression> {
+    std::unique_ptr<DeclMatcher> TargetMatcher;
+    std::shared_ptr<PointcutRefResults> Results;
+
+    PointcutRefMatcher(PointcutRefExpression* node, std::unique_ptr<DeclMatcher> Matcher,
+                       std::shared_ptr<PointcutRefResults> Results);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
+
+struct ConstantMatcher : DeclMatcher, AST<ConstantExpression> {
+    ConstantMatcher(ConstantExpression* node);
+
+    clang::ast_matchers::internal::Matcher<clang::Decl> getMatcher() const override;
+};
@@ -1,6 +1,8 @@
 #include "ASTMakeMatcherVisitor.h"
 #include "AST2Matcher.h"
 #include "ASTNode.h"
+#include "DeclCallGraph.h"
+#include "DeclHierarchy.h"
 
 
 AbstractAST2MatcherPtr ASTMakeMatcherVisitor::getMatcher() {
@@ -62,3 +64,75 @@ void ASTMakeMatcherVisitor::visit(NotationExprNode* node) {
 void ASTMakeMatcherVisitor::visit(NotationAnalysisExprNode* node) {
     matcher = std::make_unique<NotationAnalysisMatcher>(node);
 }
+
+void ASTMakeMatcherVisitor::visit(WithinFileExpression* node) {
+    matcher = std::make_unique<WithinFileMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(WithinNamespaceExpression* node) {
+    matcher = std::make_unique<WithinNamespaceMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(QualifierExpression* node) {
+    matcher = std::make_unique<QualifierMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(ReturnsExpression* node) {
+    matcher = std::make_unique<ReturnsMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(ParamsExpression* node) {
+    matcher = std::make_unique<ParamsMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(ParamCountExpression* node) {
+    matcher = std::make_unique<ParamCountMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(MethodOfExpression* node) {
+    matcher = std::make_unique<MethodOfMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(InheritsExpression* node) {
+    if (!classes) {
+        classes = std::make_shared<ClassHierarchy>();
+    }
+    matcher = std::make_unique<InheritsMatcher>(node, classes);
+}
+
+void ASTMakeMatcherVisitor::visit(CallsExpression* node) {
+    matcher = std::make_unique<CallsMatcher>(node, getCallGraph());
+}
+
+void ASTMakeMatcherVisitor::visit(CalledByExpression* node) {
+    matcher = std::make_unique<CalledByMatcher>(node, getCallGraph());
+}
+
+std::shared_ptr<TUCallGraph> ASTMakeMatcherVisitor::getCallGraph() {
+    if (!callGraph) {
+        callGraph = std::make_shared<TUCallGraph>();
+    }
+    return callGraph;
+}
+
+void ASTMakeMatcherVisitor::visit(BodySizeExpression* node) {
+    matcher = std::make_unique<BodySizeMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(BodyFlagExpression* node) {
+    matcher = std::make_unique<BodyFlagMatcher>(node);
+}
+
+void ASTMakeMatcherVisitor::visit(PointcutRefExpression* node) {
+    node->target->expression->accept(*this);
+    auto target = std::unique_ptr<DeclMatcher>(static_cast<DeclMatcher*>(matcher.release()));
+    auto &results = refResults[node->target];
+    if (!results) {
+        results = std::make_shared<PointcutRefResults>();
+    }
+    matcher = std::make_unique<PointcutRefMatcher>(node, std::move(target), results);
+}
+
+void ASTMakeMatcherVisitor::visit(ConstantExpression* node) {
+    matcher = std::make_unique<ConstantMatcher>(node);
+}
@@ -7,6 +7,13 @@
 
 struct ASTMakeMatcherVisitor : ASTVisitor {
     AbstractAST2MatcherPtr matcher;
+    // One memo per referenced pointcut, for all the matchers built here
+    llvm::DenseMap<const PointcutDeclaration*, std::shared_ptr<PointcutRefResults>> refResults;
+    // The call graph of calls() and called_by(), created by the first of
+    // them; the consumer builds it for the TU before matching
+    std::shared_ptr<TUCallGraph> callGraph;
+    // One class cache for all inherits() built here
+    std::shared_ptr<ClassHierarchy> classes;
     virtual void visit(PointcutDeclaration* node) ;
     virtual void visit(OrExpression* node) ;
     virtual void visit(AndExpression* node) ;
@@ -16,5 +23,20 @@ struct ASTMakeMatcherVisitor : ASTVisitor {
     virtual void visit(PragmaClangExprNode* node) ;
     virtual void visit(NotationExprNode* node) ;
     virtual void visit(NotationAnalysisExprNode* node) ;
+    virtual void visit(WithinFileExpression* node) ;
+    virtual void visit(WithinNamespaceExpression* node) ;
+    virtual void visit(QualifierExpression* node) ;
+    virtual void visit(ReturnsExpression* node) ;
+    virtual void visit(ParamsExpression* node) ;
+    virtual void visit(ParamCountExpression* node) ;
+    virtual void visit(MethodOfExpression* node) ;
+    virtual void visit(InheritsExpression* node) ;
+    virtual void visit(CallsExpression* node) ;
+    virtual void visit(CalledByExpression* node) ;
+    virtual void visit(BodySizeExpression* node) ;
+    virtual void visit(BodyFlagExpression* node) ;
+    virtual void visit(PointcutRefExpression* node) ;
+    virtual void visit(ConstantExpression* node) ;
     AbstractAST2MatcherPtr getMatcher() ;
+    std::shared_ptr<TUCallGraph> getCallGraph() ;
 };
\ No newline at end of file
@@ -3,6 +3,19 @@
 #include "clang/ASTMatchers/ASTMatchersMacros.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Attr.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include "DeclBody.h"
+#include "DeclCallGraph.h"
+#include "DeclHierarchy.h"
+#include "DeclScope.h"
+#include "DeclSignature.h"
+#include "FunctionFacts.h"
+#include "Pointer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
 
 
 AST_MATCHER_P(clang::FunctionDecl, hasPragmaClangBSSSectionAttr,
@@ -75,6 +88,15 @@ AST_MATCHER_P(clang::FunctionDecl, hasFuncitonName, llvm::StringRef,
   return Node.getName() == FunctionName;
 }
 
+// func(app::*::get*): a glob over the components of the qualified name
+AST_MATCHER_P(clang::FunctionDecl, matchesQualifiedNamePattern, std::string,
+              Pattern) {
+  std::string QualifiedName = Node.getQualifiedNameAsString();
+  FunctionFacts Facts;
+  Facts.qualifiedName = QualifiedName;
+  return matchesFunctionName(Pattern, Facts);
+}
+
 // Custom matcher to check for an AnnotateAttr with a specific annotation value
 AST_MATCHER_P(clang::FunctionDecl, hasAnnotateAttrWithValue, llvm::StringRef,
               AnnotationValue) {
@@ -90,13 +112,107 @@ AST_MATCHER_P(clang::FunctionDecl, hasAnnotateAttrWithValue, llvm::StringRef,
 
 AST_MATCHER_P(clang::FunctionDecl, hasAnnotateTypeAttrWithValue,
               llvm::StringRef, AnnotationValue) {
-  for (const auto *Attr : Node.attrs()) {
-    if (const auto *AnnotateType =
-            llvm::dyn_cast<clang::AnnotateTypeAttr>(Attr)) {
-      if (AnnotateType->getAnnotation() == AnnotationValue) {
-        return true;
-      }
-    }
-  }
-  return false;
+  llvm::SmallVector<llvm::StringRef, 2> Annotations;
+  collectTypeAnnotations(&Node, Annotations);
+  return llvm::is_contained(Annotations, AnnotationValue);
+}
+
+// within("glob"): the function is declared in a file matching the pattern
+AST_MATCHER_P(clang::FunctionDecl, isWithinFilePattern, std::string,
+              Pattern) {
+  FunctionFacts Facts;
+  Facts.file =
+      getDeclFileName(&Node, Finder->getASTContext().getSourceManager());
+  return isWithinFile(Pattern, Facts);
+}
+
+// within(namespace a::b): the function is declared in a::b or a namespace
+// nested in it
+AST_MATCHER_P(clang::FunctionDecl, isWithinNamespaceName, std::string,
+              Prefix) {
+  std::string NamespaceName = getEnclosingNamespaceName(&Node);
+  FunctionFacts Facts;
+  Facts.namespaceName = NamespaceName;
+  return isWithinNamespace(Prefix, Facts);
+}
+
+// const, static, virtual or volatile: Qualifier is a FunctionQualifier bit
+AST_MATCHER_P(clang::FunctionDecl, hasFunctionQualifier, u8, Qualifier) {
+  return getFunctionQualifiers(&Node) & Qualifier;
+}
+
+// returns(T): Type is in normalizeTypeText form
+AST_MATCHER_P(clang::FunctionDecl, returnsTypeText, std::string, Type) {
+  clang::PrintingPolicy Policy = Finder->getASTContext().getPrintingPolicy();
+  return getTypeText(Node.getReturnType(), Policy) == Type;
+}
+
+// params(T1, .., Tn): Types are in normalizeTypeText form
+AST_MATCHER_P(clang::FunctionDecl, hasParamTypeTexts, std::vector<std::string>,
+              Types) {
+  FunctionFacts Facts;
+  collectSignatureFacts(&Node, Facts);
+  llvm::SmallVector<llvm::StringRef, 4> Pattern(Types.begin(), Types.end());
+  return matchesParamTypes(Pattern, Facts);
+}
+
+// method_of(C): a method of a class matching Pattern
+AST_MATCHER_P(clang::FunctionDecl, isMethodOfClass, std::string, Pattern) {
+  const auto *Method = llvm::dyn_cast<clang::CXXMethodDecl>(&Node);
+  return Method &&
+         matchesQualifiedName(Pattern, Method->getParent()->getQualifiedNameAsString());
+}
+
+// inherits(B): a method of a class with a direct or indirect base matching
+// Pattern; Classes caches the bases of each class for all inherits() of the TU
+AST_MATCHER_P2(clang::FunctionDecl, inheritsFromClass, std::string, Pattern,
+               std::shared_ptr<ClassHierarchy>, Classes) {
+  FunctionFacts Facts;
+  Classes->collectFacts(&Node, Facts);
+  return inheritsFrom(Pattern, Facts);
+}
+
+// calls(F, n) / called_by(F, n) over Graph, the call graph of the TU
+AST_MATCHER_P2(clang::FunctionDecl, callsFunctionMatching, CallGraphQuery,
+               Query, std::shared_ptr<TUCallGraph>, Graph) {
+  FunctionFacts Facts;
+  Graph->collectFacts(&Node, Facts);
+  return callsFunction(Query.Pattern, Query.Depth, Facts);
+}
+
+AST_MATCHER_P2(clang::FunctionDecl, isCalledByFunctionMatching, CallGraphQuery,
+               Query, std::shared_ptr<TUCallGraph>, Graph) {
+  FunctionFacts Facts;
+  Graph->collectFacts(&Node, Facts);
+  return isCalledBy(Query.Pattern, Query.Depth, Facts);
+}
+
+// stmt_count(min, max) / body_weight(min, max): Measure is a BodyMeasure,
+// Range is {min, max}
+AST_MATCHER_P2(clang::FunctionDecl, hasBodySizeWithin, u8, Measure,
+               std::pair<u32, u32>, Range) {
+  FunctionFacts Facts;
+  BodyEstimator::collectFacts(&Node, Facts);
+  return isBodySizeWithin(static_cast<BodyMeasure>(Measure), Range.first,
+                          Range.second, Facts);
+}
+
+// has_loop / has_call: Flag is a BodyFlag bit
+AST_MATCHER_P(clang::FunctionDecl, hasBodyFlag, u8, Flag) {
+  FunctionFacts Facts;
+  BodyEstimator::collectFacts(&Node, Facts);
+  return Facts.bodyFlags & Flag;
+}
+
+// A reference to a named pointcut: Inner, the pointcut's matcher, runs once
+// per function however many pointcuts refer to it
+AST_MATCHER_P2(clang::Decl, matchesPointcutRef,
+               clang::ast_matchers::internal::Matcher<clang::Decl>, Inner,
+               std::shared_ptr<PointcutRefResults>, Results) {
+  auto It = Results->find(&Node);
+  if (It != Results->end())
+    return It->second;
+  bool Matches = Inner.matches(Node, Finder, Builder);
+  Results->try_emplace(&Node, Matches);
+  return Matches;
 }
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "FunctionFacts.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtCXX.h"
+
+#include <algorithm>
+
+// Body facts of the stmt_count(), body_weight(), has_loop and has_call
+// pointcuts and of max-overhead-ratio, shared by the matcher and the
+// bytecode engines.
+
+// Measures one function body. The weight is a static estimate of the
+// instructions of one run through it, in the spirit of an inliner's cost
+// model: loads, arithmetic and returns count 1, branches 2, divisions 4,
+// calls (including non-trivial constructors) 4 and allocations and throws
+// 16; implicit conversions, names and literals are free. The bodies of
+// loops count LOOP_TRIPS times per level of nesting. Lambda bodies,
+// unevaluated operands and local classes are not part of the run.
+//
+// Statements are those of a block (labels aside) and the branches and loop
+// bodies written without braces; blocks and empty statements do not count.
+class BodyEstimator : public clang::RecursiveASTVisitor<BodyEstimator> {
+public:
+  static constexpr u32 WEIGHT_SIMPLE = 1;
+  static constexpr u32 WEIGHT_BRANCH = 2;
+  static constexpr u32 WEIGHT_DIVIDE = 4;
+  static constexpr u32 WEIGHT_CALL = 4;
+  static constexpr u32 WEIGHT_ALLOCATION = 16;
+  static constexpr u32 LOOP_TRIPS = 8;
+
+  // Fills Facts.stmtCount, bodyWeight and bodyFlags; all 0 without a body
+  // in the TU
+  static void collectFacts(const clang::FunctionDecl *Func,
+                           FunctionFacts &Facts) {
+    Facts.stmtCount = 0;
+    Facts.bodyWeight = 0;
+    Facts.bodyFlags = 0;
+    const clang::FunctionDecl *Definition = nullptr;
+    clang::Stmt *Body = Func->getBody(Definition);
+    if (!Body)
+      return;
+    BodyEstimator Estimator;
+    // Entry and return
+    Estimator.add(WEIGHT_SIMPLE);
+    if (const auto *Ctor = llvm::dyn_cast<clang::CXXConstructorDecl>(Definition))
+      for (const clang::CXXCtorInitializer *Init : Ctor->inits())
+        Estimator.TraverseStmt(Init->getInit());
+    Estimator.countStatement(Body);
+    Estimator.TraverseStmt(Body);
+    Facts.stmtCount = Estimator.StmtCount;
+    Facts.bodyWeight = static_cast<u32>(std::min<u64>(Estimator.Weight, UINT32_MAX));
+    Facts.bodyFlags = Estimator.Flags;
+  }
+
+  // FunctionFacts::bodyWeight of Func, 0 without a body
+  static u32 getWeight(const clang::FunctionDecl *Func) {
+    FunctionFacts Facts;
+    collectFacts(Func, Facts);
+    return Facts.bodyWeight;
+  }
+
+  bool TraverseStmt(clang::Stmt *S) {
+    if (!S)
+      return true;
+    if (llvm::isa<clang::LambdaExpr>(S)) {
+      // Only the closure is built here
+      add(WEIGHT_SIMPLE);
+      return true;
+    }
+    if (llvm::isa<clang::UnaryExprOrTypeTraitExpr, clang::CXXNoexceptExpr,
+                  clang::CXXTypeidExpr>(S))
+      return true;
+    bool Loop = llvm::isa<clang::ForStmt, clang::CXXForRangeStmt,
+                          clang::WhileStmt, clang::DoStmt>(S);
+    if (Loop) {
+      Flags |= BODY_HAS_LOOP;
+      add(WEIGHT_BRANCH);
+      ++LoopDepth;
+    }
+    bool Result = clang::RecursiveASTVisitor<BodyEstimator>::TraverseStmt(S);
+    if (Loop)
+      --LoopDepth;
+    return Result;
+  }
+
+  bool TraverseDecl(clang::Decl *D) {
+    // Local variables run their initializers; local classes and functions
+    // are code of their own
+    if (!llvm::isa_and_nonnull<clang::VarDecl>(D))
+      return true;
+    return clang::RecursiveASTVisitor<BodyEstimator>::TraverseDecl(D);
+  }
+
+  bool VisitCompoundStmt(clang::CompoundStmt *Block) {
+    for (clang::Stmt *S : Block->body())
+      countStatement(S);
+    return true;
+  }
+
+  bool VisitIfStmt(clang::IfStmt *If) {
+    add(WEIGHT_BRANCH);
+    countStatement(If->getThen());
+    countStatement(If->getElse());
+    return true;
+  }
+
+  bool VisitSwitchStmt(clang::SwitchStmt *Switch) {
+    add(WEIGHT_BRANCH);
+    countStatement(Switch->getBody());
+    return true;
+  }
+
+  bool VisitForStmt(clang::ForStmt *For) {
+    countStatement(For->getBody());
+    return true;
+  }
+  bool VisitCXXForRangeStmt(clang::CXXForRangeStmt *For) {
+    countStatement(For->getBody());
+    return true;
+  }
+  bool VisitWhileStmt(clang::WhileStmt *While) {
+    countStatement(While->getBody());
+    return true;
+  }
+  bool VisitDoStmt(clang::DoStmt *Do) {
+    countStatement(Do->getBody());
+    return true;
+  }
+
+  bool VisitReturnStmt(clang::ReturnStmt *) {
+    add(WEIGHT_SIMPLE);
+    return true;
+  }
+
+  bool VisitConditionalOperator(clang::ConditionalOperator *) {
+    add(WEIGHT_BRANCH);
+    return true;
+  }
+
+  bool VisitBinaryOperator(clang::BinaryOperator *Op) {
+    switch (Op->getOpcode()) {
+    case clang::BO_Comma:
+      break;
+    case clang::BO_Div:
+    case clang::BO_Rem:
+    case clang::BO_DivAssign:
+    case clang::BO_RemAssign:
+      add(WEIGHT_DIVIDE);
+      break;
+    case clang::BO_LAnd:
+    case clang::BO_LOr:
+      add(WEIGHT_BRANCH);
+      break;
+    default:
+      add(WEIGHT_SIMPLE);
+      break;
+    }
+    return true;
+  }
+
+  bool VisitUnaryOperator(clang::UnaryOperator *Op) {
+    switch (Op->getOpcode()) {
+    case clang::UO_AddrOf:
+    case clang::UO_Plus:
+    case clang::UO_Extension:
+      break;
+    default:
+      add(WEIGHT_SIMPLE);
+      break;
+    }
+    return true;
+  }
+
+  bool VisitImplicitCastExpr(clang::ImplicitCastExpr *Cast) {
+    switch (Cast->getCastKind()) {
+    case clang::CK_LValueToRValue:
+    case clang::CK_IntegralToFloating:
+    case clang::CK_FloatingToIntegral:
+    case clang::CK_FloatingCast:
+      add(WEIGHT_SIMPLE);
+      break;
+    default:
+      break;
+    }
+    return true;
+  }
+
+  bool VisitArraySubscriptExpr(clang::ArraySubscriptExpr *) {
+    add(WEIGHT_SIMPLE);
+    return true;
+  }
+
+  bool VisitCallExpr(clang::CallExpr *) {
+    call(WEIGHT_CALL);
+    return true;
+  }
+
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *Construct) {
+    if (!Construct->getConstructor()->isTrivial())
+      call(WEIGHT_CALL);
+    return true;
+  }
+
+  bool VisitCXXNewExpr(clang::CXXNewExpr *) {
+    call(WEIGHT_ALLOCATION);
+    return true;
+  }
+
+  bool VisitCXXDeleteExpr(clang::CXXDeleteExpr *) {
+    call(WEIGHT_ALLOCATION);
+    return true;
+  }
+
+  bool VisitCXXThrowExpr(clang::CXXThrowExpr *) {
+    call(WEIGHT_ALLOCATION);
+    return true;
+  }
+
+private:
+  void add(u32 W) {
+    // LOOP_TRIPS per level; the total saturates at UINT32_MAX
+    u64 Scaled = W;
+    for (u32 I = 0; I < LoopDepth && Scaled < UINT32_MAX; ++I)
+      Scaled *= LOOP_TRIPS;
+    Weight += Scaled;
+  }
+
+  void call(u32 W) {
+    Flags |= BODY_HAS_CALL;
+    add(W);
+  }
+
+  void countStatement(const clang::Stmt *S) {
+    if (!S || llvm::isa<clang::CompoundStmt, clang::NullStmt>(S))
+      return;
+    if (const auto *Case = llvm::dyn_cast<clang::SwitchCase>(S))
+      return countStatement(Case->getSubStmt());
+    if (const auto *Label = llvm::dyn_cast<clang::LabelStmt>(S))
+      return countStatement(Label->getSubStmt());
+    ++StmtCount;
+  }
+
+  u32 StmtCount = 0;
+  u64 Weight = 0;
+  u8 Flags = 0;
+  u32 LoopDepth = 0;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CallGraph.h"
+#include "FunctionFacts.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <string>
+
+// Call graph facts of calls() and called_by() pointcuts, shared by the
+// matcher and the bytecode engines.
+
+// The direct calls of a TU: every call expression (and constructor call)
+// with a known callee inside a function body is an edge from that function.
+// Calls in a lambda belong to the lambda's call operator; virtual calls go
+// to the statically named function. Template patterns are included,
+// instantiations are not.
+class TUCallGraph {
+public:
+  void build(clang::ASTContext &Context) {
+    Builder(*this).TraverseDecl(Context.getTranslationUnitDecl());
+    Graph.finalize();
+  }
+
+  // Sets Facts.callGraph and Facts.callGraphNode
+  void collectFacts(const clang::FunctionDecl *Func,
+                    FunctionFacts &Facts) const {
+    Facts.callGraph = &Graph;
+    auto It = Nodes.find(Func->getCanonicalDecl());
+    Facts.callGraphNode = It == Nodes.end() ? CallGraph::NO_NODE : It->second;
+  }
+
+  const CallGraph &getGraph() const { return Graph; }
+
+private:
+  class Builder : public clang::RecursiveASTVisitor<Builder> {
+  public:
+    explicit Builder(TUCallGraph &Graph) : Graph(Graph) {}
+
+    bool TraverseDecl(clang::Decl *D) {
+      auto *Func = llvm::dyn_cast_or_null<clang::FunctionDecl>(D);
+      if (!Func || !Func->doesThisDeclarationHaveABody())
+        return clang::RecursiveASTVisitor<Builder>::TraverseDecl(D);
+      Callers.push_back(Graph.node(Func));
+      bool Result = clang::RecursiveASTVisitor<Builder>::TraverseDecl(D);
+      Callers.pop_back();
+      return Result;
+    }
+
+    bool TraverseLambdaExpr(clang::LambdaExpr *Lambda) {
+      // The body is the call operator's, which TraverseDecl does not see
+      Callers.push_back(Graph.node(Lambda->getCallOperator()));
+      bool Result =
+          clang::RecursiveASTVisitor<Builder>::TraverseLambdaExpr(Lambda);
+      Callers.pop_back();
+      return Result;
+    }
+
+    bool VisitCallExpr(clang::CallExpr *Call) {
+      if (const clang::FunctionDecl *Callee = Call->getDirectCallee())
+        addCall(Callee);
+      return true;
+    }
+
+    bool VisitCXXConstructExpr(clang::CXXConstructExpr *Construct) {
+      addCall(Construct->getConstructor());
+      return true;
+    }
+
+  private:
+    void addCall(const clang::FunctionDecl *Callee) {
+      if (!Callers.empty())
+        Graph.Graph.addCall(Callers.back(), Graph.node(Callee));
+    }
+
+    TUCallGraph &Graph;
+    llvm::SmallVector<u32, 8> Callers;
+  };
+
+  u32 node(const clang::FunctionDecl *Func) {
+    Func = Func->getCanonicalDecl();
+    auto [It, Inserted] = Nodes.try_emplace(Func);
+    if (Inserted)
+      It->second = Graph.addFunction(Func->getQualifiedNameAsString());
+    return It->second;
+  }
+
+  CallGraph Graph;
+  llvm::DenseMap<const clang::FunctionDecl *, u32> Nodes;
+};
+
+// calls(F, n) / called_by(F, n) of the matcher engine
+struct CallGraphQuery {
+  std::string Pattern;
+  u32 Depth;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FunctionFacts.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+#include <memory>
+
+// Class facts of method_of() and inherits() pointcuts, shared by the matcher
+// and the bytecode engines.
+
+// The qualified name and the direct and indirect bases of classes, each
+// computed once. The bases of a class are its direct bases plus their
+// (cached) bases, so every class of a hierarchy is walked once however many
+// methods and subclasses it has. Names and base lists live as long as the
+// cache.
+class ClassHierarchy {
+public:
+  struct ClassFacts {
+    llvm::StringRef Name;
+    llvm::ArrayRef<llvm::StringRef> Bases;
+  };
+
+  ClassFacts get(const clang::CXXRecordDecl *Record) {
+    Record = Record->getCanonicalDecl();
+    auto It = Classes.find(Record);
+    if (It != Classes.end())
+      return It->second;
+
+    ClassFacts Facts;
+    Facts.Name = Names.save(Record->getQualifiedNameAsString());
+    llvm::SmallSetVector<llvm::StringRef, 8> Bases;
+    if (const clang::CXXRecordDecl *Definition = Record->getDefinition()) {
+      for (const clang::CXXBaseSpecifier &Base : Definition->bases()) {
+        // Dependent bases are not known until instantiation
+        const clang::CXXRecordDecl *BaseRecord =
+            Base.getType()->getAsCXXRecordDecl();
+        if (!BaseRecord)
+          continue;
+        ClassFacts BaseFacts = get(BaseRecord);
+        Bases.insert(BaseFacts.Name);
+        Bases.insert(BaseFacts.Bases.begin(), BaseFacts.Bases.end());
+      }
+    }
+    llvm::StringRef *Copy = Allocator.Allocate<llvm::StringRef>(Bases.size());
+    std::uninitialized_copy(Bases.begin(), Bases.end(), Copy);
+    Facts.Bases = llvm::ArrayRef<llvm::StringRef>(Copy, Bases.size());
+    Classes[Record] = Facts;
+    return Facts;
+  }
+
+  // Sets Facts.className and Facts.baseClasses for a method; clears them
+  // for other functions
+  void collectFacts(const clang::FunctionDecl *Func, FunctionFacts &Facts) {
+    const auto *Method = llvm::dyn_cast<clang::CXXMethodDecl>(Func);
+    if (!Method) {
+      Facts.className = llvm::StringRef();
+      Facts.baseClasses = llvm::ArrayRef<llvm::StringRef>();
+      return;
+    }
+    ClassFacts Class = get(Method->getParent());
+    Facts.className = Class.Name;
+    Facts.baseClasses = Class.Bases;
+  }
+
+private:
+  llvm::DenseMap<const clang::CXXRecordDecl *, ClassFacts> Classes;
+  llvm::BumpPtrAllocator Allocator;
+  llvm::UniqueStringSaver Names{Allocator};
+};
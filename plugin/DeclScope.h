@@ -0,0 +1,43 @@
+#pragma once
+
+#include "clang/AST/Decl.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <string>
+
+// Scope facts of within() pointcuts, shared by the matcher and the bytecode
+// engines.
+
+// Named namespaces from DC outwards, outermost first: "a::b" for the body
+// of namespace b in namespace a, empty at global scope. Anonymous namespaces
+// are skipped.
+inline std::string getNamespaceName(const clang::DeclContext *DC) {
+  llvm::SmallVector<llvm::StringRef, 4> Names;
+  for (; DC; DC = DC->getParent()) {
+    if (const auto *NS = llvm::dyn_cast<clang::NamespaceDecl>(DC))
+      if (!NS->isAnonymousNamespace())
+        Names.push_back(NS->getName());
+  }
+  std::string Result;
+  for (llvm::StringRef Name : llvm::reverse(Names)) {
+    if (!Result.empty())
+      Result += "::";
+    Result += Name;
+  }
+  return Result;
+}
+
+// The namespace D is declared in, e.g. "a::b" for a function (or a method of
+// a class) in namespace a::b
+inline std::string getEnclosingNamespaceName(const clang::Decl *D) {
+  return getNamespaceName(D->getDeclContext());
+}
+
+// The file D is written in; for a declaration produced by a macro, the file
+// of the macro's use
+inline llvm::StringRef getDeclFileName(const clang::Decl *D,
+                                       const clang::SourceManager &SM) {
+  return SM.getFilename(SM.getExpansionLoc(D->getLocation()));
+}
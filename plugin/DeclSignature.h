@@ -0,0 +1,78 @@
+#pragma once
+
+#include "FunctionFacts.h"
+
+#include "clang/AST/Attr.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/PrettyPrinter.h"
+#include "clang/AST/TypeLoc.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <string>
+
+// Signature facts of the qualifier, returns(), params() and
+// annotation_analysis() pointcuts, shared by the matcher and the bytecode
+// engines.
+
+// FunctionQualifier bits of Func. static covers static member functions and
+// free functions with internal linkage; virtual includes overrides that do
+// not repeat the keyword.
+inline u8 getFunctionQualifiers(const clang::FunctionDecl *Func) {
+  u8 Qualifiers = 0;
+  if (const auto *Method = llvm::dyn_cast<clang::CXXMethodDecl>(Func)) {
+    if (Method->isConst())
+      Qualifiers |= QUALIFIER_CONST;
+    if (Method->isVolatile())
+      Qualifiers |= QUALIFIER_VOLATILE;
+    if (Method->isStatic())
+      Qualifiers |= QUALIFIER_STATIC;
+    if (Method->isVirtual())
+      Qualifiers |= QUALIFIER_VIRTUAL;
+  } else if (Func->getStorageClass() == clang::SC_Static) {
+    Qualifiers |= QUALIFIER_STATIC;
+  }
+  return Qualifiers;
+}
+
+// T as written in the declaration (typedefs are kept), in normalizeTypeText
+// form
+inline std::string getTypeText(clang::QualType T,
+                               const clang::PrintingPolicy &Policy) {
+  return normalizeTypeText(T.getAsString(Policy));
+}
+
+// Fills Facts.returnType and Facts.paramTypes
+inline void collectSignatureFacts(const clang::FunctionDecl *Func,
+                                  FunctionFacts &Facts) {
+  clang::PrintingPolicy Policy = Func->getASTContext().getPrintingPolicy();
+  Facts.returnType = getTypeText(Func->getReturnType(), Policy);
+  Facts.paramTypes.clear();
+  for (const clang::ParmVarDecl *Param : Func->parameters())
+    Facts.paramTypes.push_back(getTypeText(Param->getType(), Policy));
+}
+
+// Values of the [[clang::annotate_type]] attributes on the function type and
+// its return type. They live on the written type, not in Func->attrs():
+//   int [[clang::annotate_type("a")]] f() [[clang::annotate_type("b")]];
+inline void
+collectTypeAnnotations(const clang::FunctionDecl *Func,
+                       llvm::SmallVectorImpl<llvm::StringRef> &Annotations) {
+  const clang::TypeSourceInfo *Info = Func->getTypeSourceInfo();
+  if (!Info)
+    return;
+  auto Collect = [&](clang::TypeLoc Loc) {
+    Loc = Loc.IgnoreParens();
+    while (auto Attributed = Loc.getAs<clang::AttributedTypeLoc>()) {
+      if (const auto *Annotate =
+              llvm::dyn_cast_or_null<clang::AnnotateTypeAttr>(
+                  Attributed.getAttr()))
+        Annotations.push_back(Annotate->getAnnotation());
+      Loc = Attributed.getModifiedLoc().IgnoreParens();
+    }
+    return Loc;
+  };
+  clang::TypeLoc Loc = Collect(Info->getTypeLoc());
+  if (auto Function = Loc.getAs<clang::FunctionTypeLoc>())
+    Collect(Function.getReturnLoc());
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/STLExtras.h"
+
+class WrapFunctionCallback;
+class WrapCallCallback;
+
+// Join points of the pointcuts left to MatchFinder while the others run on
+// the PointcutDispatcher. The first pointcut of the file has to win across
+// both engines, so MatchFinder runs first and its callbacks only record
+// their earliest match per function and call here. The dispatcher then
+// weaves each join point it visits with the earlier of its own match and the
+// recorded one; the consumer weaves the recorded join points it left.
+class FallbackMatches {
+public:
+  template <typename Callback> struct Match {
+    unsigned Order = 0; // position of the pointcut in the file
+    Callback *Handler = nullptr;
+  };
+  using FunctionMatch = Match<WrapFunctionCallback>;
+  using CallMatch = Match<WrapCallCallback>;
+
+  void addFunction(const clang::FunctionDecl *Func, FunctionMatch M) {
+    keepFirst(Functions[Func], M);
+  }
+  void addCall(const clang::CallExpr *Call, CallMatch M) {
+    keepFirst(Calls[Call], M);
+  }
+
+  // The earlier of Own and the match recorded for Func, which is forgotten
+  FunctionMatch takeFunction(const clang::FunctionDecl *Func,
+                             FunctionMatch Own) {
+    return take(Functions, Func, Own);
+  }
+  CallMatch takeCall(const clang::CallExpr *Call, CallMatch Own) {
+    return take(Calls, Call, Own);
+  }
+
+  // What the dispatcher did not take, in the order MatchFinder first matched
+  // it, so the weaving order (and the output) is the same on every run
+  auto remainingFunctions() const {
+    return llvm::make_filter_range(Functions, [](const auto &Entry) {
+      return Entry.second.Handler != nullptr;
+    });
+  }
+  auto remainingCalls() const {
+    return llvm::make_filter_range(Calls, [](const auto &Entry) {
+      return Entry.second.Handler != nullptr;
+    });
+  }
+
+private:
+  template <typename Callback>
+  static void keepFirst(Match<Callback> &Kept, Match<Callback> M) {
+    if (M.Handler && (!Kept.Handler || M.Order < Kept.Order))
+      Kept = M;
+  }
+
+  // Taken matches are cleared rather than erased, which would be linear in a
+  // MapVector
+  template <typename Node, typename Callback>
+  static Match<Callback> take(llvm::MapVector<Node, Match<Callback>> &Matches,
+                              Node N, Match<Callback> Own) {
+    auto It = Matches.find(N);
+    if (It == Matches.end())
+      return Own;
+    Match<Callback> First = It->second;
+    It->second = Match<Callback>();
+    keepFirst(First, Own);
+    return First;
+  }
+
+  llvm::MapVector<const clang::FunctionDecl *, FunctionMatch> Functions;
+  llvm::MapVector<const clang::CallExpr *, CallMatch> Calls;
+};
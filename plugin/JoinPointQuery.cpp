@@ -0,0 +1,84 @@
+#include "JoinPointQuery.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// RFC 4180: fields with a separator, quote or line break are quoted, quotes
+// doubled (template arguments of qualified names carry commas)
+void writeCsvField(llvm::raw_ostream &OS, llvm::StringRef Field) {
+  if (Field.find_first_of(",\"\r\n") == llvm::StringRef::npos) {
+    OS << Field;
+    return;
+  }
+  OS << '"';
+  for (char C : Field) {
+    if (C == '"')
+      OS << '"';
+    OS << C;
+  }
+  OS << '"';
+}
+
+} // namespace
+
+void JoinPointQuery::addFunction(llvm::StringRef Pointcut,
+                                 const clang::FunctionDecl *Func,
+                                 clang::SourceManager &SM) {
+  add(Pointcut, /*IsCall=*/false, Func->getQualifiedNameAsString(),
+      Func->getLocation(), SM);
+}
+
+void JoinPointQuery::addCall(llvm::StringRef Pointcut,
+                             const clang::CallExpr *Call,
+                             const clang::FunctionDecl *Callee,
+                             clang::SourceManager &SM) {
+  add(Pointcut, /*IsCall=*/true, Callee->getQualifiedNameAsString(),
+      Call->getBeginLoc(), SM);
+}
+
+void JoinPointQuery::add(llvm::StringRef Pointcut, bool IsCall,
+                         std::string Function, clang::SourceLocation Loc,
+                         clang::SourceManager &SM) {
+  clang::SourceLocation FileLoc = SM.getExpansionLoc(Loc);
+  // Absolute, as the base folder is compared against
+  llvm::SmallString<256> File(SM.getFilename(FileLoc));
+  if (!File.empty())
+    llvm::sys::fs::make_absolute(File);
+  JoinPoints.push_back({Pointcut.str(), IsCall, std::move(Function),
+                        std::string(File.str()),
+                        SM.getExpansionLineNumber(FileLoc)});
+}
+
+void JoinPointQuery::write(llvm::raw_ostream &OS, QueryFormat Format) {
+  std::stable_sort(JoinPoints.begin(), JoinPoints.end(),
+                   [](const JoinPoint &A, const JoinPoint &B) {
+                     return std::tie(A.File, A.Line) < std::tie(B.File, B.Line);
+                   });
+  for (const JoinPoint &Point : JoinPoints) {
+    llvm::StringRef Kind = Point.IsCall ? "call" : "run";
+    if (Format == QueryFormat::Csv) {
+      writeCsvField(OS, Point.Pointcut);
+      OS << ',' << Kind << ',';
+      writeCsvField(OS, Point.Function);
+      OS << ',';
+      writeCsvField(OS, Point.File);
+      OS << ',' << Point.Line << '\n';
+      continue;
+    }
+    llvm::json::OStream J(OS);
+    J.object([&] {
+      J.attribute("pointcut", Point.Pointcut);
+      J.attribute("kind", Kind);
+      J.attribute("function", Point.Function);
+      J.attribute("file", Point.File);
+      J.attribute("line", Point.Line);
+    });
+    OS << '\n';
+  }
+  JoinPoints.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+// What query=<format> prints in place of the rewritten source
+enum class QueryFormat {
+  None, // weave as usual
+  Json, // one JSON object per join point and line
+  Csv,  // one record per join point and line, no header
+};
+
+// Join points a TU's pointcuts select, recorded by the callbacks at the point
+// where they would start rewriting, so a query lists exactly what weaving
+// the TU would change. Each join point is one line, so the output of many
+// TUs (or of parallel compiler runs) can simply be concatenated:
+//   {"pointcut":"traced","kind":"run","function":"Counter::get","file":"/p/src/a.cpp","line":12}
+//   traced,run,Counter::get,/p/src/a.cpp,12
+// A run join point is the matched function, a call join point the call site
+// (file and line of the call) with the callee as function.
+class JoinPointQuery {
+public:
+  void addFunction(llvm::StringRef Pointcut, const clang::FunctionDecl *Func,
+                   clang::SourceManager &SM);
+  void addCall(llvm::StringRef Pointcut, const clang::CallExpr *Call,
+               const clang::FunctionDecl *Callee, clang::SourceManager &SM);
+
+  bool empty() const { return JoinPoints.empty(); }
+
+  // Writes the join points ordered by file and line (the engines find them
+  // in different orders), then forgets them
+  void write(llvm::raw_ostream &OS, QueryFormat Format);
+
+private:
+  struct JoinPoint {
+    std::string Pointcut;
+    bool IsCall;
+    std::string Function;
+    std::string File;
+    unsigned Line;
+  };
+
+  void add(llvm::StringRef Pointcut, bool IsCall, std::string Function,
+           clang::SourceLocation Loc, clang::SourceManager &SM);
+
+  std::vector<JoinPoint> JoinPoints;
+};
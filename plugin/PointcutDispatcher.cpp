@@ -0,0 +1,261 @@
+#include "PointcutDispatcher.h"
+#include "DeclBody.h"
+#include "DeclScope.h"
+#include "DeclSignature.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+
+namespace {
+
+// Template instantiations are not visited: their text is the template
+// pattern's, which is visited (and rewritten) on its own.
+class DispatchVisitor : public clang::RecursiveASTVisitor<DispatchVisitor> {
+public:
+  DispatchVisitor(PointcutDispatcher &Dispatcher, clang::ASTContext &Context)
+      : Dispatcher(Dispatcher), Context(Context),
+        VisitCalls(Dispatcher.hasCallPointcuts()) {}
+
+  bool TraverseDecl(clang::Decl *D) {
+    if (D && Dispatcher.skipsDecl(D))
+      return true;
+    return clang::RecursiveASTVisitor<DispatchVisitor>::TraverseDecl(D);
+  }
+
+  bool VisitFunctionDecl(clang::FunctionDecl *Func) {
+    Dispatcher.dispatchFunction(Func, Context);
+    return true;
+  }
+
+  bool VisitCallExpr(clang::CallExpr *Call) {
+    if (VisitCalls)
+      Dispatcher.dispatchCall(Call, Context);
+    return true;
+  }
+
+private:
+  PointcutDispatcher &Dispatcher;
+  clang::ASTContext &Context;
+  bool VisitCalls;
+};
+
+// The single attribute scan of a function; annotate_type values are read from
+// its written type
+void collectAttributeFacts(const clang::FunctionDecl *Func, bool QualifiedName,
+                           FunctionFacts &Facts) {
+  Facts.clear();
+  if (const clang::IdentifierInfo *II = Func->getIdentifier())
+    Facts.name = II->getName();
+  if (QualifiedName)
+    Facts.qualifiedName = Func->getQualifiedNameAsString();
+  Facts.qualifiers = getFunctionQualifiers(Func);
+  Facts.paramCount = Func->getNumParams();
+
+  for (const clang::Attr *A : Func->attrs()) {
+    switch (A->getKind()) {
+    case clang::attr::Annotate:
+      Facts.annotations.push_back(
+          llvm::cast<clang::AnnotateAttr>(A)->getAnnotation());
+      break;
+    case clang::attr::PragmaClangBSSSection:
+      Facts.setSection(FACT_SECTION_BSS,
+                       llvm::cast<clang::PragmaClangBSSSectionAttr>(A)->getName());
+      break;
+    case clang::attr::PragmaClangDataSection:
+      Facts.setSection(FACT_SECTION_DATA,
+                       llvm::cast<clang::PragmaClangDataSectionAttr>(A)->getName());
+      break;
+    case clang::attr::PragmaClangRelroSection:
+      Facts.setSection(FACT_SECTION_RELRO,
+                       llvm::cast<clang::PragmaClangRelroSectionAttr>(A)->getName());
+      break;
+    case clang::attr::PragmaClangRodataSection:
+      Facts.setSection(FACT_SECTION_RODATA,
+                       llvm::cast<clang::PragmaClangRodataSectionAttr>(A)->getName());
+      break;
+    case clang::attr::PragmaClangTextSection:
+      Facts.setSection(FACT_SECTION_TEXT,
+                       llvm::cast<clang::PragmaClangTextSectionAttr>(A)->getName());
+      break;
+    default:
+      break;
+    }
+  }
+  collectTypeAnnotations(Func, Facts.typeAnnotations);
+}
+
+} // namespace
+
+bool PointcutDispatcher::addRunPointcut(const PointcutImage &Image, u32 Root,
+                                        WrapFunctionCallback *Handler) {
+  if (!RunIndex.add(RunHandlers.size(), Image, Root))
+    return false;
+  RunHandlers.push_back(Handler);
+  return true;
+}
+
+bool PointcutDispatcher::addCallPointcut(const PointcutImage &Image, u32 Root,
+                                         WrapCallCallback *Handler) {
+  if (!CallIndex.add(CallHandlers.size(), Image, Root))
+    return false;
+  CallHandlers.push_back(Handler);
+  return true;
+}
+
+void PointcutDispatcher::setCompiled(
+    const CompiledPointcutSet &Set,
+    std::vector<WrapFunctionCallback *> RunHandlers,
+    std::vector<WrapCallCallback *> CallHandlers) {
+  Compiled = &Set;
+  this->RunHandlers = std::move(RunHandlers);
+  this->CallHandlers = std::move(CallHandlers);
+}
+
+void PointcutDispatcher::run(clang::ASTContext &Context) {
+  if (empty())
+    return;
+  SM = &Context.getSourceManager();
+  Pruning = !Compiled && CallHandlers.empty() && RunIndex.isScoped();
+  // The whole TU, before any function is matched: calls() of a function
+  // depends on functions defined after it
+  if (needsCallGraph(MATCH_RUN) || needsCallGraph(MATCH_CALL))
+    Calls.build(Context);
+  DispatchVisitor Visitor(*this, Context);
+  Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+}
+
+std::optional<u32> PointcutDispatcher::firstMatch(MatchKind Kind,
+                                                  const FunctionFacts &Facts) const {
+  if (Compiled)
+    return Compiled->firstMatch(Kind, Facts);
+  return Kind == MATCH_RUN ? RunIndex.firstMatch(Facts)
+                           : CallIndex.firstMatch(Facts);
+}
+
+bool PointcutDispatcher::needsQualifiedName(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsQualifiedName;
+  return Kind == MATCH_RUN ? RunIndex.needsQualifiedName()
+                           : CallIndex.needsQualifiedName();
+}
+
+bool PointcutDispatcher::needsScope(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsScope;
+  return Kind == MATCH_RUN ? RunIndex.needsScope() : CallIndex.needsScope();
+}
+
+bool PointcutDispatcher::needsCallGraph(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsCallGraph;
+  return Kind == MATCH_RUN ? RunIndex.needsCallGraph()
+                           : CallIndex.needsCallGraph();
+}
+
+bool PointcutDispatcher::needsBody(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsBody;
+  return Kind == MATCH_RUN ? RunIndex.needsBody() : CallIndex.needsBody();
+}
+
+bool PointcutDispatcher::needsClass(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsClass;
+  return Kind == MATCH_RUN ? RunIndex.needsClass() : CallIndex.needsClass();
+}
+
+bool PointcutDispatcher::needsSignature(MatchKind Kind) const {
+  if (Compiled)
+    return Compiled->needsSignature;
+  return Kind == MATCH_RUN ? RunIndex.needsSignature()
+                           : CallIndex.needsSignature();
+}
+
+void PointcutDispatcher::collectFacts(const clang::FunctionDecl *Func,
+                                      MatchKind Kind, FunctionFacts &Facts) {
+  collectAttributeFacts(Func, needsQualifiedName(Kind), Facts);
+  if (needsScope(Kind)) {
+    Facts.file = fileName(Func);
+    Facts.namespaceName = namespaceName(Func->getDeclContext());
+  }
+  if (needsSignature(Kind))
+    collectSignatureFacts(Func, Facts);
+  if (needsClass(Kind))
+    Classes.collectFacts(Func, Facts);
+  if (needsCallGraph(Kind))
+    Calls.collectFacts(Func, Facts);
+  if (needsBody(Kind))
+    BodyEstimator::collectFacts(Func, Facts);
+}
+
+llvm::StringRef PointcutDispatcher::fileName(const clang::Decl *D) {
+  clang::FileID File = SM->getFileID(SM->getExpansionLoc(D->getLocation()));
+  auto [It, Inserted] = FileNames.try_emplace(File);
+  if (Inserted)
+    It->second = getDeclFileName(D, *SM);
+  return It->second;
+}
+
+llvm::StringRef PointcutDispatcher::namespaceName(const clang::DeclContext *DC) {
+  // All contexts in one namespace share its name
+  DC = DC->getEnclosingNamespaceContext();
+  auto [It, Inserted] = NamespaceNames.try_emplace(DC);
+  if (Inserted)
+    It->second = Names.save(getNamespaceName(DC));
+  return It->second;
+}
+
+bool PointcutDispatcher::skipsDecl(const clang::Decl *D) {
+  if (!Pruning || !D->getLexicalDeclContext() ||
+      !D->getLexicalDeclContext()->isFileContext())
+    return false;
+  if (const auto *NS = llvm::dyn_cast<clang::NamespaceDecl>(D))
+    return !NS->isAnonymousNamespace() &&
+           !RunIndex.mayEnterNamespace(namespaceName(NS));
+  // Functions and classes are judged by where they are declared; other
+  // file-level declarations (linkage specifications, ...) may contain
+  // declarations of other files
+  if (!llvm::isa<clang::FunctionDecl, clang::FunctionTemplateDecl,
+                 clang::TagDecl, clang::ClassTemplateDecl>(D))
+    return false;
+  if (RunIndex.namespaceInScope(namespaceName(D->getDeclContext())))
+    return false;
+  clang::FileID File = SM->getFileID(SM->getExpansionLoc(D->getLocation()));
+  auto [It, Inserted] = FilesInScope.try_emplace(File);
+  if (Inserted)
+    It->second = RunIndex.fileInScope(fileName(D));
+  return !It->second;
+}
+
+void PointcutDispatcher::dispatchFunction(const clang::FunctionDecl *Func,
+                                          clang::ASTContext &Context) {
+  if (RunHandlers.empty())
+    return;
+  collectFacts(Func, MATCH_RUN, Scratch);
+  FallbackMatches::FunctionMatch Match;
+  if (std::optional<u32> First = firstMatch(MATCH_RUN, Scratch))
+    Match = {RunHandlers[*First]->getOrder(), RunHandlers[*First]};
+  if (Fallback)
+    Match = Fallback->takeFunction(Func, Match);
+  if (Match.Handler)
+    Match.Handler->wrap(Func, &Context);
+}
+
+void PointcutDispatcher::dispatchCall(const clang::CallExpr *Call,
+                                      clang::ASTContext &Context) {
+  const clang::FunctionDecl *Callee = Call->getDirectCallee();
+  if (!Callee)
+    return;
+  auto [It, Inserted] = CalleeMatches.try_emplace(Callee);
+  if (Inserted) {
+    collectFacts(Callee, MATCH_CALL, Scratch);
+    It->second = firstMatch(MATCH_CALL, Scratch);
+  }
+  FallbackMatches::CallMatch Match;
+  if (It->second)
+    Match = {CallHandlers[*It->second]->getOrder(), CallHandlers[*It->second]};
+  if (Fallback)
+    Match = Fallback->takeCall(Call, Match);
+  if (Match.Handler)
+    Match.Handler->weave(Call, Context);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "WrapCallCallback.h"
+#include "WrapFunctionCallback.h"
+
+#include "CompiledPointcuts.h"
+#include "DeclCallGraph.h"
+#include "DeclHierarchy.h"
+#include "FallbackMatches.h"
+#include "PointcutIndex.h"
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+#include <vector>
+
+// Bytecode engine: evaluates all compiled pointcuts of a file in one
+// RecursiveASTVisitor pass, without ASTMatchers. For each function the
+// attributes are scanned once into FunctionFacts, the PointcutIndex yields
+// the few pointcuts that can match, and only their programs run; the first
+// match (in file order) is handed to its callback. Pointcuts referred to by
+// others run at most once per function, and a callee is matched once
+// however many calls it has.
+//
+// With a CompiledPointcutSet the generated firstMatch takes the place of both
+// indexes and their programs.
+//
+// When every pointcut is a run_pointcut confined by within() (see
+// PointcutIndex::isScoped), declarations outside all scopes are not
+// traversed at all.
+class PointcutDispatcher {
+public:
+  // False when the pointcut cannot be compiled; the caller then matches it
+  // with MatchFinder instead.
+  bool addRunPointcut(const PointcutImage &Image, u32 Root,
+                      WrapFunctionCallback *Handler);
+  bool addCallPointcut(const PointcutImage &Image, u32 Root,
+                       WrapCallCallback *Handler);
+
+  // Handlers are given in the order of Set.pointcuts, per match kind
+  void setCompiled(const CompiledPointcutSet &Set,
+                   std::vector<WrapFunctionCallback *> RunHandlers,
+                   std::vector<WrapCallCallback *> CallHandlers);
+
+  bool empty() const { return RunHandlers.empty() && CallHandlers.empty(); }
+
+  // Matches of the pointcuts MatchFinder ran before, to rank against the
+  // dispatcher's own by their order in the file
+  void setFallback(FallbackMatches *NewFallback) { Fallback = NewFallback; }
+
+  void run(clang::ASTContext &Context);
+
+  void dispatchFunction(const clang::FunctionDecl *Func,
+                        clang::ASTContext &Context);
+  void dispatchCall(const clang::CallExpr *Call, clang::ASTContext &Context);
+
+  bool hasCallPointcuts() const { return !CallHandlers.empty(); }
+
+  // Whether the traversal can skip D and everything in it
+  bool skipsDecl(const clang::Decl *D);
+
+private:
+  std::optional<u32> firstMatch(MatchKind Kind, const FunctionFacts &Facts) const;
+  bool needsQualifiedName(MatchKind Kind) const;
+  bool needsScope(MatchKind Kind) const;
+  bool needsSignature(MatchKind Kind) const;
+  bool needsClass(MatchKind Kind) const;
+  bool needsCallGraph(MatchKind Kind) const;
+  bool needsBody(MatchKind Kind) const;
+  void collectFacts(const clang::FunctionDecl *Func, MatchKind Kind,
+                    FunctionFacts &Facts);
+  llvm::StringRef fileName(const clang::Decl *D);
+  llvm::StringRef namespaceName(const clang::DeclContext *DC);
+
+  PointcutIndex RunIndex;
+  PointcutIndex CallIndex;
+  std::vector<WrapFunctionCallback *> RunHandlers;
+  std::vector<WrapCallCallback *> CallHandlers;
+  const CompiledPointcutSet *Compiled = nullptr;
+  FallbackMatches *Fallback = nullptr;
+
+  // Callees are looked up once per call site; their match once per TU
+  llvm::DenseMap<const clang::FunctionDecl *, std::optional<u32>> CalleeMatches;
+  FunctionFacts Scratch;
+
+  // Scope facts of within(), per file and per namespace
+  const clang::SourceManager *SM = nullptr;
+  llvm::DenseMap<clang::FileID, llvm::StringRef> FileNames;
+  llvm::DenseMap<clang::FileID, bool> FilesInScope;
+  llvm::DenseMap<const clang::DeclContext *, llvm::StringRef> NamespaceNames;
+  llvm::BumpPtrAllocator NameAllocator;
+  llvm::UniqueStringSaver Names{NameAllocator};
+  bool Pruning = false;
+
+  // Class names and base closures of method_of() and inherits(), per class
+  ClassHierarchy Classes;
+  // Direct calls of the TU for calls() and called_by(), built once in run()
+  TUCallGraph Calls;
+};
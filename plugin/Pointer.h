@@ -6,10 +6,21 @@
 #include "clang/AST/Stmt.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
+#include "llvm/ADT/DenseMap.h"
 
 using RunMatcherPtr = clang::ast_matchers::internal::Matcher<clang::Decl>;
 
 using CallMatcherPtr = clang::ast_matchers::internal::Matcher<clang::Stmt>;
 
+// Results of a referenced pointcut per function, shared by its references
+using PointcutRefResults = llvm::DenseMap<const clang::Decl *, bool>;
+
+// The call graph of the TU for calls() and called_by() matchers, built by the
+// consumer before MatchFinder runs
+class TUCallGraph;
+// Base closures of the classes of the TU for inherits() matchers, filled as
+// they ask
+class ClassHierarchy;
+
 struct AbstractAST2Matcher;
 using AbstractAST2MatcherPtr = std::unique_ptr<AbstractAST2Matcher>;
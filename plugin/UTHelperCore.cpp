@@ -0,0 +1,117 @@
+#include "UTHelperCore.h"
+
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+// Runs the context's consumer and keeps the rewritten main file.
+class CoreTransformAction : public clang::ASTFrontendAction {
+public:
+  CoreTransformAction(const UTHelperContext &Context, std::string &Output,
+                      bool &Rewritten)
+      : Context(Context), Output(Output), Rewritten(Rewritten) {}
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override {
+    Rewrite.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
+    return Context.createConsumer(Rewrite);
+  }
+
+  void EndSourceFileAction() override {
+    clang::SourceManager &SM = Rewrite.getSourceMgr();
+    if (const llvm::RewriteBuffer *RewriteBuf =
+            Rewrite.getRewriteBufferFor(SM.getMainFileID())) {
+      Output.assign(RewriteBuf->begin(), RewriteBuf->end());
+      Rewritten = true;
+    }
+  }
+
+private:
+  const UTHelperContext &Context;
+  std::string &Output;
+  bool &Rewritten;
+  clang::Rewriter Rewrite;
+};
+
+// Single edit covering everything between the common prefix and suffix.
+std::vector<TextEdit> computeEdits(llvm::StringRef Before, llvm::StringRef After) {
+  size_t Prefix = 0;
+  size_t MaxPrefix = std::min(Before.size(), After.size());
+  while (Prefix < MaxPrefix && Before[Prefix] == After[Prefix])
+    ++Prefix;
+  size_t Suffix = 0;
+  while (Suffix < MaxPrefix - Prefix &&
+         Before[Before.size() - 1 - Suffix] == After[After.size() - 1 - Suffix])
+    ++Suffix;
+  if (Prefix == Before.size() && Prefix == After.size())
+    return {};
+  TextEdit Edit;
+  Edit.Offset = Prefix;
+  Edit.Length = Before.size() - Prefix - Suffix;
+  Edit.Replacement = After.substr(Prefix, After.size() - Prefix - Suffix).str();
+  return {std::move(Edit)};
+}
+
+} // namespace
+
+UTHelperContext::UTHelperContext(UTHelperOptions Opts) : Opts(std::move(Opts)) {}
+
+std::unique_ptr<clang::ASTConsumer>
+UTHelperContext::createConsumer(clang::Rewriter &Rewrite) const {
+  return createUTHelperConsumer(Rewrite, Opts);
+}
+
+TransformResult UTHelperContext::transform(llvm::StringRef Buffer,
+                                           llvm::StringRef FileName,
+                                           llvm::ArrayRef<std::string> CompileArgs,
+                                           TransformOutput Kind) const {
+  TransformResult Result;
+
+  // Per-call file system: the buffer is served from memory, everything else
+  // (headers) from disk.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> OverlayFS(
+      new llvm::vfs::OverlayFileSystem(llvm::vfs::getRealFileSystem()));
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFS(
+      new llvm::vfs::InMemoryFileSystem);
+  OverlayFS->pushOverlay(InMemoryFS);
+  InMemoryFS->addFile(FileName, 0,
+                      llvm::MemoryBuffer::getMemBufferCopy(Buffer, FileName));
+  llvm::IntrusiveRefCntPtr<clang::FileManager> Files(
+      new clang::FileManager(clang::FileSystemOptions(), OverlayFS));
+
+  std::vector<std::string> CommandLine = {"uthelper", "-fsyntax-only"};
+  CommandLine.insert(CommandLine.end(), CompileArgs.begin(), CompileArgs.end());
+  CommandLine.push_back(FileName.str());
+
+  std::string Output;
+  bool Rewritten = false;
+  llvm::raw_string_ostream DiagStream(Result.Diagnostics);
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts(
+      new clang::DiagnosticOptions());
+  clang::TextDiagnosticPrinter DiagPrinter(DiagStream, DiagOpts.get());
+
+  clang::tooling::ToolInvocation Invocation(
+      CommandLine, std::make_unique<CoreTransformAction>(*this, Output, Rewritten),
+      Files.get());
+  Invocation.setDiagnosticConsumer(&DiagPrinter);
+  Result.Success = Invocation.run();
+  DiagStream.flush();
+  if (!Result.Success)
+    return Result;
+
+  if (!Rewritten)
+    Output = Buffer.str();
+  if (Kind == TransformOutput::Edits)
+    Result.Edits = computeEdits(Buffer, Output);
+  else
+    Result.Output = std::move(Output);
+  return Result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// UTHelperCore - the UTHelper transformations as an embeddable library.
+//
+// All state lives in a UTHelperContext and in the objects created per call,
+// so independent contexts (or one context shared read-only) can transform
+// many buffers concurrently on different threads of one process.
+
+#include "UTHelperOptions.h"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Replace Length bytes at Offset of the input buffer with Replacement.
+struct TextEdit {
+  unsigned Offset = 0;
+  unsigned Length = 0;
+  std::string Replacement;
+};
+
+enum class TransformOutput {
+  Buffer, // TransformResult::Output holds the whole rewritten buffer
+  Edits,  // TransformResult::Edits holds the changes against the input
+};
+
+struct TransformResult {
+  bool Success = false;
+  std::string Output;
+  std::vector<TextEdit> Edits;
+  // Compiler diagnostics of this run (never written to a global stream)
+  std::string Diagnostics;
+};
+
+class UTHelperContext {
+public:
+  explicit UTHelperContext(UTHelperOptions Opts);
+
+  const UTHelperOptions &getOptions() const { return Opts; }
+
+  // Consumer for an existing compiler instance (plugin, watch tool).
+  std::unique_ptr<clang::ASTConsumer> createConsumer(clang::Rewriter &Rewrite) const;
+
+  // Parse Buffer as FileName with CompileArgs (compiler flags without the
+  // compiler path and input file) and run the configured transformations.
+  // Pass -resource-dir in CompileArgs when builtin headers are needed.
+  TransformResult transform(llvm::StringRef Buffer, llvm::StringRef FileName,
+                            llvm::ArrayRef<std::string> CompileArgs,
+                            TransformOutput Kind = TransformOutput::Buffer) const;
+
+private:
+  UTHelperOptions Opts;
+};
@@ -0,0 +1,156 @@
+#include "UTHelperOptions.h"
+#include "WrapFunctionConsumer.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+bool UTHelperOptions::parseArg(llvm::StringRef Arg) {
+  if (Arg.starts_with("pointcut=")) {
+    PointcutText = Arg.substr(strlen("pointcut=")).str();
+    if (PointcutText.empty()) {
+      llvm::errs() << "Empty pointcut text\n";
+      return false;
+    }
+  } else if (Arg.starts_with("pointcut-cache=")) {
+    PointcutCacheDir = Arg.substr(strlen("pointcut-cache=")).str();
+  } else if (Arg.starts_with("max-overhead-ratio=")) {
+    llvm::StringRef Ratio = Arg.substr(strlen("max-overhead-ratio="));
+    if (Ratio.getAsDouble(MaxOverheadRatio) || MaxOverheadRatio < 0) {
+      llvm::errs() << "Invalid max-overhead-ratio: " << Ratio
+                   << " (expected a non-negative number)\n";
+      return false;
+    }
+  } else if (Arg == "query" || Arg.starts_with("query=")) {
+    llvm::StringRef Format = Arg == "query" ? "json" : Arg.substr(strlen("query="));
+    if (Format == "json") {
+      Query = QueryFormat::Json;
+    } else if (Format == "csv") {
+      Query = QueryFormat::Csv;
+    } else {
+      llvm::errs() << "Unknown query format: " << Format
+                   << " (expected json or csv)\n";
+      return false;
+    }
+  } else if (Arg.starts_with("base-folder=")) {
+    BaseFolder = Arg.substr(strlen("base-folder=")).str();
+  } else if (Arg == "static-pointcut") {
+    StaticBinding = true;
+  } else if (Arg == "disable-remove-final") {
+    DisableRemoveFinal = true;
+  } else if (Arg == "disable-make-virtual") {
+    DisableMakeVirtual = true;
+  } else if (Arg == "disable-add-friend") {
+    DisableAddFriend = true;
+  } else if (Arg.starts_with("engine=")) {
+    llvm::StringRef Name = Arg.substr(strlen("engine="));
+    if (Name == "bytecode") {
+      Engine = PointcutEngine::Bytecode;
+    } else if (Name == "matcher") {
+      Engine = PointcutEngine::Matcher;
+    } else {
+      llvm::errs() << "Unknown pointcut engine: " << Name
+                   << " (expected bytecode or matcher)\n";
+      return false;
+    }
+  } else if (Arg.starts_with("matcher-pointcuts=")) {
+    llvm::SmallVector<llvm::StringRef, 4> Names;
+    Arg.substr(strlen("matcher-pointcuts=")).split(Names, ',', -1, false);
+    for (llvm::StringRef Name : Names)
+      MatcherPointcuts.push_back(Name.trim().str());
+  } else if (Arg.starts_with("custom-friends=")) {
+    parseFriendsList(Arg.substr(strlen("custom-friends=")).str());
+  } else {
+    llvm::errs() << "Unknown argument: " << Arg << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool UTHelperOptions::finalize() {
+  // Validate that base-folder is provided (mandatory)
+  if (BaseFolder.empty()) {
+    llvm::errs() << "Error: base-folder parameter is mandatory\n";
+    llvm::errs() << "Usage: -Xclang -plugin-arg-uthelper -Xclang base-folder=<path>\n";
+    return false;
+  }
+  if (Query != QueryFormat::None && PointcutText.empty() && !Compiled) {
+    llvm::errs() << "Error: query needs pointcuts (pointcut=<file>)\n";
+    return false;
+  }
+  // Convert to absolute path if relative
+  if (!llvm::sys::path::is_absolute(BaseFolder)) {
+    llvm::SmallString<256> AbsPath(BaseFolder);
+    std::error_code EC = llvm::sys::fs::make_absolute(AbsPath);
+    if (EC) {
+      llvm::errs() << "Failed to resolve base folder path: " << EC.message() << "\n";
+      return false;
+    }
+    BaseFolder = std::string(AbsPath.str());
+  }
+  // Ensure it ends with a separator for easier comparison
+  if (BaseFolder.back() != llvm::sys::path::get_separator()[0]) {
+    BaseFolder += llvm::sys::path::get_separator();
+  }
+  return true;
+}
+
+void UTHelperOptions::parseFriendsList(const std::string &FriendsList) {
+  // Parse semicolon-separated list of friend templates
+  size_t Start = 0;
+  size_t End = FriendsList.find(';');
+
+  while (End != std::string::npos) {
+    std::string FriendText = FriendsList.substr(Start, End - Start);
+    if (!FriendText.empty()) {
+      CustomFriends.push_back({FriendText});
+    }
+    Start = End + 1;
+    End = FriendsList.find(';', Start);
+  }
+
+  // Don't forget the last one
+  if (Start < FriendsList.length()) {
+    std::string FriendText = FriendsList.substr(Start);
+    if (!FriendText.empty()) {
+      CustomFriends.push_back({FriendText});
+    }
+  }
+}
+
+std::unique_ptr<clang::ASTConsumer>
+createUTHelperConsumer(clang::Rewriter &Rewrite, const UTHelperOptions &Opts) {
+  // Check if base-folder is provided (mandatory)
+  if (Opts.BaseFolder.empty()) {
+    llvm::errs() << "Error: base-folder parameter is mandatory\n";
+    return nullptr;
+  }
+
+  // If pointcut mode is specified, use only that
+  if (!Opts.PointcutText.empty()) {
+    auto Consumer = std::make_unique<WrapFunctionConsumer>(
+        Rewrite, Opts.PointcutText, Opts.Engine, Opts.PointcutCacheDir,
+        Opts.MatcherPointcuts);
+    Consumer->setBaseFolder(Opts.BaseFolder);
+    Consumer->setMaxOverheadRatio(Opts.MaxOverheadRatio);
+    Consumer->setStaticBinding(Opts.StaticBinding);
+    Consumer->setQuery(Opts.Query, Opts.QueryOutput ? *Opts.QueryOutput : llvm::outs());
+    return Consumer;
+  }
+  if (Opts.Compiled) {
+    auto Consumer = std::make_unique<WrapFunctionConsumer>(Rewrite, *Opts.Compiled);
+    Consumer->setBaseFolder(Opts.BaseFolder);
+    Consumer->setMaxOverheadRatio(Opts.MaxOverheadRatio);
+    Consumer->setStaticBinding(Opts.StaticBinding);
+    Consumer->setQuery(Opts.Query, Opts.QueryOutput ? *Opts.QueryOutput : llvm::outs());
+    return Consumer;
+  }
+
+  // Default mode: all transformations enabled unless explicitly disabled
+  return std::make_unique<UnifiedASTConsumer>(Rewrite, Opts.BaseFolder,
+                                              !Opts.DisableRemoveFinal,
+                                              !Opts.DisableMakeVirtual,
+                                              !Opts.DisableAddFriend,
+                                              Opts.CustomFriends);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "UnifiedASTVisitor.h"
+#include "CompiledPointcuts.h"
+#include "JoinPointQuery.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// How pointcuts are matched against the TU
+enum class PointcutEngine {
+  Bytecode, // compiled programs run from one RecursiveASTVisitor pass
+  Matcher,  // one clang ASTMatcher per pointcut, run by MatchFinder
+};
+
+// Options shared by the clang plugin and the standalone uthelper tool.
+struct UTHelperOptions {
+  std::string PointcutText;
+  std::string BaseFolder;
+  bool DisableRemoveFinal = false;
+  bool DisableMakeVirtual = false;
+  bool DisableAddFriend = false;
+  std::vector<FriendTemplate> CustomFriends;
+  PointcutEngine Engine = PointcutEngine::Bytecode;
+  // matcher-pointcuts=a,b: pointcuts matched by MatchFinder although the
+  // engine is bytecode, to compare the engines on them
+  std::vector<std::string> MatcherPointcuts;
+  // Directory for cached pointcut images; empty stores them next to the file
+  std::string PointcutCacheDir;
+  // Functions whose wrapper would cost more than this many times their own
+  // estimated body weight are not wrapped (reported instead); 0 wraps all
+  double MaxOverheadRatio = 0;
+  // Wrappers use StaticPointcut<&f__wrapped__> (saop.h): proceed() is a
+  // direct call that inlines, but there is no func_size
+  bool StaticBinding = false;
+  // query=json|csv: list the join points of the pointcuts on QueryOutput
+  // (stdout when null) instead of rewriting; needs pointcuts
+  QueryFormat Query = QueryFormat::None;
+  llvm::raw_ostream *QueryOutput = nullptr;
+  // Set by plugin variants with pointcuts compiled in (UTHELPER_AOT_POINTCUTS);
+  // used in place of a pointcut file when none is given
+  const CompiledPointcutSet *Compiled = nullptr;
+
+  // Parse one "key=value" / flag argument as passed with
+  // -plugin-arg-uthelper. Returns false (and reports) on unknown arguments.
+  bool parseArg(llvm::StringRef Arg);
+
+  // Normalizes BaseFolder to an absolute path with a trailing separator.
+  bool finalize();
+
+  void parseFriendsList(const std::string &FriendsList);
+};
+
+// Create the consumer that performs the requested transformations.
+std::unique_ptr<clang::ASTConsumer>
+createUTHelperConsumer(clang::Rewriter &Rewrite, const UTHelperOptions &Opts);
@@ -5,8 +5,6 @@
 #include "clang/Lex/Lexer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
-#include <sstream>
-#include <regex>
 
 // FriendTemplate implementation
 std::string FriendTemplate::instantiate(const std::string& namespaceName, 
@@ -0,0 +1,269 @@
+#include "WrapCallCallback.h"
+#include "FallbackMatches.h"
+#include "JoinPointQuery.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/QualTypeNames.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+// Spelling of T that is valid at any call site of the TU
+std::string qualifiedTypeName(clang::QualType T, clang::ASTContext &Context) {
+  clang::PrintingPolicy Policy = Context.getPrintingPolicy();
+  Policy.SuppressUnwrittenScope = true;
+  return clang::TypeName::getFullyQualifiedName(T, Context, Policy,
+                                                /*WithGlobalNsPrefix=*/true);
+}
+
+std::string qualifiedFunctionName(const clang::FunctionDecl *Func,
+                                  clang::ASTContext &Context) {
+  clang::PrintingPolicy Policy = Context.getPrintingPolicy();
+  Policy.SuppressUnwrittenScope = true;
+  std::string Name;
+  llvm::raw_string_ostream OS(Name);
+  OS << "::";
+  Func->printQualifiedName(OS, Policy);
+  return OS.str();
+}
+
+} // namespace
+
+WrapCallCallback::WrapCallCallback(
+    clang::Rewriter &Rewrite, llvm::StringRef Id,
+    llvm::DenseSet<const clang::CallExpr *> &Woven)
+    : Rewrite(Rewrite), Id(Id.str()), Woven(Woven) {}
+
+void WrapCallCallback::run(
+    const clang::ast_matchers::MatchFinder::MatchResult &Result) {
+  const clang::CallExpr *Call = Result.Nodes.getNodeAs<clang::CallExpr>(Id);
+  if (!Call)
+    return;
+  if (Fallback)
+    Fallback->addCall(Call, {Order, this});
+  else
+    weave(Call, *Result.Context);
+}
+
+void WrapCallCallback::weave(const clang::CallExpr *Call,
+                             clang::ASTContext &Context) {
+  const clang::FunctionDecl *Callee = Call->getDirectCallee();
+  if (!Callee || !canWeave(Call, Callee, Context))
+    return;
+  if (!Woven.insert(Call).second)
+    return;
+  if (Query) {
+    Query->addCall(Id, Call, Callee, Context.getSourceManager());
+    return;
+  }
+
+  if (const auto *MemberCall = llvm::dyn_cast<clang::CXXMemberCallExpr>(Call))
+    weaveMemberCall(MemberCall, llvm::cast<clang::CXXMethodDecl>(Callee),
+                    Context);
+  else
+    weaveFreeCall(Call, Callee, Context);
+}
+
+bool WrapCallCallback::canWeave(const clang::CallExpr *Call,
+                                const clang::FunctionDecl *Callee,
+                                clang::ASTContext &Context) {
+  clang::SourceManager &SM = Context.getSourceManager();
+  if (!isInBaseFolder(Call->getBeginLoc(), SM))
+    return false;
+  // Text from macro expansions cannot be rewritten in place
+  if (Call->getBeginLoc().isMacroID() || Call->getEndLoc().isMacroID())
+    return false;
+  // Operators, builtins and C varargs have no around() to forward to
+  if (llvm::isa<clang::CXXOperatorCallExpr>(Call) ||
+      Callee->getBuiltinID() != 0 || Callee->isVariadic() ||
+      Callee->isOverloadedOperator())
+    return false;
+
+  for (const clang::Expr *Arg : Call->arguments()) {
+    // Defaulted arguments have no text to cast
+    if (llvm::isa<clang::CXXDefaultArgExpr>(Arg))
+      return false;
+    if (Arg->getBeginLoc().isMacroID() || Arg->getEndLoc().isMacroID())
+      return false;
+    // static_cast<T>({...}) is ill-formed
+    if (*SM.getCharacterData(Arg->getBeginLoc()) == '{')
+      return false;
+  }
+
+  // A static member called through an object with side effects keeps the
+  // object expression (see weaveFreeCall), except behind parentheses:
+  // (f().s)(a)
+  if (const auto *Member = llvm::dyn_cast<clang::MemberExpr>(
+          Call->getCallee()->IgnoreParenImpCasts())) {
+    if (!llvm::isa<clang::CXXMemberCallExpr>(Call) &&
+        Member->getBase()->HasSideEffects(Context) &&
+        Call->getCallee()->IgnoreImpCasts() != Member)
+      return false;
+  }
+
+  if (const auto *MemberCall = llvm::dyn_cast<clang::CXXMemberCallExpr>(Call)) {
+    const auto *Member =
+        llvm::dyn_cast<clang::MemberExpr>(MemberCall->getCallee()->IgnoreParens());
+    if (!Member)
+      return false; // pointer-to-member call
+    // Qualified calls (obj.Base::m()) bypass virtual dispatch; the trampoline
+    // would not
+    if (Member->hasQualifier())
+      return false;
+    const auto *Method = llvm::dyn_cast<clang::CXXMethodDecl>(Callee);
+    if (!Method || Method->getRefQualifier() == clang::RQ_RValue)
+      return false;
+    // The object is passed by address
+    if (!Member->isArrow() && !Member->getBase()->isLValue())
+      return false;
+  }
+  return true;
+}
+
+std::string WrapCallCallback::templateArguments(const clang::FunctionDecl *Callee,
+                                                clang::ASTContext &Context) {
+  std::string Args = qualifiedTypeName(Callee->getReturnType(), Context);
+  for (const clang::ParmVarDecl *Param : Callee->parameters())
+    Args += ", " + qualifiedTypeName(Param->getType(), Context);
+  return Args;
+}
+
+void WrapCallCallback::castArguments(const clang::CallExpr *Call,
+                                     const clang::FunctionDecl *Callee,
+                                     clang::ASTContext &Context) {
+  // around() takes Args&&..., so every argument is converted to the exact
+  // parameter type first, as the original call would have done
+  for (unsigned i = 0; i < Call->getNumArgs(); ++i) {
+    const clang::Expr *Arg = Call->getArg(i);
+    std::string ParamType =
+        qualifiedTypeName(Callee->getParamDecl(i)->getType(), Context);
+    Rewrite.InsertTextBefore(Arg->getBeginLoc(),
+                             "static_cast<" + ParamType + ">(");
+    Rewrite.InsertTextAfterToken(Arg->getEndLoc(), ")");
+  }
+}
+
+void WrapCallCallback::weaveFreeCall(const clang::CallExpr *Call,
+                                     const clang::FunctionDecl *Callee,
+                                     clang::ASTContext &Context) {
+  // The explicit template arguments pick the exact overload / specialization
+  // that the original call resolved to
+  std::string NewCallee = "createCallPointcut<" +
+                          templateArguments(Callee, Context) + ">(&" +
+                          qualifiedFunctionName(Callee, Context) +
+                          ").template around<PointcutName::" + Id + ">";
+  const auto *Member = llvm::dyn_cast<clang::MemberExpr>(
+      Call->getCallee()->IgnoreImpCasts());
+  if (Member && Member->getBase()->HasSideEffects(Context)) {
+    // Static member through an object with side effects (f().s(a)): the
+    // object is still evaluated first
+    //   ((void)(f()), createCallPointcut<...>(&::C::s).template around<...>(a))
+    Rewrite.InsertTextBefore(Call->getBeginLoc(), "((void)(");
+    Rewrite.ReplaceText(
+        clang::CharSourceRange::getTokenRange(Member->getOperatorLoc(),
+                                              Member->getEndLoc()),
+        "), " + NewCallee);
+    Rewrite.InsertTextAfterToken(Call->getEndLoc(), ")");
+  } else {
+    Rewrite.ReplaceText(
+        clang::CharSourceRange::getTokenRange(Call->getCallee()->getSourceRange()),
+        NewCallee);
+  }
+  castArguments(Call, Callee, Context);
+}
+
+void WrapCallCallback::weaveMemberCall(const clang::CXXMemberCallExpr *Call,
+                                       const clang::CXXMethodDecl *Callee,
+                                       clang::ASTContext &Context) {
+  const auto *Member =
+      llvm::cast<clang::MemberExpr>(Call->getCallee()->IgnoreParens());
+  const clang::Expr *Base = Member->getBase();
+
+  // Static type of the object expression, cv-qualifiers included, so the
+  // trampoline converts back to exactly what the caller had
+  clang::QualType ObjectType = Base->getType();
+  if (Member->isArrow())
+    ObjectType = ObjectType->getPointeeType();
+
+  // Unqualified call in the trampoline keeps virtual dispatch. Its parameters
+  // are P&& (a reference P as it is), so the arguments reach the method
+  // without being constructed once more
+  std::string Trampoline;
+  llvm::raw_string_ostream OS(Trampoline);
+  OS << "[](void* obj_";
+  for (unsigned i = 0; i < Callee->getNumParams(); ++i) {
+    clang::QualType ParamType = Callee->getParamDecl(i)->getType();
+    OS << ", " << qualifiedTypeName(ParamType, Context)
+       << (ParamType->isReferenceType() ? "" : "&&") << " a" << i;
+  }
+  OS << ") -> " << qualifiedTypeName(Callee->getReturnType(), Context) << " { "
+     << "return static_cast<" << qualifiedTypeName(ObjectType, Context)
+     << "*>(obj_)->" << Callee->getNameAsString() << "(";
+  for (unsigned i = 0; i < Callee->getNumParams(); ++i) {
+    if (i > 0)
+      OS << ", ";
+    OS << "std::forward<"
+       << qualifiedTypeName(Callee->getParamDecl(i)->getType(), Context)
+       << ">(a" << i << ")";
+  }
+  OS << "); }";
+
+  std::string Prefix = "createCallPointcut<" +
+                       templateArguments(Callee, Context) + ">(" + OS.str() +
+                       ", (void*)";
+  std::string Suffix = ").template around<PointcutName::" + Id + ">";
+
+  if (Member->isImplicitAccess()) {
+    // m(a) inside a member function: the base is an implicit this
+    Rewrite.ReplaceText(
+        clang::CharSourceRange::getTokenRange(Member->getSourceRange()),
+        Prefix + "this" + Suffix);
+  } else {
+    // Keep the object expression's text (and any rewrites inside it) and
+    // wrap around it
+    Rewrite.InsertTextBefore(Base->getBeginLoc(),
+                             Prefix + (Member->isArrow() ? "(" : "std::addressof("));
+    Rewrite.ReplaceText(clang::CharSourceRange::getTokenRange(
+                            Member->getOperatorLoc(), Member->getEndLoc()),
+                        ")" + Suffix);
+  }
+  castArguments(Call, Callee, Context);
+}
+
+void WrapCallCallback::setBaseFolder(const std::string &Folder) {
+  BaseFolder = Folder;
+}
+
+void WrapCallCallback::setQuery(JoinPointQuery *NewQuery) {
+  Query = NewQuery;
+}
+
+bool WrapCallCallback::isInBaseFolder(clang::SourceLocation Loc,
+                                      clang::SourceManager &SM) {
+  if (BaseFolder.empty()) {
+    return true; // No base folder specified, process all files
+  }
+
+  if (!Loc.isValid() || !SM.isInMainFile(Loc)) {
+    return false;
+  }
+
+  std::string Filename = SM.getFilename(Loc).str();
+  if (Filename.empty()) {
+    return false;
+  }
+
+  // Convert to absolute path if needed
+  llvm::SmallString<256> AbsPath(Filename);
+  if (!llvm::sys::path::is_absolute(AbsPath)) {
+    if (std::error_code EC = llvm::sys::fs::make_absolute(AbsPath)) {
+      return false;
+    }
+  }
+
+  // Check if the file is under the base folder
+  return AbsPath.str().starts_with(BaseFolder);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringRef.h"
+
+class FallbackMatches;
+class JoinPointQuery;
+
+// Call-site weaving for call_pointcut: rewrites each matched call expression
+//   foo(a, b)      ->  createCallPointcut<RT, P0, P1>(&::foo)
+//                          .template around<PointcutName::Id>(
+//                              static_cast<P0>(a), static_cast<P1>(b))
+//   obj.m(a)       ->  createCallPointcut<RT, P0>(<trampoline>, (void*)&obj)
+//                          .template around<PointcutName::Id>(static_cast<P0>(a))
+// The callee itself is left untouched, so other callers pay nothing.
+class WrapCallCallback
+    : public clang::ast_matchers::MatchFinder::MatchCallback {
+public:
+  // Id is both the name the CallExpr is bound to and the PointcutName
+  // enumerator passed to around. Woven is shared by all call pointcuts of one
+  // TU so a call matched by several of them is rewritten once.
+  WrapCallCallback(clang::Rewriter &Rewrite, llvm::StringRef Id,
+                   llvm::DenseSet<const clang::CallExpr *> &Woven);
+
+  void
+  run(const clang::ast_matchers::MatchFinder::MatchResult &Result) override;
+
+  // Weave a call already known to match this pointcut
+  void weave(const clang::CallExpr *Call, clang::ASTContext &Context);
+
+  void setBaseFolder(const std::string &BaseFolder);
+  // With a query, matched calls are recorded there instead of rewritten
+  void setQuery(JoinPointQuery *Query);
+  // See WrapFunctionCallback::setOrder and setFallback
+  void setOrder(unsigned NewOrder) { Order = NewOrder; }
+  unsigned getOrder() const { return Order; }
+  void setFallback(FallbackMatches *NewFallback) { Fallback = NewFallback; }
+  llvm::StringRef getId() const { return Id; }
+
+private:
+  bool canWeave(const clang::CallExpr *Call, const clang::FunctionDecl *Callee,
+                clang::ASTContext &Context);
+  void weaveFreeCall(const clang::CallExpr *Call,
+                     const clang::FunctionDecl *Callee,
+                     clang::ASTContext &Context);
+  void weaveMemberCall(const clang::CXXMemberCallExpr *Call,
+                       const clang::CXXMethodDecl *Callee,
+                       clang::ASTContext &Context);
+  void castArguments(const clang::CallExpr *Call,
+                     const clang::FunctionDecl *Callee,
+                     clang::ASTContext &Context);
+  std::string templateArguments(const clang::FunctionDecl *Callee,
+                                clang::ASTContext &Context);
+
+  bool isInBaseFolder(clang::SourceLocation Loc, clang::SourceManager &SM);
+
+  clang::Rewriter &Rewrite;
+  std::string Id;
+  llvm::DenseSet<const clang::CallExpr *> &Woven;
+  std::string BaseFolder;
+  JoinPointQuery *Query = nullptr;
+  unsigned Order = 0;
+  FallbackMatches *Fallback = nullptr;
+};
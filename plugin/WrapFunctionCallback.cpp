@@ -1,30 +1,108 @@
 #include "WrapFunctionCallback.h"
+#include "DeclBody.h"
+#include "FallbackMatches.h"
+#include "JoinPointQuery.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/Lex/Lexer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Path.h"
 
-WrapFunctionCallback::WrapFunctionCallback(clang::Rewriter &Rewrite,
-                                           llvm::StringRef Id)
-    : Rewrite(Rewrite), Id(Id) {}
+namespace {
+
+// Whether a by-value parameter is worth passing on by reference: the caller
+// already materialized it in the wrapper's parameter, and passing it on by
+// value would construct it once more (a move, or a copy for types without
+// one) on the way to the original body. Scalars and small trivially
+// copyable classes travel in registers and stay by value.
+bool passesByReference(const clang::ParmVarDecl *Param,
+                       clang::ASTContext &Context) {
+  clang::QualType Type = Param->getType();
+  if (Type->isDependentType() || Type->isIncompleteType() ||
+      !Type->isRecordType())
+    return false;
+  if (!Type.isTriviallyCopyableType(Context))
+    return true;
+  return Context.getTypeSize(Type) > 2 * Context.getTypeSize(Context.VoidPtrTy);
+}
+
+// The parameters of the wrapped function that become rvalue references to
+// the wrapper's parameters, and only when every such parameter is spelled in
+// the file in each declaration. The definition in this TU decides for every
+// declaration of the function, so the renamed ones keep agreeing: the
+// in-class declaration of an out-of-line method gets the same && as its
+// definition. Declarations that stay unrenamed (in a header, or not matched)
+// declare the wrapper, which keeps the declared signature. Without a
+// definition in the TU every parameter stays by value.
+std::vector<bool> byReferenceParams(const clang::FunctionDecl *Func,
+                                    clang::ASTContext &Context) {
+  std::vector<bool> ByReference(Func->getNumParams(), false);
+  const clang::FunctionDecl *Definition = Func->getDefinition();
+  if (!Definition)
+    return ByReference;
+  for (unsigned i = 0; i < Func->getNumParams(); ++i) {
+    if (!passesByReference(Definition->getParamDecl(i), Context))
+      continue;
+    for (const clang::FunctionDecl *Redecl : Func->redecls()) {
+      const clang::ParmVarDecl *Param = Redecl->getParamDecl(i);
+      if (Param->getLocation().isMacroID() || Param->getBeginLoc().isMacroID())
+        return std::vector<bool>(Func->getNumParams(), false);
+    }
+    ByReference[i] = true;
+  }
+  return ByReference;
+}
+
+} // namespace
+
+WrapFunctionCallback::WrapFunctionCallback(
+    clang::Rewriter &Rewrite, llvm::StringRef Id,
+    llvm::DenseSet<const clang::FunctionDecl *> &Wrapped)
+    : Rewrite(Rewrite), Id(Id.str()), Wrapped(Wrapped) {}
 
 void WrapFunctionCallback::run(
     const clang::ast_matchers::MatchFinder::MatchResult &Result) {
   const clang::FunctionDecl *Func =
       Result.Nodes.getNodeAs<clang::FunctionDecl>(Id);
-  if (!Func || Func->isImplicit())
+  if (!Func)
     return;
+  if (Fallback)
+    Fallback->addFunction(Func, {Order, this});
+  else
+    wrap(Func, Result.Context);
+}
 
-  processFunction(Func, Result.Context);
+void WrapFunctionCallback::wrap(const clang::FunctionDecl *Func,
+                                clang::ASTContext *Context) {
+  if (Func->isImplicit())
+    return;
+  if (!Wrapped.insert(Func).second)
+    return;
+
+  processFunction(Func, Context);
 }
+
 void WrapFunctionCallback::processFunction(const clang::FunctionDecl *Func,
                                            clang::ASTContext *Context) {
   // Check if function is in base folder
   if (!isInBaseFolder(Func->getLocation(), Context->getSourceManager())) {
     return;
   }
-  
+
+  // A tiny function would spend most of its time in the wrapper
+  if (MaxOverheadRatio > 0) {
+    u32 BodyWeight = BodyEstimator::getWeight(Func);
+    if (exceedsOverheadRatio(BodyWeight, MaxOverheadRatio)) {
+      Skipped.push_back({Func->getQualifiedNameAsString(), BodyWeight});
+      return;
+    }
+  }
+
+  if (Query) {
+    Query->addFunction(Id, Func, Context->getSourceManager());
+    return;
+  }
+
   std::string OriginalName = Func->getNameAsString();
   std::string WrappedName = OriginalName + "__wrapped__";
 
@@ -57,6 +135,21 @@ void WrapFunctionCallback::processFunction(const clang::FunctionDecl *Func,
   unsigned NameLength = OriginalName.length();
   Rewrite.ReplaceText(ActualImpFuncNameLoc, NameLength, WrappedName);
 
+  // Each argument is materialized once, in the wrapper's parameter; around()
+  // and proceed() pass references to it, and heavy by-value parameters of the
+  // wrapped function bind to it as rvalue references
+  std::vector<bool> ByReference = byReferenceParams(Func, *Context);
+  for (unsigned i = 0; i < Func->getNumParams(); ++i) {
+    if (!ByReference[i])
+      continue;
+    const clang::ParmVarDecl *Param = Func->getParamDecl(i);
+    if (Param->getIdentifier())
+      Rewrite.InsertTextBefore(Param->getLocation(), "&&");
+    else
+      Rewrite.InsertTextAfterToken(
+          Param->getTypeSourceInfo()->getTypeLoc().getEndLoc(), "&&");
+  }
+
   // Insert the wrapper function after the original function
   clang::SourceLocation InsertLoc;
   if (IsDefinition) {
@@ -80,8 +173,9 @@ void WrapFunctionCallback::processFunction(const clang::FunctionDecl *Func,
     }
   }
 
-  // Insert inline assembly markers in the wrapped function
-  if (IsDefinition && Func->hasBody()) {
+  // Insert inline assembly markers in the wrapped function. A statically
+  // bound wrapper may inline the wrapped body, which would define them twice.
+  if (IsDefinition && Func->hasBody() && !StaticBinding) {
     clang::SourceLocation FuncStart =
         Func->getBody()->getBeginLoc().getLocWithOffset(1);
     clang::SourceLocation FuncEnd = Func->getBody()->getEndLoc();
@@ -148,6 +242,8 @@ void WrapFunctionCallback::processFunction(const clang::FunctionDecl *Func,
         if (i > 0)
           WrapperDecl += ", ";
         WrapperDecl += Func->getParamDecl(i)->getType().getAsString();
+        if (ByReference[i])
+          WrapperDecl += "&&";
         WrapperDecl += " " + Func->getParamDecl(i)->getNameAsString();
       }
       WrapperDecl += ")";
@@ -211,30 +307,49 @@ std::string WrapFunctionCallback::buildWrapperFunction(
 
   OS << " {\n";
 
-  // Declare external symbols
-  OS << "    extern char " << QualifiedNameUnderbar << "_start_;\n";
-  OS << "    extern char " << QualifiedNameUnderbar << "_end_;\n";
-
-  // Create Pointcut
-  OS << "    auto pc = ";
-  if (IsMethod) {
-    if (IsStaticMethod) {
-      // Static member function
-      OS << "createPointcut(&" << ClassName << "::" << WrappedName << ", &"
-         << QualifiedNameUnderbar << "_start_, &" << QualifiedNameUnderbar << "_end_);\n";
+  if (StaticBinding) {
+    // The wrapped function is a template argument: proceed is a direct call
+    OS << "    auto pc = StaticPointcut<&";
+    if (IsMethod)
+      OS << ClassName << "::";
+    OS << WrappedName << ">(" << (IsMethod && !IsStaticMethod ? "this" : "")
+       << ");\n";
+  } else {
+    // Declare external symbols
+    OS << "    extern char " << QualifiedNameUnderbar << "_start_;\n";
+    OS << "    extern char " << QualifiedNameUnderbar << "_end_;\n";
+
+    // Descriptor for WovenRegistry, placed in its section by saop.h
+    OS << "    static const WovenFunction saop_woven_function_ SAOP_WOVEN_FUNCTION = {\"";
+    OS.write_escaped(Func->getQualifiedNameAsString());
+    OS << "\", PointcutName::" << Id << ", &" << QualifiedNameUnderbar
+       << "_start_, &" << QualifiedNameUnderbar << "_end_};\n";
+
+    // Create Pointcut
+    OS << "    auto pc = ";
+    if (IsMethod) {
+      if (IsStaticMethod) {
+        // Static member function
+        OS << "createPointcut(&" << ClassName << "::" << WrappedName << ", &"
+           << QualifiedNameUnderbar << "_start_, &" << QualifiedNameUnderbar << "_end_);\n";
+      } else {
+        // Non-static member function, called through a trampoline
+        // instantiated for it (see saop_detail::MemberTrampoline)
+        OS << "createPointcut<&" << ClassName << "::" << WrappedName
+           << ">(this, &" << QualifiedNameUnderbar << "_start_, &" << QualifiedNameUnderbar
+           << "_end_);\n";
+      }
     } else {
-      // Non-static member function
-      OS << "createPointcut(&" << ClassName << "::" << WrappedName
-         << ", this, &" << QualifiedNameUnderbar << "_start_, &" << QualifiedNameUnderbar
-         << "_end_);\n";
+      // Non-method function
+      OS << "createPointcut(&" << WrappedName << ", &" << QualifiedNameUnderbar
+         << "_start_, &" << QualifiedNameUnderbar << "_end_);\n";
     }
-  } else {
-    // Non-method function
-    OS << "createPointcut(&" << WrappedName << ", &" << QualifiedNameUnderbar
-       << "_start_, &" << QualifiedNameUnderbar << "_end_);\n";
   }
 
-  // Call around function
+  // Call around function. std::forward<T>(x) passes a by-value parameter on
+  // as an rvalue: around(Args&&...) and proceed() only bind references to it,
+  // down to the wrapped function (T&& there when passesByReference, else a
+  // cheap copy).
   OS << "    ";
   if (!Func->getReturnType()->isVoidType()) {
     OS << "return ";
@@ -257,6 +372,18 @@ void WrapFunctionCallback::setBaseFolder(const std::string &Folder) {
   BaseFolder = Folder;
 }
 
+void WrapFunctionCallback::setMaxOverheadRatio(double Ratio) {
+  MaxOverheadRatio = Ratio;
+}
+
+void WrapFunctionCallback::setQuery(JoinPointQuery *NewQuery) {
+  Query = NewQuery;
+}
+
+void WrapFunctionCallback::setStaticBinding(bool Static) {
+  StaticBinding = Static;
+}
+
 bool WrapFunctionCallback::isInBaseFolder(clang::SourceLocation Loc, clang::SourceManager &SM) {
   if (BaseFolder.empty()) {
     return true; // No base folder specified, process all files
@@ -2,19 +2,52 @@
 
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringRef.h"
 #include <cfloat>
+#include <string>
+#include <vector>
+
+class FallbackMatches;
+class JoinPointQuery;
 
 class WrapFunctionCallback
     : public clang::ast_matchers::MatchFinder::MatchCallback {
 public:
-  WrapFunctionCallback(clang::Rewriter &Rewrite,
-                       llvm::StringRef Id = "funcDecl");
+  // Id is both the name the FunctionDecl is bound to and the PointcutName
+  // enumerator of the generated wrapper. Wrapped is shared by all callbacks
+  // of one TU so a function matched by several pointcuts is wrapped once.
+  WrapFunctionCallback(clang::Rewriter &Rewrite, llvm::StringRef Id,
+                       llvm::DenseSet<const clang::FunctionDecl *> &Wrapped);
 
   void
   run(const clang::ast_matchers::MatchFinder::MatchResult &Result) override;
+
+  // Wrap a function already known to match this pointcut
+  void wrap(const clang::FunctionDecl *Func, clang::ASTContext *Context);
   
   void setBaseFolder(const std::string &BaseFolder);
+  // Functions whose wrapper costs more than Ratio times their body weight
+  // are left alone and recorded in getSkipped(); 0 wraps all
+  void setMaxOverheadRatio(double Ratio);
+  // With a query, matched functions are recorded there instead of wrapped
+  void setQuery(JoinPointQuery *Query);
+  // Wrappers bind the wrapped function statically (StaticPointcut in
+  // saop.h) instead of building a Pointcut with its size markers
+  void setStaticBinding(bool Static);
+  // Position of the pointcut in its file; the first matching one wraps
+  void setOrder(unsigned NewOrder) { Order = NewOrder; }
+  unsigned getOrder() const { return Order; }
+  // With fallback matches, MatchFinder results are recorded there and
+  // wrapped once the dispatcher has ranked them against its own
+  void setFallback(FallbackMatches *NewFallback) { Fallback = NewFallback; }
+
+  struct SkippedFunction {
+    std::string QualifiedName;
+    unsigned BodyWeight;
+  };
+  const std::vector<SkippedFunction> &getSkipped() const { return Skipped; }
+  llvm::StringRef getId() const { return Id; }
 
 private:
   void processFunction(const clang::FunctionDecl *Func,
@@ -31,6 +64,13 @@ private:
   bool isInBaseFolder(clang::SourceLocation Loc, clang::SourceManager &SM);
   
   clang::Rewriter &Rewrite;
-  llvm::StringRef Id;
+  std::string Id;
+  llvm::DenseSet<const clang::FunctionDecl *> &Wrapped;
   std::string BaseFolder;
+  double MaxOverheadRatio = 0;
+  JoinPointQuery *Query = nullptr;
+  bool StaticBinding = false;
+  unsigned Order = 0;
+  FallbackMatches *Fallback = nullptr;
+  std::vector<SkippedFunction> Skipped;
 };
\ No newline at end of file
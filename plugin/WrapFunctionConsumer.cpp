@@ -4,15 +4,20 @@
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/AST/ASTContext.h"
+#include "clang/Basic/Diagnostic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/ADT/StringSet.h"
 #include <cassert>
 
 #include "AST2Matcher.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "PointcutCache.h"
+#include "PointcutOptimizer.h"
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -47,22 +52,23 @@ namespace {
 
 }
 
-WrapFunctionConsumer::WrapFunctionConsumer(clang::Rewriter &R, const std::string &PointcutTextFile)
-    : Handler(R) {
+WrapFunctionConsumer::WrapFunctionConsumer(clang::Rewriter &R, const std::string &PointcutTextFile,
+                                           PointcutEngine Engine, const std::string &CacheDir,
+                                           const std::vector<std::string> &MatcherPointcuts) {
     // Read the file into a MemoryBuffer
     ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
         MemoryBuffer::getFile(PointcutTextFile);
 
     if (!FileOrErr) {
-        errs() << "Error reading file: " << PointcutTextFile << "\n";
-        errs() << "Error: " << FileOrErr.getError().message() << "\n";
-        llvm_unreachable("File not found or cannot be read");
+        Error = "cannot read pointcut file " + PointcutTextFile + ": " +
+                FileOrErr.getError().message();
+        return;
     }
 
-    std::unique_ptr<MemoryBuffer> &Buffer = FileOrErr.get();
+    std::unique_ptr<MemoryBuffer> PointcutBuffer = std::move(FileOrErr.get());
 
     // Get the contents as a StringRef
-    StringRef PointcutStringRead = Buffer->getBuffer();
+    StringRef PointcutStringRead = PointcutBuffer->getBuffer();
 
     // Check for UTF-8 BOM and remove it if present
     if (PointcutStringRead.starts_with("\xEF\xBB\xBF")) {
@@ -70,43 +76,214 @@ WrapFunctionConsumer::WrapFunctionConsumer(clang::Rewriter &R, const std::string
         PointcutStringRead = PointcutStringRead.drop_front(3);
     }
 
-    // Expected string for verification
-    StringRef PointcutTextExpect = "run_pointcut funcDecl = pragma_clang(text, data) || annotation(wrap);";
+    if (Engine == PointcutEngine::Matcher) {
+        addMatchers(R, PointcutStringRead, nullptr);
+        return;
+    }
+
+    // The cached image of this text spares lexing, parsing and optimizing;
+    // the dispatcher copies what it keeps, so the mapping is released here
+    PointcutCache Cache;
+    const PointcutImage &Image = Cache.load(PointcutTextFile, PointcutStringRead, CacheDir);
+    if (Cache.hasError()) {
+        Error = "syntax error in pointcut file " + PointcutTextFile + ": " + Cache.getError();
+        return;
+    }
 
-    // Verify the content matches the expected string
-    if (PointcutStringRead.trim() != PointcutTextExpect) {
-        errs() << "Pointcut text does not match expected value.\n";
-        errs() << "Expected: " << PointcutTextExpect << "\n";
-        errs() << "Got: " << PointcutStringRead << "\n";
-        llvm_unreachable("Pointcut text does not match");
+    llvm::StringSet<> ForcedToMatcher;
+    for (const std::string &Name : MatcherPointcuts) {
+        ForcedToMatcher.insert(Name);
     }
 
-    // Now process PointcutStringRead
-    // Create a Lexer and Parser to parse the pointcut string
-    ::Lexer lexer(PointcutStringRead);
-    Parser parser(lexer);
-    auto ast = parser.parsePointcutList();
+    // Position of each pointcut in the file: across both engines, the first
+    // pointcut wins when several match the same node
+    llvm::StringMap<unsigned> Orders;
+    llvm::StringSet<> Uncompiled;
+    for (const ImagePointcut &Pointcut : Image.getPointcuts()) {
+        StringRef Name = Image.getString(Pointcut.name);
+        unsigned Order = Orders.size();
+        if (!Orders.try_emplace(Name, Order).second) {
+            errs() << "Duplicate pointcut name: " << Name << "\n";
+            continue;
+        }
+        // Pointcuts without run_/call_pointcut are only building blocks
+        if (Pointcut.matchKind == MATCH_NONE) {
+            continue;
+        }
+        if (ForcedToMatcher.count(Name)) {
+            Uncompiled.insert(Name);
+            continue;
+        }
+
+        // Each callback dispatches to the PointcutName enumerator of its
+        // pointcut. The dispatcher tries candidates in file order.
+        if (Pointcut.matchKind == MATCH_RUN) {
+            Handlers.push_back(std::make_unique<WrapFunctionCallback>(R, Name, Wrapped));
+            Handlers.back()->setOrder(Order);
+            if (!Dispatcher.addRunPointcut(Image, Pointcut.root, Handlers.back().get())) {
+                Handlers.pop_back();
+                Uncompiled.insert(Name);
+            }
+        } else if (Pointcut.matchKind == MATCH_CALL) {
+            CallHandlers.push_back(std::make_unique<WrapCallCallback>(R, Name, Woven));
+            CallHandlers.back()->setOrder(Order);
+            if (!Dispatcher.addCallPointcut(Image, Pointcut.root, CallHandlers.back().get())) {
+                CallHandlers.pop_back();
+                Uncompiled.insert(Name);
+            }
+        }
+    }
+    for (const std::string &Name : MatcherPointcuts) {
+        if (!Orders.count(Name)) {
+            errs() << "matcher-pointcuts: no pointcut named " << Name << "\n";
+        }
+    }
+    if (Uncompiled.empty()) {
+        return;
+    }
+
+    // Pointcuts the bytecode cannot express are matched by MatchFinder. It
+    // runs first and only records its matches, which the dispatcher ranks
+    // against its own.
+    size_t FirstRun = Handlers.size();
+    size_t FirstCall = CallHandlers.size();
+    addMatchers(R, PointcutStringRead, &Uncompiled);
+    for (size_t i = FirstRun; i < Handlers.size(); ++i) {
+        Handlers[i]->setOrder(Orders.lookup(Handlers[i]->getId()));
+        Handlers[i]->setFallback(&Fallback);
+    }
+    for (size_t i = FirstCall; i < CallHandlers.size(); ++i) {
+        CallHandlers[i]->setOrder(Orders.lookup(CallHandlers[i]->getId()));
+        CallHandlers[i]->setFallback(&Fallback);
+    }
+    Dispatcher.setFallback(&Fallback);
+}
+
+void WrapFunctionConsumer::addMatchers(clang::Rewriter &R, StringRef Text,
+                                       const llvm::StringSet<> *Only) {
+    ::Lexer lexer(Text);
+    Parser parser(lexer, PointcutAST);
+    Pointcuts = parser.parsePointcutList();
+    if (parser.hasError()) {
+        Error = "syntax error in pointcuts: " + parser.getError();
+        return;
+    }
     ASTMakeMatcherVisitor visitor;
 
-    for (const auto &pointcut : ast) {
+    llvm::StringSet<> Names;
+    for (PointcutDeclaration *pointcut : Pointcuts) {
+        if (!Names.insert(pointcut->name).second) {
+            if (!Only) {
+                errs() << "Duplicate pointcut name: " << pointcut->name << "\n";
+            }
+            continue;
+        }
+        // Building blocks too, as references read the optimized expression
+        pointcut->expression = optimizePointcut(pointcut->expression, PointcutAST);
+        if (pointcut->matchKind == MATCH_NONE || (Only && !Only->contains(pointcut->name))) {
+            continue;
+        }
+
+        // The matcher binds the FunctionDecl / CallExpr under the pointcut name
         pointcut->accept(visitor);
         auto matcher = visitor.getMatcher();
         if (matcher->isType(MATCH_RUN)) {
+            Handlers.push_back(std::make_unique<WrapFunctionCallback>(R, pointcut->name, Wrapped));
             auto *runMatcher = static_cast<RunMatcher*>(matcher.get());
-            assert(runMatcher && "Failed to cast to RunMatcher");
-            DeclarationMatcher functionMatcher = runMatcher->getMatcher();
-            Matcher.addMatcher(functionMatcher, &Handler);
+            Matcher.addMatcher(runMatcher->getMatcher(), Handlers.back().get());
+        } else if (matcher->isType(MATCH_CALL)) {
+            CallHandlers.push_back(std::make_unique<WrapCallCallback>(R, pointcut->name, Woven));
+            auto *callMatcher = static_cast<CallMatcher*>(matcher.get());
+            Matcher.addMatcher(callMatcher->getMatcher(), CallHandlers.back().get());
         } else {
             llvm_unreachable("Matcher type not supported");
         }
+        HasMatchers = true;
+    }
+    MatcherCalls = visitor.callGraph;
+}
+
+WrapFunctionConsumer::WrapFunctionConsumer(clang::Rewriter &R,
+                                           const CompiledPointcutSet &Compiled) {
+    std::vector<WrapFunctionCallback *> CompiledRunHandlers;
+    std::vector<WrapCallCallback *> CompiledCallHandlers;
+    for (const CompiledPointcut &Pointcut : Compiled.pointcuts) {
+        if (Pointcut.matchKind == MATCH_RUN) {
+            Handlers.push_back(std::make_unique<WrapFunctionCallback>(R, Pointcut.name, Wrapped));
+            CompiledRunHandlers.push_back(Handlers.back().get());
+        } else {
+            CallHandlers.push_back(std::make_unique<WrapCallCallback>(R, Pointcut.name, Woven));
+            CompiledCallHandlers.push_back(CallHandlers.back().get());
+        }
     }
+    Dispatcher.setCompiled(Compiled, std::move(CompiledRunHandlers), std::move(CompiledCallHandlers));
 }
 
 void WrapFunctionConsumer::HandleTranslationUnit(ASTContext &Context) {
-    Handler.setBaseFolder(BaseFolder);
-    Matcher.matchAST(Context);
+    // A compiler error, not an exit: the plugin fails the compilation and
+    // UTHelperContext::transform returns it in its Diagnostics
+    if (!Error.empty()) {
+        DiagnosticsEngine &Diags = Context.getDiagnostics();
+        Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error, "uthelper: %0")) << Error;
+        return;
+    }
+    JoinPointQuery *Recorder = Query != QueryFormat::None ? &JoinPoints : nullptr;
+    for (auto &Handler : Handlers) {
+        Handler->setBaseFolder(BaseFolder);
+        Handler->setMaxOverheadRatio(MaxOverheadRatio);
+        Handler->setStaticBinding(StaticBinding);
+        Handler->setQuery(Recorder);
+    }
+    for (auto &Handler : CallHandlers) {
+        Handler->setBaseFolder(BaseFolder);
+        Handler->setQuery(Recorder);
+    }
+    // MatchFinder first: with pointcuts on both engines it only records its
+    // matches in Fallback for the dispatcher to rank
+    if (HasMatchers) {
+        // The whole TU first: calls() of a function depends on functions
+        // defined after it
+        if (MatcherCalls) {
+            MatcherCalls->build(Context);
+        }
+        Matcher.matchAST(Context);
+    }
+    Dispatcher.run(Context);
+    // Join points the dispatcher did not visit (or has no pointcut of that
+    // kind for) go to their recorded pointcut
+    for (const auto &[Func, Match] : Fallback.remainingFunctions()) {
+        Match.Handler->wrap(Func, &Context);
+    }
+    for (const auto &[Call, Match] : Fallback.remainingCalls()) {
+        Match.Handler->weave(Call, Context);
+    }
+    if (Recorder) {
+        JoinPoints.write(*QueryOutput, Query);
+    }
+    // stdout carries the rewritten source (or the join points)
+    for (auto &Handler : Handlers) {
+        for (const auto &Skipped : Handler->getSkipped()) {
+            errs() << "uthelper: not wrapping " << Skipped.QualifiedName << " (pointcut "
+                   << Handler->getId() << "): body weight " << Skipped.BodyWeight
+                   << ", wrapper weight " << WRAPPER_WEIGHT << ", over max-overhead-ratio="
+                   << format("%g", MaxOverheadRatio) << "\n";
+        }
+    }
 }
 
 void WrapFunctionConsumer::setBaseFolder(const std::string &Folder) {
     BaseFolder = Folder;
+}
+
+void WrapFunctionConsumer::setMaxOverheadRatio(double Ratio) {
+    MaxOverheadRatio = Ratio;
+}
+
+void WrapFunctionConsumer::setStaticBinding(bool Static) {
+    StaticBinding = Static;
+}
+
+void WrapFunctionConsumer::setQuery(QueryFormat Format, raw_ostream &OS) {
+    Query = Format;
+    QueryOutput = &OS;
 }
\ No newline at end of file
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "FallbackMatches.h"
+#include "JoinPointQuery.h"
+#include "PointcutDispatcher.h"
+#include "UTHelperOptions.h"
+#include "WrapCallCallback.h"
 #include "WrapFunctionCallback.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MemoryBuffer.h"
 
+#include "ASTNode.h"
+
+#include <memory>
 #include <vector>
 
 // Forward declarations
@@ -14,15 +26,60 @@ namespace clang {
 
 class WrapFunctionConsumer : public clang::ASTConsumer {
 public:
-    WrapFunctionConsumer(clang::Rewriter &R, const std::string &PointcutTextFile);
+    // CacheDir: where the parsed pointcuts are cached (PointcutCache); empty
+    // keeps the cache next to the pointcut file. MatcherPointcuts are matched
+    // by MatchFinder even with the bytecode engine.
+    WrapFunctionConsumer(clang::Rewriter &R, const std::string &PointcutTextFile,
+                         PointcutEngine Engine = PointcutEngine::Bytecode,
+                         const std::string &CacheDir = "",
+                         const std::vector<std::string> &MatcherPointcuts = {});
+    // Pointcuts compiled into the plugin ahead of time; no file is read
+    WrapFunctionConsumer(clang::Rewriter &R, const CompiledPointcutSet &Compiled);
 
     void HandleTranslationUnit(clang::ASTContext &Context) override;
     
     void setBaseFolder(const std::string &BaseFolder);
+    // See UTHelperOptions::MaxOverheadRatio
+    void setMaxOverheadRatio(double Ratio);
+    // Query mode: the join points are written to OS in Format and nothing is
+    // rewritten; QueryFormat::None weaves
+    void setQuery(QueryFormat Format, llvm::raw_ostream &OS);
+    // See UTHelperOptions::StaticBinding
+    void setStaticBinding(bool Static);
 
 private:
-    WrapFunctionCallback Handler;
+    // Registers MatchFinder matchers for the pointcuts of Text (only those
+    // named in Only, if given)
+    void addMatchers(clang::Rewriter &R, llvm::StringRef Text, const llvm::StringSet<> *Only);
+
+    // Matchers refer to the pointcut AST, so it lives as long as the
+    // consumer; its identifiers are interned, the file buffer is not kept.
+    PointcutContext PointcutAST;
+    std::vector<PointcutDeclaration*> Pointcuts;
+
+    // One callback per run_/call_pointcut, selected by the dispatcher or
+    // registered on the MatchFinder
+    std::vector<std::unique_ptr<WrapFunctionCallback>> Handlers;
+    std::vector<std::unique_ptr<WrapCallCallback>> CallHandlers;
+    // Functions / calls already woven by some pointcut of this TU
+    llvm::DenseSet<const clang::FunctionDecl *> Wrapped;
+    llvm::DenseSet<const clang::CallExpr *> Woven;
+    PointcutDispatcher Dispatcher;
+    // Matches of the MatchFinder pointcuts when the dispatcher has others
+    FallbackMatches Fallback;
+    // Pointcuts of the matcher engine, and those the bytecode cannot express
     clang::ast_matchers::MatchFinder Matcher;
-    std::vector<clang::ast_matchers::DeclarationMatcher> matcher_decl;
+    bool HasMatchers = false;
+    // The call graph of their calls() and called_by(), if any; a consumer
+    // sees one TU, so it is built once in HandleTranslationUnit
+    std::shared_ptr<TUCallGraph> MatcherCalls;
     std::string BaseFolder;
-};
\ No newline at end of file
+    double MaxOverheadRatio = 0;
+    bool StaticBinding = false;
+    QueryFormat Query = QueryFormat::None;
+    llvm::raw_ostream *QueryOutput = nullptr;
+    JoinPointQuery JoinPoints;
+    // Why the pointcut file could not be read or parsed; reported as a
+    // compiler error instead of weaving
+    std::string Error;
+};
@@ -3,18 +3,35 @@
 #include <type_traits>
 #include <utility>
 #include <functional>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <span>
+#include <vector>
 
 enum class PointcutName;
 
 // Pointcut structure to hold function pointer and size
+//
+// Args are the parameter types of the wrapped function. around() and
+// proceed() take Args&&..., so between the wrapper and the wrapped function
+// arguments only travel as references to the wrapper's parameters: each one
+// is materialized once, by the caller of the wrapper. For that, the plugin
+// gives the wrapped function T&& for a by-value class parameter T that is
+// not trivially copyable or is larger than two pointers, in its definition
+// and in the declarations it renames along with it, e.g.
+//   std::size_t count(std::string text);            // wrapper, as declared
+//   std::size_t count__wrapped__(std::string &&text) // the original body
 template<typename RT, typename... Args>
 class Pointcut {
 public:
     // For free functions and static member functions
     RT(*func)(Args...);
 
-    // For non-static member functions
-    using MemFuncType = RT(*)(void*, Args...);
+    // For non-static member functions: a trampoline calling the method on obj_ptr.
+    // It takes Args&&... like proceed(), so no argument is constructed on the way
+    using MemFuncType = RT(*)(void*, Args&&...);
     MemFuncType mem_func;
     void* obj_ptr;
 
@@ -35,46 +52,299 @@ public:
     RT proceed(Args&&... args);
 };
 
+// The result of the woven function is returned as it is: nothing of type RT
+// is constructed here, so RT may be a reference, move-only or without a
+// default constructor, and a prvalue result is constructed directly in the
+// caller's storage (guaranteed copy elision), as long as around() returns
+// proceed(...) directly too.
 template<typename RT, typename... Args>
 RT Pointcut<RT, Args...>::proceed(Args&&... args) {
-    if constexpr (!std::is_void_v<RT>) {
-        RT result;
-        if (func) {
-            result = std::invoke(func, std::forward<Args>(args)...);
-        } else if (mem_func && obj_ptr) {
-            result = mem_func(obj_ptr, std::forward<Args>(args)...);
-        }
-        return result;
-    } else {
-        if (func) {
-            std::invoke(func, std::forward<Args>(args)...);
-        } else if (mem_func && obj_ptr) {
-            mem_func(obj_ptr, std::forward<Args>(args)...);
-        }
+    if (mem_func) {
+        return mem_func(obj_ptr, std::forward<Args>(args)...);
     }
+    return std::invoke(func, std::forward<Args>(args)...);
 }
 
+// Runs the post-processing of an advice when around() returns, after the
+// result of `return proceed(...)` is constructed, so the advice keeps the
+// result copy-free whatever RT is:
+//   AfterProceed after([&] { /* post-processing */ });
+//   return proceed(std::forward<Args>(args)...);
+// The result is already in the caller's storage then, so the advice cannot
+// see it; one that needs the result keeps it in a local instead
+// (`RT result = proceed(...); /* post-processing */ return result;`), which
+// costs a move and rules out references and non-movable types.
+// If proceed() throws, the advice is skipped rather than run during stack
+// unwinding, where an exception from it would terminate the program.
+template<typename F>
+class AfterProceed {
+public:
+    explicit AfterProceed(F f) : f(std::move(f)), exceptions(std::uncaught_exceptions()) {}
+    AfterProceed(const AfterProceed&) = delete;
+    AfterProceed& operator=(const AfterProceed&) = delete;
+    ~AfterProceed() noexcept(noexcept(std::declval<F&>()())) {
+        if (std::uncaught_exceptions() <= exceptions) {
+            f();
+        }
+    }
+
+private:
+    F f;
+    int exceptions;
+};
+
 // Function to create a Pointcut for free functions and static member functions
 template<typename RT, typename... Args>
 constexpr auto createPointcut(RT(*func)(Args...), char* func_start, char* func_end) {
     return Pointcut<RT, Args...>(func, static_cast<std::size_t>(func_end - func_start));
 }
 
-// Function to create a Pointcut for non-static member functions
-template<typename RT, typename ClassType, typename... Args>
-constexpr auto createPointcut(RT(ClassType::*func)(Args...), ClassType* obj, char* func_start, char* func_end) {
-    using MemFuncType = RT(*)(void*, Args...);
-    // Convert member function pointer to a callable function pointer
-    MemFuncType mf = (MemFuncType)(*(void**)&func);
-    return Pointcut<RT, Args...>(mf, obj, static_cast<std::size_t>(func_end - func_start));
+namespace saop_detail {
+
+// Trampoline of a non-static member function, stored in Pointcut::mem_func:
+// calls Method on obj the way the language does (virtual dispatch, this
+// adjustment for bases), and as Method is a template argument the call is
+// direct and can be inlined into proceed().
+template<auto Method, typename ObjectType, typename RT, typename... Args>
+struct MemberTrampolineBase {
+    using Object = ObjectType;
+    using PointcutType = Pointcut<RT, Args...>;
+
+    static RT call(void* obj, Args&&... args) {
+        return (static_cast<ObjectType*>(obj)->*Method)(std::forward<Args>(args)...);
+    }
+};
+
+template<auto Method, typename F = decltype(Method)>
+struct MemberTrampoline;
+
+template<auto Method, typename RT, typename ClassType, typename... Args>
+struct MemberTrampoline<Method, RT(ClassType::*)(Args...)>
+    : MemberTrampolineBase<Method, ClassType, RT, Args...> {};
+template<auto Method, typename RT, typename ClassType, typename... Args>
+struct MemberTrampoline<Method, RT(ClassType::*)(Args...) const>
+    : MemberTrampolineBase<Method, const ClassType, RT, Args...> {};
+template<auto Method, typename RT, typename ClassType, typename... Args>
+struct MemberTrampoline<Method, RT(ClassType::*)(Args...) noexcept>
+    : MemberTrampolineBase<Method, ClassType, RT, Args...> {};
+template<auto Method, typename RT, typename ClassType, typename... Args>
+struct MemberTrampoline<Method, RT(ClassType::*)(Args...) const noexcept>
+    : MemberTrampolineBase<Method, const ClassType, RT, Args...> {};
+
+} // namespace saop_detail
+
+// Function to create a Pointcut for non-static member functions, e.g.
+//   createPointcut<&Foo::bar__wrapped__>(this, &Foo____bar_start_, &Foo____bar_end_)
+// obj converts to the class of Method first, so a method of a base class is
+// called on the right subobject.
+template<auto Method>
+constexpr auto createPointcut(typename saop_detail::MemberTrampoline<Method>::Object* obj,
+                              char* func_start, char* func_end) {
+    using Trampoline = saop_detail::MemberTrampoline<Method>;
+    return typename Trampoline::PointcutType(&Trampoline::call,
+                                             const_cast<void*>(static_cast<const void*>(obj)),
+                                             static_cast<std::size_t>(func_end - func_start));
+}
+
+// Call-site pointcuts (call_pointcut). The plugin spells out RT and Args of the
+// callee, so &foo of an overloaded or templated function resolves to the
+// exact function the original call used. There is no woven body, so func_size is 0.
+template<typename RT, typename... Args>
+constexpr auto createCallPointcut(std::type_identity_t<RT(*)(Args...)> func) {
+    return Pointcut<RT, Args...>(func, 0);
+}
+
+// Member calls go through a trampoline the plugin emits at the call site,
+// which casts obj back to the caller's object type and forwards its Args&&...
+// to the method.
+template<typename RT, typename... Args>
+constexpr auto createCallPointcut(std::type_identity_t<RT(*)(void*, Args&&...)> trampoline, void* obj) {
+    return Pointcut<RT, Args...>(trampoline, obj, 0);
 }
 
+namespace saop_detail {
+
+template<typename F> struct FunctionTraits;
+
+template<typename RT, typename... Args>
+struct FunctionTraits<RT(*)(Args...)> {
+    using ReturnType = RT;
+    using ObjectType = void;
+};
+template<typename RT, typename... Args>
+struct FunctionTraits<RT(*)(Args...) noexcept> : FunctionTraits<RT(*)(Args...)> {};
+
+template<typename RT, typename ClassType, typename... Args>
+struct FunctionTraits<RT(ClassType::*)(Args...)> {
+    using ReturnType = RT;
+    using ObjectType = ClassType;
+};
+template<typename RT, typename ClassType, typename... Args>
+struct FunctionTraits<RT(ClassType::*)(Args...) const> {
+    using ReturnType = RT;
+    using ObjectType = const ClassType;
+};
+template<typename RT, typename ClassType, typename... Args>
+struct FunctionTraits<RT(ClassType::*)(Args...) noexcept>
+    : FunctionTraits<RT(ClassType::*)(Args...)> {};
+template<typename RT, typename ClassType, typename... Args>
+struct FunctionTraits<RT(ClassType::*)(Args...) const noexcept>
+    : FunctionTraits<RT(ClassType::*)(Args...) const> {};
+
+} // namespace saop_detail
+
+// Statically bound pointcut (plugin argument static-pointcut): the woven
+// function is a template argument rather than a member, e.g.
+//   StaticPointcut<&twice__wrapped__>()
+//   StaticPointcut<&Foo::bar__wrapped__>(this)
+// so proceed() is a direct call and, once around() is inlined, the wrapped
+// body can be inlined into the wrapper. With an advice that only proceeds
+// the optimized wrapper is the unwoven function. There are no size markers
+// in the wrapped body (they could not be duplicated by inlining), so there
+// is no func_size.
+template<auto Func>
+class StaticPointcut {
+    using Traits = saop_detail::FunctionTraits<decltype(Func)>;
+
+public:
+    using ReturnType = typename Traits::ReturnType;
+    // Class of a non-static member function (const for const ones), else void
+    using ObjectType = typename Traits::ObjectType;
+
+    ObjectType* obj_ptr = nullptr;
+
+    constexpr StaticPointcut() = default;
+    constexpr explicit StaticPointcut(ObjectType* obj) : obj_ptr(obj) {}
+
+    // Implemented in saopImpl.h, once for all statically bound functions.
+    // Args are deduced from the wrapper's std::forward<Param>(param), so they
+    // are the parameter types of the wrapped function.
+    template<PointcutName Id, typename... Args>
+    ReturnType around(Args&&... args);
+
+    template<typename... Args>
+    ReturnType proceed(Args&&... args) {
+        if constexpr (std::is_member_function_pointer_v<decltype(Func)>) {
+            return (obj_ptr->*Func)(std::forward<Args>(args)...);
+        } else {
+            return Func(std::forward<Args>(args)...);
+        }
+    }
+};
+
+// Descriptor of a woven function. The plugin defines one per wrapper with
+// size markers (not with static-pointcut), as a constant in the linker
+// section SAOP_WOVEN_SECTION:
+//   static const WovenFunction saop_woven_function_ SAOP_WOVEN_FUNCTION =
+//       {"Foo::bar", PointcutName::traced, &Foo____bar_start_, &Foo____bar_end_};
+// [start, end) is the code between the markers, the body of the wrapped
+// function without its prologue and epilogue.
+struct WovenFunction {
+    const char* name;       // qualified name of the woven function
+    PointcutName pointcut;
+    const char* start;
+    const char* end;
+
+    bool contains(const void* address) const {
+        const char* at = static_cast<const char*>(address);
+        return std::less_equal<>()(start, at) && std::less<>()(at, end);
+    }
+};
+
+// A section name that is a C identifier gets __start_/__stop_ symbols from
+// the ELF linkers, and a section referenced by them survives --gc-sections.
+#define SAOP_WOVEN_SECTION "saop_woven"
+#if defined(__has_attribute)
+#if __has_attribute(retain)
+#define SAOP_WOVEN_RETAIN __attribute__((retain))
+#endif
+#endif
+#ifndef SAOP_WOVEN_RETAIN
+#define SAOP_WOVEN_RETAIN
+#endif
+#define SAOP_WOVEN_FUNCTION __attribute__((used, section(SAOP_WOVEN_SECTION))) SAOP_WOVEN_RETAIN
+
+#if defined(__ELF__)
+// Weak: a program without woven functions has no such section
+extern "C" const WovenFunction __start_saop_woven[] __attribute__((weak, visibility("hidden")));
+extern "C" const WovenFunction __stop_saop_woven[] __attribute__((weak, visibility("hidden")));
+#endif
+
+// The woven functions of the program (or shared object) by address, so code
+// addresses map to them in O(log n), e.g. in a profiler or crash handler:
+//   if (const WovenFunction* woven = WovenRegistry::instance().find(pc))
+//       report(woven->name);
+// It is built from SAOP_WOVEN_SECTION during static initialization; after
+// that, find() neither allocates nor locks. Empty on non-ELF targets.
+class WovenRegistry {
+public:
+    static const WovenRegistry& instance() {
+        static const WovenRegistry registry(sectionBegin(), sectionEnd());
+        return registry;
+    }
+
+    WovenRegistry(const WovenFunction* begin, const WovenFunction* end) {
+        functions.reserve(static_cast<std::size_t>(end - begin));
+        for (const WovenFunction* function = begin; function != end; ++function) {
+            functions.push_back(function);
+        }
+        std::sort(functions.begin(), functions.end(), [](const WovenFunction* a, const WovenFunction* b) {
+            return std::less<>()(a->start, b->start);
+        });
+    }
+
+    // The woven function whose code contains address, or nullptr
+    const WovenFunction* find(const void* address) const {
+        const char* at = static_cast<const char*>(address);
+        auto next = std::upper_bound(functions.begin(), functions.end(), at,
+                                     [](const char* at, const WovenFunction* function) {
+                                         return std::less<>()(at, function->start);
+                                     });
+        if (next == functions.begin()) {
+            return nullptr;
+        }
+        const WovenFunction* function = *(next - 1);
+        return function->contains(at) ? function : nullptr;
+    }
+
+    // Ordered by start address
+    std::span<const WovenFunction* const> all() const {
+        return functions;
+    }
+
+private:
+    static const WovenFunction* sectionBegin() {
+#if defined(__ELF__)
+        return __start_saop_woven;
+#else
+        return nullptr;
+#endif
+    }
+    static const WovenFunction* sectionEnd() {
+#if defined(__ELF__)
+        return __stop_saop_woven;
+#else
+        return nullptr;
+#endif
+    }
+
+    std::vector<const WovenFunction*> functions;
+};
+
+namespace saop_detail {
+// Builds the registry before main, rather than on first use by a handler
+inline const WovenRegistry& wovenRegistryAtStartup = WovenRegistry::instance();
+} // namespace saop_detail
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Inside saopImpl.h, which is on include path.
-// You need to define enum class element for each pointcut name. (Here funcDecl)
-// example: clang ...... -Xclang pointcut="run_pointcut funcDecl = pragma_clang(text, data) || annotation(wrap);"
+// You need to define enum class element for each run_pointcut name of the pointcut file.
+// example: pointcut file
+//   run_pointcut funcDecl = pragma_clang(text, data) || annotation(wrap);
+//   run_pointcut traced = annotation(trace);
+//   call_pointcut callSite = func(square);
 /*
-enum class PointcutName {funcDecl};
+enum class PointcutName {funcDecl, traced, callSite};
 */
 //
 // General 'around' function template.
@@ -85,12 +355,21 @@ template<typename RT, typename... Args>
 template<PointcutName Id> 
 RT Pointcut<RT, Args...>::around(Args&&... args) {
     // Do your pre-processing here
-    if constexpr (!std::is_void_v<RT>) {
-        return proceed(std::forward<Args>(args)...);
-    } else {
-        proceed(std::forward<Args>(args)...);
-    }
-    //  Do your post-processing here
+    AfterProceed after([&] {
+        //  Do your post-processing here
+    });
+    // Return the result directly (also for void): storing it in a local
+    // would copy it and rule out references and move-only types
+    return proceed(std::forward<Args>(args)...);
+}
+*/
+//
+// With static-pointcut, the advice of the statically bound wrappers:
+/*
+template<auto Func>
+template<PointcutName Id, typename... Args>
+typename StaticPointcut<Func>::ReturnType StaticPointcut<Func>::around(Args&&... args) {
+    return proceed(std::forward<Args>(args)...);
 }
 */
 
@@ -1,149 +1,220 @@
 #include "ASTNode.h"
 
-#include "ASTNode.h"
-#include <utility>
-
-using namespace std;
-
-Expression::Expression(ASTNodePtr e)
-    : expr(std::move(e)) {}
-
-void Expression::print(llvm::raw_ostream &OS, int indent) const {
-    OS.indent(indent) << getClassName() << ":\n";
-    expr->print(OS, indent + 2);
-}
-
-PairExpression::PairExpression(ASTNodePtr lhs, ASTNodePtr rhs)
-    : left(std::move(lhs)), right(std::move(rhs)) {}
-
-void PairExpression::print(llvm::raw_ostream &OS, int indent) const {
-    OS.indent(indent) << getClassName() << ":\n";
-    left->print(OS, indent + 2);
-    right->print(OS, indent + 2);
-}
-
-IdExpression::IdExpression(llvm::StringRef id)
-    : id(id) {}
-
-void IdExpression::print(llvm::raw_ostream &OS, int indent) const {
-    OS.indent(indent) << getClassName() << ": " << id << "\n";
-}
-
-PointcutDeclaration::PointcutDeclaration(bool exported, llvm::StringRef n, MatchKind matchKind, ASTNodePtr expr)
-    : isExported(exported), name(n), matchKind(matchKind), expression(std::move(expr)) {}
-
-std::string PointcutDeclaration::getClassName() const {
-    return "PointcutDeclaration";
-}
-
-void PointcutDeclaration::print(llvm::raw_ostream &OS, int indent) const {
-    OS.indent(indent) << (isExported ? "export " : "") << getClassName() << ": " << name << "\n";
-    if (expression) {
-        expression->print(OS, indent + 2);
-    }
-}
-
-ASTVisitor& PointcutDeclaration::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
-
-OrExpression::OrExpression(ASTNodePtr lhs, ASTNodePtr rhs)
-    : PairExpression(std::move(lhs), std::move(rhs)) {}
+using llvm::cast;
 
-std::string OrExpression::getClassName() const {
-    return "OrExpression";
-}
+Expression::Expression(ASTNodeKind kind, ASTNode *e)
+    : ASTNode(kind), expr(e) {}
 
-ASTVisitor& OrExpression::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
-
-AndExpression::AndExpression(ASTNodePtr lhs, ASTNodePtr rhs)
-    : PairExpression(std::move(lhs), std::move(rhs)) {}
-
-std::string AndExpression::getClassName() const {
-    return "AndExpression";
-}
-
-ASTVisitor& AndExpression::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+PairExpression::PairExpression(ASTNodeKind kind, ASTNode *lhs, ASTNode *rhs)
+    : ASTNode(kind), left(lhs), right(rhs) {}
 
-NotExpression::NotExpression(ASTNodePtr e)
-    : Expression(std::move(e)) {}
+IdExpression::IdExpression(ASTNodeKind kind, llvm::StringRef id)
+    : ASTNode(kind), id(id) {}
 
-std::string NotExpression::getClassName() const {
-    return "NotExpression";
-}
+PointcutDeclaration::PointcutDeclaration(bool exported, llvm::StringRef n, MatchKind matchKind, ASTNode *expr)
+    : ASTNode(AST_POINTCUT_DECLARATION), isExported(exported), name(n), matchKind(matchKind), expression(expr) {}
 
-ASTVisitor& NotExpression::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+OrExpression::OrExpression(ASTNode *lhs, ASTNode *rhs)
+    : PairExpression(AST_OR, lhs, rhs) {}
 
-ParenthesizedExpression::ParenthesizedExpression(ASTNodePtr e)
-    : Expression(std::move(e)) {}
+AndExpression::AndExpression(ASTNode *lhs, ASTNode *rhs)
+    : PairExpression(AST_AND, lhs, rhs) {}
 
-std::string ParenthesizedExpression::getClassName() const {
-    return "ParenthesizedExpression";
-}
+NotExpression::NotExpression(ASTNode *e)
+    : Expression(AST_NOT, e) {}
 
-ASTVisitor& ParenthesizedExpression::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+ParenthesizedExpression::ParenthesizedExpression(ASTNode *e)
+    : Expression(AST_PARENTHESIZED, e) {}
 
 FuncExpression::FuncExpression(llvm::StringRef id)
-    : IdExpression(id) {}
-
-std::string FuncExpression::getClassName() const {
-    return "FuncExpression";
-}
-
-ASTVisitor& FuncExpression::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+    : IdExpression(AST_FUNC, id) {}
 
 PragmaClangExprNode::PragmaClangExprNode(Token kind, llvm::StringRef section)
-    : pragmaKind(kind), sectionName(section) {}
-
-std::string PragmaClangExprNode::getClassName() const {
-    return "PragmaClangExprNode";
-}
-
-void PragmaClangExprNode::print(llvm::raw_ostream &OS, int indent) const {
-    OS.indent(indent) << getClassName() << ": " << pragmaKind << ", " << sectionName << "\n";
-}
-
-ASTVisitor& PragmaClangExprNode::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+    : ASTNode(AST_PRAGMA_CLANG), pragmaKind(kind), sectionName(section) {}
 
 NotationExprNode::NotationExprNode(llvm::StringRef id)
-    : IdExpression(id) {}
-
-std::string NotationExprNode::getClassName() const {
-    return "NotationExprNode";
-}
-
-ASTVisitor& NotationExprNode::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
-    return visitor;
-}
+    : IdExpression(AST_NOTATION, id) {}
 
 NotationAnalysisExprNode::NotationAnalysisExprNode(llvm::StringRef id)
-    : IdExpression(id) {}
-
-std::string NotationAnalysisExprNode::getClassName() const {
-    return "NotationAnalysisExprNode";
-}
-
-ASTVisitor& NotationAnalysisExprNode::accept(ASTVisitor &visitor) {
-    visitor.visit(this);
+    : IdExpression(AST_NOTATION_ANALYSIS, id) {}
+
+WithinFileExpression::WithinFileExpression(llvm::StringRef pattern)
+    : IdExpression(AST_WITHIN_FILE, pattern) {}
+
+WithinNamespaceExpression::WithinNamespaceExpression(llvm::StringRef name)
+    : IdExpression(AST_WITHIN_NAMESPACE, name) {}
+
+QualifierExpression::QualifierExpression(TokenKind qualifier)
+    : ASTNode(AST_QUALIFIER), qualifier(qualifier) {}
+
+ReturnsExpression::ReturnsExpression(llvm::StringRef type)
+    : IdExpression(AST_RETURNS, type) {}
+
+ParamsExpression::ParamsExpression(llvm::ArrayRef<llvm::StringRef> types)
+    : ASTNode(AST_PARAMS), types(types) {}
+
+ParamCountExpression::ParamCountExpression(u32 count)
+    : ASTNode(AST_PARAM_COUNT), count(count) {}
+
+MethodOfExpression::MethodOfExpression(llvm::StringRef pattern)
+    : IdExpression(AST_METHOD_OF, pattern) {}
+
+InheritsExpression::InheritsExpression(llvm::StringRef pattern)
+    : IdExpression(AST_INHERITS, pattern) {}
+
+CallGraphExpression::CallGraphExpression(ASTNodeKind kind, llvm::StringRef pattern, u32 depth)
+    : IdExpression(kind, pattern), depth(depth) {}
+
+CallsExpression::CallsExpression(llvm::StringRef pattern, u32 depth)
+    : CallGraphExpression(AST_CALLS, pattern, depth) {}
+
+CalledByExpression::CalledByExpression(llvm::StringRef pattern, u32 depth)
+    : CallGraphExpression(AST_CALLED_BY, pattern, depth) {}
+
+BodySizeExpression::BodySizeExpression(TokenKind measure, u32 min, u32 max)
+    : ASTNode(AST_BODY_SIZE), measure(measure), min(min), max(max) {}
+
+BodyFlagExpression::BodyFlagExpression(TokenKind flag)
+    : ASTNode(AST_BODY_FLAG), flag(flag) {}
+
+PointcutRefExpression::PointcutRefExpression(llvm::StringRef name, PointcutDeclaration *target)
+    : ASTNode(AST_POINTCUT_REF), name(name), target(target) {}
+
+ConstantExpression::ConstantExpression(bool value)
+    : ASTNode(AST_CONSTANT), value(value) {}
+
+StringRef ASTNode::getClassName() const {
+    switch (kind) {
+        case AST_POINTCUT_DECLARATION: return "PointcutDeclaration";
+        case AST_OR: return "OrExpression";
+        case AST_AND: return "AndExpression";
+        case AST_NOT: return "NotExpression";
+        case AST_PARENTHESIZED: return "ParenthesizedExpression";
+        case AST_FUNC: return "FuncExpression";
+        case AST_PRAGMA_CLANG: return "PragmaClangExprNode";
+        case AST_NOTATION: return "NotationExprNode";
+        case AST_NOTATION_ANALYSIS: return "NotationAnalysisExprNode";
+        case AST_WITHIN_FILE: return "WithinFileExpression";
+        case AST_WITHIN_NAMESPACE: return "WithinNamespaceExpression";
+        case AST_QUALIFIER: return "QualifierExpression";
+        case AST_RETURNS: return "ReturnsExpression";
+        case AST_PARAMS: return "ParamsExpression";
+        case AST_PARAM_COUNT: return "ParamCountExpression";
+        case AST_METHOD_OF: return "MethodOfExpression";
+        case AST_INHERITS: return "InheritsExpression";
+        case AST_CALLS: return "CallsExpression";
+        case AST_CALLED_BY: return "CalledByExpression";
+        case AST_BODY_SIZE: return "BodySizeExpression";
+        case AST_BODY_FLAG: return "BodyFlagExpression";
+        case AST_POINTCUT_REF: return "PointcutRefExpression";
+        case AST_CONSTANT: return "ConstantExpression";
+    }
+    llvm_unreachable("Unknown AST node kind");
+}
+
+void ASTNode::print(llvm::raw_ostream &OS, int indent) const {
+    switch (kind) {
+        case AST_POINTCUT_DECLARATION: {
+            auto *node = cast<PointcutDeclaration>(this);
+            OS.indent(indent) << (node->isExported ? "export " : "") << getClassName() << ": " << node->name << "\n";
+            if (node->expression) {
+                node->expression->print(OS, indent + 2);
+            }
+            return;
+        }
+        case AST_OR:
+        case AST_AND: {
+            auto *node = cast<PairExpression>(this);
+            OS.indent(indent) << getClassName() << ":\n";
+            node->left->print(OS, indent + 2);
+            node->right->print(OS, indent + 2);
+            return;
+        }
+        case AST_NOT:
+        case AST_PARENTHESIZED:
+            OS.indent(indent) << getClassName() << ":\n";
+            cast<Expression>(this)->expr->print(OS, indent + 2);
+            return;
+        case AST_FUNC:
+        case AST_NOTATION:
+        case AST_NOTATION_ANALYSIS:
+        case AST_WITHIN_FILE:
+        case AST_WITHIN_NAMESPACE:
+        case AST_RETURNS:
+        case AST_METHOD_OF:
+        case AST_INHERITS:
+            OS.indent(indent) << getClassName() << ": " << cast<IdExpression>(this)->id << "\n";
+            return;
+        case AST_PRAGMA_CLANG: {
+            auto *node = cast<PragmaClangExprNode>(this);
+            OS.indent(indent) << getClassName() << ": " << node->pragmaKind << ", " << node->sectionName << "\n";
+            return;
+        }
+        case AST_CALLS:
+        case AST_CALLED_BY: {
+            auto *node = cast<CallGraphExpression>(this);
+            OS.indent(indent) << getClassName() << ": " << node->id << ", " << node->depth << "\n";
+            return;
+        }
+        case AST_QUALIFIER:
+            OS.indent(indent) << getClassName() << ": " << Token(cast<QualifierExpression>(this)->qualifier).text << "\n";
+            return;
+        case AST_PARAMS: {
+            OS.indent(indent) << getClassName() << ": ";
+            llvm::interleave(cast<ParamsExpression>(this)->types, OS, ", ");
+            OS << "\n";
+            return;
+        }
+        case AST_PARAM_COUNT:
+            OS.indent(indent) << getClassName() << ": " << cast<ParamCountExpression>(this)->count << "\n";
+            return;
+        case AST_BODY_SIZE: {
+            auto *node = cast<BodySizeExpression>(this);
+            OS.indent(indent) << getClassName() << ": " << Token(node->measure).text << ", " << node->min;
+            if (node->max != UNBOUNDED) {
+                OS << ".." << node->max;
+            }
+            OS << "\n";
+            return;
+        }
+        case AST_BODY_FLAG:
+            OS.indent(indent) << getClassName() << ": " << Token(cast<BodyFlagExpression>(this)->flag).text << "\n";
+            return;
+        case AST_POINTCUT_REF:
+            OS.indent(indent) << getClassName() << ": " << cast<PointcutRefExpression>(this)->name << "\n";
+            return;
+        case AST_CONSTANT:
+            OS.indent(indent) << getClassName() << ": " << (cast<ConstantExpression>(this)->value ? "true" : "false") << "\n";
+            return;
+    }
+    llvm_unreachable("Unknown AST node kind");
+}
+
+ASTVisitor& ASTNode::accept(ASTVisitor &visitor) {
+    switch (kind) {
+        case AST_POINTCUT_DECLARATION: visitor.visit(cast<PointcutDeclaration>(this)); break;
+        case AST_OR: visitor.visit(cast<OrExpression>(this)); break;
+        case AST_AND: visitor.visit(cast<AndExpression>(this)); break;
+        case AST_NOT: visitor.visit(cast<NotExpression>(this)); break;
+        case AST_PARENTHESIZED: visitor.visit(cast<ParenthesizedExpression>(this)); break;
+        case AST_FUNC: visitor.visit(cast<FuncExpression>(this)); break;
+        case AST_PRAGMA_CLANG: visitor.visit(cast<PragmaClangExprNode>(this)); break;
+        case AST_NOTATION: visitor.visit(cast<NotationExprNode>(this)); break;
+        case AST_NOTATION_ANALYSIS: visitor.visit(cast<NotationAnalysisExprNode>(this)); break;
+        case AST_WITHIN_FILE: visitor.visit(cast<WithinFileExpression>(this)); break;
+        case AST_WITHIN_NAMESPACE: visitor.visit(cast<WithinNamespaceExpression>(this)); break;
+        case AST_QUALIFIER: visitor.visit(cast<QualifierExpression>(this)); break;
+        case AST_RETURNS: visitor.visit(cast<ReturnsExpression>(this)); break;
+        case AST_PARAMS: visitor.visit(cast<ParamsExpression>(this)); break;
+        case AST_PARAM_COUNT: visitor.visit(cast<ParamCountExpression>(this)); break;
+        case AST_METHOD_OF: visitor.visit(cast<MethodOfExpression>(this)); break;
+        case AST_INHERITS: visitor.visit(cast<InheritsExpression>(this)); break;
+        case AST_CALLS: visitor.visit(cast<CallsExpression>(this)); break;
+        case AST_CALLED_BY: visitor.visit(cast<CalledByExpression>(this)); break;
+        case AST_BODY_SIZE: visitor.visit(cast<BodySizeExpression>(this)); break;
+        case AST_BODY_FLAG: visitor.visit(cast<BodyFlagExpression>(this)); break;
+        case AST_POINTCUT_REF: visitor.visit(cast<PointcutRefExpression>(this)); break;
+        case AST_CONSTANT: visitor.visit(cast<ConstantExpression>(this)); break;
+    }
     return visitor;
-}
\ No newline at end of file
+}
@@ -1,9 +1,14 @@
 #pragma once
 
 #include "Token.h"
-#include <memory>
+#include <algorithm>
 #include <string>
+#include <type_traits>
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/StringSaver.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 
 class PointcutDeclaration;
@@ -15,6 +20,20 @@ class FuncExpression;
 class PragmaClangExprNode;
 class NotationExprNode;
 class NotationAnalysisExprNode;
+class WithinFileExpression;
+class WithinNamespaceExpression;
+class QualifierExpression;
+class ReturnsExpression;
+class ParamsExpression;
+class ParamCountExpression;
+class MethodOfExpression;
+class InheritsExpression;
+class CallsExpression;
+class CalledByExpression;
+class BodySizeExpression;
+class BodyFlagExpression;
+class PointcutRefExpression;
+class ConstantExpression;
 
 struct ASTVisitor {
     virtual void visit(PointcutDeclaration* node) = 0;
@@ -26,6 +45,20 @@ struct ASTVisitor {
     virtual void visit(PragmaClangExprNode* node) = 0;
     virtual void visit(NotationExprNode* node) = 0;
     virtual void visit(NotationAnalysisExprNode* node) = 0;
+    virtual void visit(WithinFileExpression* node) = 0;
+    virtual void visit(WithinNamespaceExpression* node) = 0;
+    virtual void visit(QualifierExpression* node) = 0;
+    virtual void visit(ReturnsExpression* node) = 0;
+    virtual void visit(ParamsExpression* node) = 0;
+    virtual void visit(ParamCountExpression* node) = 0;
+    virtual void visit(MethodOfExpression* node) = 0;
+    virtual void visit(InheritsExpression* node) = 0;
+    virtual void visit(CallsExpression* node) = 0;
+    virtual void visit(CalledByExpression* node) = 0;
+    virtual void visit(BodySizeExpression* node) = 0;
+    virtual void visit(BodyFlagExpression* node) = 0;
+    virtual void visit(PointcutRefExpression* node) = 0;
+    virtual void visit(ConstantExpression* node) = 0;
 };
 
 
@@ -35,49 +68,127 @@ enum MatchKind {
     MATCH_CALL,
 };
 
-class PointcutDeclaration;
-using PointcutDeclarationPtr = std::unique_ptr<PointcutDeclaration>;
-class ASTNode;
-using ASTNodePtr = std::unique_ptr<ASTNode>;
+// Concrete node classes, for llvm::isa / dyn_cast / cast
+enum ASTNodeKind : u8 {
+    AST_POINTCUT_DECLARATION,
+    AST_OR,
+    AST_AND,
+    AST_NOT,
+    AST_PARENTHESIZED,
+    AST_FUNC,
+    AST_PRAGMA_CLANG,
+    AST_NOTATION,
+    AST_NOTATION_ANALYSIS,
+    AST_WITHIN_FILE,
+    AST_WITHIN_NAMESPACE,
+    AST_QUALIFIER,
+    AST_RETURNS,
+    AST_PARAMS,
+    AST_PARAM_COUNT,
+    AST_METHOD_OF,
+    AST_INHERITS,
+    AST_CALLS,
+    AST_CALLED_BY,
+    AST_BODY_SIZE,
+    AST_BODY_FLAG,
+    AST_POINTCUT_REF,
+    AST_CONSTANT,
+};
+
+// Owns pointcut trees: nodes are bump-allocated and identifiers pooled, and
+// both are released together with the context. Nodes own nothing and are
+// never freed one by one, so a tree (and every StringRef taken from it) is
+// valid exactly as long as the context that built it; the parsed text can
+// be dropped right after parsing.
+class PointcutContext {
+public:
+    PointcutContext() = default;
+    PointcutContext(const PointcutContext &) = delete;
+    PointcutContext &operator=(const PointcutContext &) = delete;
+
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena nodes are never destroyed");
+        return new (allocator.Allocate<T>()) T(std::forward<Args>(args)...);
+    }
+
+    // Pooled copy of text; equal strings share one copy
+    StringRef intern(StringRef text) { return strings.save(text); }
+
+    // Arena copy of a list of nodes' operands
+    template <typename T>
+    llvm::ArrayRef<T> copy(llvm::ArrayRef<T> items) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena nodes are never destroyed");
+        T *data = allocator.Allocate<T>(items.size());
+        std::uninitialized_copy(items.begin(), items.end(), data);
+        return llvm::ArrayRef<T>(data, items.size());
+    }
+
+    usize getBytesAllocated() const { return allocator.getBytesAllocated(); }
+
+private:
+    llvm::BumpPtrAllocator allocator;
+    llvm::UniqueStringSaver strings{allocator};
+};
 
 // AST Nodes
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
-    virtual void print(llvm::raw_ostream &OS, int indent = 0) const = 0;
-    virtual std::string getClassName() const = 0;
-    virtual ASTVisitor& accept(ASTVisitor &visitor) = 0;
+    ASTNodeKind getKind() const { return kind; }
+    StringRef getClassName() const;
+
+    void print(llvm::raw_ostream &OS, int indent = 0) const;
+    ASTVisitor& accept(ASTVisitor &visitor);
+
+protected:
+    explicit ASTNode(ASTNodeKind kind) : kind(kind) {}
+
+private:
+    ASTNodeKind kind;
 };
 
+// Not and parentheses
 class Expression : public ASTNode {
 public:
-    ASTNodePtr expr;
+    ASTNode *expr;
 
-    Expression(ASTNodePtr e);
+    static bool classof(const ASTNode *node) {
+        return node->getKind() == AST_NOT || node->getKind() == AST_PARENTHESIZED;
+    }
 
-    void print(llvm::raw_ostream &OS, int indent = 0) const override;
-    // virtual ASTVisitor& accept(ASTVisitor &visitor) override;
+protected:
+    Expression(ASTNodeKind kind, ASTNode *e);
 };
 
+// And and Or
 class PairExpression : public ASTNode {
 public:
-    ASTNodePtr left;
-    ASTNodePtr right;
+    ASTNode *left;
+    ASTNode *right;
 
-    PairExpression(ASTNodePtr lhs, ASTNodePtr rhs);
+    static bool classof(const ASTNode *node) {
+        return node->getKind() == AST_OR || node->getKind() == AST_AND;
+    }
 
-    void print(llvm::raw_ostream &OS, int indent = 0) const override;
-    // virtual ASTVisitor& accept(ASTVisitor &visitor) override;
+protected:
+    PairExpression(ASTNodeKind kind, ASTNode *lhs, ASTNode *rhs);
 };
 
+// Predicates on one identifier
 class IdExpression : public ASTNode {
 public:
     llvm::StringRef id;
 
-    IdExpression(llvm::StringRef id);
+    static bool classof(const ASTNode *node) {
+        return node->getKind() == AST_FUNC || node->getKind() == AST_NOTATION ||
+               node->getKind() == AST_NOTATION_ANALYSIS || node->getKind() == AST_WITHIN_FILE ||
+               node->getKind() == AST_WITHIN_NAMESPACE || node->getKind() == AST_RETURNS ||
+               node->getKind() == AST_METHOD_OF || node->getKind() == AST_INHERITS ||
+               node->getKind() == AST_CALLS || node->getKind() == AST_CALLED_BY;
+    }
 
-    void print(llvm::raw_ostream &OS, int indent = 0) const override;
-    // virtual ASTVisitor& accept(ASTVisitor &visitor) override;
+protected:
+    IdExpression(ASTNodeKind kind, llvm::StringRef id);
 };
 
 class PointcutDeclaration : public ASTNode {
@@ -85,54 +196,46 @@ public:
     bool isExported;
     llvm::StringRef name;
     MatchKind matchKind;
-    ASTNodePtr expression;
-
-    PointcutDeclaration(bool exported, llvm::StringRef n, MatchKind matchKind, ASTNodePtr expr);
+    ASTNode *expression;
 
-    std::string getClassName() const override;
+    PointcutDeclaration(bool exported, llvm::StringRef n, MatchKind matchKind, ASTNode *expr);
 
-    void print(llvm::raw_ostream &OS, int indent = 0) const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_POINTCUT_DECLARATION; }
 };
 
 class OrExpression : public PairExpression {
 public:
-    OrExpression(ASTNodePtr lhs, ASTNodePtr rhs);
+    OrExpression(ASTNode *lhs, ASTNode *rhs);
 
-    std::string getClassName() const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_OR; }
 };
 
 class AndExpression : public PairExpression {
 public:
-    AndExpression(ASTNodePtr lhs, ASTNodePtr rhs);
+    AndExpression(ASTNode *lhs, ASTNode *rhs);
 
-    std::string getClassName() const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_AND; }
 };
 
 class NotExpression : public Expression {
 public:
-    NotExpression(ASTNodePtr e);
+    NotExpression(ASTNode *e);
 
-    std::string getClassName() const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_NOT; }
 };
 
 class ParenthesizedExpression : public Expression {
 public:
-    ParenthesizedExpression(ASTNodePtr e);
+    ParenthesizedExpression(ASTNode *e);
 
-    std::string getClassName() const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_PARENTHESIZED; }
 };
 
 class FuncExpression : public IdExpression {
 public:
     FuncExpression(llvm::StringRef id);
 
-    std::string getClassName() const override;
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_FUNC; }
 };
 
 class PragmaClangExprNode : public ASTNode {
@@ -142,27 +245,166 @@ public:
 
     PragmaClangExprNode(Token kind, llvm::StringRef section);
 
-    std::string getClassName() const override;
-
-    void print(llvm::raw_ostream &OS, int indent = 0) const override;
-
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_PRAGMA_CLANG; }
 };
 
 class NotationExprNode : public IdExpression {
 public:
     NotationExprNode(llvm::StringRef id);
 
-    std::string getClassName() const override;
-
-    ASTVisitor& accept(ASTVisitor &visitor) override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_NOTATION; }
 };
 
 class NotationAnalysisExprNode : public IdExpression {
 public:
     NotationAnalysisExprNode(llvm::StringRef id);
 
-    std::string getClassName() const override;
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_NOTATION_ANALYSIS; }
+};
+
+// within("glob"): id is the path pattern, without the quotes
+class WithinFileExpression : public IdExpression {
+public:
+    WithinFileExpression(llvm::StringRef pattern);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_WITHIN_FILE; }
+};
+
+// within(namespace a::b): id is the namespace, without a leading "::"
+class WithinNamespaceExpression : public IdExpression {
+public:
+    WithinNamespaceExpression(llvm::StringRef name);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_WITHIN_NAMESPACE; }
+};
+
+// const, static or virtual: qualifier is the keyword
+class QualifierExpression : public ASTNode {
+public:
+    TokenKind qualifier;
+
+    QualifierExpression(TokenKind qualifier);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_QUALIFIER; }
+};
+
+// returns(T): id is the type, in normalizeTypeText form
+class ReturnsExpression : public IdExpression {
+public:
+    ReturnsExpression(llvm::StringRef type);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_RETURNS; }
+};
+
+// params(T1, .., Tn): types in normalizeTypeText form; ".." stands for any
+// number of parameters
+class ParamsExpression : public ASTNode {
+public:
+    llvm::ArrayRef<llvm::StringRef> types;
+
+    ParamsExpression(llvm::ArrayRef<llvm::StringRef> types);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_PARAMS; }
+};
+
+// param_count(n)
+class ParamCountExpression : public ASTNode {
+public:
+    u32 count;
+
+    ParamCountExpression(u32 count);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_PARAM_COUNT; }
+};
+
+// method_of(C): id is a class name pattern, with func() semantics
+class MethodOfExpression : public IdExpression {
+public:
+    MethodOfExpression(llvm::StringRef pattern);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_METHOD_OF; }
+};
+
+// inherits(B): id is a pattern for a direct or indirect base class
+class InheritsExpression : public IdExpression {
+public:
+    InheritsExpression(llvm::StringRef pattern);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_INHERITS; }
+};
+
+// calls() and called_by(): id is a function name pattern, with func()
+// semantics; depth bounds the number of calls on the path (0: any number)
+class CallGraphExpression : public IdExpression {
+public:
+    u32 depth;
+
+    static bool classof(const ASTNode *node) {
+        return node->getKind() == AST_CALLS || node->getKind() == AST_CALLED_BY;
+    }
+
+protected:
+    CallGraphExpression(ASTNodeKind kind, llvm::StringRef pattern, u32 depth);
+};
+
+class CallsExpression : public CallGraphExpression {
+public:
+    CallsExpression(llvm::StringRef pattern, u32 depth);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_CALLS; }
+};
+
+class CalledByExpression : public CallGraphExpression {
+public:
+    CalledByExpression(llvm::StringRef pattern, u32 depth);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_CALLED_BY; }
+};
+
+// Upper bound of stmt_count() / body_weight() when none is given
+constexpr u32 UNBOUNDED = ~0u;
 
-    ASTVisitor& accept(ASTVisitor &visitor) override;
-};
\ No newline at end of file
+// stmt_count(min, max) and body_weight(min, max): measure is the keyword
+class BodySizeExpression : public ASTNode {
+public:
+    TokenKind measure;
+    u32 min;
+    u32 max;
+
+    BodySizeExpression(TokenKind measure, u32 min, u32 max);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_BODY_SIZE; }
+};
+
+// has_loop or has_call: flag is the keyword
+class BodyFlagExpression : public ASTNode {
+public:
+    TokenKind flag;
+
+    BodyFlagExpression(TokenKind flag);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_BODY_FLAG; }
+};
+
+// The name of another pointcut, declared before this one: its expression
+// is shared, not copied, so the declarations of a file form a DAG. target
+// holds the current (e.g. optimized) expression.
+class PointcutRefExpression : public ASTNode {
+public:
+    llvm::StringRef name;
+    PointcutDeclaration *target;
+
+    PointcutRefExpression(llvm::StringRef name, PointcutDeclaration *target);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_POINTCUT_REF; }
+};
+
+// true / false; never parsed, produced by the pointcut optimizer
+class ConstantExpression : public ASTNode {
+public:
+    bool value;
+
+    ConstantExpression(bool value);
+
+    static bool classof(const ASTNode *node) { return node->getKind() == AST_CONSTANT; }
+};
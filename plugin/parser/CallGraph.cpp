@@ -0,0 +1,99 @@
+#include "CallGraph.h"
+
+#include "FunctionFacts.h"
+#include "PathTrie.h"
+
+#include "llvm/ADT/SmallString.h"
+
+#include <algorithm>
+
+u32 CallGraph::addFunction(StringRef qualifiedName) {
+    names.push_back(strings.save(qualifiedName));
+    return names.size() - 1;
+}
+
+void CallGraph::addCall(u32 caller, u32 callee) {
+    edges.emplace_back(caller, callee);
+}
+
+void CallGraph::buildRows(bool byCaller, std::vector<u32> &offsets, std::vector<u32> &targets) const {
+    offsets.assign(size() + 1, 0);
+    for (const auto &[caller, callee] : edges) {
+        ++offsets[(byCaller ? caller : callee) + 1];
+    }
+    for (u32 node = 0; node < size(); ++node) {
+        offsets[node + 1] += offsets[node];
+    }
+    targets.resize(edges.size());
+    std::vector<u32> next(offsets.begin(), offsets.end() - 1);
+    // Edges are sorted by caller, then callee, so both rows come out sorted
+    for (const auto &[caller, callee] : edges) {
+        targets[next[byCaller ? caller : callee]++] = byCaller ? callee : caller;
+    }
+}
+
+void CallGraph::finalize() {
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    buildRows(true, calleeOffsets, callees);
+    buildRows(false, callerOffsets, callers);
+    edges.clear();
+    edges.shrink_to_fit();
+    queries.clear();
+}
+
+const llvm::BitVector &CallGraph::reaching(StringRef pattern, u32 maxDepth, CallDirection direction) const {
+    SmallString<64> key;
+    key += direction == CALL_CALLEES ? '>' : '<';
+    key += std::to_string(maxDepth);
+    key += ':';
+    key += pattern;
+    auto [it, inserted] = queries.try_emplace(key);
+    llvm::BitVector &result = it->second;
+    if (!inserted) {
+        return result;
+    }
+    result.resize(size());
+
+    // Level 0 are the functions matching the pattern; a BFS against the
+    // direction of the query then finds every node at 1..maxDepth calls
+    std::vector<u32> frontier;
+    if (hasWildcard(pattern)) {
+        PathTrie trie(PATH_QUALIFIED_NAME);
+        trie.add(pattern);
+        llvm::BitVector matches;
+        for (u32 node = 0; node < size(); ++node) {
+            trie.match(names[node], matches);
+            if (matches.test(0)) {
+                frontier.push_back(node);
+            }
+        }
+    } else {
+        for (u32 node = 0; node < size(); ++node) {
+            if (matchesQualifiedName(pattern, names[node])) {
+                frontier.push_back(node);
+            }
+        }
+    }
+    llvm::BitVector expanded(size());
+    for (u32 node : frontier) {
+        expanded.set(node);
+    }
+    std::vector<u32> next;
+    for (u32 depth = 1; !frontier.empty() && (maxDepth == 0 || depth <= maxDepth); ++depth) {
+        next.clear();
+        for (u32 node : frontier) {
+            // calls(P) holds for the callers of a function that reaches P
+            for (u32 other : direction == CALL_CALLEES ? getCallers(node) : getCallees(node)) {
+                // A matching function may itself reach one, e.g. by recursion
+                result.set(other);
+                if (!expanded.test(other)) {
+                    expanded.set(other);
+                    next.push_back(other);
+                }
+            }
+        }
+        std::swap(frontier, next);
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Common.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+#include <utility>
+#include <vector>
+
+// Direction of a call graph query: calls() follows the calls of a function,
+// called_by() the calls into it
+enum CallDirection : u8 {
+    CALL_CALLEES,
+    CALL_CALLERS,
+};
+
+// Direct calls between the functions of one TU, in compressed sparse row
+// form: the callees of node n are callees[calleeOffsets[n] ..
+// calleeOffsets[n + 1]), and the callers likewise, so a traversal touches
+// three flat arrays and no per-node allocation.
+//
+// The plugin adds every function and call once per TU, then finalize()s the
+// graph. Queries (which nodes reach a function matching a pattern) run one
+// breadth-first search over the whole graph and are cached, so testing a
+// function against calls() or called_by() is then a bit test.
+class CallGraph {
+public:
+    static constexpr u32 NO_NODE = ~0u;
+
+    // Dense ids from 0; overloads share a name but not a node
+    u32 addFunction(StringRef qualifiedName);
+    // Calls made more than once count once
+    void addCall(u32 caller, u32 callee);
+    // Builds the adjacency arrays; no calls can be added afterwards
+    void finalize();
+
+    u32 size() const { return names.size(); }
+    StringRef getName(u32 node) const { return names[node]; }
+    ArrayRef<u32> getCallees(u32 node) const {
+        return ArrayRef<u32>(callees).slice(calleeOffsets[node], calleeOffsets[node + 1] - calleeOffsets[node]);
+    }
+    ArrayRef<u32> getCallers(u32 node) const {
+        return ArrayRef<u32>(callers).slice(callerOffsets[node], callerOffsets[node + 1] - callerOffsets[node]);
+    }
+
+    // Nodes with a path of 1 to maxDepth calls (0: any number) to a function
+    // matching pattern (CALL_CALLEES), or from one (CALL_CALLERS). The
+    // pattern has func() semantics over the qualified names.
+    const llvm::BitVector &reaching(StringRef pattern, u32 maxDepth, CallDirection direction) const;
+
+private:
+    void buildRows(bool byCaller, std::vector<u32> &offsets, std::vector<u32> &targets) const;
+
+    llvm::BumpPtrAllocator allocator;
+    llvm::UniqueStringSaver strings{allocator};
+    std::vector<StringRef> names;
+    // (caller, callee), until finalize()
+    std::vector<std::pair<u32, u32>> edges;
+    std::vector<u32> calleeOffsets;
+    std::vector<u32> callees;
+    std::vector<u32> callerOffsets;
+    std::vector<u32> callers;
+    mutable StringMap<llvm::BitVector> queries;
+};
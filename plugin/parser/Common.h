@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cassert>
 #include <memory> // For std::unique_ptr
+#include <string>
 
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h" // For llvm::sys::PrintStackTrace
@@ -18,7 +19,12 @@
 #include "llvm/Support/Error.h"
 
 
-#define DEBUG_MODE 1
+// Per-token tracing writes to llvm::errs() from the lexer and parser, which
+// is neither cheap nor safe when several compiler instances share a process.
+// Build with -DDEBUG_MODE=1 to turn it on.
+#ifndef DEBUG_MODE
+#define DEBUG_MODE 0
+#endif
 
 
 #if (DEBUG_MODE == 1)
@@ -46,16 +52,19 @@
 #define ASSERT_MSG(x, msg) if (!(x)) { DEBUG_LOG(msg); exit(1); }
 
 #define CONTENT_PRINT_SIZE 10
-#define CASSERT(x) if (!(x)) { printContext(llvm::errs()); DEBUG_LOG("Assertion failed: " #x << "\n" ); exit(1); }
-#define CASSERT_EQ(x, y) if ((x) != (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" == " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_NE(x, y) if ((x) == (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" != " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_LT(x, y) if ((x) >= (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" < " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_LE(x, y) if ((x) > (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" <= " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_GT(x, y) if ((x) <= (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" > " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_GE(x, y) if ((x) < (y)) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << ":" <<x <<" >= " #y<<":"<<y << "\n" ); exit(1); }
-#define CASSERT_NULL(x) if ((x) != nullptr) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << " is not null" << "\n" ); exit(1); }
-#define CASSERT_NOT_NULL(x) if ((x) == nullptr) { printContext(llvm::errs());DEBUG_LOG("Assertion failed: " #x << " is null" << "\n" ); exit(1); }
-#define CASSERT_MSG(x, msg) if (!(x)) { printContext(llvm::errs());DEBUG_LOG(msg << "\n" ); exit(1); }
+// Parser checks: a failed one records the error with the parser's context
+// (Parser::fail) and returns an empty value; the parse then ends, so a
+// syntax error never terminates the process
+#define CASSERT_MSG(x, msg) if (!(x)) { std::string error_; llvm::raw_string_ostream errorStream_(error_); errorStream_ << msg; fail(errorStream_.str()); return {}; }
+#define CASSERT(x) CASSERT_MSG(x, "Assertion failed: " #x)
+#define CASSERT_EQ(x, y) CASSERT_MSG((x) == (y), "Assertion failed: " #x << ":" <<x <<" == " #y<<":"<<y)
+#define CASSERT_NE(x, y) CASSERT_MSG((x) != (y), "Assertion failed: " #x << ":" <<x <<" != " #y<<":"<<y)
+#define CASSERT_LT(x, y) CASSERT_MSG((x) < (y), "Assertion failed: " #x << ":" <<x <<" < " #y<<":"<<y)
+#define CASSERT_LE(x, y) CASSERT_MSG((x) <= (y), "Assertion failed: " #x << ":" <<x <<" <= " #y<<":"<<y)
+#define CASSERT_GT(x, y) CASSERT_MSG((x) > (y), "Assertion failed: " #x << ":" <<x <<" > " #y<<":"<<y)
+#define CASSERT_GE(x, y) CASSERT_MSG((x) >= (y), "Assertion failed: " #x << ":" <<x <<" >= " #y<<":"<<y)
+#define CASSERT_NULL(x) CASSERT_MSG((x) == nullptr, "Assertion failed: " #x << " is not null")
+#define CASSERT_NOT_NULL(x) CASSERT_MSG((x) != nullptr, "Assertion failed: " #x << " is null")
 
 
 
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+#include "FunctionFacts.h"
+
+#include <optional>
+
+// Interface of a pointcut set compiled ahead of time to C++ by
+// uthelper-pointcutc (see PointcutCodegen.h). A plugin variant built with
+// UTHELPER_AOT_POINTCUTS links one generated set and matches with it, so no
+// pointcut file is read, lexed, parsed or interpreted at compile time.
+
+struct CompiledPointcut {
+    const char *name;
+    MatchKind matchKind;
+};
+
+struct CompiledPointcutSet {
+    // run_ and call_pointcuts in file order
+    ArrayRef<CompiledPointcut> pointcuts;
+    // Whether firstMatch reads FunctionFacts::qualifiedName
+    bool needsQualifiedName;
+    // Whether firstMatch reads FunctionFacts::file and namespaceName
+    bool needsScope;
+    // Whether firstMatch reads FunctionFacts::returnType and paramTypes
+    bool needsSignature;
+    // Whether firstMatch reads FunctionFacts::className and baseClasses
+    bool needsClass;
+    // Whether firstMatch reads FunctionFacts::callGraph and callGraphNode
+    bool needsCallGraph;
+    // Whether firstMatch reads FunctionFacts::stmtCount, bodyWeight and
+    // bodyFlags
+    bool needsBody;
+    // Position, among the pointcuts of matchKind, of the first one matching
+    // the function
+    std::optional<u32> (*firstMatch)(MatchKind matchKind, const FunctionFacts &facts);
+};
+
+// Defined by the generated source
+const CompiledPointcutSet &getCompiledPointcuts();
@@ -0,0 +1,197 @@
+#include "FunctionFacts.h"
+#include "CallGraph.h"
+#include "PathTrie.h"
+
+FactKind sectionFactKind(TokenKind pragmaKind) {
+    switch (pragmaKind) {
+        case TOK_BSS: return FACT_SECTION_BSS;
+        case TOK_DATA: return FACT_SECTION_DATA;
+        case TOK_RELRO: return FACT_SECTION_RELRO;
+        case TOK_RODATA: return FACT_SECTION_RODATA;
+        case TOK_TEXT: return FACT_SECTION_TEXT;
+        default:
+            llvm_unreachable("Unknown pragma kind");
+    }
+}
+
+void FunctionFacts::setSection(FactKind kind, StringRef name) {
+    StringRef &slot = sections[kind - FACT_SECTION_BSS];
+    if (slot.empty()) {
+        slot = name;
+    }
+}
+
+void FunctionFacts::clear() {
+    name = StringRef();
+    qualifiedName.clear();
+    annotations.clear();
+    typeAnnotations.clear();
+    for (auto &section : sections) {
+        section = StringRef();
+    }
+    file = StringRef();
+    namespaceName = StringRef();
+    qualifiers = 0;
+    paramCount = 0;
+    returnType.clear();
+    paramTypes.clear();
+    className = StringRef();
+    baseClasses = ArrayRef<StringRef>();
+    callGraph = nullptr;
+    callGraphNode = CallGraph::NO_NODE;
+    stmtCount = 0;
+    bodyWeight = 0;
+    bodyFlags = 0;
+}
+
+FunctionQualifier functionQualifier(TokenKind keyword) {
+    switch (keyword) {
+        case TOK_CONST: return QUALIFIER_CONST;
+        case TOK_STATIC: return QUALIFIER_STATIC;
+        case TOK_VIRTUAL: return QUALIFIER_VIRTUAL;
+        case TOK_VOLATILE: return QUALIFIER_VOLATILE;
+        default:
+            llvm_unreachable("Not a function qualifier");
+    }
+}
+
+BodyMeasure bodyMeasure(TokenKind keyword) {
+    switch (keyword) {
+        case TOK_STMT_COUNT: return BODY_STMT_COUNT;
+        case TOK_BODY_WEIGHT: return BODY_WEIGHT;
+        default:
+            llvm_unreachable("Not a body measure");
+    }
+}
+
+BodyFlag bodyFlag(TokenKind keyword) {
+    switch (keyword) {
+        case TOK_HAS_LOOP: return BODY_HAS_LOOP;
+        case TOK_HAS_CALL: return BODY_HAS_CALL;
+        default:
+            llvm_unreachable("Not a body flag");
+    }
+}
+
+namespace {
+
+bool isIdentifierChar(char c) {
+    return llvm::isAlnum(c) || c == '_';
+}
+
+bool matchParams(ArrayRef<StringRef> pattern, ArrayRef<std::string> types) {
+    if (pattern.empty()) {
+        return types.empty();
+    }
+    if (pattern.front() == "..") {
+        for (usize skip = 0; skip <= types.size(); ++skip) {
+            if (matchParams(pattern.drop_front(), types.drop_front(skip))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return !types.empty() && pattern.front() == types.front() &&
+           matchParams(pattern.drop_front(), types.drop_front());
+}
+
+} // namespace
+
+std::string normalizeTypeText(StringRef text) {
+    std::string result;
+    bool space = false;
+    for (char c : text) {
+        if (llvm::isSpace(c)) {
+            space = !result.empty();
+            continue;
+        }
+        if (space && isIdentifierChar(result.back()) && isIdentifierChar(c)) {
+            result += ' ';
+        }
+        space = false;
+        result += c;
+    }
+    return result;
+}
+
+bool matchesParamTypes(ArrayRef<StringRef> pattern, const FunctionFacts &facts) {
+    return matchParams(pattern, facts.paramTypes);
+}
+
+namespace {
+
+bool matchesName(StringRef pattern, StringRef name, StringRef qualifiedName) {
+    if (hasWildcard(pattern)) {
+        return !qualifiedName.empty() &&
+               matchesPathPattern(pattern, qualifiedName, PATH_QUALIFIED_NAME);
+    }
+    if (!pattern.contains("::")) {
+        return name == pattern;
+    }
+    if (pattern.consume_front("::")) {
+        return qualifiedName == pattern;
+    }
+    if (!qualifiedName.consume_back(pattern)) {
+        return false;
+    }
+    return qualifiedName.empty() || qualifiedName.ends_with("::");
+}
+
+} // namespace
+
+bool matchesFunctionName(StringRef pattern, const FunctionFacts &facts) {
+    return matchesName(pattern, facts.name, facts.qualifiedName);
+}
+
+bool isQualifiedNamePattern(StringRef id) {
+    return id.contains("::") || hasWildcard(id);
+}
+
+StringRef unqualifiedName(StringRef qualifiedName) {
+    usize separator = qualifiedName.rfind("::");
+    return separator == StringRef::npos ? qualifiedName : qualifiedName.drop_front(separator + 2);
+}
+
+bool matchesQualifiedName(StringRef pattern, StringRef qualifiedName) {
+    return !qualifiedName.empty() && matchesName(pattern, unqualifiedName(qualifiedName), qualifiedName);
+}
+
+bool isMethodOf(StringRef pattern, const FunctionFacts &facts) {
+    return matchesQualifiedName(pattern, facts.className);
+}
+
+bool inheritsFrom(StringRef pattern, const FunctionFacts &facts) {
+    return llvm::any_of(facts.baseClasses,
+                        [&](StringRef base) { return matchesQualifiedName(pattern, base); });
+}
+
+bool callsFunction(StringRef pattern, u32 maxDepth, const FunctionFacts &facts) {
+    return facts.callGraph && facts.callGraphNode != CallGraph::NO_NODE &&
+           facts.callGraph->reaching(pattern, maxDepth, CALL_CALLEES).test(facts.callGraphNode);
+}
+
+bool isCalledBy(StringRef pattern, u32 maxDepth, const FunctionFacts &facts) {
+    return facts.callGraph && facts.callGraphNode != CallGraph::NO_NODE &&
+           facts.callGraph->reaching(pattern, maxDepth, CALL_CALLERS).test(facts.callGraphNode);
+}
+
+bool isBodySizeWithin(BodyMeasure measure, u32 min, u32 max, const FunctionFacts &facts) {
+    u32 size = measure == BODY_STMT_COUNT ? facts.stmtCount : facts.bodyWeight;
+    return min <= size && size <= max;
+}
+
+bool exceedsOverheadRatio(u32 bodyWeight, double maxRatio) {
+    return maxRatio > 0 && bodyWeight != 0 && WRAPPER_WEIGHT > maxRatio * bodyWeight;
+}
+
+bool isWithinNamespace(StringRef prefix, const FunctionFacts &facts) {
+    StringRef name = facts.namespaceName;
+    if (!name.consume_front(prefix)) {
+        return false;
+    }
+    return name.empty() || name.starts_with("::");
+}
+
+bool isWithinFile(StringRef pattern, const FunctionFacts &facts) {
+    return !facts.file.empty() && matchesPathPattern(pattern, facts.file);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Common.h"
+#include "Token.h"
+
+#include <string>
+
+class CallGraph;
+
+// What pointcut expressions can test about one function. The plugin fills
+// this in with a single pass over the function's attributes; everything else
+// here works on these facts only, so it stays free of clang.
+enum FactKind : u8 {
+    FACT_NAME,
+    FACT_ANNOTATION,
+    FACT_TYPE_ANNOTATION,
+    FACT_SECTION_BSS,
+    FACT_SECTION_DATA,
+    FACT_SECTION_RELRO,
+    FACT_SECTION_RODATA,
+    FACT_SECTION_TEXT,
+    FACT_CLASS,             // name of the class of a method
+    FACT_BASE,              // name of one of its bases
+    FACT_KIND_COUNT
+};
+
+constexpr u32 SECTION_KIND_COUNT = FACT_SECTION_TEXT - FACT_SECTION_BSS + 1;
+
+// FACT_SECTION_* for a pragma kind token (TOK_BSS ... TOK_TEXT)
+FactKind sectionFactKind(TokenKind pragmaKind);
+
+// Bits of FunctionFacts::qualifiers
+enum FunctionQualifier : u8 {
+    QUALIFIER_CONST = 1 << 0,   // const member function
+    QUALIFIER_STATIC = 1 << 1,  // static member function, or static free function
+    QUALIFIER_VIRTUAL = 1 << 2, // virtual, also when only implied by an override
+    QUALIFIER_VOLATILE = 1 << 3, // volatile member function
+};
+
+// FunctionQualifier of a qualifier keyword (TOK_CONST, TOK_STATIC, TOK_VIRTUAL,
+// TOK_VOLATILE)
+FunctionQualifier functionQualifier(TokenKind keyword);
+
+// What stmt_count() and body_weight() measure
+enum BodyMeasure : u8 {
+    BODY_STMT_COUNT,
+    BODY_WEIGHT,
+};
+
+// BodyMeasure of a measure keyword (TOK_STMT_COUNT, TOK_BODY_WEIGHT)
+BodyMeasure bodyMeasure(TokenKind keyword);
+
+// Bits of FunctionFacts::bodyFlags
+enum BodyFlag : u8 {
+    BODY_HAS_LOOP = 1 << 0, // for, range-for, while or do
+    BODY_HAS_CALL = 1 << 1, // a call, or a constructor, new, delete or throw that calls
+};
+
+// BodyFlag of a flag keyword (TOK_HAS_LOOP, TOK_HAS_CALL)
+BodyFlag bodyFlag(TokenKind keyword);
+
+// Estimated weight of the code a woven function runs besides its own body:
+// the Pointcut built by the wrapper and the calls through around() and
+// proceed(), in the units of FunctionFacts::bodyWeight
+constexpr u32 WRAPPER_WEIGHT = 24;
+
+struct FunctionFacts {
+    StringRef name;
+    // Only filled in when PointcutIndex::needsQualifiedName()
+    std::string qualifiedName;
+    SmallVector<StringRef, 4> annotations;
+    SmallVector<StringRef, 2> typeAnnotations;
+    // First `#pragma clang section` of each kind, empty if there is none
+    StringRef sections[SECTION_KIND_COUNT];
+    // Only filled in when PointcutIndex::needsScope(): the file the function
+    // is declared in, and its enclosing named namespaces ("a::b", empty at
+    // global scope)
+    StringRef file;
+    StringRef namespaceName;
+    // FunctionQualifier bits and the number of parameters; always filled in
+    u8 qualifiers = 0;
+    u32 paramCount = 0;
+    // Only filled in when PointcutIndex::needsSignature(): the types as
+    // written in the declaration, in normalizeTypeText form
+    std::string returnType;
+    SmallVector<std::string, 4> paramTypes;
+    // Only filled in when PointcutIndex::needsClass(): the qualified name of
+    // the class of a method (empty for other functions) and those of all its
+    // direct and indirect bases, each once. The plugin computes the bases
+    // once per class and shares them between its methods.
+    StringRef className;
+    ArrayRef<StringRef> baseClasses;
+    // Only filled in when PointcutIndex::needsCallGraph(): the call graph of
+    // the TU and the function's node in it (CallGraph::NO_NODE when it is
+    // not in the graph)
+    const CallGraph *callGraph = nullptr;
+    u32 callGraphNode = ~0u;
+    // Only filled in when PointcutIndex::needsBody(): the statements of the
+    // body, its weight (roughly the instructions of one run through it, loop
+    // bodies counted several times) and BodyFlag bits. All 0 for a function
+    // without a body in the TU; the weight of a body is at least 1.
+    u32 stmtCount = 0;
+    u32 bodyWeight = 0;
+    u8 bodyFlags = 0;
+
+    StringRef section(FactKind kind) const { return sections[kind - FACT_SECTION_BSS]; }
+    void setSection(FactKind kind, StringRef name);
+    void clear();
+};
+
+// hasName() semantics: "f" matches by name, "a::f" matches a qualified-name
+// suffix at a "::" boundary, "::a::f" matches the full qualified name.
+// Patterns with `*` or `?` are globs over the components of the qualified
+// name, anchored the same way (see PathTrie.h): "app::*::get*",
+// "::app::**::serialize".
+bool matchesFunctionName(StringRef pattern, const FunctionFacts &facts);
+
+// Whether func(id) needs FunctionFacts::qualifiedName rather than the name
+bool isQualifiedNamePattern(StringRef id);
+
+// matchesFunctionName semantics over a qualified name alone (of a class, or
+// of a function of the call graph)
+bool matchesQualifiedName(StringRef pattern, StringRef qualifiedName);
+
+// Last component of a qualified name
+StringRef unqualifiedName(StringRef qualifiedName);
+
+// method_of(C): a method of a class matching C
+bool isMethodOf(StringRef pattern, const FunctionFacts &facts);
+
+// inherits(B): a method of a class with a direct or indirect base matching B
+bool inheritsFrom(StringRef pattern, const FunctionFacts &facts);
+
+// Whitespace dropped except between two identifier characters, so that
+// "const  Request &" and "const Request&" compare equal
+std::string normalizeTypeText(StringRef text);
+
+// params(T1, .., Tn): the types in normalizeTypeText form, where ".." stands
+// for any number of parameters
+bool matchesParamTypes(ArrayRef<StringRef> pattern, const FunctionFacts &facts);
+
+// calls(F, n): calls a function matching F directly or through at most n - 1
+// others (any number for n = 0), within the call graph of the TU
+bool callsFunction(StringRef pattern, u32 maxDepth, const FunctionFacts &facts);
+
+// called_by(F, n): called by a function matching F, likewise
+bool isCalledBy(StringRef pattern, u32 maxDepth, const FunctionFacts &facts);
+
+// stmt_count(min, max) / body_weight(min, max): min <= measure <= max
+bool isBodySizeWithin(BodyMeasure measure, u32 min, u32 max, const FunctionFacts &facts);
+
+// Whether the wrapper of a function with this body weight costs more than
+// maxRatio times the function, so that max-overhead-ratio=maxRatio leaves
+// it alone. Never for a ratio of 0 (no limit) or an unknown weight of 0.
+bool exceedsOverheadRatio(u32 bodyWeight, double maxRatio);
+
+// within(namespace a::b): declared in a::b or a namespace nested in it
+bool isWithinNamespace(StringRef prefix, const FunctionFacts &facts);
+
+// within("glob"): declared in a file matching the pattern (see PathTrie.h)
+bool isWithinFile(StringRef pattern, const FunctionFacts &facts);
@@ -2,56 +2,79 @@
 
 #include "Common.h"
 
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #undef CONTENT_PRINT_SIZE
 #define CONTENT_PRINT_SIZE 50
 
+namespace {
+
+enum CharClass : u8 {
+    CC_SPACE = 1 << 0,
+    CC_IDENT_START = 1 << 1, // letters, '_', '.', ':' (qualified names), '*' and '?' (globs)
+    CC_IDENT = 1 << 2,       // CC_IDENT_START and digits
+    CC_DIGIT = 1 << 3,
+};
+
+constexpr std::array<u8, 256> CharClasses = [] {
+    std::array<u8, 256> classes{};
+    for (u32 c = 0; c < 256; ++c) {
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                      c == ':' || c == '_' || c == '.' || c == '*' || c == '?';
+        bool digit = c >= '0' && c <= '9';
+        bool space = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        classes[c] = (space ? CC_SPACE : 0) | (letter ? CC_IDENT_START : 0) |
+                     (letter || digit ? CC_IDENT : 0) | (digit ? CC_DIGIT : 0);
+    }
+    return classes;
+}();
+
+inline bool hasClass(char c, CharClass cls) {
+    return CharClasses[static_cast<u8>(c)] & cls;
+}
+
+} // namespace
+
 Lexer::Lexer(llvm::StringRef input)
     : source(input), ptr(input.begin()) {}
 
 Token Lexer::next() {
-    while (ptr != source.end()) {
+    const char *end = source.end();
+    while (ptr != end) {
         char c = *ptr;
+        u8 cls = CharClasses[static_cast<u8>(c)];
 
-        // Skip whitespace
-        if (isWhitespace(c)) {
-            ++ptr;
-            continue;
-        }
-
-        // Handle comments
-        if (c == '#') {
-            // Skip comments
-            lexComment();
+        if (cls & CC_SPACE) {
+            skipWhitespace();
             continue;
         }
 
         // Handle identifiers and keywords
-        if (isLetter(c) || c == '_' || c == '.') {
-            DEBUG_LOG("lexIdentifierOrKeyword");
+        if (cls & CC_IDENT_START) {
             return lexIdentifierOrKeyword();
         }
 
         // Handle numbers
-        if (isDigit(c)) {
-            DEBUG_LOG("lexNumber");
+        if (cls & CC_DIGIT) {
             return lexNumber();
         }
 
-        // Handle string literals
-        if (c == '"') {
-            DEBUG_LOG("lexStringLiteral");
-            return lexStringLiteral();
-        }
-
-        DEBUG_LOG("lexOperator: " << c);
-        // Handle operators and punctuation
+        // Handle comments, string literals, operators and punctuation
         switch (c) {
+            case '#':
+                lexComment();
+                continue;
+            case '"':
+                return lexStringLiteral();
             case '(':
                 ++ptr;
-                if (paren_open_idx < paren_pairloc_stack.size()) {
-                    return Token(TOK_LPAREN);
-                }
-                break;
+                return Token(TOK_LPAREN);
             case ')':
                 ++ptr;
                 return Token(TOK_RPAREN);
@@ -66,24 +89,20 @@ Token Lexer::next() {
                 return Token(TOK_EXCLAMATION);
             case '=':
                 if (peekNext() == '>') {
-                    ++ptr;
-                    ++ptr;
+                    ptr += 2;
                     return Token(TOK_ARROW);
-                } else {
-                    ++ptr;
-                    return Token(TOK_EQUAL);
                 }
+                ++ptr;
+                return Token(TOK_EQUAL);
             case '&':
                 if (peekNext() == '&') {
-                    ++ptr;
-                    ++ptr;
+                    ptr += 2;
                     return Token(TOK_AMPAMP);
                 }
                 break;
             case '|':
                 if (peekNext() == '|') {
-                    ++ptr;
-                    ++ptr;
+                    ptr += 2;
                     return Token(TOK_PIPEPIPE);
                 }
                 break;
@@ -92,62 +111,14 @@ Token Lexer::next() {
         }
 
         // Unknown character
-        DEBUG_LOG("Unknown symbol '" << c << "'");
+        DEBUG_PRINT("Unknown symbol '" << c << "'");
         ++ptr;
-        return Token(TOK_UNKNOWN, llvm::StringRef(&c, 1));
+        return Token(TOK_UNKNOWN, llvm::StringRef(ptr - 1, 1));
     }
 
     return Token(TOK_EOF);
 }
 
-const char* Lexer::updateDeclarationEnd() {
-    const char* org_loc = getCurrent();
-    paren_pairloc_stack.clear();
-    paren_open_idx = 0;
-
-    llvm::SmallVector<size_t, 10> temp_open_paren_loc_stack;
-    const char* result = nullptr;
-    while (ptr != source.end()) {
-        char c = *ptr;
-
-        // Handle comments
-        if (c == '#') {
-            // Skip comments
-            lexComment();
-            continue;
-        }
-        size_t idx;
-        switch (c) {
-            case '(':
-                temp_open_paren_loc_stack.push_back(paren_pairloc_stack.size());
-                paren_pairloc_stack.push_back(ptr);
-                break;
-            case ')':
-                if (!temp_open_paren_loc_stack.empty()) {
-                    idx = temp_open_paren_loc_stack.back();
-                    temp_open_paren_loc_stack.pop_back();
-                    if (idx < paren_pairloc_stack.size()) {
-                        paren_pairloc_stack[idx] = ptr;
-                    }
-                }
-                break;
-            case ';':
-                if (temp_open_paren_loc_stack.empty()) {
-                    result = ptr;
-                    cur_decl_end = ptr;
-                    restore(org_loc);
-                    return result;
-                }
-                break;
-            default:
-                break;
-        }
-        ++ptr;
-    }
-    restore(org_loc);
-    return result;
-}
-
 const char* Lexer::getCurrent() const {
     return ptr;
 }
@@ -156,6 +127,23 @@ void Lexer::restore(const char* pos) {
     ptr = pos;
 }
 
+llvm::StringRef Lexer::typeText() {
+    const char *start = ptr;
+    const char *end = source.end();
+    u32 depth = 0;
+    for (; ptr != end; ++ptr) {
+        char c = *ptr;
+        if (c == '(' || c == '<' || c == '[') {
+            ++depth;
+        } else if (depth == 0 && (c == ')' || c == ',')) {
+            break;
+        } else if (depth != 0 && (c == ')' || c == '>' || c == ']')) {
+            --depth;
+        }
+    }
+    return llvm::StringRef(start, ptr - start).trim();
+}
+
 void Lexer::printContext(llvm::raw_ostream &OS) {
     const char* start = (ptr - CONTENT_PRINT_SIZE) > source.data() ? (ptr - CONTENT_PRINT_SIZE) : source.data();
     OS << llvm::StringRef(start, ptr - start);
@@ -174,37 +162,51 @@ char Lexer::peekNext(size_t offset) const {
     }
 }
 
-bool Lexer::isWhitespace(char c) const {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
-}
-
-bool Lexer::isLetter(char c) const {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == ':';
-}
-
-bool Lexer::isDigit(char c) const {
-    return c >= '0' && c <= '9';
+void Lexer::skipWhitespace() {
+    const char *end = source.end();
+    // Most runs are a single separator; only longer ones (indentation, blank
+    // lines of generated files) are worth a vector compare
+    ++ptr;
+    if (ptr == end || !hasClass(*ptr, CC_SPACE)) {
+        return;
+    }
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    while (end - ptr >= 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+        __m128i isSpace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, carriageReturn)));
+        u32 other = ~static_cast<u32>(_mm_movemask_epi8(isSpace)) & 0xFFFFu;
+        if (other) {
+            ptr += std::countr_zero(other);
+            return;
+        }
+        ptr += 16;
+    }
+#endif
+    while (ptr != end && hasClass(*ptr, CC_SPACE)) {
+        ++ptr;
+    }
 }
 
 Token Lexer::lexIdentifierOrKeyword() {
     const char *start = ptr;
-    while (ptr != source.end() && (isLetter(*ptr) || isDigit(*ptr) || *ptr == '_' || *ptr == '.')) {
+    const char *end = source.end();
+    while (ptr != end && hasClass(*ptr, CC_IDENT)) {
         ++ptr;
     }
-    llvm::StringRef text(start, ptr - start);
-
-    // Check for keywords
-    if (KeywordToken::isKeyword(text)) {
-        DEBUG_LOG("lexIdentifierOrKeyword(KeywordToken): " << text);
-        return KeywordToken(text);
-    }
-    DEBUG_LOG("lexIdentifierOrKeyword(TOK_IDENTIFIER): " << text);
-    return Token(TOK_IDENTIFIER, text);
+    // One perfect-hash probe; anything that is not a keyword is TOK_IDENTIFIER
+    return KeywordToken(llvm::StringRef(start, ptr - start));
 }
 
 Token Lexer::lexNumber() {
     const char *start = ptr;
-    while (ptr != source.end() && isDigit(*ptr)) {
+    const char *end = source.end();
+    while (ptr != end && hasClass(*ptr, CC_DIGIT)) {
         ++ptr;
     }
     llvm::StringRef text(start, ptr - start);
@@ -214,19 +216,19 @@ Token Lexer::lexNumber() {
 Token Lexer::lexStringLiteral() {
     const char *start = ptr;
     ++ptr; // Skip opening quote
-    while (ptr != source.end() && *ptr != '"') {
-        ++ptr;
-    }
-    if (ptr != source.end()) {
-        ++ptr; // Skip closing quote
-    }
+    const char *quote = static_cast<const char *>(std::memchr(ptr, '"', source.end() - ptr));
+    // Skip closing quote, or run to the end of an unterminated literal
+    ptr = quote ? quote + 1 : source.end();
     llvm::StringRef text(start, ptr - start);
     return Token(TOK_STRING_LITERAL, text);
 }
 
 void Lexer::lexComment() {
     ++ptr; // Skip '#'
-    while (ptr != source.end() && *ptr != '\n' && *ptr != '\r') {
-        ++ptr;
-    }
-}
\ No newline at end of file
+    // A comment ends at the first '\n' or '\r'
+    const char *end = source.end();
+    const char *newline = static_cast<const char *>(std::memchr(ptr, '\n', end - ptr));
+    const char *lineEnd = newline ? newline : end;
+    const char *carriageReturn = static_cast<const char *>(std::memchr(ptr, '\r', lineEnd - ptr));
+    ptr = carriageReturn ? carriageReturn : lineEnd;
+}
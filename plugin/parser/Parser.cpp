@@ -1,30 +1,45 @@
 #include "Parser.h"
 #include "Common.h"
+#include "FunctionFacts.h"
+#include "PathTrie.h"
 
-Parser::Parser(Lexer &lexer) : lex(lexer), currentToken(TOK_NOT_INIT) {
+Parser::Parser(Lexer &lexer, PointcutContext &context)
+    : lex(lexer), context(context), currentToken(TOK_NOT_INIT) {
 }
 
-std::vector<PointcutDeclarationPtr> Parser::parsePointcutList() {
-    std::vector<PointcutDeclarationPtr> declarations;
+std::vector<PointcutDeclaration*> Parser::parsePointcutList() {
+    std::vector<PointcutDeclaration*> declarations;
     while (currentToken.kind != TOK_EOF) {
-        lex.updateDeclarationEnd();
         if (currentToken.kind == TOK_NOT_INIT) {
             nextToken();
         }
 
         auto decl = pointcut_declaration();
-        CASSERT_MSG(decl, "Failed to parse pointcut declaration.");
-        declarations.push_back(std::move(decl));
+        CASSERT_MSG(decl && !hasError(), "Failed to parse pointcut declaration.");
+        declarations.push_back(decl);
     }
     return declarations;
 }
 
 void Parser::printContext(llvm::raw_ostream &OS) {
-    llvm::errs() << "Current token: " << currentToken << "\t";
-    lex.printContext(llvm::errs());
+    OS << "Current token: " << currentToken << "\t";
+    lex.printContext(OS);
+}
+
+void Parser::fail(StringRef message) {
+    if (hasError()) {
+        return;
+    }
+    llvm::raw_string_ostream OS(error);
+    OS << message << "\n";
+    printContext(OS);
+    currentToken = Token(TOK_EOF);
 }
 
 void Parser::nextToken() {
+    if (hasError()) {
+        return;
+    }
     currentToken = lex.next();
     // Skip comments
     while (currentToken.kind == TOK_COMMENT) {
@@ -34,9 +49,6 @@ void Parser::nextToken() {
 
 Token Parser::_c(TokenKind expectedKind, llvm::StringRef msg) {
     if (currentToken.kind != expectedKind) {
-        if (!msg.empty()) {
-            llvm::errs() << "Expected " << msg << Token(expectedKind) << ", got " << currentToken << "\n";
-        }
         return Token(TOK_EOF);
     }
     DEBUG_PRINT("check, current token: " + Token::toTwine(currentToken.kind));
@@ -47,18 +59,23 @@ Token Parser::_c(TokenKind expectedKind, llvm::StringRef msg) {
 
 Token Parser::_(TokenKind expectedKind, llvm::StringRef msg) {
     auto token = _c(expectedKind, msg);
-    CASSERT(token.kind != TOK_EOF);
+    if (token.kind == TOK_EOF) {
+        std::string message;
+        llvm::raw_string_ostream OS(message);
+        OS << "Expected " << msg << (msg.empty() ? "" : " ") << Token(expectedKind) << ", got " << currentToken;
+        fail(OS.str());
+    }
     return token;
 }
 
-PointcutDeclarationPtr Parser::pointcut_declaration() {
+PointcutDeclaration* Parser::pointcut_declaration() {
     auto result = _pointcut_declaration();
-    DEBUG_LOG("parsePointcutDeclaration, current token: " + Token::toTwine(currentToken.kind) + ", result: " + (result ? "success" : "failure"));
+    DEBUG_PRINT("parsePointcutDeclaration, current token: " + Token::toTwine(currentToken.kind) + ", result: " + (result ? "success" : "failure"));
     DEBUG_NODE_LOG(result);
     return result;
 }
 
-PointcutDeclarationPtr Parser::_pointcut_declaration() {
+PointcutDeclaration* Parser::_pointcut_declaration() {
     bool isExported = false;
     MatchKind matchKind = MATCH_NONE;
     llvm::StringRef name;
@@ -71,7 +88,7 @@ PointcutDeclarationPtr Parser::_pointcut_declaration() {
         matchKind = MATCH_CALL;
     }
 
-    name = _(TOK_IDENTIFIER, "Pointcut name").text;
+    name = context.intern(_(TOK_IDENTIFIER, "Pointcut name").text);
 
     _(TOK_EQUAL);
     auto expr = parseExpression();
@@ -80,7 +97,15 @@ PointcutDeclarationPtr Parser::_pointcut_declaration() {
 
     _(TOK_SEMICOLON);
 
-    return std::make_unique<PointcutDeclaration>(isExported, name, matchKind, std::move(expr));
+    auto decl = context.create<PointcutDeclaration>(isExported, name, matchKind, expr);
+    auto [it, inserted] = declarations.try_emplace(name, decl);
+    if (!inserted) {
+        // Duplicates are reported by the users of the list, unless a
+        // reference would then be ambiguous
+        CASSERT_MSG(!referenced.contains(name), "Pointcut " << name << " is declared again after being referred to");
+        it->second = nullptr;
+    }
+    return decl;
 }
 
 Token Parser::pragma_kind() {
@@ -99,58 +124,99 @@ Token Parser::pragma_kind() {
         nextToken();
         return kind;
     }
-    CASSERT_MSG(false, "Expected pragma kind (bss, data, relro, rodata, text): " << currentToken);
+    std::string message;
+    llvm::raw_string_ostream OS(message);
+    OS << "Expected pragma kind (bss, data, relro, rodata, text): " << currentToken;
+    fail(OS.str());
     return Token(TOK_EOF);
 }
 
-ASTNodePtr Parser::parseExpression() {
+ASTNode* Parser::parseExpression() {
     return parseOrExpression();
 }
 
-ASTNodePtr Parser::parseOrExpression() {
+ASTNode* Parser::parseOrExpression() {
     auto lhs = parseAndExpression();
     while (_c(TOK_PIPEPIPE).kind != TOK_EOF) {
         auto rhs = parseAndExpression();
-        lhs = std::make_unique<OrExpression>(std::move(lhs), std::move(rhs));
+        lhs = context.create<OrExpression>(lhs, rhs);
     }
     return lhs;
 }
 
-ASTNodePtr Parser::parseAndExpression() {
+ASTNode* Parser::parseAndExpression() {
     auto lhs = parseUnaryExpression();
     while (_c(TOK_AMPAMP).kind != TOK_EOF) {
         auto rhs = parseUnaryExpression();
-        lhs = std::make_unique<AndExpression>(std::move(lhs), std::move(rhs));
+        lhs = context.create<AndExpression>(lhs, rhs);
     }
     return lhs;
 }
 
-ASTNodePtr Parser::parseUnaryExpression() {
+ASTNode* Parser::parseUnaryExpression() {
     if (_c(TOK_EXCLAMATION).kind != TOK_EOF) {
         auto expr = parseUnaryExpression();
-        return std::make_unique<NotExpression>(std::move(expr));
+        return context.create<NotExpression>(expr);
     } else {
         return parsePrimaryExpression();
     }
 }
 
-ASTNodePtr Parser::parsePrimaryExpression() {
+ASTNode* Parser::parsePrimaryExpression() {
     if (_c(TOK_LPAREN).kind != TOK_EOF) {
         auto expr = parseExpression();
         _(TOK_RPAREN);
-        return std::make_unique<ParenthesizedExpression>(std::move(expr));
+        return context.create<ParenthesizedExpression>(expr);
     } else {
         return parsePointcutPrimary();
     }
 }
 
-ASTNodePtr Parser::parsePointcutPrimary() {
+TokenKind Parser::contextualPredicate() {
+    TokenKind kind = llvm::StringSwitch<TokenKind>(currentToken.text)
+        .Case("virtual", TOK_VIRTUAL)
+        .Case("returns", TOK_RETURNS)
+        .Case("params", TOK_PARAMS)
+        .Case("param_count", TOK_PARAM_COUNT)
+        .Case("method_of", TOK_METHOD_OF)
+        .Case("inherits", TOK_INHERITS)
+        .Case("calls", TOK_CALLS)
+        .Case("called_by", TOK_CALLED_BY)
+        .Case("stmt_count", TOK_STMT_COUNT)
+        .Case("body_weight", TOK_BODY_WEIGHT)
+        .Case("has_loop", TOK_HAS_LOOP)
+        .Case("has_call", TOK_HAS_CALL)
+        .Default(TOK_IDENTIFIER);
+    switch (kind) {
+        case TOK_IDENTIFIER:
+            return kind;
+        case TOK_VIRTUAL:
+        case TOK_HAS_LOOP:
+        case TOK_HAS_CALL:
+            // Without arguments: an earlier pointcut of that name wins
+            return declarations.count(currentToken.text) ? TOK_IDENTIFIER : kind;
+        default: {
+            // With arguments: only before "("
+            const char *position = lex.getCurrent();
+            bool call = lex.next().kind == TOK_LPAREN;
+            lex.restore(position);
+            return call ? kind : TOK_IDENTIFIER;
+        }
+    }
+}
+
+ASTNode* Parser::parsePointcutPrimary() {
+    if (currentToken.kind == TOK_IDENTIFIER) {
+        currentToken.kind = contextualPredicate();
+    }
     if (_c(TOK_FUNC).kind != TOK_EOF) {
         _(TOK_LPAREN);
         auto functionName = _(TOK_IDENTIFIER, "Function name").text;
+        CASSERT_MSG(!hasWildcard(functionName) || isValidPathPattern(functionName, PATH_QUALIFIED_NAME),
+                    "Malformed function name pattern in func(): " << functionName);
         _(TOK_RPAREN);
-        DEBUG_LOG("parsePointcutPrimary, current token: " + Token::toTwine(currentToken.kind));
-        return std::make_unique<FuncExpression>(functionName);
+        DEBUG_PRINT("parsePointcutPrimary, current token: " + Token::toTwine(currentToken.kind));
+        return context.create<FuncExpression>(context.intern(functionName));
     }
     if (_c(TOK_PRAGMA_CLANG).kind != TOK_EOF) {
         _(TOK_LPAREN);
@@ -158,25 +224,176 @@ ASTNodePtr Parser::parsePointcutPrimary() {
         _(TOK_COMMA);
         auto sectionName = _(TOK_IDENTIFIER, "Section name").text;
         _(TOK_RPAREN);
-        return std::make_unique<PragmaClangExprNode>(pragmaKind, sectionName);
+        pragmaKind.text = context.intern(pragmaKind.text);
+        return context.create<PragmaClangExprNode>(pragmaKind, context.intern(sectionName));
     }
     if (_c(TOK_ANNOTATION).kind != TOK_EOF) {
         _(TOK_LPAREN);
         auto annotationName = _(TOK_IDENTIFIER, "Annotation name").text;
         _(TOK_RPAREN);
-        return std::make_unique<NotationExprNode>(annotationName);
+        return context.create<NotationExprNode>(context.intern(annotationName));
     }
     if (_c(TOK_ANNOTATION_ANALYSIS).kind != TOK_EOF) {
         _(TOK_LPAREN);
         auto annotationName = _(TOK_IDENTIFIER, "Annotation name").text;
         _(TOK_RPAREN);
-        return std::make_unique<NotationAnalysisExprNode>(annotationName);
+        return context.create<NotationAnalysisExprNode>(context.intern(annotationName));
+    }
+
+    if (_c(TOK_WITHIN).kind != TOK_EOF) {
+        _(TOK_LPAREN);
+        ASTNode *scope = nullptr;
+        // Contextual as well, and only a keyword here
+        if (currentToken.kind == TOK_IDENTIFIER && currentToken.text == Token(TOK_NAMESPACE).text) {
+            nextToken();
+            StringRef name = _(TOK_IDENTIFIER, "Namespace name").text;
+            name.consume_front("::");
+            CASSERT_MSG(!name.empty() && !name.ends_with("::") && !name.contains(":::"),
+                        "Malformed namespace name in within(): " << name);
+            scope = context.create<WithinNamespaceExpression>(context.intern(name));
+        } else {
+            StringRef literal = _(TOK_STRING_LITERAL, "File path pattern").text;
+            CASSERT_MSG(literal.size() >= 2 && literal.ends_with("\""),
+                        "Unterminated file path pattern in within(): " << literal);
+            StringRef pattern = literal.drop_front().drop_back();
+            CASSERT_MSG(isValidPathPattern(pattern), "Malformed file path pattern in within(): " << literal);
+            scope = context.create<WithinFileExpression>(context.intern(pattern));
+        }
+        _(TOK_RPAREN);
+        return scope;
+    }
+
+    if (_c(TOK_METHOD_OF).kind != TOK_EOF) {
+        return context.create<MethodOfExpression>(classPattern("method_of"));
+    }
+    if (_c(TOK_INHERITS).kind != TOK_EOF) {
+        return context.create<InheritsExpression>(classPattern("inherits"));
+    }
+    if (_c(TOK_CALLS).kind != TOK_EOF) {
+        auto [pattern, depth] = callPattern("calls");
+        return context.create<CallsExpression>(pattern, depth);
+    }
+    if (_c(TOK_CALLED_BY).kind != TOK_EOF) {
+        auto [pattern, depth] = callPattern("called_by");
+        return context.create<CalledByExpression>(pattern, depth);
+    }
+    for (TokenKind qualifier : {TOK_CONST, TOK_STATIC, TOK_VIRTUAL, TOK_VOLATILE}) {
+        if (_c(qualifier).kind != TOK_EOF) {
+            return context.create<QualifierExpression>(qualifier);
+        }
+    }
+    if (_c(TOK_RETURNS).kind != TOK_EOF) {
+        StringRef type = typeText();
+        CASSERT_MSG(!type.empty(), "Expected a type in returns()");
+        _(TOK_RPAREN);
+        return context.create<ReturnsExpression>(type);
+    }
+    if (_c(TOK_PARAMS).kind != TOK_EOF) {
+        SmallVector<StringRef, 4> types;
+        StringRef type = typeText();
+        // params() is a function without parameters
+        if (!type.empty() || currentToken.kind != TOK_RPAREN) {
+            types.push_back(type);
+            while (currentToken.kind == TOK_COMMA) {
+                types.push_back(typeText(TOK_COMMA));
+            }
+            for (StringRef t : types) {
+                CASSERT_MSG(!t.empty(), "Empty parameter type in params()");
+            }
+        }
+        _(TOK_RPAREN);
+        return context.create<ParamsExpression>(context.copy(ArrayRef<StringRef>(types)));
+    }
+    for (TokenKind measure : {TOK_STMT_COUNT, TOK_BODY_WEIGHT}) {
+        if (_c(measure).kind != TOK_EOF) {
+            auto [min, max] = sizeRange(Token(measure).text);
+            return context.create<BodySizeExpression>(measure, min, max);
+        }
+    }
+    for (TokenKind flag : {TOK_HAS_LOOP, TOK_HAS_CALL}) {
+        if (_c(flag).kind != TOK_EOF) {
+            return context.create<BodyFlagExpression>(flag);
+        }
+    }
+    if (_c(TOK_PARAM_COUNT).kind != TOK_EOF) {
+        _(TOK_LPAREN);
+        StringRef number = _(TOK_NUMBER, "Parameter count").text;
+        u32 count = 0;
+        CASSERT_MSG(!number.getAsInteger(10, count), "Parameter count out of range: " << number);
+        _(TOK_RPAREN);
+        return context.create<ParamCountExpression>(count);
+    }
+
+    if (currentToken.kind == TOK_IDENTIFIER) {
+        StringRef name = currentToken.text;
+        nextToken();
+        return pointcutRef(name);
     }
 
-    ASSERT_MSG(false, "Unknown expression starting with " << currentToken << "\n");
+    CASSERT_MSG(false, "Unknown expression starting with " << currentToken);
     return nullptr;
 }
 
+StringRef Parser::classPattern(StringRef predicate) {
+    _(TOK_LPAREN);
+    StringRef pattern = _(TOK_IDENTIFIER, "Class name").text;
+    CASSERT_MSG(!hasWildcard(pattern) || isValidPathPattern(pattern, PATH_QUALIFIED_NAME),
+                "Malformed class name pattern in " << predicate << "(): " << pattern);
+    CASSERT_MSG(!pattern.ends_with("::") && pattern != "::",
+                "Malformed class name in " << predicate << "(): " << pattern);
+    _(TOK_RPAREN);
+    return context.intern(pattern);
+}
+
+std::pair<StringRef, u32> Parser::callPattern(StringRef predicate) {
+    _(TOK_LPAREN);
+    StringRef pattern = _(TOK_IDENTIFIER, "Function name").text;
+    CASSERT_MSG(!hasWildcard(pattern) || isValidPathPattern(pattern, PATH_QUALIFIED_NAME),
+                "Malformed function name pattern in " << predicate << "(): " << pattern);
+    u32 depth = 0;
+    if (_c(TOK_COMMA).kind != TOK_EOF) {
+        StringRef number = _(TOK_NUMBER, "Call depth").text;
+        CASSERT_MSG(!number.getAsInteger(10, depth) && depth != 0,
+                    "Call depth in " << predicate << "() must be a positive number: " << number);
+    }
+    _(TOK_RPAREN);
+    return {context.intern(pattern), depth};
+}
+
+std::pair<u32, u32> Parser::sizeRange(StringRef predicate) {
+    _(TOK_LPAREN);
+    StringRef number = _(TOK_NUMBER, "Minimum size").text;
+    u32 min = 0;
+    CASSERT_MSG(!number.getAsInteger(10, min), "Minimum of " << predicate << "() out of range: " << number);
+    u32 max = UNBOUNDED;
+    if (_c(TOK_COMMA).kind != TOK_EOF) {
+        number = _(TOK_NUMBER, "Maximum size").text;
+        CASSERT_MSG(!number.getAsInteger(10, max) && max != UNBOUNDED,
+                    "Maximum of " << predicate << "() out of range: " << number);
+        CASSERT_MSG(min <= max, "Empty range in " << predicate << "(): " << min << " > " << max);
+    }
+    _(TOK_RPAREN);
+    return {min, max};
+}
+
+ASTNode* Parser::pointcutRef(StringRef name) {
+    auto it = declarations.find(name);
+    // Only earlier declarations can be named, so references cannot form a cycle
+    CASSERT_MSG(it != declarations.end(),
+                "Unknown pointcut " << name << " (a pointcut can only refer to those declared before it)");
+    CASSERT_MSG(it->second, "Pointcut " << name << " is declared more than once and cannot be referred to");
+    referenced.insert(name);
+    return context.create<PointcutRefExpression>(it->second->name, it->second);
+}
+
+StringRef Parser::typeText(TokenKind opening) {
+    // The lexer is right after the current token, the '(' or ',' before the type
+    CASSERT_MSG(currentToken.kind == opening, "Expected " << Token(opening) << " before a type, got " << currentToken);
+    std::string type = normalizeTypeText(lex.typeText());
+    nextToken();
+    return context.intern(type);
+}
+
 void Parser::skipToNextSemicolon() {
     while (currentToken.kind != TOK_SEMICOLON && currentToken.kind != TOK_EOF) {
         nextToken();
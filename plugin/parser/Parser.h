@@ -1,40 +1,71 @@
 #include "ASTNode.h"
 #include "Lexer.h"
 #include "Token.h"
+#include <string>
 #include <vector>
 #include <llvm/ADT/StringSwitch.h>
 #include <llvm/Support/raw_ostream.h>
 
 
 // Parser class
+// Nodes and identifiers are created in context, so the declarations live
+// as long as it does, independent of the lexed text.
 class Parser {
 public:
-    Parser(Lexer &lexer);
+    Parser(Lexer &lexer, PointcutContext &context);
 
-    std::vector<PointcutDeclarationPtr> parsePointcutList();
+    // The declarations of the text; on a syntax error the parse stops there,
+    // hasError() is set and the list is empty
+    std::vector<PointcutDeclaration*> parsePointcutList();
+
+    bool hasError() const { return !error.empty(); }
+    // The first syntax error with its context, for the caller to report
+    const std::string &getError() const { return error; }
 
     void printContext(llvm::raw_ostream &OS);
 
 private:
     Lexer &lex;
+    PointcutContext &context;
     Token currentToken;
+    // Declarations so far by name, for references; nullptr once a name is
+    // declared twice
+    StringMap<PointcutDeclaration*> declarations;
+    StringSet<> referenced;
+    std::string error;
 
     void nextToken();
+    // Records the first error and ends the parse: from here on the current
+    // token stays TOK_EOF
+    void fail(llvm::StringRef message);
 
     Token _c(TokenKind expectedKind, llvm::StringRef msg = "");
     Token _(TokenKind expectedKind, llvm::StringRef msg = "");
 
-    PointcutDeclarationPtr pointcut_declaration();
-    PointcutDeclarationPtr _pointcut_declaration();
+    PointcutDeclaration* pointcut_declaration();
+    PointcutDeclaration* _pointcut_declaration();
 
     Token pragma_kind();
+    // Kind of the predicate the current identifier starts, or TOK_IDENTIFIER
+    // when it is the name of a pointcut (see Token.def)
+    TokenKind contextualPredicate();
+    // "(" class name pattern ")" of method_of() and inherits()
+    llvm::StringRef classPattern(llvm::StringRef predicate);
+    // "(" function name pattern [ "," depth ] ")" of calls() and called_by()
+    std::pair<llvm::StringRef, u32> callPattern(llvm::StringRef predicate);
+    // "(" min [ "," max ] ")" of stmt_count() and body_weight()
+    std::pair<u32, u32> sizeRange(llvm::StringRef predicate);
+    // Reference to the pointcut declared as name
+    ASTNode* pointcutRef(llvm::StringRef name);
+    // Type argument of returns() and params(), in normalizeTypeText form
+    llvm::StringRef typeText(TokenKind opening = TOK_LPAREN);
 
-    ASTNodePtr parseExpression();
-    ASTNodePtr parseOrExpression();
-    ASTNodePtr parseAndExpression();
-    ASTNodePtr parseUnaryExpression();
-    ASTNodePtr parsePrimaryExpression();
-    ASTNodePtr parsePointcutPrimary();
+    ASTNode* parseExpression();
+    ASTNode* parseOrExpression();
+    ASTNode* parseAndExpression();
+    ASTNode* parseUnaryExpression();
+    ASTNode* parsePrimaryExpression();
+    ASTNode* parsePointcutPrimary();
 
     void skipToNextSemicolon();
 };
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "PathTrie.h"
+
+namespace {
+
+void splitPath(StringRef path, PathSyntax syntax, llvm::SmallVectorImpl<StringRef> &components) {
+    if (syntax == PATH_QUALIFIED_NAME) {
+        while (!path.empty()) {
+            auto [component, rest] = path.split("::");
+            if (!component.empty()) {
+                components.push_back(component);
+            }
+            path = rest;
+        }
+        return;
+    }
+    while (!path.empty()) {
+        usize end = path.find_first_of("/\\");
+        StringRef component = path.take_front(end);
+        if (!component.empty() && component != ".") {
+            components.push_back(component);
+        }
+        if (end == StringRef::npos) {
+            break;
+        }
+        path = path.drop_front(end + 1);
+    }
+}
+
+bool isAnchored(StringRef pattern, PathSyntax syntax) {
+    if (syntax == PATH_QUALIFIED_NAME) {
+        return pattern.starts_with("::");
+    }
+    return pattern.starts_with("/") || pattern.starts_with("\\");
+}
+
+// Straightforward backtracking over the components; the reference for
+// PathTrie::match
+bool matchComponents(ArrayRef<StringRef> pattern, ArrayRef<StringRef> path) {
+    if (pattern.empty()) {
+        return path.empty();
+    }
+    if (pattern.front() == "**") {
+        for (usize skip = 0; skip <= path.size(); ++skip) {
+            if (matchComponents(pattern.drop_front(), path.drop_front(skip))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (path.empty()) {
+        return false;
+    }
+    llvm::Expected<llvm::GlobPattern> glob = llvm::GlobPattern::create(pattern.front());
+    if (!glob) {
+        llvm::consumeError(glob.takeError());
+        return false;
+    }
+    return glob->match(path.front()) && matchComponents(pattern.drop_front(), path.drop_front());
+}
+
+} // namespace
+
+bool hasWildcard(StringRef text) {
+    return text.find_first_of("*?[") != StringRef::npos;
+}
+
+bool matchesPathPattern(StringRef pattern, StringRef path, PathSyntax syntax) {
+    SmallVector<StringRef, 8> patternComponents;
+    if (!isAnchored(pattern, syntax)) {
+        patternComponents.push_back("**");
+    }
+    splitPath(pattern, syntax, patternComponents);
+    SmallVector<StringRef, 16> pathComponents;
+    splitPath(path, syntax, pathComponents);
+    return matchComponents(patternComponents, pathComponents);
+}
+
+bool isValidPathPattern(StringRef pattern, PathSyntax syntax) {
+    SmallVector<StringRef, 8> components;
+    splitPath(pattern, syntax, components);
+    if (components.empty()) {
+        return false;
+    }
+    for (StringRef component : components) {
+        if (component == "**" || !hasWildcard(component)) {
+            continue;
+        }
+        llvm::Expected<llvm::GlobPattern> glob = llvm::GlobPattern::create(component);
+        if (!glob) {
+            llvm::consumeError(glob.takeError());
+            return false;
+        }
+    }
+    return true;
+}
+
+PathTrie::PathTrie(PathSyntax syntax) : syntax(syntax) {
+    nodes.emplace_back();
+}
+
+PathTrie::PathTrie(const PathTrie &other) : PathTrie(other.syntax) {
+    std::vector<StringRef> patterns(other.size());
+    for (const auto &entry : other.patternIds) {
+        patterns[entry.second] = entry.getKey();
+    }
+    // Same ids, as they are handed out in order
+    for (StringRef pattern : patterns) {
+        add(pattern);
+    }
+}
+
+PathTrie &PathTrie::operator=(const PathTrie &other) {
+    if (this != &other) {
+        *this = PathTrie(other);
+    }
+    return *this;
+}
+
+std::optional<u32> PathTrie::find(StringRef pattern) const {
+    auto it = patternIds.find(pattern);
+    if (it == patternIds.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+u32 PathTrie::child(u32 parent, StringRef component) {
+    if (component == "**") {
+        if (nodes[parent].anyDepth == NO_NODE) {
+            u32 node = nodes.size();
+            nodes.emplace_back();
+            nodes[node].repeats = true;
+            nodes[parent].anyDepth = node;
+        }
+        return nodes[parent].anyDepth;
+    }
+    if (!hasWildcard(component)) {
+        auto [it, inserted] = nodes[parent].literals.try_emplace(component, nodes.size());
+        // Read before emplace_back moves the parent's map
+        u32 node = it->second;
+        if (inserted) {
+            nodes.emplace_back();
+        }
+        return node;
+    }
+    for (const GlobChild &glob : nodes[parent].globs) {
+        if (glob.text == component) {
+            return glob.node;
+        }
+    }
+    u32 node = nodes.size();
+    GlobChild glob{component, llvm::cantFail(llvm::GlobPattern::create(component)), node};
+    nodes.emplace_back();
+    nodes[parent].globs.push_back(std::move(glob));
+    return node;
+}
+
+u32 PathTrie::add(StringRef pattern) {
+    auto [it, inserted] = patternIds.try_emplace(pattern, patternIds.size());
+    if (!inserted) {
+        return it->second;
+    }
+    // Components refer to the map's copy of the pattern, which stays put
+    StringRef stored = it->getKey();
+    u32 node = isAnchored(stored, syntax) ? 0 : child(0, "**");
+    SmallVector<StringRef, 8> components;
+    splitPath(stored, syntax, components);
+    for (StringRef component : components) {
+        node = child(node, component);
+    }
+    nodes[node].accepts.push_back(it->second);
+    return it->second;
+}
+
+void PathTrie::activate(u32 node, llvm::SmallVectorImpl<u32> &active, std::vector<u32> &seen,
+                        u32 generation) const {
+    while (node != NO_NODE && seen[node] != generation) {
+        seen[node] = generation;
+        active.push_back(node);
+        node = nodes[node].anyDepth;
+    }
+}
+
+void PathTrie::match(StringRef path, llvm::BitVector &matches) const {
+    matches.clear();
+    matches.resize(size());
+    SmallVector<StringRef, 16> components;
+    splitPath(path, syntax, components);
+
+    std::vector<u32> seen(nodes.size(), 0);
+    u32 generation = 1;
+    SmallVector<u32, 8> active;
+    SmallVector<u32, 8> next;
+    activate(0, active, seen, generation);
+    for (StringRef component : components) {
+        if (active.empty()) {
+            return;
+        }
+        ++generation;
+        next.clear();
+        for (u32 index : active) {
+            const Node &node = nodes[index];
+            if (node.repeats) {
+                activate(index, next, seen, generation);
+            }
+            auto literal = node.literals.find(component);
+            if (literal != node.literals.end()) {
+                activate(literal->second, next, seen, generation);
+            }
+            for (const GlobChild &glob : node.globs) {
+                if (glob.glob.match(component)) {
+                    activate(glob.node, next, seen, generation);
+                }
+            }
+        }
+        std::swap(active, next);
+    }
+    for (u32 index : active) {
+        for (u32 id : nodes[index].accepts) {
+            matches.set(id);
+        }
+    }
+}
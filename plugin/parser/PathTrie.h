@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Common.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/GlobPattern.h"
+
+#include <optional>
+#include <vector>
+
+// Globs over paths of components: the files of within("...") and the
+// qualified names of func(...) pointcuts.
+//
+// File paths are split into '/'-separated components ('\' counts as a
+// separator too; empty and "." components are dropped), qualified names at
+// "::". A component of a pattern is a literal, a glob over one component
+// (`*`, `?`, `[...]`), or `**`, which stands for any number of components.
+// A pattern that is not anchored (by a leading '/', or "::" for names) may
+// match from any component on, as if it were prefixed by `**`: "src/net/**"
+// matches both "src/net/a.cpp" and "/home/me/project/src/net/io/b.h", and
+// "app::*::get*" matches "app::db::getRow" and "v2::app::db::getRow".
+enum PathSyntax : u8 {
+    PATH_FILE,
+    PATH_QUALIFIED_NAME,
+};
+
+bool matchesPathPattern(StringRef pattern, StringRef path, PathSyntax syntax = PATH_FILE);
+
+// False for an empty pattern or one with a malformed glob (e.g. "[a-")
+bool isValidPathPattern(StringRef pattern, PathSyntax syntax = PATH_FILE);
+
+// Whether text has a glob character, i.e. is a pattern rather than a name
+bool hasWildcard(StringRef text);
+
+// All patterns of a pointcut set in one trie of their components. Matching a
+// path walks the trie once, with the set of nodes reachable so far, and
+// yields every pattern that matches; a literal component is one hash lookup
+// however many patterns share the prefix, so the cost of a match does not
+// grow with the number of patterns.
+class PathTrie {
+public:
+    explicit PathTrie(PathSyntax syntax = PATH_FILE);
+    // Globs refer to the trie's own copy of the patterns, so a copy is
+    // rebuilt from them
+    PathTrie(const PathTrie &other);
+    PathTrie &operator=(const PathTrie &other);
+    PathTrie(PathTrie &&) = default;
+    PathTrie &operator=(PathTrie &&) = default;
+
+    // Id of the pattern (dense, from 0); adding a pattern again returns the
+    // id it already has. The pattern must be valid.
+    u32 add(StringRef pattern);
+    u32 size() const { return patternIds.size(); }
+    // Id of a pattern added before
+    std::optional<u32> find(StringRef pattern) const;
+
+    // Resizes matches to size() and sets the bits of the matching patterns
+    void match(StringRef path, llvm::BitVector &matches) const;
+
+private:
+    // glob refers to text, a component of a key of patternIds
+    struct GlobChild {
+        StringRef text;
+        llvm::GlobPattern glob;
+        u32 node;
+    };
+
+    struct Node {
+        StringMap<u32> literals;
+        SmallVector<GlobChild, 1> globs;
+        // Child for a `**` component
+        u32 anyDepth = NO_NODE;
+        // This node is a `**`: it consumes any component and stays
+        bool repeats = false;
+        SmallVector<u32, 1> accepts;
+    };
+    static constexpr u32 NO_NODE = ~0u;
+
+    u32 child(u32 parent, StringRef component);
+    // Adds node, and whatever follows it over `**` without consuming a
+    // component, to active (once per generation)
+    void activate(u32 node, llvm::SmallVectorImpl<u32> &active, std::vector<u32> &seen, u32 generation) const;
+
+    std::vector<Node> nodes;
+    StringMap<u32> patternIds;
+    PathSyntax syntax;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Perfect hash table over a fixed set of strings, built at compile time.
+//
+// The constructor searches for a seed under which every key lands in its own
+// slot, so a lookup is one hash, one slot load and one string compare. Tables
+// are meant to be declared constexpr: they are then plain read-only data and
+// need no static initialization when the library is loaded.
+template <typename ValueT>
+struct PerfectHashEntry {
+    std::string_view key;
+    ValueT value;
+};
+
+template <typename ValueT, std::size_t N>
+class PerfectHashTable {
+public:
+    using Entry = PerfectHashEntry<ValueT>;
+
+    consteval PerfectHashTable(const Entry (&entries)[N]) {
+        for (std::uint32_t candidate = 1; candidate < MaxSeed; ++candidate) {
+            if (tryBuild(entries, candidate)) {
+                seed = candidate;
+                return;
+            }
+        }
+        // Not a constant expression: fails compilation if no seed was found
+        throw "PerfectHashTable: no collision-free seed";
+    }
+
+    // Value for key, or fallback when key is not in the table.
+    constexpr ValueT lookup(std::string_view key, ValueT fallback) const {
+        const Slot &slot = slots[index(key, seed)];
+        if (slot.used && slot.entry.key == key) {
+            return slot.entry.value;
+        }
+        return fallback;
+    }
+
+    constexpr bool contains(std::string_view key) const {
+        const Slot &slot = slots[index(key, seed)];
+        return slot.used && slot.entry.key == key;
+    }
+
+private:
+    // Load factor <= 1/4 keeps the expected number of seeds tried small
+    static constexpr std::size_t TableSize = std::bit_ceil(N) * 4;
+    static constexpr std::uint32_t MaxSeed = 4096;
+
+    struct Slot {
+        Entry entry{};
+        bool used = false;
+    };
+
+    static constexpr std::size_t index(std::string_view key, std::uint32_t seed) {
+        // FNV-1a, seeded
+        std::uint32_t h = 2166136261u ^ seed;
+        for (char c : key) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        return (h ^ (h >> 15)) & (TableSize - 1);
+    }
+
+    constexpr bool tryBuild(const Entry (&entries)[N], std::uint32_t candidate) {
+        slots = {};
+        for (const Entry &e : entries) {
+            Slot &slot = slots[index(e.key, candidate)];
+            if (slot.used) {
+                return false;
+            }
+            slot.entry = e;
+            slot.used = true;
+        }
+        return true;
+    }
+
+    std::array<Slot, TableSize> slots{};
+    std::uint32_t seed = 0;
+};
+
+// Deduces N from a braced list: makePerfectHashTable<Kind>({{"a", A}, ...})
+template <typename ValueT, std::size_t N>
+consteval PerfectHashTable<ValueT, N>
+makePerfectHashTable(const PerfectHashEntry<ValueT> (&entries)[N]) {
+    return PerfectHashTable<ValueT, N>(entries);
+}
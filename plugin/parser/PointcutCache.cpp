@@ -0,0 +1,98 @@
+#include "PointcutCache.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "PointcutOptimizer.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Path.h"
+
+std::string PointcutCache::imagePath(StringRef pointcutFile, StringRef cacheDir, u64 hash) {
+    if (cacheDir.empty()) {
+        return (pointcutFile + ".pci").str();
+    }
+    SmallString<256> path(cacheDir);
+    llvm::sys::path::append(path, llvm::utohexstr(hash, /*LowerCase=*/true) + ".pci");
+    return std::string(path.str());
+}
+
+const PointcutImage &PointcutCache::load(StringRef pointcutFile, StringRef text, StringRef cacheDir) {
+    u64 hash = hashPointcutText(text);
+    std::string path = imagePath(pointcutFile, cacheDir, hash);
+    error.clear();
+    cached = map(path, hash);
+    if (!cached && build(text, hash)) {
+        store(path);
+    }
+    return image;
+}
+
+bool PointcutCache::map(const std::string &path, u64 hash) {
+    llvm::Expected<llvm::sys::fs::file_t> file = llvm::sys::fs::openNativeFileForRead(path);
+    if (!file) {
+        llvm::consumeError(file.takeError());
+        return false;
+    }
+    llvm::sys::fs::file_status status;
+    std::error_code ec = llvm::sys::fs::status(*file, status);
+    if (!ec && status.getSize() > 0) {
+        region.emplace(*file, llvm::sys::fs::mapped_file_region::readonly, status.getSize(), 0, ec);
+    }
+    llvm::sys::fs::closeFile(*file);
+    if (ec || !region) {
+        region.reset();
+        return false;
+    }
+
+    std::optional<PointcutImage> mapped =
+        PointcutImage::fromBytes(StringRef(region->const_data(), region->size()), hash);
+    if (!mapped) {
+        // Stale (another text with the same name) or damaged: rebuilt below
+        region.reset();
+        return false;
+    }
+    image = *mapped;
+    return true;
+}
+
+bool PointcutCache::build(StringRef text, u64 hash) {
+    PointcutContext context;
+    ::Lexer lexer(text);
+    Parser parser(lexer, context);
+    std::vector<PointcutDeclaration*> pointcuts = parser.parsePointcutList();
+    if (parser.hasError()) {
+        error = parser.getError();
+        image = PointcutImage();
+        return false;
+    }
+
+    PointcutImageBuilder builder;
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        pointcut->expression = optimizePointcut(pointcut->expression, context);
+        builder.addPointcut(*pointcut);
+    }
+    llvm::raw_svector_ostream OS(built);
+    builder.write(OS, hash);
+    image = *PointcutImage::fromBytes(StringRef(built.data(), built.size()), hash);
+    return true;
+}
+
+void PointcutCache::store(const std::string &path) {
+    SmallString<256> temp;
+    int fd;
+    if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%.tmp", fd, temp)) {
+        return;
+    }
+    {
+        llvm::raw_fd_ostream OS(fd, /*shouldClose=*/true);
+        OS.write(built.data(), built.size());
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            llvm::sys::fs::remove(temp);
+            return;
+        }
+    }
+    if (llvm::sys::fs::rename(temp, path)) {
+        llvm::sys::fs::remove(temp);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+#include "PointcutImage.h"
+
+#include "llvm/Support/FileSystem.h"
+
+#include <optional>
+#include <string>
+
+// Keeps the parsed and optimized pointcuts of a file as a PointcutImage on
+// disk, keyed by the xxHash64 of the file's text. Later compiler runs map
+// the image read-only and use it in place, so the Lexer, Parser and
+// optimizer only run when the text has changed.
+//
+// The image is stored next to the pointcut file as <file>.pci, or as
+// <hash>.pci in a cache directory shared by several pointcut files. It is
+// written to a temporary file and renamed, so concurrent compiler runs never
+// see a partial image; failing to write it is not an error.
+class PointcutCache {
+public:
+    // Image of text (the contents of pointcutFile). On a syntax error the
+    // image is empty, nothing is stored and hasError() is set.
+    const PointcutImage &load(StringRef pointcutFile, StringRef text, StringRef cacheDir = "");
+
+    const PointcutImage &getImage() const { return image; }
+    bool hasError() const { return !error.empty(); }
+    // The parser's message for the last load
+    const std::string &getError() const { return error; }
+    // Whether the last load was served from the cache
+    bool hit() const { return cached; }
+
+    static std::string imagePath(StringRef pointcutFile, StringRef cacheDir, u64 hash);
+
+private:
+    bool map(const std::string &path, u64 hash);
+    bool build(StringRef text, u64 hash);
+    void store(const std::string &path);
+
+    std::optional<llvm::sys::fs::mapped_file_region> region;
+    // Image bytes when built by this load (also what gets stored)
+    SmallVector<char, 0> built;
+    PointcutImage image;
+    bool cached = false;
+    std::string error;
+};
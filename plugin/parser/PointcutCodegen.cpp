@@ -0,0 +1,511 @@
+#include "PointcutCodegen.h"
+#include "FunctionFacts.h"
+#include "PathTrie.h"
+
+namespace {
+
+const char *factKindName(FactKind kind) {
+    switch (kind) {
+        case FACT_SECTION_BSS: return "FACT_SECTION_BSS";
+        case FACT_SECTION_DATA: return "FACT_SECTION_DATA";
+        case FACT_SECTION_RELRO: return "FACT_SECTION_RELRO";
+        case FACT_SECTION_RODATA: return "FACT_SECTION_RODATA";
+        case FACT_SECTION_TEXT: return "FACT_SECTION_TEXT";
+        default:
+            llvm_unreachable("Not a section fact");
+    }
+}
+
+const char *bodyFlagName(BodyFlag flag) {
+    switch (flag) {
+        case BODY_HAS_LOOP: return "BODY_HAS_LOOP";
+        case BODY_HAS_CALL: return "BODY_HAS_CALL";
+    }
+    llvm_unreachable("Unknown body flag");
+}
+
+const char *qualifierName(FunctionQualifier qualifier) {
+    switch (qualifier) {
+        case QUALIFIER_CONST: return "QUALIFIER_CONST";
+        case QUALIFIER_STATIC: return "QUALIFIER_STATIC";
+        case QUALIFIER_VIRTUAL: return "QUALIFIER_VIRTUAL";
+        case QUALIFIER_VOLATILE: return "QUALIFIER_VOLATILE";
+    }
+    llvm_unreachable("Unknown function qualifier");
+}
+
+void emitString(raw_ostream &OS, StringRef text) {
+    OS << '"';
+    OS.write_escaped(text);
+    OS << '"';
+}
+
+// Strings and fact kinds used by the whole set
+struct CodegenState {
+    std::vector<StringRef> strings;
+    StringMap<u32> stringIds;
+    bool used[FACT_KIND_COUNT] = {};
+    bool qualifiedNames = false;
+    bool scope = false;
+    bool signature = false;
+    bool classes = false;
+    bool callGraph = false;
+    bool body = false;
+    // func() globs, matched together by one PathTrie
+    std::vector<StringRef> namePatterns;
+    StringMap<u32> namePatternIds;
+    // Referenced pointcuts, dependencies first; each has a ref<N> function
+    std::vector<const PointcutDeclaration*> references;
+    DenseMap<const PointcutDeclaration*, u32> referenceIds;
+
+    u32 intern(StringRef text) {
+        auto [it, inserted] = stringIds.try_emplace(text, strings.size());
+        if (inserted) {
+            strings.push_back(text);
+        }
+        return it->second;
+    }
+
+    u32 namePattern(StringRef pattern) {
+        auto [it, inserted] = namePatternIds.try_emplace(pattern, namePatterns.size());
+        if (inserted) {
+            namePatterns.push_back(pattern);
+        }
+        return it->second;
+    }
+};
+
+// Writes one expression as a C++ boolean expression over `f` (the interned
+// facts, see emitCompiledPointcuts)
+struct ExpressionEmitter : ASTVisitor {
+    CodegenState &state;
+    raw_ostream &OS;
+
+    ExpressionEmitter(CodegenState &state, raw_ostream &OS) : state(state), OS(OS) {}
+
+    void pair(PairExpression *node, StringRef op) {
+        OS << "(";
+        node->left->accept(*this);
+        OS << " " << op << " ";
+        node->right->accept(*this);
+        OS << ")";
+    }
+
+    void visit(PointcutDeclaration* node) override { node->expression->accept(*this); }
+    void visit(OrExpression* node) override { pair(node, "||"); }
+    void visit(AndExpression* node) override { pair(node, "&&"); }
+    void visit(NotExpression* node) override {
+        OS << "!(";
+        node->expr->accept(*this);
+        OS << ")";
+    }
+    void visit(ParenthesizedExpression* node) override { node->expr->accept(*this); }
+    void visit(FuncExpression* node) override {
+        if (hasWildcard(node->id)) {
+            state.qualifiedNames = true;
+            OS << "f.namePattern(P_" << state.namePattern(node->id) << ")";
+            return;
+        }
+        if (node->id.contains("::")) {
+            // Suffix semantics, so it cannot be interned
+            state.qualifiedNames = true;
+            OS << "matchesFunctionName(";
+            emitString(OS, node->id);
+            OS << ", f.facts)";
+            return;
+        }
+        state.used[FACT_NAME] = true;
+        OS << "f.name == S_" << state.intern(node->id);
+    }
+    void visit(PragmaClangExprNode* node) override {
+        FactKind kind = sectionFactKind(node->pragmaKind.kind);
+        state.used[kind] = true;
+        OS << "f.section(" << factKindName(kind) << ") == S_" << state.intern(node->sectionName);
+    }
+    void visit(NotationExprNode* node) override {
+        state.used[FACT_ANNOTATION] = true;
+        OS << "f.annotation(S_" << state.intern(node->id) << ")";
+    }
+    void visit(NotationAnalysisExprNode* node) override {
+        state.used[FACT_TYPE_ANNOTATION] = true;
+        OS << "f.typeAnnotation(S_" << state.intern(node->id) << ")";
+    }
+    void visit(WithinFileExpression* node) override {
+        state.scope = true;
+        OS << "isWithinFile(";
+        emitString(OS, node->id);
+        OS << ", f.facts)";
+    }
+    void visit(WithinNamespaceExpression* node) override {
+        state.scope = true;
+        OS << "isWithinNamespace(";
+        emitString(OS, node->id);
+        OS << ", f.facts)";
+    }
+    void visit(QualifierExpression* node) override {
+        OS << "(f.facts.qualifiers & " << qualifierName(functionQualifier(node->qualifier)) << ") != 0";
+    }
+    void visit(ReturnsExpression* node) override {
+        state.signature = true;
+        OS << "f.facts.returnType == ";
+        emitString(OS, node->id);
+    }
+    void visit(ParamsExpression* node) override {
+        state.signature = true;
+        OS << "matchesParamTypes({";
+        for (usize i = 0; i < node->types.size(); ++i) {
+            OS << (i ? ", " : "");
+            emitString(OS, node->types[i]);
+        }
+        OS << "}, f.facts)";
+    }
+    void visit(ParamCountExpression* node) override {
+        OS << "f.facts.paramCount == " << node->count;
+    }
+    void visit(MethodOfExpression* node) override {
+        state.classes = true;
+        OS << "isMethodOf(";
+        emitString(OS, node->id);
+        OS << ", f.facts)";
+    }
+    void visit(InheritsExpression* node) override {
+        state.classes = true;
+        OS << "inheritsFrom(";
+        emitString(OS, node->id);
+        OS << ", f.facts)";
+    }
+    void visit(CallsExpression* node) override {
+        state.callGraph = true;
+        OS << "callsFunction(";
+        emitString(OS, node->id);
+        OS << ", " << node->depth << ", f.facts)";
+    }
+    void visit(CalledByExpression* node) override {
+        state.callGraph = true;
+        OS << "isCalledBy(";
+        emitString(OS, node->id);
+        OS << ", " << node->depth << ", f.facts)";
+    }
+    void visit(BodySizeExpression* node) override {
+        state.body = true;
+        OS << "isBodySizeWithin(" << (bodyMeasure(node->measure) == BODY_STMT_COUNT ? "BODY_STMT_COUNT" : "BODY_WEIGHT")
+           << ", " << node->min << ", " << (node->max == UNBOUNDED ? "UNBOUNDED" : std::to_string(node->max))
+           << ", f.facts)";
+    }
+    void visit(BodyFlagExpression* node) override {
+        state.body = true;
+        OS << "(f.facts.bodyFlags & " << bodyFlagName(bodyFlag(node->flag)) << ") != 0";
+    }
+    void visit(PointcutRefExpression* node) override {
+        OS << "ref" << state.referenceIds.find(node->target)->second << "(f)";
+    }
+    void visit(ConstantExpression* node) override { OS << (node->value ? "true" : "false"); }
+};
+
+// Numbers the pointcuts an expression refers to, those they refer to first
+struct ReferenceCollector : ASTVisitor {
+    CodegenState &state;
+
+    ReferenceCollector(CodegenState &state) : state(state) {}
+
+    void visit(PointcutDeclaration* node) override { node->expression->accept(*this); }
+    void visit(OrExpression* node) override {
+        node->left->accept(*this);
+        node->right->accept(*this);
+    }
+    void visit(AndExpression* node) override {
+        node->left->accept(*this);
+        node->right->accept(*this);
+    }
+    void visit(NotExpression* node) override { node->expr->accept(*this); }
+    void visit(ParenthesizedExpression* node) override { node->expr->accept(*this); }
+    void visit(FuncExpression* node) override {}
+    void visit(PragmaClangExprNode* node) override {}
+    void visit(NotationExprNode* node) override {}
+    void visit(NotationAnalysisExprNode* node) override {}
+    void visit(WithinFileExpression* node) override {}
+    void visit(WithinNamespaceExpression* node) override {}
+    void visit(QualifierExpression* node) override {}
+    void visit(ReturnsExpression* node) override {}
+    void visit(ParamsExpression* node) override {}
+    void visit(ParamCountExpression* node) override {}
+    void visit(MethodOfExpression* node) override {}
+    void visit(InheritsExpression* node) override {}
+    void visit(CallsExpression* node) override {}
+    void visit(CalledByExpression* node) override {}
+    void visit(BodySizeExpression* node) override {}
+    void visit(BodyFlagExpression* node) override {}
+    void visit(PointcutRefExpression* node) override {
+        if (state.referenceIds.count(node->target)) {
+            return;
+        }
+        node->target->expression->accept(*this);
+        state.referenceIds[node->target] = state.references.size();
+        state.references.push_back(node->target);
+    }
+    void visit(ConstantExpression* node) override {}
+};
+
+ASTNode *skipParens(ASTNode *node) {
+    while (auto *paren = llvm::dyn_cast<ParenthesizedExpression>(node)) {
+        node = paren->expr;
+    }
+    return node;
+}
+
+void collectAlternatives(ASTNode *node, SmallVector<ASTNode*, 8> &out) {
+    node = skipParens(node);
+    if (auto *orExpr = llvm::dyn_cast<OrExpression>(node)) {
+        collectAlternatives(orExpr->left, out);
+        collectAlternatives(orExpr->right, out);
+        return;
+    }
+    out.push_back(node);
+}
+
+bool isPlainName(ASTNode *node) {
+    auto *func = llvm::dyn_cast<FuncExpression>(node);
+    return func && !isQualifiedNamePattern(func->id);
+}
+
+// Body of the match function of one pointcut. Alternatives are free of side
+// effects, so the names among them can be tested first, by one switch.
+void emitBody(ASTNode *expression, CodegenState &state, raw_ostream &OS) {
+    SmallVector<ASTNode*, 8> alternatives;
+    collectAlternatives(expression, alternatives);
+    SmallVector<ASTNode*, 8> names;
+    SmallVector<ASTNode*, 8> rest;
+    for (ASTNode *node : alternatives) {
+        (isPlainName(node) ? names : rest).push_back(node);
+    }
+
+    ExpressionEmitter emitter(state, OS);
+    if (names.size() >= 2) {
+        state.used[FACT_NAME] = true;
+        OS << "    switch (f.name) {\n";
+        StringSet<> seen;
+        for (ASTNode *node : names) {
+            StringRef name = static_cast<FuncExpression*>(node)->id;
+            if (seen.insert(name).second) {
+                OS << "        case S_" << state.intern(name) << ":\n";
+            }
+        }
+        OS << "            return true;\n"
+           << "        default:\n"
+           << "            break;\n"
+           << "    }\n";
+        OS << "    return ";
+        if (rest.empty()) {
+            OS << "false";
+        }
+        for (usize i = 0; i < rest.size(); ++i) {
+            OS << (i ? "\n        || " : "");
+            rest[i]->accept(emitter);
+        }
+        OS << ";\n";
+        return;
+    }
+    OS << "    return ";
+    expression->accept(emitter);
+    OS << ";\n";
+}
+
+void emitInterning(const CodegenState &state, raw_ostream &OS) {
+    OS << "// The facts of one function as string ids\n"
+       << "struct Facts {\n"
+       << "    const FunctionFacts &facts;\n"
+       << "    u32 name = NO_STRING;\n"
+       << "    SmallVector<u32, 4> annotations;\n"
+       << "    SmallVector<u32, 2> typeAnnotations;\n"
+       << "    u32 sections[SECTION_KIND_COUNT];\n"
+       << "    llvm::BitVector namePatterns;\n";
+    if (!state.references.empty()) {
+        OS << "    // Results of the referenced pointcuts: 0 unknown, 1 false, 2 true\n"
+           << "    mutable u8 refs[" << state.references.size() << "] = {};\n";
+    }
+    OS << "\n"
+       << "    explicit Facts(const FunctionFacts &facts) : facts(facts) {\n";
+    if (!state.namePatterns.empty()) {
+        OS << "        if (!facts.qualifiedName.empty()) {\n"
+           << "            getNamePatterns().match(facts.qualifiedName, namePatterns);\n"
+           << "        }\n";
+    }
+    if (state.used[FACT_NAME]) {
+        OS << "        name = intern(facts.name);\n";
+    }
+    if (state.used[FACT_ANNOTATION]) {
+        OS << "        for (StringRef text : facts.annotations) {\n"
+           << "            annotations.push_back(intern(text));\n"
+           << "        }\n";
+    }
+    if (state.used[FACT_TYPE_ANNOTATION]) {
+        OS << "        for (StringRef text : facts.typeAnnotations) {\n"
+           << "            typeAnnotations.push_back(intern(text));\n"
+           << "        }\n";
+    }
+    OS << "        for (u32 i = 0; i < SECTION_KIND_COUNT; ++i) {\n"
+       << "            sections[i] = NO_STRING;\n"
+       << "        }\n";
+    for (u32 kind = FACT_SECTION_BSS; kind <= FACT_SECTION_TEXT; ++kind) {
+        if (state.used[kind]) {
+            const char *name = factKindName(static_cast<FactKind>(kind));
+            OS << "        sections[" << name << " - FACT_SECTION_BSS] = intern(facts.section("
+               << name << "));\n";
+        }
+    }
+    OS << "    }\n"
+       << "\n"
+       << "    bool annotation(u32 id) const { return llvm::is_contained(annotations, id); }\n"
+       << "    bool typeAnnotation(u32 id) const { return llvm::is_contained(typeAnnotations, id); }\n"
+       << "    u32 section(FactKind kind) const { return sections[kind - FACT_SECTION_BSS]; }\n"
+       << "    bool namePattern(u32 id) const { return id < namePatterns.size() && namePatterns.test(id); }\n"
+       << "};\n\n";
+}
+
+} // namespace
+
+void emitCompiledPointcuts(ArrayRef<PointcutDeclaration*> pointcuts, StringRef source,
+                           raw_ostream &OS) {
+    CodegenState state;
+    ReferenceCollector collector(state);
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        if (pointcut->matchKind != MATCH_NONE) {
+            pointcut->expression->accept(collector);
+        }
+    }
+
+    std::string bodies;
+    llvm::raw_string_ostream bodyOS(bodies);
+    // A referenced pointcut is evaluated once per function, whatever the
+    // number of references
+    for (usize i = 0; i < state.references.size(); ++i) {
+        bodyOS << "// " << state.references[i]->name << "\n"
+               << "bool evaluate" << i << "(const Facts &f) {\n";
+        emitBody(state.references[i]->expression, state, bodyOS);
+        bodyOS << "}\n\n"
+               << "bool ref" << i << "(const Facts &f) {\n"
+               << "    if (f.refs[" << i << "] == 0) {\n"
+               << "        f.refs[" << i << "] = evaluate" << i << "(f) ? 2 : 1;\n"
+               << "    }\n"
+               << "    return f.refs[" << i << "] == 2;\n"
+               << "}\n\n";
+    }
+
+    SmallVector<const PointcutDeclaration*, 16> selected;
+    for (const PointcutDeclaration *pointcut : pointcuts) {
+        if (pointcut->matchKind == MATCH_NONE) {
+            continue;
+        }
+        bodyOS << "// " << (pointcut->matchKind == MATCH_RUN ? "run_pointcut " : "call_pointcut ")
+               << pointcut->name << "\n"
+               << "bool match" << selected.size() << "(const Facts &f) {\n";
+        auto reference = state.referenceIds.find(pointcut);
+        if (reference != state.referenceIds.end()) {
+            bodyOS << "    return ref" << reference->second << "(f);\n";
+        } else {
+            emitBody(pointcut->expression, state, bodyOS);
+        }
+        bodyOS << "}\n\n";
+        selected.push_back(pointcut);
+    }
+
+    OS << "// Generated by uthelper-pointcutc from " << source << ". Do not edit.\n"
+       << "\n"
+       << "#include \"CompiledPointcuts.h\"\n"
+       << "#include \"PathTrie.h\"\n"
+       << "#include \"PerfectHash.h\"\n"
+       << "\n"
+       << "namespace {\n"
+       << "\n"
+       << "constexpr u32 NO_STRING = ~0u;\n"
+       << "\n";
+
+    if (!state.strings.empty()) {
+        OS << "enum : u32 {\n";
+        for (usize i = 0; i < state.strings.size(); ++i) {
+            OS << "    S_" << i << ", // " << state.strings[i] << "\n";
+        }
+        OS << "};\n\n"
+           << "constexpr auto Strings = makePerfectHashTable<u32>({\n";
+        for (usize i = 0; i < state.strings.size(); ++i) {
+            OS << "    {";
+            emitString(OS, state.strings[i]);
+            OS << ", S_" << i << "},\n";
+        }
+        OS << "});\n\n"
+           << "[[maybe_unused]] u32 intern(StringRef text) {\n"
+           << "    return Strings.lookup(std::string_view(text.data(), text.size()), NO_STRING);\n"
+           << "}\n\n";
+    } else {
+        OS << "[[maybe_unused]] u32 intern(StringRef) { return NO_STRING; }\n\n";
+    }
+
+    if (!state.namePatterns.empty()) {
+        OS << "enum : u32 {\n";
+        for (usize i = 0; i < state.namePatterns.size(); ++i) {
+            OS << "    P_" << i << ", // " << state.namePatterns[i] << "\n";
+        }
+        OS << "};\n\n"
+           << "// All func() globs in one trie, walked once per function\n"
+           << "const PathTrie &getNamePatterns() {\n"
+           << "    static const PathTrie Trie = [] {\n"
+           << "        PathTrie trie(PATH_QUALIFIED_NAME);\n";
+        for (StringRef pattern : state.namePatterns) {
+            OS << "        trie.add(";
+            emitString(OS, pattern);
+            OS << ");\n";
+        }
+        OS << "        return trie;\n"
+           << "    }();\n"
+           << "    return Trie;\n"
+           << "}\n\n";
+    }
+
+    emitInterning(state, OS);
+    OS << bodies;
+
+    // Dispatch in file order within each kind, as the other engines do
+    OS << "std::optional<u32> firstMatch(MatchKind matchKind, const FunctionFacts &facts) {\n"
+       << "    Facts f(facts);\n";
+    for (MatchKind kind : {MATCH_RUN, MATCH_CALL}) {
+        OS << "    if (matchKind == " << (kind == MATCH_RUN ? "MATCH_RUN" : "MATCH_CALL") << ") {\n";
+        u32 position = 0;
+        for (usize i = 0; i < selected.size(); ++i) {
+            if (selected[i]->matchKind == kind) {
+                OS << "        if (match" << i << "(f)) {\n"
+                   << "            return " << position++ << ";\n"
+                   << "        }\n";
+            }
+        }
+        OS << "    }\n";
+    }
+    OS << "    return std::nullopt;\n"
+       << "}\n\n";
+
+    OS << "constexpr CompiledPointcut Pointcuts[] = {\n";
+    for (const PointcutDeclaration *pointcut : selected) {
+        OS << "    {";
+        emitString(OS, pointcut->name);
+        OS << ", " << (pointcut->matchKind == MATCH_RUN ? "MATCH_RUN" : "MATCH_CALL") << "},\n";
+    }
+    if (selected.empty()) {
+        OS << "    {nullptr, MATCH_NONE},\n";
+    }
+    OS << "};\n"
+       << "\n"
+       << "} // namespace\n"
+       << "\n"
+       << "const CompiledPointcutSet &getCompiledPointcuts() {\n"
+       << "    static const CompiledPointcutSet Set = {\n"
+       << "        ArrayRef<CompiledPointcut>(Pointcuts, " << selected.size() << "),\n"
+       << "        " << (state.qualifiedNames ? "true" : "false") << ",\n"
+       << "        " << (state.scope ? "true" : "false") << ",\n"
+       << "        " << (state.signature ? "true" : "false") << ",\n"
+       << "        " << (state.classes ? "true" : "false") << ",\n"
+       << "        " << (state.callGraph ? "true" : "false") << ",\n"
+       << "        " << (state.body ? "true" : "false") << ",\n"
+       << "        firstMatch,\n"
+       << "    };\n"
+       << "    return Set;\n"
+       << "}\n";
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+
+// Emits the C++ definition of getCompiledPointcuts() (CompiledPointcuts.h)
+// for the run_ and call_pointcuts of a file.
+//
+// Every string the pointcuts test gets a dense id, found at run time through
+// a compile-time perfect hash; a function's facts are interned once and the
+// pointcut bodies become inlined integer compares. Alternatives over function
+// names turn into a switch on the interned name. A pointcut referred to by
+// others is emitted once, and its result kept with the interned facts, so it
+// runs at most once per function. Expressions should already
+// be optimized (optimizePointcut); source is only quoted in the header
+// comment of the output.
+void emitCompiledPointcuts(ArrayRef<PointcutDeclaration*> pointcuts, StringRef source,
+                           raw_ostream &OS);
@@ -0,0 +1,266 @@
+#include "PointcutImage.h"
+
+#include "PathTrie.h"
+
+#include "llvm/Support/xxhash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr char IMAGE_MAGIC[4] = {'S', 'P', 'C', 'I'};
+// Bump whenever the layout or the meaning of a record changes
+constexpr u32 IMAGE_VERSION = 7;
+
+struct ImageFlattener : ASTVisitor {
+    PointcutImageBuilder &builder;
+    u32 result = 0;
+
+    ImageFlattener(PointcutImageBuilder &builder) : builder(builder) {}
+
+    u32 flatten(ASTNode *node) {
+        node->accept(*this);
+        return result;
+    }
+
+    void pair(PairExpression *node, ImageNodeKind kind) {
+        u32 lhs = flatten(node->left);
+        u32 rhs = flatten(node->right);
+        result = builder.addNode({kind, 0, 0, lhs, rhs});
+    }
+
+    void leaf(ImageNodeKind kind, StringRef text, u8 fact = 0) {
+        result = builder.addNode({kind, fact, 0, builder.intern(text), 0});
+    }
+
+    void visit(PointcutDeclaration* node) override { node->expression->accept(*this); }
+    void visit(OrExpression* node) override { pair(node, IMAGE_OR); }
+    void visit(AndExpression* node) override { pair(node, IMAGE_AND); }
+    void visit(NotExpression* node) override {
+        u32 operand = flatten(node->expr);
+        result = builder.addNode({IMAGE_NOT, 0, 0, operand, 0});
+    }
+    // Grouping is already in the tree shape
+    void visit(ParenthesizedExpression* node) override { node->expr->accept(*this); }
+    void visit(FuncExpression* node) override { leaf(IMAGE_FUNC, node->id); }
+    void visit(PragmaClangExprNode* node) override {
+        leaf(IMAGE_SECTION, node->sectionName, sectionFactKind(node->pragmaKind.kind));
+    }
+    void visit(NotationExprNode* node) override { leaf(IMAGE_ANNOTATION, node->id); }
+    void visit(NotationAnalysisExprNode* node) override {
+        leaf(IMAGE_TYPE_ANNOTATION, node->id);
+    }
+    void visit(WithinFileExpression* node) override { leaf(IMAGE_WITHIN_FILE, node->id); }
+    void visit(WithinNamespaceExpression* node) override {
+        leaf(IMAGE_WITHIN_NAMESPACE, node->id);
+    }
+    void visit(QualifierExpression* node) override {
+        result = builder.addNode({IMAGE_QUALIFIER, 0, 0, functionQualifier(node->qualifier), 0});
+    }
+    void visit(ReturnsExpression* node) override { leaf(IMAGE_RETURNS, node->id); }
+    void visit(ParamsExpression* node) override {
+        std::string types;
+        llvm::raw_string_ostream OS(types);
+        llvm::interleave(node->types, OS, "\n");
+        leaf(IMAGE_PARAMS, types);
+    }
+    void visit(ParamCountExpression* node) override {
+        result = builder.addNode({IMAGE_PARAM_COUNT, 0, 0, node->count, 0});
+    }
+    void visit(MethodOfExpression* node) override { leaf(IMAGE_METHOD_OF, node->id); }
+    void visit(InheritsExpression* node) override { leaf(IMAGE_INHERITS, node->id); }
+    void visit(CallsExpression* node) override {
+        result = builder.addNode({IMAGE_CALLS, 0, 0, builder.intern(node->id), node->depth});
+    }
+    void visit(CalledByExpression* node) override {
+        result = builder.addNode({IMAGE_CALLED_BY, 0, 0, builder.intern(node->id), node->depth});
+    }
+    void visit(BodySizeExpression* node) override {
+        result = builder.addNode({IMAGE_BODY_SIZE, bodyMeasure(node->measure), 0, node->min, node->max});
+    }
+    void visit(BodyFlagExpression* node) override {
+        result = builder.addNode({IMAGE_BODY_FLAG, 0, 0, bodyFlag(node->flag), 0});
+    }
+    void visit(PointcutRefExpression* node) override {
+        u32 root = builder.addDeclaration(*node->target);
+        result = builder.addNode({IMAGE_REF, 0, 0, root, builder.intern(node->name)});
+    }
+    void visit(ConstantExpression* node) override {
+        result = builder.addNode({IMAGE_CONST, 0, 0, node->value ? 1u : 0u, 0});
+    }
+};
+
+template <typename T>
+bool takeArray(StringRef &bytes, u32 count, ArrayRef<T> &out) {
+    usize size = usize(count) * sizeof(T);
+    if (bytes.size() < size) {
+        return false;
+    }
+    out = ArrayRef<T>(reinterpret_cast<const T*>(bytes.data()), count);
+    bytes = bytes.drop_front(size);
+    return true;
+}
+
+bool validNode(const ImageNode &node, u32 index, u32 stringCount) {
+    switch (node.kind) {
+        case IMAGE_OR:
+        case IMAGE_AND:
+            return node.a < index && node.b < index;
+        case IMAGE_NOT:
+            return node.a < index;
+        case IMAGE_REF:
+            return node.a < index && node.b < stringCount;
+        case IMAGE_SECTION:
+            if (node.fact < FACT_SECTION_BSS || node.fact > FACT_SECTION_TEXT) {
+                return false;
+            }
+            return node.a < stringCount;
+        case IMAGE_FUNC:
+        case IMAGE_ANNOTATION:
+        case IMAGE_TYPE_ANNOTATION:
+        case IMAGE_WITHIN_FILE:
+        case IMAGE_WITHIN_NAMESPACE:
+        case IMAGE_RETURNS:
+        case IMAGE_PARAMS:
+        case IMAGE_METHOD_OF:
+        case IMAGE_INHERITS:
+        case IMAGE_CALLS:
+        case IMAGE_CALLED_BY:
+            return node.a < stringCount;
+        case IMAGE_QUALIFIER:
+            return std::has_single_bit(node.a) &&
+                   node.a <= (QUALIFIER_CONST | QUALIFIER_STATIC | QUALIFIER_VIRTUAL | QUALIFIER_VOLATILE);
+        case IMAGE_BODY_SIZE:
+            return node.fact <= BODY_WEIGHT && node.a <= node.b;
+        case IMAGE_BODY_FLAG:
+            return std::has_single_bit(node.a) && node.a <= (BODY_HAS_LOOP | BODY_HAS_CALL);
+        case IMAGE_CONST:
+        case IMAGE_PARAM_COUNT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+std::optional<PointcutImage> PointcutImage::fromBytes(StringRef bytes, u64 sourceHash) {
+    if (bytes.size() < sizeof(ImageHeader) ||
+        reinterpret_cast<uintptr_t>(bytes.data()) % alignof(ImageHeader) != 0) {
+        return std::nullopt;
+    }
+    const auto *header = reinterpret_cast<const ImageHeader*>(bytes.data());
+    if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header->version != IMAGE_VERSION || header->sourceHash != sourceHash) {
+        return std::nullopt;
+    }
+    bytes = bytes.drop_front(sizeof(ImageHeader));
+
+    PointcutImage image;
+    if (!takeArray(bytes, header->pointcutCount, image.pointcuts) ||
+        !takeArray(bytes, header->nodeCount, image.nodes) ||
+        !takeArray(bytes, header->stringCount, image.strings) ||
+        bytes.size() != header->charCount) {
+        return std::nullopt;
+    }
+    image.chars = bytes;
+
+    // A truncated or stale file must not send a lookup out of bounds
+    for (const ImageString &string : image.strings) {
+        if (string.offset > image.chars.size() || string.size > image.chars.size() - string.offset) {
+            return std::nullopt;
+        }
+    }
+    for (u32 i = 0; i < image.nodes.size(); ++i) {
+        const ImageNode &node = image.nodes[i];
+        if (!validNode(node, i, header->stringCount)) {
+            return std::nullopt;
+        }
+        // Patterns go into a PathTrie, which takes only valid ones
+        if (node.kind == IMAGE_WITHIN_FILE && !isValidPathPattern(image.getString(node.a))) {
+            return std::nullopt;
+        }
+        bool namePattern = node.kind == IMAGE_FUNC || node.kind == IMAGE_METHOD_OF ||
+                           node.kind == IMAGE_INHERITS || node.kind == IMAGE_CALLS ||
+                           node.kind == IMAGE_CALLED_BY;
+        if (namePattern && hasWildcard(image.getString(node.a)) &&
+            !isValidPathPattern(image.getString(node.a), PATH_QUALIFIED_NAME)) {
+            return std::nullopt;
+        }
+    }
+    for (const ImagePointcut &pointcut : image.pointcuts) {
+        if (pointcut.name >= header->stringCount || pointcut.root >= header->nodeCount ||
+            pointcut.matchKind > MATCH_CALL) {
+            return std::nullopt;
+        }
+    }
+    return image;
+}
+
+u32 PointcutImageBuilder::addNode(ImageNode node) {
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+u32 PointcutImageBuilder::intern(StringRef text) {
+    auto [it, inserted] = stringIds.try_emplace(text, strings.size());
+    if (inserted) {
+        strings.push_back({u32(chars.size()), u32(text.size())});
+        chars.append(text.data(), text.size());
+    }
+    return it->second;
+}
+
+u32 PointcutImageBuilder::addExpression(ASTNode *expression) {
+    ImageFlattener flattener(*this);
+    return flattener.flatten(expression);
+}
+
+u32 PointcutImageBuilder::addDeclaration(const PointcutDeclaration &pointcut) {
+    auto it = roots.find(&pointcut);
+    if (it != roots.end()) {
+        return it->second;
+    }
+    u32 root = addExpression(pointcut.expression);
+    roots[&pointcut] = root;
+    return root;
+}
+
+void PointcutImageBuilder::addPointcut(const PointcutDeclaration &pointcut) {
+    // References that follow share these nodes
+    u32 root = addExpression(pointcut.expression);
+    roots[&pointcut] = root;
+    pointcuts.push_back({intern(pointcut.name), root, u8(pointcut.matchKind),
+                         u8(pointcut.isExported), 0});
+}
+
+PointcutImage PointcutImageBuilder::getImage() const {
+    PointcutImage image;
+    image.pointcuts = pointcuts;
+    image.nodes = nodes;
+    image.strings = strings;
+    image.chars = chars;
+    return image;
+}
+
+void PointcutImageBuilder::write(raw_ostream &OS, u64 sourceHash) const {
+    ImageHeader header = {};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.sourceHash = sourceHash;
+    header.pointcutCount = pointcuts.size();
+    header.nodeCount = nodes.size();
+    header.stringCount = strings.size();
+    header.charCount = chars.size();
+
+    OS.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    OS.write(reinterpret_cast<const char*>(pointcuts.data()), pointcuts.size() * sizeof(ImagePointcut));
+    OS.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(ImageNode));
+    OS.write(reinterpret_cast<const char*>(strings.data()), strings.size() * sizeof(ImageString));
+    OS << chars;
+}
+
+u64 hashPointcutText(StringRef text) {
+    return llvm::xxHash64(text);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+#include "FunctionFacts.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Flat form of optimized pointcut declarations: fixed-size records that
+// refer to each other by index, so the same bytes can be built in memory,
+// written to the pointcut cache and later used straight from a read-only
+// mapping. PointcutProgram and PointcutIndex compile from this form.
+//
+// Layout: ImageHeader, ImagePointcut[pointcutCount], ImageNode[nodeCount],
+// ImageString[stringCount], char[charCount]. Nodes are stored children
+// first, so the children of node i have indices below i. A referenced
+// pointcut is stored once; its references point to its root, which makes
+// the nodes a DAG. Native byte order;
+// an image only has to be readable by the plugin build that wrote it.
+enum ImageNodeKind : u8 {
+    IMAGE_OR,               // lhs || rhs: a, b are node indices
+    IMAGE_AND,              // lhs && rhs
+    IMAGE_NOT,              // !a
+    IMAGE_FUNC,             // func(strings[a])
+    IMAGE_SECTION,          // pragma_clang(fact, strings[a])
+    IMAGE_ANNOTATION,       // annotation(strings[a])
+    IMAGE_TYPE_ANNOTATION,  // annotation_analysis(strings[a])
+    IMAGE_CONST,            // a != 0
+    IMAGE_WITHIN_FILE,      // within("strings[a]")
+    IMAGE_WITHIN_NAMESPACE, // within(namespace strings[a])
+    IMAGE_QUALIFIER,        // FunctionQualifier a (one bit)
+    IMAGE_RETURNS,          // returns(strings[a])
+    IMAGE_PARAMS,           // params(...): strings[a] is the types joined by '\n'
+    IMAGE_PARAM_COUNT,      // param_count(a)
+    IMAGE_METHOD_OF,        // method_of(strings[a])
+    IMAGE_INHERITS,         // inherits(strings[a])
+    IMAGE_CALLS,            // calls(strings[a], b)
+    IMAGE_CALLED_BY,        // called_by(strings[a], b)
+    IMAGE_BODY_SIZE,        // BodyMeasure fact between a and b
+    IMAGE_BODY_FLAG,        // BodyFlag a (one bit)
+    IMAGE_REF,              // the pointcut named strings[b], rooted at node a
+    IMAGE_KIND_COUNT
+};
+
+struct ImageNode {
+    ImageNodeKind kind;
+    u8 fact;        // FactKind of IMAGE_SECTION, BodyMeasure of IMAGE_BODY_SIZE
+    u16 reserved;
+    u32 a;
+    u32 b;
+};
+
+struct ImageString {
+    u32 offset;     // into the character block
+    u32 size;
+};
+
+struct ImagePointcut {
+    u32 name;       // string index
+    u32 root;       // node index
+    u8 matchKind;   // MatchKind
+    u8 exported;
+    u16 reserved;
+};
+
+struct ImageHeader {
+    char magic[4];
+    u32 version;
+    u64 sourceHash;
+    u32 pointcutCount;
+    u32 nodeCount;
+    u32 stringCount;
+    u32 charCount;
+};
+
+// Read-only view of an image; it does not own the bytes.
+class PointcutImage {
+public:
+    PointcutImage() = default;
+
+    // View of a serialized image, or nothing when bytes is not a well-formed
+    // image of the current version for a source with sourceHash. bytes must
+    // be 8-byte aligned (mappings and heap buffers are).
+    static std::optional<PointcutImage> fromBytes(StringRef bytes, u64 sourceHash);
+
+    ArrayRef<ImagePointcut> getPointcuts() const { return pointcuts; }
+    ArrayRef<ImageNode> getNodes() const { return nodes; }
+    const ImageNode &getNode(u32 index) const { return nodes[index]; }
+    StringRef getString(u32 index) const {
+        return chars.substr(strings[index].offset, strings[index].size);
+    }
+
+private:
+    friend class PointcutImageBuilder;
+
+    ArrayRef<ImagePointcut> pointcuts;
+    ArrayRef<ImageNode> nodes;
+    ArrayRef<ImageString> strings;
+    StringRef chars;
+};
+
+// Flattens pointcut ASTs into an image held in memory.
+class PointcutImageBuilder {
+public:
+    // Root node index of the expression
+    u32 addExpression(ASTNode *expression);
+    void addPointcut(const PointcutDeclaration &pointcut);
+    // Root node index of the pointcut's expression, added on first use; the
+    // pointcut and every reference to it share the nodes
+    u32 addDeclaration(const PointcutDeclaration &pointcut);
+
+    // Valid until the builder is changed or destroyed
+    PointcutImage getImage() const;
+
+    void write(raw_ostream &OS, u64 sourceHash) const;
+
+    u32 addNode(ImageNode node);
+    u32 intern(StringRef text);
+
+private:
+    std::vector<ImagePointcut> pointcuts;
+    std::vector<ImageNode> nodes;
+    std::vector<ImageString> strings;
+    std::string chars;
+    StringMap<u32> stringIds;
+    DenseMap<const PointcutDeclaration*, u32> roots;
+};
+
+// Content hash a cached image is keyed by
+u64 hashPointcutText(StringRef text);
@@ -0,0 +1,431 @@
+#include "PointcutIndex.h"
+
+#include <algorithm>
+
+namespace {
+
+struct IndexKey {
+    FactKind kind;
+    StringRef value;
+    // value is a func() glob, filed under its id in the program's name trie
+    bool namePattern = false;
+};
+
+// A set of facts at least one of which every function matching an
+// expression has. `indexable` is false when there is no such set.
+struct IndexKeys {
+    bool indexable = false;
+    SmallVector<IndexKey, 4> keys;
+};
+
+struct IndexKeyBuilder {
+    IndexKeyBuilder(const PointcutImage &image) : image(image) {}
+
+    const PointcutImage &image;
+    bool qualifiedNames = false;
+    bool scopes = false;
+    bool signatures = false;
+    bool classes = false;
+    bool callGraphs = false;
+    bool bodies = false;
+    // Keys of the referenced pointcuts, by root
+    DenseMap<u32, IndexKeys> references;
+
+    IndexKeys leaf(FactKind kind, StringRef value) {
+        IndexKeys result;
+        result.indexable = true;
+        result.keys.push_back({kind, value});
+        return result;
+    }
+
+    IndexKeys build(u32 index) {
+        const ImageNode &node = image.getNode(index);
+        switch (node.kind) {
+            case IMAGE_OR: {
+                IndexKeys lhs = build(node.a);
+                IndexKeys rhs = build(node.b);
+                if (!lhs.indexable || !rhs.indexable) {
+                    return {};
+                }
+                lhs.keys.append(rhs.keys.begin(), rhs.keys.end());
+                return lhs;
+            }
+            case IMAGE_AND: {
+                IndexKeys lhs = build(node.a);
+                IndexKeys rhs = build(node.b);
+                if (lhs.indexable && (!rhs.indexable || lhs.keys.size() <= rhs.keys.size())) {
+                    return lhs;
+                }
+                return rhs;
+            }
+            case IMAGE_NOT:
+                // Still built for qualified-name use inside
+                build(node.a);
+                return {};
+            case IMAGE_REF: {
+                auto it = references.find(node.a);
+                if (it != references.end()) {
+                    return it->second;
+                }
+                IndexKeys result = build(node.a);
+                references[node.a] = result;
+                return result;
+            }
+            case IMAGE_FUNC: {
+                StringRef id = image.getString(node.a);
+                if (hasWildcard(id)) {
+                    qualifiedNames = true;
+                    // "app::*::serialize" still needs the name "serialize"
+                    StringRef name = id.contains("::") ? id.rsplit("::").second : id;
+                    if (!name.empty() && !hasWildcard(name)) {
+                        return leaf(FACT_NAME, name);
+                    }
+                    IndexKeys result = leaf(FACT_NAME, id);
+                    result.keys.back().namePattern = true;
+                    return result;
+                }
+                if (id.contains("::")) {
+                    qualifiedNames = true;
+                    id = id.rsplit("::").second;
+                }
+                return leaf(FACT_NAME, id);
+            }
+            case IMAGE_SECTION:
+                return leaf(static_cast<FactKind>(node.fact), image.getString(node.a));
+            case IMAGE_ANNOTATION:
+                return leaf(FACT_ANNOTATION, image.getString(node.a));
+            case IMAGE_TYPE_ANNOTATION:
+                return leaf(FACT_TYPE_ANNOTATION, image.getString(node.a));
+            case IMAGE_WITHIN_FILE:
+            case IMAGE_WITHIN_NAMESPACE:
+                // Every function has a file and a namespace
+                scopes = true;
+                return {};
+            case IMAGE_RETURNS:
+            case IMAGE_PARAMS:
+                signatures = true;
+                return {};
+            case IMAGE_METHOD_OF:
+            case IMAGE_INHERITS: {
+                classes = true;
+                StringRef name = unqualifiedName(image.getString(node.a));
+                if (hasWildcard(name)) {
+                    return {};
+                }
+                return leaf(node.kind == IMAGE_METHOD_OF ? FACT_CLASS : FACT_BASE, name);
+            }
+            case IMAGE_CALLS:
+            case IMAGE_CALLED_BY:
+                callGraphs = true;
+                return {};
+            case IMAGE_BODY_SIZE:
+            case IMAGE_BODY_FLAG:
+                bodies = true;
+                return {};
+            case IMAGE_QUALIFIER:
+            case IMAGE_PARAM_COUNT:
+                // Shared by too many functions to be worth a key
+                return {};
+            case IMAGE_CONST: {
+                // false needs a fact no function has; true cannot be narrowed down
+                IndexKeys result;
+                result.indexable = node.a == 0;
+                return result;
+            }
+            default:
+                llvm_unreachable("Unknown image node kind");
+        }
+    }
+};
+
+// The within() predicates (IMAGE_WITHIN_* nodes) at least one of which every
+// function matching an expression satisfies; built like IndexKeys.
+struct ScopeKeys {
+    bool scoped = false;
+    SmallVector<const ImageNode*, 2> scopes;
+};
+
+ScopeKeys buildScopeKeys(const PointcutImage &image, u32 index) {
+    const ImageNode &node = image.getNode(index);
+    switch (node.kind) {
+        case IMAGE_REF:
+            return buildScopeKeys(image, node.a);
+        case IMAGE_OR: {
+            ScopeKeys lhs = buildScopeKeys(image, node.a);
+            ScopeKeys rhs = buildScopeKeys(image, node.b);
+            if (!lhs.scoped || !rhs.scoped) {
+                return {};
+            }
+            lhs.scopes.append(rhs.scopes.begin(), rhs.scopes.end());
+            return lhs;
+        }
+        case IMAGE_AND: {
+            ScopeKeys lhs = buildScopeKeys(image, node.a);
+            ScopeKeys rhs = buildScopeKeys(image, node.b);
+            if (lhs.scoped && (!rhs.scoped || lhs.scopes.size() <= rhs.scopes.size())) {
+                return lhs;
+            }
+            return rhs;
+        }
+        case IMAGE_WITHIN_FILE:
+        case IMAGE_WITHIN_NAMESPACE: {
+            ScopeKeys result;
+            result.scoped = true;
+            result.scopes.push_back(&node);
+            return result;
+        }
+        case IMAGE_CONST: {
+            // false matches nowhere
+            ScopeKeys result;
+            result.scoped = node.a == 0;
+            return result;
+        }
+        default:
+            return {};
+    }
+}
+
+struct FactsEvaluator : ASTVisitor {
+    const FunctionFacts &facts;
+    bool result = false;
+
+    FactsEvaluator(const FunctionFacts &facts) : facts(facts) {}
+
+    void visit(PointcutDeclaration* node) override {
+        node->expression->accept(*this);
+    }
+    void visit(OrExpression* node) override {
+        node->left->accept(*this);
+        if (!result) {
+            node->right->accept(*this);
+        }
+    }
+    void visit(AndExpression* node) override {
+        node->left->accept(*this);
+        if (result) {
+            node->right->accept(*this);
+        }
+    }
+    void visit(NotExpression* node) override {
+        node->expr->accept(*this);
+        result = !result;
+    }
+    void visit(ParenthesizedExpression* node) override {
+        node->expr->accept(*this);
+    }
+    void visit(FuncExpression* node) override {
+        result = matchesFunctionName(node->id, facts);
+    }
+    void visit(PragmaClangExprNode* node) override {
+        result = facts.section(sectionFactKind(node->pragmaKind.kind)) == node->sectionName;
+    }
+    void visit(NotationExprNode* node) override {
+        result = llvm::is_contained(facts.annotations, node->id);
+    }
+    void visit(NotationAnalysisExprNode* node) override {
+        result = llvm::is_contained(facts.typeAnnotations, node->id);
+    }
+    void visit(WithinFileExpression* node) override {
+        result = isWithinFile(node->id, facts);
+    }
+    void visit(WithinNamespaceExpression* node) override {
+        result = isWithinNamespace(node->id, facts);
+    }
+    void visit(QualifierExpression* node) override {
+        result = facts.qualifiers & functionQualifier(node->qualifier);
+    }
+    void visit(ReturnsExpression* node) override {
+        result = facts.returnType == node->id;
+    }
+    void visit(ParamsExpression* node) override {
+        result = matchesParamTypes(node->types, facts);
+    }
+    void visit(ParamCountExpression* node) override {
+        result = facts.paramCount == node->count;
+    }
+    void visit(MethodOfExpression* node) override {
+        result = isMethodOf(node->id, facts);
+    }
+    void visit(InheritsExpression* node) override {
+        result = inheritsFrom(node->id, facts);
+    }
+    void visit(CallsExpression* node) override {
+        result = callsFunction(node->id, node->depth, facts);
+    }
+    void visit(CalledByExpression* node) override {
+        result = isCalledBy(node->id, node->depth, facts);
+    }
+    void visit(BodySizeExpression* node) override {
+        result = isBodySizeWithin(bodyMeasure(node->measure), node->min, node->max, facts);
+    }
+    void visit(BodyFlagExpression* node) override {
+        result = facts.bodyFlags & bodyFlag(node->flag);
+    }
+    void visit(PointcutRefExpression* node) override {
+        node->target->expression->accept(*this);
+    }
+    void visit(ConstantExpression* node) override {
+        result = node->value;
+    }
+};
+
+} // namespace
+
+bool evaluatePointcut(ASTNode *expression, const FunctionFacts &facts) {
+    FactsEvaluator evaluator(facts);
+    expression->accept(evaluator);
+    return evaluator.result;
+}
+
+bool PointcutIndex::add(u32 id, ASTNode *expression) {
+    PointcutImageBuilder builder;
+    u32 root = builder.addExpression(expression);
+    return add(id, builder.getImage(), root);
+}
+
+bool PointcutIndex::add(u32 id, const PointcutImage &image, u32 root) {
+    std::optional<u32> entry = program.compile(image, root);
+    if (!entry) {
+        return false;
+    }
+    if (entries.size() <= id) {
+        entries.resize(id + 1, NO_ENTRY);
+    }
+    entries[id] = *entry;
+
+    IndexKeyBuilder builder(image);
+    IndexKeys result = builder.build(root);
+    qualifiedNames |= builder.qualifiedNames;
+    scopes |= builder.scopes;
+    signatures |= builder.signatures;
+    classes |= builder.classes;
+    callGraphs |= builder.callGraphs;
+    bodies |= builder.bodies;
+
+    ScopeKeys scope = buildScopeKeys(image, root);
+    scoped &= scope.scoped;
+    for (const ImageNode *node : scope.scopes) {
+        if (node->kind == IMAGE_WITHIN_FILE) {
+            scopeFiles.add(image.getString(node->a));
+        } else {
+            scopeNamespaces.insert(image.getString(node->a));
+        }
+    }
+
+    if (!result.indexable) {
+        unindexed.push_back(id);
+        return true;
+    }
+    for (const IndexKey &key : result.keys) {
+        if (key.namePattern) {
+            u32 pattern = *program.getNamePatterns().find(key.value);
+            if (namePatternKeys.size() <= pattern) {
+                namePatternKeys.resize(pattern + 1);
+            }
+            auto &ids = namePatternKeys[pattern];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+            continue;
+        }
+        auto &ids = keys[key.kind][key.value];
+        // a || a files the pointcut under the same key twice
+        if (ids.empty() || ids.back() != id) {
+            ids.push_back(id);
+        }
+    }
+    return true;
+}
+
+void PointcutIndex::addCandidates(FactKind kind, StringRef value, llvm::SmallVectorImpl<u32> &out) const {
+    if (value.empty() || keys[kind].empty()) {
+        return;
+    }
+    auto it = keys[kind].find(value);
+    if (it != keys[kind].end()) {
+        out.append(it->second.begin(), it->second.end());
+    }
+}
+
+void PointcutIndex::candidates(const FunctionFacts &facts, llvm::SmallVectorImpl<u32> &out) const {
+    out.assign(unindexed.begin(), unindexed.end());
+    addCandidates(FACT_NAME, facts.name, out);
+    if (!namePatternKeys.empty() && !facts.qualifiedName.empty()) {
+        // One walk of the name trie, however many patterns there are
+        for (unsigned pattern : program.matchName(facts.qualifiedName).set_bits()) {
+            if (pattern < namePatternKeys.size()) {
+                out.append(namePatternKeys[pattern].begin(), namePatternKeys[pattern].end());
+            }
+        }
+    }
+    for (StringRef annotation : facts.annotations) {
+        addCandidates(FACT_ANNOTATION, annotation, out);
+    }
+    for (StringRef annotation : facts.typeAnnotations) {
+        addCandidates(FACT_TYPE_ANNOTATION, annotation, out);
+    }
+    for (u32 i = 0; i < SECTION_KIND_COUNT; ++i) {
+        addCandidates(static_cast<FactKind>(FACT_SECTION_BSS + i), facts.sections[i], out);
+    }
+    if (!facts.className.empty()) {
+        addCandidates(FACT_CLASS, unqualifiedName(facts.className), out);
+    }
+    if (!keys[FACT_BASE].empty()) {
+        for (StringRef base : facts.baseClasses) {
+            addCandidates(FACT_BASE, unqualifiedName(base), out);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+std::optional<u32> PointcutIndex::firstMatch(const FunctionFacts &facts) const {
+    SmallVector<u32, 8> ids;
+    candidates(facts, ids);
+    // The candidates share the pointcuts they refer to
+    PointcutMemo memo;
+    for (u32 id : ids) {
+        if (program.run(entries[id], facts, memo)) {
+            return id;
+        }
+    }
+    return std::nullopt;
+}
+
+bool PointcutIndex::fileInScope(StringRef file) const {
+    if (scopeFiles.size() == 0 || file.empty()) {
+        return false;
+    }
+    llvm::BitVector matches;
+    scopeFiles.match(file, matches);
+    return matches.any();
+}
+
+bool PointcutIndex::namespaceInScope(StringRef namespaceName) const {
+    FunctionFacts facts;
+    facts.namespaceName = namespaceName;
+    for (const auto &scope : scopeNamespaces) {
+        if (isWithinNamespace(scope.getKey(), facts)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PointcutIndex::mayEnterNamespace(StringRef namespaceName) const {
+    if (scopeFiles.size() != 0) {
+        return true;
+    }
+    for (const auto &scope : scopeNamespaces) {
+        // A scope around the namespace, the namespace itself or one in it
+        StringRef outer = namespaceName;
+        StringRef inner = scope.getKey();
+        if (inner.size() < outer.size()) {
+            std::swap(inner, outer);
+        }
+        if (inner.consume_front(outer) && (inner.empty() || inner.starts_with("::"))) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+#include "FunctionFacts.h"
+#include "PointcutProgram.h"
+
+#include <optional>
+#include <vector>
+
+// Evaluates a pointcut expression against the facts of one function by
+// walking the tree (references included, without memoization); the
+// reference for PointcutProgram.
+bool evaluatePointcut(ASTNode *expression, const FunctionFacts &facts);
+
+// Maps annotation values, section names and function names to the pointcuts
+// that can only match functions carrying them. A function's candidates are
+// then found with one lookup per fact, and only those are evaluated, so the
+// cost per function tracks its attribute count rather than the number of
+// pointcuts. func() globs whose last component is a glob too are keyed by
+// the glob: the qualified name is run once through the trie of all of them.
+// method_of() and inherits() are keyed by the unqualified class name, so a
+// method is looked up under its class and each of its bases.
+//
+// A pointcut is filed under a set of facts at least one of which every
+// matching function must have: an Or needs the keys of both sides, an And
+// the (smaller) key set of either side. Pointcuts that have no such set,
+// e.g. a top-level Not, are evaluated for every function.
+class PointcutIndex {
+public:
+    // Ids are dense and in declaration order; earlier ids win in firstMatch.
+    // Returns false, and does not index the pointcut, when it cannot be
+    // compiled to a PointcutProgram. Keys and strings are copied.
+    bool add(u32 id, const PointcutImage &image, u32 root);
+    bool add(u32 id, ASTNode *expression);
+
+    bool empty() const { return entries.empty(); }
+    bool needsQualifiedName() const { return qualifiedNames; }
+    // Whether FunctionFacts::file and namespaceName are read
+    bool needsScope() const { return scopes; }
+    // Whether FunctionFacts::returnType and paramTypes are read
+    bool needsSignature() const { return signatures; }
+    // Whether FunctionFacts::className and baseClasses are read
+    bool needsClass() const { return classes; }
+    // Whether FunctionFacts::callGraph and callGraphNode are read
+    bool needsCallGraph() const { return callGraphs; }
+    // Whether FunctionFacts::stmtCount, bodyWeight and bodyFlags are read
+    bool needsBody() const { return bodies; }
+
+    // Whether every pointcut is confined by within(): each has a set of
+    // within() predicates at least one of which all its matches satisfy.
+    // Functions outside every such scope cannot match, so the dispatcher
+    // skips their declarations without collecting any facts.
+    bool isScoped() const { return scoped; }
+    // With isScoped(): whether a function declared in file, or in namespace
+    // namespaceName, may match
+    bool fileInScope(StringRef file) const;
+    bool namespaceInScope(StringRef namespaceName) const;
+    // With isScoped(): whether a function declared in namespace
+    // namespaceName or in one nested in it may match (the namespace may
+    // also span files)
+    bool mayEnterNamespace(StringRef namespaceName) const;
+
+    // Candidate ids for the function, sorted, including unindexed pointcuts
+    void candidates(const FunctionFacts &facts, llvm::SmallVectorImpl<u32> &out) const;
+
+    // Lowest id whose pointcut matches the function
+    std::optional<u32> firstMatch(const FunctionFacts &facts) const;
+
+private:
+    void addCandidates(FactKind kind, StringRef value, llvm::SmallVectorImpl<u32> &out) const;
+
+    StringMap<SmallVector<u32, 2>> keys[FACT_KIND_COUNT];
+    // Ids filed under a func() glob, by the glob's id in program's name trie
+    std::vector<SmallVector<u32, 1>> namePatternKeys;
+    SmallVector<u32, 4> unindexed;
+    PointcutProgram program;
+    // Program entry of each id; NO_ENTRY for ids that were not added
+    std::vector<u32> entries;
+    static constexpr u32 NO_ENTRY = ~0u;
+    bool qualifiedNames = false;
+    bool scopes = false;
+    bool signatures = false;
+    bool classes = false;
+    bool callGraphs = false;
+    bool bodies = false;
+
+    bool scoped = true;
+    PathTrie scopeFiles;
+    StringSet<> scopeNamespaces;
+};
@@ -0,0 +1,261 @@
+#include "PointcutOptimizer.h"
+#include "FunctionFacts.h"
+#include "PathTrie.h"
+
+#include <algorithm>
+
+namespace {
+
+// Costs of the leaf predicates. A name compare touches only the decl; the
+// attribute predicates walk the attribute list. within() tests facts the
+// dispatcher looks up once per file / namespace; a glob may still be walked.
+// Qualifiers and the parameter count are flags of the decl, but the types of
+// returns() / params() are printed and compared as text. The class of a
+// method and its bases are looked up once per class, but inherits() tests
+// every base. A call graph query is a bit test once its search has run. The
+// body of a function is measured by one walk, shared by all its predicates.
+// A reference costs what its pointcut does.
+constexpr u32 COST_NAME = 1;
+constexpr u32 COST_SCOPE = 2;
+constexpr u32 COST_BODY = 2;
+constexpr u32 COST_QUALIFIED_NAME = 4;
+constexpr u32 COST_SIGNATURE = 4;
+constexpr u32 COST_HIERARCHY = 4;
+constexpr u32 COST_CALL_GRAPH = 4;
+constexpr u32 COST_ATTRIBUTE = 8;
+
+struct CostVisitor : ASTVisitor {
+    u32 cost = 0;
+    DenseMap<const PointcutDeclaration*, u32> refCosts;
+
+    void visit(PointcutDeclaration* node) override { node->expression->accept(*this); }
+    void visit(OrExpression* node) override {
+        node->left->accept(*this);
+        u32 lhs = cost;
+        node->right->accept(*this);
+        cost += lhs;
+    }
+    void visit(AndExpression* node) override {
+        node->left->accept(*this);
+        u32 lhs = cost;
+        node->right->accept(*this);
+        cost += lhs;
+    }
+    void visit(NotExpression* node) override { node->expr->accept(*this); }
+    void visit(ParenthesizedExpression* node) override { node->expr->accept(*this); }
+    void visit(FuncExpression* node) override {
+        cost = isQualifiedNamePattern(node->id) ? COST_QUALIFIED_NAME : COST_NAME;
+    }
+    void visit(PragmaClangExprNode*) override { cost = COST_ATTRIBUTE; }
+    void visit(NotationExprNode*) override { cost = COST_ATTRIBUTE; }
+    void visit(NotationAnalysisExprNode*) override { cost = COST_ATTRIBUTE; }
+    void visit(WithinFileExpression*) override { cost = COST_SCOPE; }
+    void visit(WithinNamespaceExpression*) override { cost = COST_SCOPE; }
+    void visit(QualifierExpression*) override { cost = COST_NAME; }
+    void visit(ReturnsExpression*) override { cost = COST_SIGNATURE; }
+    void visit(ParamsExpression*) override { cost = COST_SIGNATURE; }
+    void visit(ParamCountExpression*) override { cost = COST_NAME; }
+    void visit(MethodOfExpression* node) override {
+        cost = hasWildcard(node->id) ? COST_QUALIFIED_NAME : COST_SCOPE;
+    }
+    void visit(InheritsExpression*) override { cost = COST_HIERARCHY; }
+    void visit(CallsExpression*) override { cost = COST_CALL_GRAPH; }
+    void visit(CalledByExpression*) override { cost = COST_CALL_GRAPH; }
+    void visit(BodySizeExpression*) override { cost = COST_BODY; }
+    void visit(BodyFlagExpression*) override { cost = COST_BODY; }
+    void visit(PointcutRefExpression* node) override {
+        // Computed once: shared pointcuts may be referenced many times over
+        auto it = refCosts.find(node->target);
+        if (it != refCosts.end()) {
+            cost = it->second;
+            return;
+        }
+        node->target->expression->accept(*this);
+        refCosts[node->target] = cost;
+    }
+    void visit(ConstantExpression*) override { cost = 0; }
+};
+
+struct KeyVisitor : ASTVisitor {
+    llvm::raw_string_ostream OS;
+
+    KeyVisitor(std::string &out) : OS(out) {}
+
+    void pair(char op, PairExpression* node) {
+        OS << op << "(";
+        node->left->accept(*this);
+        OS << ",";
+        node->right->accept(*this);
+        OS << ")";
+    }
+
+    void visit(PointcutDeclaration* node) override { node->expression->accept(*this); }
+    void visit(OrExpression* node) override { pair('|', node); }
+    void visit(AndExpression* node) override { pair('&', node); }
+    void visit(NotExpression* node) override {
+        OS << "!";
+        node->expr->accept(*this);
+    }
+    void visit(ParenthesizedExpression* node) override { node->expr->accept(*this); }
+    void visit(FuncExpression* node) override { OS << "func(" << node->id << ")"; }
+    void visit(PragmaClangExprNode* node) override {
+        OS << "pragma(" << Token::toTwine(node->pragmaKind.kind) << "," << node->sectionName << ")";
+    }
+    void visit(NotationExprNode* node) override { OS << "annotation(" << node->id << ")"; }
+    void visit(NotationAnalysisExprNode* node) override {
+        OS << "annotation_analysis(" << node->id << ")";
+    }
+    void visit(WithinFileExpression* node) override { OS << "within(\"" << node->id << "\")"; }
+    void visit(WithinNamespaceExpression* node) override {
+        OS << "within(namespace " << node->id << ")";
+    }
+    void visit(QualifierExpression* node) override { OS << Token(node->qualifier).text; }
+    void visit(ReturnsExpression* node) override { OS << "returns(" << node->id << ")"; }
+    void visit(ParamsExpression* node) override {
+        OS << "params(";
+        llvm::interleave(node->types, OS, ",");
+        OS << ")";
+    }
+    void visit(ParamCountExpression* node) override { OS << "param_count(" << node->count << ")"; }
+    void visit(MethodOfExpression* node) override { OS << "method_of(" << node->id << ")"; }
+    void visit(InheritsExpression* node) override { OS << "inherits(" << node->id << ")"; }
+    void visit(CallsExpression* node) override {
+        OS << "calls(" << node->id << "," << node->depth << ")";
+    }
+    void visit(CalledByExpression* node) override {
+        OS << "called_by(" << node->id << "," << node->depth << ")";
+    }
+    void visit(BodySizeExpression* node) override {
+        OS << Token(node->measure).text << "(" << node->min << "," << node->max << ")";
+    }
+    void visit(BodyFlagExpression* node) override { OS << Token(node->flag).text; }
+    // A referenced name is declared once, so it stands for its pointcut
+    void visit(PointcutRefExpression* node) override { OS << "@" << node->name; }
+    void visit(ConstantExpression* node) override { OS << (node->value ? "true" : "false"); }
+};
+
+// Optimized operands of a flattened And (isAnd) or Or chain
+void collectOperands(ASTNode *node, bool isAnd, PointcutContext &context, std::vector<ASTNode*> &out) {
+    if (auto *paren = llvm::dyn_cast<ParenthesizedExpression>(node)) {
+        collectOperands(paren->expr, isAnd, context, out);
+        return;
+    }
+    ASTNodeKind chainKind = isAnd ? AST_AND : AST_OR;
+    if (node->getKind() == chainKind) {
+        auto *pair = llvm::cast<PairExpression>(node);
+        collectOperands(pair->left, isAnd, context, out);
+        collectOperands(pair->right, isAnd, context, out);
+        return;
+    }
+    ASTNode *operand = optimizePointcut(node, context);
+    // Optimizing an operand can expose a chain of the same kind, e.g. (a && b)
+    // under a double negation
+    if (operand->getKind() == chainKind) {
+        collectOperands(operand, isAnd, context, out);
+        return;
+    }
+    out.push_back(operand);
+}
+
+ASTNode *optimizeChain(ASTNode *node, bool isAnd, PointcutContext &context) {
+    std::vector<ASTNode*> operands;
+    collectOperands(node, isAnd, context, operands);
+
+    // For And, `false` absorbs and `true` is neutral; the other way round for Or
+    bool absorbing = !isAnd;
+
+    struct Operand {
+        ASTNode *node;
+        std::string key;
+        u32 cost;
+    };
+    std::vector<Operand> kept;
+    StringSet<> keys;
+    for (ASTNode *operand : operands) {
+        if (auto *constant = llvm::dyn_cast<ConstantExpression>(operand)) {
+            if (constant->value == absorbing) {
+                return context.create<ConstantExpression>(absorbing);
+            }
+            continue;
+        }
+        std::string key = pointcutKey(operand);
+        if (!keys.insert(key).second) {
+            continue;
+        }
+        kept.push_back({operand, std::move(key), pointcutCost(operand)});
+    }
+
+    // x && !x is false, x || !x is true
+    for (const Operand &operand : kept) {
+        if (StringRef(operand.key).starts_with("!") && keys.contains(StringRef(operand.key).drop_front())) {
+            return context.create<ConstantExpression>(absorbing);
+        }
+    }
+
+    if (kept.empty()) {
+        return context.create<ConstantExpression>(!absorbing);
+    }
+
+    // Cheapest first; ties keep the written order
+    std::stable_sort(kept.begin(), kept.end(), [](const Operand &a, const Operand &b) {
+        return a.cost < b.cost;
+    });
+
+    ASTNode *result = kept.front().node;
+    for (usize i = 1; i < kept.size(); ++i) {
+        if (isAnd) {
+            result = context.create<AndExpression>(result, kept[i].node);
+        } else {
+            result = context.create<OrExpression>(result, kept[i].node);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+ASTNode *optimizePointcut(ASTNode *expression, PointcutContext &context) {
+    switch (expression->getKind()) {
+        case AST_PARENTHESIZED:
+            return optimizePointcut(llvm::cast<ParenthesizedExpression>(expression)->expr, context);
+        case AST_AND:
+            return optimizeChain(expression, true, context);
+        case AST_OR:
+            return optimizeChain(expression, false, context);
+        case AST_NOT: {
+            auto *notExpr = llvm::cast<NotExpression>(expression);
+            ASTNode *inner = optimizePointcut(notExpr->expr, context);
+            if (auto *constant = llvm::dyn_cast<ConstantExpression>(inner)) {
+                return context.create<ConstantExpression>(!constant->value);
+            }
+            if (auto *innerNot = llvm::dyn_cast<NotExpression>(inner)) {
+                return innerNot->expr;
+            }
+            notExpr->expr = inner;
+            return expression;
+        }
+        case AST_POINTCUT_REF: {
+            auto *target = llvm::cast<PointcutRefExpression>(expression)->target->expression;
+            if (auto *constant = llvm::dyn_cast<ConstantExpression>(target)) {
+                return context.create<ConstantExpression>(constant->value);
+            }
+            return expression;
+        }
+        default:
+            return expression;
+    }
+}
+
+u32 pointcutCost(ASTNode *expression) {
+    CostVisitor visitor;
+    expression->accept(visitor);
+    return visitor.cost;
+}
+
+std::string pointcutKey(ASTNode *expression) {
+    std::string key;
+    KeyVisitor visitor(key);
+    expression->accept(visitor);
+    visitor.OS.flush();
+    return key;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+
+#include <string>
+
+// Rewrites a pointcut expression into an equivalent one that is cheaper to
+// match:
+//  - parentheses are dropped and nested And / Or chains are flattened,
+//  - duplicate operands and double negations are removed,
+//  - true / false operands are folded, and so are x && !x (false) and
+//    x || !x (true),
+//  - operands are ordered by estimated cost, cheapest first, so the
+//    short-circuiting matchers reject on a name compare before scanning
+//    attributes,
+//  - references to a pointcut that is constant become that constant.
+// References are otherwise kept, not inlined: the engines evaluate a shared
+// pointcut once per function. Their targets should be optimized first (in
+// file order).
+// Predicates have no side effects, so the set of matched functions is
+// unchanged. New nodes are created in context; nodes of expression may be
+// reused or updated in place.
+ASTNode *optimizePointcut(ASTNode *expression, PointcutContext &context);
+
+// Relative cost of matching the expression against one function
+u32 pointcutCost(ASTNode *expression);
+
+// Canonical text of the expression; equal for structurally equal trees
+std::string pointcutKey(ASTNode *expression);
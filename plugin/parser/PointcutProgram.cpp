@@ -0,0 +1,387 @@
+#include "PointcutProgram.h"
+
+u32 PointcutProgram::intern(StringRef text) {
+    auto [it, inserted] = stringIds.try_emplace(text, strings.size());
+    if (inserted) {
+        // The map owns the characters, so the program outlives its source
+        strings.push_back(it->first());
+    }
+    return it->second;
+}
+
+void PointcutProgram::emit(const PointcutImage &image, u32 index) {
+    const ImageNode &node = image.getNode(index);
+    switch (node.kind) {
+        case IMAGE_OR:
+        case IMAGE_AND: {
+            // a; JUMP end; b; end:
+            emit(image, node.a);
+            usize jumpAt = ops.size();
+            ops.push_back({node.kind == IMAGE_OR ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE, 0, 0});
+            emit(image, node.b);
+            ops[jumpAt].operand = ops.size();
+            break;
+        }
+        case IMAGE_NOT:
+            emit(image, node.a);
+            ops.push_back({OP_NOT, 0, 0});
+            break;
+        case IMAGE_FUNC: {
+            StringRef id = image.getString(node.a);
+            if (hasWildcard(id)) {
+                ops.push_back({OP_NAME_PATTERN, 0, namePatterns.add(id)});
+                lastName.valid = false;
+                break;
+            }
+            ops.push_back({id.contains("::") ? OP_QUALIFIED_NAME : OP_NAME, 0, intern(id)});
+            break;
+        }
+        case IMAGE_SECTION:
+            ops.push_back({OP_SECTION, node.fact, intern(image.getString(node.a))});
+            break;
+        case IMAGE_ANNOTATION:
+            ops.push_back({OP_ANNOTATION, 0, intern(image.getString(node.a))});
+            break;
+        case IMAGE_TYPE_ANNOTATION:
+            ops.push_back({OP_TYPE_ANNOTATION, 0, intern(image.getString(node.a))});
+            break;
+        case IMAGE_WITHIN_FILE:
+            ops.push_back({OP_WITHIN_FILE, 0, files.add(image.getString(node.a))});
+            // Cached matches lack the new pattern
+            lastFile.valid = false;
+            break;
+        case IMAGE_WITHIN_NAMESPACE:
+            ops.push_back({OP_WITHIN_NAMESPACE, 0, intern(image.getString(node.a))});
+            break;
+        case IMAGE_QUALIFIER:
+            ops.push_back({OP_QUALIFIER, 0, node.a});
+            break;
+        case IMAGE_RETURNS:
+            ops.push_back({OP_RETURNS, 0, intern(image.getString(node.a))});
+            break;
+        case IMAGE_PARAMS: {
+            SmallVector<StringRef, 4> types;
+            StringRef joined = image.getString(node.a);
+            if (!joined.empty()) {
+                joined.split(types, '\n');
+            }
+            for (StringRef &type : types) {
+                type = strings[intern(type)];
+            }
+            ops.push_back({OP_PARAMS, 0, u32(paramLists.size())});
+            paramLists.push_back(std::move(types));
+            break;
+        }
+        case IMAGE_PARAM_COUNT:
+            ops.push_back({OP_PARAM_COUNT, 0, node.a});
+            break;
+        case IMAGE_METHOD_OF:
+        case IMAGE_INHERITS: {
+            StringRef id = image.getString(node.a);
+            bool methodOf = node.kind == IMAGE_METHOD_OF;
+            if (hasWildcard(id)) {
+                ops.push_back({methodOf ? OP_METHOD_OF_PATTERN : OP_INHERITS_PATTERN, 0, classPatterns.add(id)});
+                lastClass.valid = false;
+                lastBases.valid = false;
+                break;
+            }
+            ops.push_back({methodOf ? OP_METHOD_OF : OP_INHERITS, 0, intern(id)});
+            break;
+        }
+        case IMAGE_CALLS:
+        case IMAGE_CALLED_BY:
+            ops.push_back({node.kind == IMAGE_CALLS ? OP_CALLS : OP_CALLED_BY, 0, u32(callQueries.size())});
+            callQueries.push_back({strings[intern(image.getString(node.a))], node.b});
+            break;
+        case IMAGE_BODY_SIZE:
+            ops.push_back({OP_BODY_SIZE, node.fact, u32(bodyRanges.size())});
+            bodyRanges.push_back({node.a, node.b});
+            break;
+        case IMAGE_BODY_FLAG:
+            ops.push_back({OP_BODY_FLAG, 0, node.a});
+            break;
+        case IMAGE_REF:
+            // Compiled by compileReferences
+            ops.push_back({OP_REF, 0, referenceIds.find(image.getString(node.b))->second});
+            break;
+        case IMAGE_CONST:
+            ops.push_back({OP_CONST, 0, node.a != 0});
+            break;
+        default:
+            llvm_unreachable("Unknown image node kind");
+    }
+}
+
+void PointcutProgram::compileReferences(const PointcutImage &image, u32 index) {
+    const ImageNode &node = image.getNode(index);
+    switch (node.kind) {
+        case IMAGE_OR:
+        case IMAGE_AND:
+            compileReferences(image, node.a);
+            compileReferences(image, node.b);
+            break;
+        case IMAGE_NOT:
+            compileReferences(image, node.a);
+            break;
+        case IMAGE_REF: {
+            StringRef name = image.getString(node.b);
+            if (referenceIds.count(name)) {
+                break;
+            }
+            compileReferences(image, node.a);
+            u32 entry = ops.size();
+            emit(image, node.a);
+            ops.push_back({OP_RETURN, 0, 0});
+            threadJumps(entry);
+            referenceIds[name] = references.size();
+            references.push_back({strings[intern(name)], entry});
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+std::optional<u32> PointcutProgram::compile(const PointcutImage &image, u32 root) {
+    compileReferences(image, root);
+    u32 entry = ops.size();
+    emit(image, root);
+    ops.push_back({OP_RETURN, 0, 0});
+    threadJumps(entry);
+    return entry;
+}
+
+std::optional<u32> PointcutProgram::compile(ASTNode *expression) {
+    PointcutImageBuilder builder;
+    u32 root = builder.addExpression(expression);
+    return compile(builder.getImage(), root);
+}
+
+void PointcutProgram::threadJumps(u32 begin) {
+    // At a jump target the register is known: false after JUMP_IF_FALSE,
+    // true after JUMP_IF_TRUE. A jump landing on a jump of the same kind
+    // takes it too; one of the opposite kind falls through.
+    for (usize i = ops.size(); i-- > begin;) {
+        PointcutOp &op = ops[i];
+        if (op.code != OP_JUMP_IF_FALSE && op.code != OP_JUMP_IF_TRUE) {
+            continue;
+        }
+        // Targets are after i and already threaded
+        const PointcutOp &target = ops[op.operand];
+        if (target.code == op.code) {
+            op.operand = target.operand;
+        } else if (target.code == OP_JUMP_IF_FALSE || target.code == OP_JUMP_IF_TRUE) {
+            op.operand = op.operand + 1;
+        }
+    }
+}
+
+const llvm::BitVector &PointcutProgram::match(const PathTrie &trie, LastMatch &last, StringRef text) {
+    if (!last.valid || last.text != text) {
+        trie.match(text, last.matches);
+        last.text.assign(text.data(), text.size());
+        last.valid = true;
+    }
+    return last.matches;
+}
+
+const llvm::BitVector &PointcutProgram::matchFile(StringRef file) const {
+    return match(files, lastFile, file);
+}
+
+const llvm::BitVector &PointcutProgram::matchName(StringRef qualifiedName) const {
+    return match(namePatterns, lastName, qualifiedName);
+}
+
+const llvm::BitVector &PointcutProgram::matchClass(StringRef className) const {
+    return match(classPatterns, lastClass, className);
+}
+
+const llvm::BitVector &PointcutProgram::matchBases(ArrayRef<StringRef> baseClasses) const {
+    basesKey.clear();
+    for (StringRef base : baseClasses) {
+        basesKey.append(base.data(), base.size());
+        basesKey += '\n';
+    }
+    // The methods of one class have the same bases
+    if (lastBases.valid && lastBases.text == basesKey) {
+        return lastBases.matches;
+    }
+    lastBases.matches.clear();
+    lastBases.matches.resize(classPatterns.size());
+    llvm::BitVector matches;
+    for (StringRef base : baseClasses) {
+        classPatterns.match(base, matches);
+        lastBases.matches |= matches;
+    }
+    lastBases.text = basesKey;
+    lastBases.valid = true;
+    return lastBases.matches;
+}
+
+bool PointcutProgram::runReference(u32 reference, const FunctionFacts &facts, PointcutMemo &memo) const {
+    if (memo.known.size() < references.size()) {
+        memo.known.resize(references.size());
+        memo.values.resize(references.size());
+    }
+    if (!memo.known.test(reference)) {
+        memo.values[reference] = run(references[reference].entry, facts, memo);
+        memo.known.set(reference);
+    }
+    return memo.values.test(reference);
+}
+
+bool PointcutProgram::run(u32 entry, const FunctionFacts &facts) const {
+    PointcutMemo memo;
+    return run(entry, facts, memo);
+}
+
+bool PointcutProgram::run(u32 entry, const FunctionFacts &facts, PointcutMemo &memo) const {
+    bool r = false;
+    const PointcutOp *code = ops.data();
+    for (u32 pc = entry;; ++pc) {
+        const PointcutOp &op = code[pc];
+        switch (op.code) {
+            case OP_NAME:
+                r = facts.name == strings[op.operand];
+                break;
+            case OP_QUALIFIED_NAME:
+                r = matchesFunctionName(strings[op.operand], facts);
+                break;
+            case OP_ANNOTATION:
+                r = llvm::is_contained(facts.annotations, strings[op.operand]);
+                break;
+            case OP_TYPE_ANNOTATION:
+                r = llvm::is_contained(facts.typeAnnotations, strings[op.operand]);
+                break;
+            case OP_SECTION:
+                r = facts.section(static_cast<FactKind>(op.kind)) == strings[op.operand];
+                break;
+            case OP_NAME_PATTERN:
+                r = !facts.qualifiedName.empty() && matchName(facts.qualifiedName).test(op.operand);
+                break;
+            case OP_WITHIN_FILE:
+                r = !facts.file.empty() && matchFile(facts.file).test(op.operand);
+                break;
+            case OP_WITHIN_NAMESPACE:
+                r = isWithinNamespace(strings[op.operand], facts);
+                break;
+            case OP_QUALIFIER:
+                r = facts.qualifiers & op.operand;
+                break;
+            case OP_RETURNS:
+                r = facts.returnType == strings[op.operand];
+                break;
+            case OP_PARAMS:
+                r = matchesParamTypes(paramLists[op.operand], facts);
+                break;
+            case OP_PARAM_COUNT:
+                r = facts.paramCount == op.operand;
+                break;
+            case OP_METHOD_OF:
+                r = isMethodOf(strings[op.operand], facts);
+                break;
+            case OP_METHOD_OF_PATTERN:
+                r = !facts.className.empty() && matchClass(facts.className).test(op.operand);
+                break;
+            case OP_INHERITS:
+                r = inheritsFrom(strings[op.operand], facts);
+                break;
+            case OP_INHERITS_PATTERN:
+                r = !facts.baseClasses.empty() && matchBases(facts.baseClasses).test(op.operand);
+                break;
+            case OP_CALLS:
+                r = callsFunction(callQueries[op.operand].pattern, callQueries[op.operand].depth, facts);
+                break;
+            case OP_CALLED_BY:
+                r = isCalledBy(callQueries[op.operand].pattern, callQueries[op.operand].depth, facts);
+                break;
+            case OP_BODY_SIZE: {
+                const BodyRange &range = bodyRanges[op.operand];
+                r = isBodySizeWithin(static_cast<BodyMeasure>(op.kind), range.min, range.max, facts);
+                break;
+            }
+            case OP_BODY_FLAG:
+                r = facts.bodyFlags & op.operand;
+                break;
+            case OP_REF:
+                r = runReference(op.operand, facts, memo);
+                break;
+            case OP_CONST:
+                r = op.operand != 0;
+                break;
+            case OP_NOT:
+                r = !r;
+                break;
+            case OP_JUMP_IF_FALSE:
+                if (!r) {
+                    pc = op.operand - 1;
+                }
+                break;
+            case OP_JUMP_IF_TRUE:
+                if (r) {
+                    pc = op.operand - 1;
+                }
+                break;
+            case OP_RETURN:
+                return r;
+        }
+    }
+}
+
+void PointcutProgram::print(llvm::raw_ostream &OS) const {
+    static const char *names[] = {
+        "NAME", "QUALIFIED_NAME", "NAME_PATTERN", "ANNOTATION", "TYPE_ANNOTATION", "SECTION",
+        "WITHIN_FILE", "WITHIN_NAMESPACE", "QUALIFIER", "RETURNS", "PARAMS", "PARAM_COUNT",
+        "METHOD_OF", "METHOD_OF_PATTERN", "INHERITS", "INHERITS_PATTERN", "CALLS", "CALLED_BY",
+        "BODY_SIZE", "BODY_FLAG", "REF", "CONST", "NOT", "JUMP_IF_FALSE", "JUMP_IF_TRUE", "RETURN",
+    };
+    for (usize i = 0; i < ops.size(); ++i) {
+        const PointcutOp &op = ops[i];
+        OS << i << ": " << names[op.code];
+        switch (op.code) {
+            case OP_NAME:
+            case OP_QUALIFIED_NAME:
+            case OP_ANNOTATION:
+            case OP_TYPE_ANNOTATION:
+            case OP_WITHIN_NAMESPACE:
+            case OP_RETURNS:
+            case OP_METHOD_OF:
+            case OP_INHERITS:
+                OS << " " << strings[op.operand];
+                break;
+            case OP_CALLS:
+            case OP_CALLED_BY:
+                OS << " " << callQueries[op.operand].pattern << " " << callQueries[op.operand].depth;
+                break;
+            case OP_REF:
+                OS << " " << references[op.operand].name << " " << references[op.operand].entry;
+                break;
+            case OP_BODY_SIZE:
+                OS << " " << u32(op.kind) << " " << bodyRanges[op.operand].min << " " << bodyRanges[op.operand].max;
+                break;
+            case OP_PARAMS:
+                OS << " ";
+                llvm::interleave(paramLists[op.operand], OS, ", ");
+                break;
+            case OP_SECTION:
+                OS << " " << u32(op.kind) << " " << strings[op.operand];
+                break;
+            case OP_NAME_PATTERN:
+            case OP_WITHIN_FILE:
+            case OP_QUALIFIER:
+            case OP_PARAM_COUNT:
+            case OP_BODY_FLAG:
+            case OP_METHOD_OF_PATTERN:
+            case OP_INHERITS_PATTERN:
+            case OP_CONST:
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE:
+                OS << " " << op.operand;
+                break;
+            default:
+                break;
+        }
+        OS << "\n";
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Common.h"
+#include "FunctionFacts.h"
+#include "PathTrie.h"
+#include "PointcutImage.h"
+
+#include "llvm/ADT/SmallBitVector.h"
+
+#include <optional>
+#include <vector>
+
+// Pointcut expressions compiled to a flat array of predicate ops.
+//
+// Every op leaves its result in a single boolean register. Leaf ops test one
+// fact of the function, NOT flips the register, and the jumps implement the
+// short circuit of && / ||: the register holds the value of the whole
+// sub-expression at every jump target, so a chain a && b && c is
+//     a; JUMP_IF_FALSE end; b; JUMP_IF_FALSE end; c; end: RETURN
+//
+// A referenced pointcut is compiled once, into code of its own ending in
+// RETURN; REF runs it, at most once per function (see PointcutMemo).
+enum PointcutOpCode : u8 {
+    OP_NAME,              // facts.name == strings[operand]
+    OP_QUALIFIED_NAME,    // matchesFunctionName(strings[operand], facts)
+    OP_NAME_PATTERN,      // facts.qualifiedName matches pattern operand of the name trie
+    OP_ANNOTATION,        // strings[operand] in facts.annotations
+    OP_TYPE_ANNOTATION,   // strings[operand] in facts.typeAnnotations
+    OP_SECTION,           // facts.section(kind) == strings[operand]
+    OP_WITHIN_FILE,       // facts.file matches pattern operand of the file trie
+    OP_WITHIN_NAMESPACE,  // isWithinNamespace(strings[operand], facts)
+    OP_QUALIFIER,         // facts.qualifiers & operand
+    OP_RETURNS,           // facts.returnType == strings[operand]
+    OP_PARAMS,            // matchesParamTypes(paramLists[operand], facts)
+    OP_PARAM_COUNT,       // facts.paramCount == operand
+    OP_METHOD_OF,         // isMethodOf(strings[operand], facts)
+    OP_METHOD_OF_PATTERN, // facts.className matches pattern operand of the class trie
+    OP_INHERITS,          // inheritsFrom(strings[operand], facts)
+    OP_INHERITS_PATTERN,  // one of facts.baseClasses matches pattern operand of the class trie
+    OP_CALLS,             // callsFunction(callQueries[operand], facts)
+    OP_CALLED_BY,         // isCalledBy(callQueries[operand], facts)
+    OP_BODY_SIZE,         // isBodySizeWithin(kind, bodyRanges[operand], facts)
+    OP_BODY_FLAG,         // facts.bodyFlags & operand
+    OP_REF,               // the code of references[operand], or its result for this function
+    OP_CONST,             // operand != 0
+    OP_NOT,
+    OP_JUMP_IF_FALSE,     // to operand
+    OP_JUMP_IF_TRUE,      // to operand
+    OP_RETURN,
+};
+
+struct PointcutOp {
+    PointcutOpCode code;
+    u8 kind;        // FactKind of OP_SECTION, BodyMeasure of OP_BODY_SIZE
+    u32 operand;    // string index, constant or jump target
+};
+
+// Results of the referenced pointcuts for one function, so that a pointcut
+// shared by several others runs once. Clear it (or use a new one) for the
+// next function.
+class PointcutMemo {
+public:
+    void clear() { known.reset(); }
+
+private:
+    friend class PointcutProgram;
+    llvm::SmallBitVector known;
+    llvm::SmallBitVector values;
+};
+
+class PointcutProgram {
+public:
+    // Appends the code of one expression and returns its entry point, or
+    // nothing when the expression uses a predicate without an op (those
+    // pointcuts are left to the MatchFinder engine). Every predicate of the
+    // grammar currently has one. Strings are copied, so neither the image
+    // nor the AST has to outlive the program.
+    std::optional<u32> compile(const PointcutImage &image, u32 root);
+    std::optional<u32> compile(ASTNode *expression);
+
+    bool run(u32 entry, const FunctionFacts &facts) const;
+    // Pointcuts run with the same memo share the results of the pointcuts
+    // they refer to; facts must be those of the same function
+    bool run(u32 entry, const FunctionFacts &facts, PointcutMemo &memo) const;
+
+    ArrayRef<PointcutOp> getOps() const { return ops; }
+    ArrayRef<StringRef> getStrings() const { return strings; }
+    // within("...") patterns; OP_WITHIN_FILE operands are their ids
+    const PathTrie &getFiles() const { return files; }
+    // func(...) globs; OP_NAME_PATTERN operands are their ids
+    const PathTrie &getNamePatterns() const { return namePatterns; }
+    // method_of() and inherits() globs; the *_PATTERN operands are their ids
+    const PathTrie &getClassPatterns() const { return classPatterns; }
+
+    // Patterns of getFiles() that match file. The result for the last file
+    // is kept, so the functions of one file share a single trie walk.
+    const llvm::BitVector &matchFile(StringRef file) const;
+    // Patterns of getNamePatterns() that match a qualified name. The result
+    // is kept for the last name, so all pointcuts (and the index) share the
+    // one walk per function.
+    const llvm::BitVector &matchName(StringRef qualifiedName) const;
+    // Patterns of getClassPatterns() that match a class, or any of a list of
+    // bases; kept for the last one like matchName
+    const llvm::BitVector &matchClass(StringRef className) const;
+    const llvm::BitVector &matchBases(ArrayRef<StringRef> baseClasses) const;
+
+    void print(llvm::raw_ostream &OS) const;
+
+private:
+    u32 intern(StringRef text);
+    void emit(const PointcutImage &image, u32 index);
+    // Compiles the pointcuts the expression refers to, dependencies first
+    void compileReferences(const PointcutImage &image, u32 index);
+    bool runReference(u32 reference, const FunctionFacts &facts, PointcutMemo &memo) const;
+    // Retargets jumps that land on another jump of a known outcome
+    void threadJumps(u32 begin);
+
+    std::vector<PointcutOp> ops;
+    std::vector<StringRef> strings;
+    StringMap<u32> stringIds;
+    // params(...) type lists, of interned strings
+    std::vector<SmallVector<StringRef, 4>> paramLists;
+    // calls() and called_by() operands, of interned strings
+    struct CallQuery {
+        StringRef pattern;
+        u32 depth;
+    };
+    std::vector<CallQuery> callQueries;
+    // stmt_count() and body_weight() bounds
+    struct BodyRange {
+        u32 min;
+        u32 max;
+    };
+    std::vector<BodyRange> bodyRanges;
+    // Referenced pointcuts, by name: names are unique among the pointcuts
+    // of a file, which a program compiles
+    struct Reference {
+        StringRef name;
+        u32 entry;
+    };
+    std::vector<Reference> references;
+    StringMap<u32> referenceIds;
+    PathTrie files;
+    PathTrie namePatterns{PATH_QUALIFIED_NAME};
+    PathTrie classPatterns{PATH_QUALIFIED_NAME};
+
+    // Matches of a trie for the text it was last run on
+    struct LastMatch {
+        std::string text;
+        llvm::BitVector matches;
+        bool valid = false;
+    };
+    static const llvm::BitVector &match(const PathTrie &trie, LastMatch &last, StringRef text);
+    mutable LastMatch lastFile;
+    mutable LastMatch lastName;
+    mutable LastMatch lastClass;
+    // text is the bases, one per line
+    mutable LastMatch lastBases;
+    mutable std::string basesKey;
+};
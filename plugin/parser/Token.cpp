@@ -1,7 +1,26 @@
 #include "Token.h"
+#include "PerfectHash.h"
+
+namespace {
+
+// Spelling -> kind for every token in Token.def
+constexpr auto TokenKinds = makePerfectHashTable<TokenKind>({
+    #define TOKEN_DEF(NAME, STR) {STR, NAME},
+    #include "Token.def"
+    #undef TOKEN_DEF
+});
+
+// Reserved words only (the KEYWORD_DEF entries of Token.def)
+constexpr auto Keywords = makePerfectHashTable<TokenKind>({
+    #define TOKEN_DEF(NAME, STR)
+    #define KEYWORD_DEF(NAME, STR) {STR, NAME},
+    #include "Token.def"
+    #undef TOKEN_DEF
+});
+
+} // namespace
 
 Token::Token(const char* s) : Token(llvm::StringRef(s)) {}
-Token::Token(TokenKind k, llvm::StringRef t) : kind(k), text(t) {}
 
 //make std::out printable with text if it is not empty
 llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, const Token &T) {
@@ -16,7 +35,7 @@ bool Token::operator==(TokenKind k) const { return kind == k; }
 
 bool Token::operator==(llvm::StringRef t) const { return text == t; }
 
-const bool Token::operator==(Token& other) const { return kind == other.kind && text == other.text; }
+bool Token::operator==(const Token& other) const { return kind == other.kind && text == other.text; }
 
 bool Token::operator<(const Token& other) const {
     return kind < other.kind || (kind == other.kind && text < other.text);
@@ -39,17 +58,15 @@ llvm::Twine Token::toTwine(TokenKind type) {
     return toStr(type);
 }
 
-llvm::StringMap<TokenKind> Token::toTokenKind({
-    #define TOKEN_DEF(NAME, STR) {STR, NAME},
-    #include "Token.def"
-    #undef TOKEN_DEF
-});
+TokenKind Token::toTokenKind(llvm::StringRef s) {
+    return TokenKinds.lookup(std::string_view(s.data(), s.size()), TOK_UNKNOWN);
+}
 
 
 Token::Token(TokenKind k) : kind(k), text(toStr(k)) {}
-Token::Token(StringRef s) : kind(Token::toTokenKind.at(s)), text(s) {}
+Token::Token(StringRef s) : kind(Token::toTokenKind(s)), text(s) {}
 
-const Token EOF_TOKEN(TOK_EOF);
+constinit const Token EOF_TOKEN(TOK_EOF, "EOF");
 
 ParenOpenToken::ParenOpenToken(const char* cur, const char* pairParent) : Token(TOK_LPAREN, llvm::StringRef(cur, pairParent-cur)) {}
 
@@ -62,9 +79,10 @@ bool ParenOpenToken::operator==(const ParenOpenToken& other) const {
 }
 
 KeywordToken::KeywordToken(TokenKind k) : Token(k){}
-KeywordToken::KeywordToken(llvm::StringRef t) : Token(keywords.lookup(t), t) {}
+KeywordToken::KeywordToken(llvm::StringRef t)
+    : Token(Keywords.lookup(std::string_view(t.data(), t.size()), TOK_IDENTIFIER), t) {}
 bool KeywordToken::isKeyword(llvm::StringRef text) {
-    return keywords.count(text);
+    return Keywords.contains(std::string_view(text.data(), text.size()));
 }
 bool KeywordToken::operator==(TokenKind k) const { return kind == k; }
 bool KeywordToken::operator==(const Token& other) const {
@@ -73,37 +91,3 @@ bool KeywordToken::operator==(const Token& other) const {
 bool KeywordToken::operator==(const KeywordToken& other) const {
     return kind == other.kind && text == other.text;
 }
-
-
-// _TokenKindToStr(TOK_POINTCUT) and TOK_POINTCUT map initialization
-llvm::StringMap<TokenKind> KeywordToken::keywords({
-    {toStr(TOK_POINTCUT), TOK_POINTCUT},
-    {toStr(TOK_FUNC), TOK_FUNC},
-    {toStr(TOK_WITHIN), TOK_WITHIN},
-    {toStr(TOK_EXPORT), TOK_EXPORT},
-    {toStr(TOK_PRAGMA_CLANG), TOK_PRAGMA_CLANG},
-    {toStr(TOK_ANNOTATION), TOK_ANNOTATION},
-    {toStr(TOK_ANNOTATION_ANALYSIS), TOK_ANNOTATION_ANALYSIS},
-    {toStr(TOK_CONST), TOK_CONST},
-    {toStr(TOK_STATIC), TOK_STATIC},
-    {toStr(TOK_REGISTER), TOK_REGISTER},
-    {toStr(TOK_VOLATILE), TOK_VOLATILE},
-    {toStr(TOK_RESTRICT), TOK_RESTRICT},
-    {toStr(TOK_RUN_POINTCUT), TOK_RUN_POINTCUT},
-    {toStr(TOK_CALL_POINTCUT), TOK_CALL_POINTCUT}
-
-});
-/*
-    {toStr(TOK_BSS), TOK_BSS},
-    {toStr(TOK_DATA), TOK_DATA},
-    {toStr(TOK_RELRO), TOK_RELRO},
-    {toStr(TOK_RODATA), TOK_RODATA},
-    {toStr(TOK_TEXT), TOK_TEXT},
-*/
-/*
-TOKEN_DEF(TOK_BSS, "bss")
-TOKEN_DEF(TOK_DATA, "data")
-TOKEN_DEF(TOK_RELRO, "relro")
-TOKEN_DEF(TOK_RODATA, "rodata")
-TOKEN_DEF(TOK_TEXT, "text")
-*/
\ No newline at end of file
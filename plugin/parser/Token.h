@@ -13,7 +13,8 @@ enum TokenKind {
 //impl std::less<T> for TokenKind and then text
 // Token structure
 struct Token : public std::less<Token> {
-    static llvm::StringMap<TokenKind> toTokenKind;
+    // Kind spelled by s (punctuation, keyword or pseudo token), else TOK_UNKNOWN
+    static TokenKind toTokenKind(llvm::StringRef s);
     static auto toStr(TokenKind type);
     static llvm::Twine toTwine(TokenKind type);
 
@@ -23,13 +24,13 @@ struct Token : public std::less<Token> {
     Token(TokenKind k);
     Token(StringRef s);
     Token(const char* s);
-    Token(TokenKind k, llvm::StringRef t);
+    constexpr Token(TokenKind k, llvm::StringRef t) : kind(k), text(t) {}
     
     //make std::out printable with text if it is not empty
     friend llvm::raw_ostream& operator<<(llvm::raw_ostream &OS, const Token &T);
     bool operator==(TokenKind k) const;
     bool operator==(llvm::StringRef t) const;
-    const bool operator==(Token& other) const;
+    bool operator==(const Token& other) const;
     bool operator<(const Token& other) const ;
     // cast to bool
     operator bool() const;
@@ -46,10 +47,6 @@ struct ParenOpenToken : public Token {
 
 
 struct KeywordToken : public Token {
-private:
-    // Use llvm::StringSet for better performance and simplicity
-    static llvm::StringMap<TokenKind> keywords;
-public:
     KeywordToken(TokenKind k);
     KeywordToken(llvm::StringRef t);
     static bool isKeyword(llvm::StringRef text);
@@ -0,0 +1,198 @@
+// Counts how often an argument is materialized between the caller and the
+// original body of a woven function, for large by-value and by-reference
+// parameters. The wrappers below have the shape WrapFunctionCallback
+// generates: the wrapper keeps the declared signature and passes
+// std::forward<T>(param) to around(); the wrapped function takes T&& for a
+// heavy by-value T, also for a method, whose trampoline forwards Args&&.
+// "T in wrapped" shows the previous convention for the 4 KiB parameter, in
+// which the wrapped function kept T and proceed() constructed it once more.
+//
+// The process fails unless every woven call copies and moves exactly as
+// often as the direct call.
+//
+// usage: argument_bench [calls]
+
+#include "saop.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+enum class PointcutName {bench};
+
+namespace {
+
+// Counts its copies and moves; owns a heap buffer like std::string
+struct Tracked {
+    static inline unsigned long long copies = 0;
+    static inline unsigned long long moves = 0;
+
+    explicit Tracked(std::string text) : text(std::move(text)) {}
+    Tracked(const Tracked& other) : text(other.text) { ++copies; }
+    Tracked(Tracked&& other) noexcept : text(std::move(other.text)) { ++moves; }
+
+    std::string text;
+};
+
+// Trivially copyable and large: its copies cannot be counted, but every
+// extra hop is a 4 KiB memcpy in the time per call
+struct Large {
+    std::array<char, 4096> bytes;
+};
+
+} // namespace
+
+namespace {
+
+volatile unsigned long long adviceRuns = 0;
+
+} // namespace
+
+// A minimal advice that still does something after proceed(), as real ones
+// do; an advice that only proceeds would let the wrapper tail-call the
+// wrapped function and reuse the caller's copy of a trivially copyable
+// argument
+template<typename RT, typename... Args>
+template<PointcutName Id>
+RT Pointcut<RT, Args...>::around(Args&&... args) {
+    AfterProceed after([] { adviceRuns = adviceRuns + 1; });
+    return proceed(std::forward<Args>(args)...);
+}
+
+template<auto Func>
+template<PointcutName Id, typename... Args>
+typename StaticPointcut<Func>::ReturnType StaticPointcut<Func>::around(Args&&... args) {
+    AfterProceed after([] { adviceRuns = adviceRuns + 1; });
+    return proceed(std::forward<Args>(args)...);
+}
+
+#define NOINLINE __attribute__((noinline))
+
+// External linkage and noinline, so no call is specialized away: every hop
+// is a real call with the ABI of its signature
+
+// Original bodies
+NOINLINE std::size_t direct(Tracked value) { return value.text.size(); }
+NOINLINE std::size_t directRef(const Tracked& value) { return value.text.size(); }
+NOINLINE int directLarge(Large value) { return value.bytes[7]; }
+
+// Previous convention: the wrapped function keeps its by-value parameter
+NOINLINE int byValueLarge__wrapped__(Large value) { return value.bytes[7]; }
+NOINLINE int byValueLarge(Large value) {
+    auto pc = createPointcut(&byValueLarge__wrapped__, nullptr, nullptr);
+    return pc.template around<PointcutName::bench>(std::forward<Large>(value));
+}
+
+// Generated now: the wrapped function binds to the wrapper's parameter
+NOINLINE std::size_t woven__wrapped__(Tracked&& value) { return value.text.size(); }
+NOINLINE std::size_t woven(Tracked value) {
+    auto pc = createPointcut(&woven__wrapped__, nullptr, nullptr);
+    return pc.template around<PointcutName::bench>(std::forward<Tracked>(value));
+}
+NOINLINE std::size_t wovenStatic(Tracked value) {
+    auto pc = StaticPointcut<&woven__wrapped__>();
+    return pc.template around<PointcutName::bench>(std::forward<Tracked>(value));
+}
+NOINLINE std::size_t wovenRef__wrapped__(const Tracked& value) { return value.text.size(); }
+NOINLINE std::size_t wovenRef(const Tracked& value) {
+    auto pc = createPointcut(&wovenRef__wrapped__, nullptr, nullptr);
+    return pc.template around<PointcutName::bench>(std::forward<const Tracked&>(value));
+}
+// An out-of-line method: its in-class declaration is renamed along with the
+// definition, so both take T&&
+struct Greeter {
+    NOINLINE std::size_t direct(Tracked value) { return value.text.size(); }
+    std::size_t woven__wrapped__(Tracked&& value);
+    std::size_t woven(Tracked value);
+};
+NOINLINE std::size_t Greeter::woven__wrapped__(Tracked&& value) { return value.text.size(); }
+NOINLINE std::size_t Greeter::woven(Tracked value) {
+    auto pc = createPointcut<&Greeter::woven__wrapped__>(this, nullptr, nullptr);
+    return pc.template around<PointcutName::bench>(std::forward<Tracked>(value));
+}
+NOINLINE int wovenLarge__wrapped__(Large&& value) { return value.bytes[7]; }
+NOINLINE int wovenLarge(Large value) {
+    auto pc = createPointcut(&wovenLarge__wrapped__, nullptr, nullptr);
+    return pc.template around<PointcutName::bench>(std::forward<Large>(value));
+}
+
+namespace {
+
+volatile std::size_t checksum = 0;
+
+struct Result {
+    unsigned long long copies;
+    unsigned long long moves;
+    double nsPerCall;
+};
+
+template<typename Call>
+Result measure(unsigned calls, Call call) {
+    Tracked::copies = 0;
+    Tracked::moves = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < calls; ++i) {
+        checksum = checksum + call();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return {Tracked::copies, Tracked::moves, ns / calls};
+}
+
+void report(const char* name, const Result& result, unsigned calls) {
+    std::printf("%-34s %6.2f copies/call %6.2f moves/call %8.1f ns/call\n", name,
+                double(result.copies) / calls, double(result.moves) / calls, result.nsPerCall);
+}
+
+bool same(const Result& result, const Result& expected) {
+    return result.copies == expected.copies && result.moves == expected.moves;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if (calls == 0) {
+        std::fprintf(stderr, "usage: argument_bench [calls]\n");
+        return 1;
+    }
+
+    // The caller copies an lvalue into the parameter: one copy per call
+    const Tracked source(std::string(256, 'x'));
+    Large large{};
+    large.bytes[7] = 1;
+
+    Greeter greeter;
+
+    Result directResult = measure(calls, [&] { return direct(source); });
+    Result wovenResult = measure(calls, [&] { return woven(source); });
+    Result wovenStaticResult = measure(calls, [&] { return wovenStatic(source); });
+    Result directMemberResult = measure(calls, [&] { return greeter.direct(source); });
+    Result wovenMemberResult = measure(calls, [&] { return greeter.woven(source); });
+    Result directRefResult = measure(calls, [&] { return directRef(source); });
+    Result wovenRefResult = measure(calls, [&] { return wovenRef(source); });
+    Result directLargeResult = measure(calls, [&] { return directLarge(large); });
+    Result byValueLargeResult = measure(calls, [&] { return byValueLarge(large); });
+    Result wovenLargeResult = measure(calls, [&] { return wovenLarge(large); });
+
+    report("by value: direct", directResult, calls);
+    report("by value: Pointcut, T&& in wrapped", wovenResult, calls);
+    report("by value: StaticPointcut", wovenStaticResult, calls);
+    report("method by value: direct", directMemberResult, calls);
+    report("method by value: Pointcut", wovenMemberResult, calls);
+    report("by reference: direct", directRefResult, calls);
+    report("by reference: Pointcut", wovenRefResult, calls);
+    report("4 KiB by value: direct", directLargeResult, calls);
+    report("4 KiB by value: T in wrapped", byValueLargeResult, calls);
+    report("4 KiB by value: T&& in wrapped", wovenLargeResult, calls);
+
+    if (!same(wovenResult, directResult) || !same(wovenStaticResult, directResult) ||
+        !same(wovenMemberResult, directMemberResult) || !same(wovenRefResult, directRefResult)) {
+        std::printf("FAILED: a woven call materializes its argument more often than a direct one\n");
+        return 1;
+    }
+    std::printf("OK: woven calls materialize each argument once\n");
+    return 0;
+}
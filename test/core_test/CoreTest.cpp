@@ -0,0 +1,82 @@
+// UTHelperContext::transform reports what goes wrong with the pointcut file
+// in its result: the host process of the library keeps running.
+//
+// usage: core_test
+
+#include "UTHelperCore.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+namespace {
+
+const char *Source = "int f(int x) { return x + 1; }\n";
+
+unsigned Failures = 0;
+
+void check(bool Condition, const char *What, const TransformResult &Result) {
+  if (Condition)
+    return;
+  llvm::errs() << "FAILED: " << What << "\n" << Result.Diagnostics << "\n";
+  ++Failures;
+}
+
+TransformResult transformWith(llvm::StringRef PointcutFile,
+                              llvm::StringRef Dir) {
+  UTHelperOptions Opts;
+  Opts.PointcutText = PointcutFile.str();
+  Opts.BaseFolder = Dir.str();
+  Opts.finalize();
+  UTHelperContext Context(std::move(Opts));
+  llvm::SmallString<128> Input(Dir);
+  llvm::sys::path::append(Input, "input.cpp");
+  return Context.transform(Source, Input, {"-std=c++20"});
+}
+
+void writeFile(llvm::StringRef Path, llvm::StringRef Text) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  OS << Text;
+}
+
+} // namespace
+
+int main() {
+  llvm::SmallString<128> Dir;
+  if (llvm::sys::fs::createUniqueDirectory("core_test", Dir)) {
+    llvm::errs() << "cannot create a directory\n";
+    return 1;
+  }
+  llvm::SmallString<128> Good(Dir), Bad(Dir), Missing(Dir);
+  llvm::sys::path::append(Good, "good.pc");
+  llvm::sys::path::append(Bad, "bad.pc");
+  llvm::sys::path::append(Missing, "missing.pc");
+  writeFile(Good, "run_pointcut p = func(f);\n");
+  writeFile(Bad, "run_pointcut p = func(f) &&;\n");
+
+  TransformResult Woven = transformWith(Good, Dir);
+  check(Woven.Success, "a valid pointcut file transforms", Woven);
+  check(llvm::StringRef(Woven.Output).contains("f__wrapped__"),
+        "the matched function is woven", Woven);
+
+  TransformResult Syntax = transformWith(Bad, Dir);
+  check(!Syntax.Success, "a syntax error fails the transform", Syntax);
+  check(llvm::StringRef(Syntax.Diagnostics).contains("syntax error"),
+        "the syntax error is in the diagnostics", Syntax);
+
+  TransformResult Unreadable = transformWith(Missing, Dir);
+  check(!Unreadable.Success, "a missing pointcut file fails the transform",
+        Unreadable);
+  check(llvm::StringRef(Unreadable.Diagnostics).contains("cannot read"),
+        "the missing file is in the diagnostics", Unreadable);
+
+  llvm::sys::fs::remove_directories(Dir);
+  if (Failures)
+    return 1;
+  llvm::outs() << "OK: pointcut file errors are reported in the result\n";
+  return 0;
+}
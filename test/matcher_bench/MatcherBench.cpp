@@ -0,0 +1,144 @@
+// Measures how many function declarations per second each pointcut engine
+// matches. A synthetic TU with <functions> functions and a pointcut file with
+// <pointcuts> run_pointcuts are generated; the TU is parsed once and then
+// handed to a fresh WrapFunctionConsumer per engine and repetition, so only
+// matching (and the identical rewrites) are timed.
+//
+// usage: matcher_bench [functions] [pointcuts] [repetitions]
+
+#include "WrapFunctionConsumer.h"
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Functions carry an annotation, a text section or nothing, so that some
+// match a pointcut and most are rejected after their attributes are read.
+std::string generateSource(unsigned Functions, unsigned Pointcuts) {
+  std::string Source;
+  llvm::raw_string_ostream OS(Source);
+  for (unsigned I = 0; I < Functions; ++I) {
+    switch (I % 4) {
+    case 0:
+      OS << "[[clang::annotate(\"tag" << (I % (Pointcuts * 2)) << "\")]]\n";
+      break;
+    case 1:
+      OS << "#pragma clang section text=\"sec" << (I % (Pointcuts * 2))
+         << "\"\n";
+      break;
+    default:
+      break;
+    }
+    OS << "int fn" << I << "(int x) { return x + " << I << "; }\n";
+    if (I % 4 == 1)
+      OS << "#pragma clang section text=\"\"\n";
+  }
+  return OS.str();
+}
+
+std::string generatePointcuts(unsigned Pointcuts) {
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  for (unsigned I = 0; I < Pointcuts; ++I) {
+    switch (I % 3) {
+    case 0:
+      OS << "run_pointcut p" << I << " = annotation(tag" << I
+         << ") && !func(fn0);\n";
+      break;
+    case 1:
+      OS << "run_pointcut p" << I << " = pragma_clang(text, sec" << I
+         << ") || func(fn" << I << ");\n";
+      break;
+    default:
+      OS << "run_pointcut p" << I << " = (func(fn" << I << ") || annotation(tag"
+         << I << ")) && !annotation(never);\n";
+      break;
+    }
+  }
+  return OS.str();
+}
+
+unsigned countFunctions(clang::ASTContext &Context) {
+  unsigned Count = 0;
+  for (const clang::Decl *D : Context.getTranslationUnitDecl()->decls())
+    if (llvm::isa<clang::FunctionDecl>(D))
+      ++Count;
+  return Count;
+}
+
+double matchOnce(clang::ASTUnit &AST, const std::string &PointcutFile,
+                 PointcutEngine Engine) {
+  clang::Rewriter Rewrite(AST.getSourceManager(), AST.getLangOpts());
+  // Consumer construction (parsing and compiling the pointcuts) is part of
+  // every compiler invocation, so it is timed too
+  auto Start = std::chrono::steady_clock::now();
+  WrapFunctionConsumer Consumer(Rewrite, PointcutFile, Engine);
+  Consumer.HandleTranslationUnit(AST.getASTContext());
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned Functions = argc > 1 ? std::atoi(argv[1]) : 20000;
+  unsigned Pointcuts = argc > 2 ? std::atoi(argv[2]) : 200;
+  unsigned Repetitions = argc > 3 ? std::atoi(argv[3]) : 3;
+  if (Functions == 0 || Pointcuts == 0 || Repetitions == 0) {
+    llvm::errs() << "usage: " << argv[0]
+                 << " [functions] [pointcuts] [repetitions]\n";
+    return 2;
+  }
+
+  llvm::SmallString<128> PointcutFile;
+  int FD;
+  if (llvm::sys::fs::createTemporaryFile("matcher_bench", "pc", FD,
+                                         PointcutFile)) {
+    llvm::errs() << "cannot create pointcut file\n";
+    return 1;
+  }
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << generatePointcuts(Pointcuts);
+  }
+
+  std::unique_ptr<clang::ASTUnit> AST = clang::tooling::buildASTFromCodeWithArgs(
+      generateSource(Functions, Pointcuts), {"-std=c++20"}, "bench.cpp");
+  if (!AST) {
+    llvm::errs() << "cannot parse generated source\n";
+    return 1;
+  }
+  unsigned Decls = countFunctions(AST->getASTContext());
+
+  struct {
+    const char *Name;
+    PointcutEngine Engine;
+  } Engines[] = {
+      {"bytecode", PointcutEngine::Bytecode},
+      {"matcher", PointcutEngine::Matcher},
+  };
+  llvm::outs() << Decls << " functions, " << Pointcuts << " pointcuts\n";
+  for (const auto &E : Engines) {
+    double Best = 0;
+    for (unsigned R = 0; R < Repetitions; ++R) {
+      double Seconds = matchOnce(*AST, std::string(PointcutFile.str()), E.Engine);
+      if (R == 0 || Seconds < Best)
+        Best = Seconds;
+    }
+    llvm::outs() << llvm::format("%-9s %10.0f decls/sec (%.3f ms)\n", E.Name,
+                                 Decls / Best, Best * 1000);
+  }
+
+  llvm::sys::fs::remove(PointcutFile);
+  return 0;
+}
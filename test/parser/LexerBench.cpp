@@ -0,0 +1,95 @@
+// Measures lexer throughput (MB/s and tokens/s) on a generated pointcut file
+// shaped like the output of pointcut generators: indented declarations,
+// comment lines, qualified names and long alternations.
+//
+// usage: lexer_bench [declarations] [repetitions]
+
+#include "Common.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+std::string generatePointcuts(u32 declarations) {
+    std::string text;
+    llvm::raw_string_ostream OS(text);
+    for (u32 i = 0; i < declarations; ++i) {
+        if (i % 8 == 0) {
+            OS << "\n# generated block " << i / 8 << ": functions of module m" << i / 8 << "\n";
+        }
+        switch (i % 3) {
+        case 0:
+            OS << "run_pointcut p" << i << " =\n        func(m" << i / 8 << "::fn" << i
+               << ") || func(fn" << i << "_alt) || annotation(tag" << i << ");\n";
+            break;
+        case 1:
+            OS << "call_pointcut p" << i << " = (pragma_clang(text, sec" << i
+               << ") || annotation_analysis(hot))\n        && !func(fn" << i << ");\n";
+            break;
+        default:
+            OS << "p" << i << " = func(...) && !annotation(skip" << i << ");    # helper\n";
+            break;
+        }
+    }
+    return OS.str();
+}
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    u32 declarations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    u32 repetitions = argc > 2 ? std::atoi(argv[2]) : 10;
+    if (declarations == 0 || repetitions == 0) {
+        llvm::errs() << "usage: " << argv[0] << " [declarations] [repetitions]\n";
+        return 1;
+    }
+
+    std::string text = generatePointcuts(declarations);
+
+    usize tokens = 0;
+    Clock::time_point start = Clock::now();
+    for (u32 r = 0; r < repetitions; ++r) {
+        Lexer lexer(text);
+        tokens = 0;
+        while (lexer.next().kind != TOK_EOF) {
+            ++tokens;
+        }
+    }
+    double lexSeconds = secondsSince(start) / repetitions;
+
+    usize parsed = 0;
+    start = Clock::now();
+    for (u32 r = 0; r < repetitions; ++r) {
+        PointcutContext context;
+        Lexer lexer(text);
+        Parser parser(lexer, context);
+        parsed = parser.parsePointcutList().size();
+    }
+    double parseSeconds = secondsSince(start) / repetitions;
+
+    if (parsed != declarations) {
+        llvm::errs() << "parsed " << parsed << " of " << declarations << " declarations\n";
+        return 1;
+    }
+
+    double megabytes = text.size() / (1024.0 * 1024.0);
+    llvm::outs() << declarations << " declarations, " << text.size() << " bytes, " << tokens << " tokens\n";
+    llvm::outs() << llvm::format("lex   %8.1f MB/s %12.0f tokens/sec (%.3f ms)\n",
+                                 megabytes / lexSeconds, tokens / lexSeconds, lexSeconds * 1000);
+    llvm::outs() << llvm::format("parse %8.1f MB/s %12.0f decls/sec  (%.3f ms)\n",
+                                 megabytes / parseSeconds, declarations / parseSeconds, parseSeconds * 1000);
+    return 0;
+}
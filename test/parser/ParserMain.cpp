@@ -10,12 +10,41 @@
 #include "Token.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "CallGraph.h"
+#include "PathTrie.h"
+#include "PointcutCache.h"
+#include "PointcutCodegen.h"
+#include "PointcutImage.h"
+#include "PointcutIndex.h"
+#include "PointcutOptimizer.h"
+#include "PointcutProgram.h"
 
 class A{public: void print(){}};
+
+// Owns the nodes and identifiers of every pointcut parsed by these tests
+PointcutContext TestContext;
+
+void runTokenTableTests() {
+    // every Token.def spelling resolves through the constexpr tables
+    ASSERT_EQ(Token("(").kind, TOK_LPAREN);
+    ASSERT_EQ(Token("&&").kind, TOK_AMPAMP);
+    ASSERT_EQ(Token("run_pointcut").kind, TOK_RUN_POINTCUT);
+    ASSERT_EQ(Token("rodata").kind, TOK_RODATA);
+    ASSERT_EQ(Token("no_such_token").kind, TOK_UNKNOWN);
+    ASSERT_EQ(KeywordToken::isKeyword("annotation_analysis"), true);
+    ASSERT_EQ(KeywordToken::isKeyword("call_pointcut"), true);
+    // pragma kinds and the newer predicate names are contextual, not reserved
+    ASSERT_EQ(KeywordToken::isKeyword("text"), false);
+    ASSERT_EQ(KeywordToken::isKeyword("calls"), false);
+    ASSERT_EQ(KeywordToken::isKeyword("namespace"), false);
+    ASSERT_EQ(Token("has_loop").kind, TOK_HAS_LOOP);
+    ASSERT_EQ(KeywordToken::isKeyword("annotatio"), false);
+    ASSERT_EQ(KeywordToken("func").kind, TOK_FUNC);
+}
+
 void runLexerTests() {
     llvm::StringRef testInput1 = "call_pointcut myPointcut = func(myFunction);";
     Lexer lexer1(testInput1);
-    lexer1.updateDeclarationEnd();
     ASSERT_EQ(lexer1.next().kind, TOK_CALL_POINTCUT);
     ASSERT_EQ(lexer1.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer1.next().kind, TOK_EQUAL);
@@ -29,7 +58,6 @@ void runLexerTests() {
     llvm::StringRef testInput2 = "# This is a comment\nmyPointcut = func(someFunction);";
     Lexer lexer2(testInput2);
     //ASSERT_EQ(lexer2.nextToken().kind, TOK_COMMENT);
-    lexer2.updateDeclarationEnd();
     ASSERT_EQ(lexer2.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer2.next().kind, TOK_EQUAL);
     ASSERT_EQ(lexer2.next().kind, TOK_FUNC);
@@ -41,7 +69,6 @@ void runLexerTests() {
 
     llvm::StringRef testInput3 = "myPointcut = func(func1) && func(func2);";
     Lexer lexer3(testInput3);
-    lexer3.updateDeclarationEnd();
     ASSERT_EQ(lexer3.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer3.next().kind, TOK_EQUAL);
     ASSERT_EQ(lexer3.next().kind, TOK_FUNC);
@@ -59,7 +86,6 @@ void runLexerTests() {
     // clang_section = pragma_clang(bss, my_section);
     llvm::StringRef testInput4 = "clang_section = pragma_clang(bss, my_section);";
     Lexer lexer4(testInput4);
-    lexer4.updateDeclarationEnd();
     ASSERT_EQ(lexer4.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer4.next().kind, TOK_EQUAL);
     ASSERT_EQ(lexer4.next().kind, TOK_PRAGMA_CLANG);
@@ -76,7 +102,6 @@ void runLexerTests() {
     // pragma_clang || example
     llvm::StringRef testInput5 = "run_pointcut myPointcut = pragma_clang(bss, data) || pragma_clang(data, my_data);";
     Lexer lexer5(testInput5);
-    lexer5.updateDeclarationEnd();
     ASSERT_EQ(lexer5.next().kind, TOK_RUN_POINTCUT);
     ASSERT_EQ(lexer5.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer5.next().kind, TOK_EQUAL);
@@ -99,7 +124,6 @@ void runLexerTests() {
     // myPointcut = annotation_analysis(my_annotation);
     llvm::StringRef testInput6 = "myPointcut = annotation_analysis(my_annotation);";
     Lexer lexer6(testInput6);
-    lexer6.updateDeclarationEnd();
     ASSERT_EQ(lexer6.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer6.next().kind, TOK_EQUAL);
     ASSERT_EQ(lexer6.next().kind, TOK_ANNOTATION_ANALYSIS);
@@ -112,7 +136,6 @@ void runLexerTests() {
     // call_pointcut myPointcut = func(...);
     llvm::StringRef testInput7 = "call_pointcut myPointcut = func(...);";
     Lexer lexer7(testInput7);
-    lexer7.updateDeclarationEnd();
     ASSERT_EQ(lexer7.next().kind, TOK_CALL_POINTCUT);
     ASSERT_EQ(lexer7.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer7.next().kind, TOK_EQUAL);
@@ -126,7 +149,6 @@ void runLexerTests() {
     // "call_pointcut myPointcut = func(...) && (pragma_clang(bss, my_section) || pragma_clang(data, my_data));"
     llvm::StringRef testInput8 = "call_pointcut myPointcut = func(...) && (pragma_clang(bss, my_section) || pragma_clang(data, my_data));";
     Lexer lexer8(testInput8);
-    lexer8.updateDeclarationEnd();
     ASSERT_EQ(lexer8.next().kind, TOK_CALL_POINTCUT);
     ASSERT_EQ(lexer8.next().kind, TOK_IDENTIFIER);
     ASSERT_EQ(lexer8.next().kind, TOK_EQUAL);
@@ -152,86 +174,1396 @@ void runLexerTests() {
     ASSERT_EQ(lexer8.next().kind, TOK_RPAREN);
     ASSERT_EQ(lexer8.next().kind, TOK_SEMICOLON);
     ASSERT_EQ(lexer8.next().kind, TOK_EOF);
+
+    // Long whitespace runs, comments ending at '\n' or '\r', a stray character
+    std::string testInput9 = std::string(37, ' ') + "# comment ( ;\n" + std::string(20, '\t') +
+                             "run_pointcut# tail\rn::f_2 = \"lit\" 42 \n\r\n  \t  &x";
+    Lexer lexer9(testInput9);
+    ASSERT_EQ(lexer9.next().kind, TOK_RUN_POINTCUT);
+    Token name9 = lexer9.next();
+    ASSERT_EQ(name9.kind, TOK_IDENTIFIER);
+    ASSERT_EQ(name9.text, "n::f_2");
+    ASSERT_EQ(lexer9.next().kind, TOK_EQUAL);
+    Token literal9 = lexer9.next();
+    ASSERT_EQ(literal9.kind, TOK_STRING_LITERAL);
+    ASSERT_EQ(literal9.text, "\"lit\"");
+    ASSERT_EQ(lexer9.next().text, "42");
+    Token stray9 = lexer9.next();
+    ASSERT_EQ(stray9.kind, TOK_UNKNOWN);
+    ASSERT_EQ(stray9.text, "&");
+    ASSERT_EQ(lexer9.next().text, "x");
+    ASSERT_EQ(lexer9.next().kind, TOK_EOF);
+
+    // An unterminated literal or comment runs to the end of the text
+    Lexer lexer10("\"open");
+    ASSERT_EQ(lexer10.next().text, "\"open");
+    ASSERT_EQ(lexer10.next().kind, TOK_EOF);
+    Lexer lexer11("func # no newline");
+    ASSERT_EQ(lexer11.next().kind, TOK_FUNC);
+    ASSERT_EQ(lexer11.next().kind, TOK_EOF);
 }
 void runParserTests() {
     // run_pointcut myPointcut = call(myFunction);
     llvm::StringRef testInput1 = "run_pointcut myPointcut = func(myFunction);";
     Lexer lexer1(testInput1);
-    Parser parser1(lexer1);
+    Parser parser1(lexer1, TestContext);
     auto ast1 = parser1.parsePointcutList();
     ASSERT_EQ(ast1.size(), 1);
-    auto *pointcut1 = dynamic_cast<PointcutDeclaration *>(ast1[0].get());
+    auto *pointcut1 = llvm::dyn_cast<PointcutDeclaration>(ast1[0]);
     ASSERT_NOT_NULL(pointcut1);
     ASSERT_EQ(pointcut1->isExported, true);
     ASSERT_EQ(pointcut1->name, "myPointcut");
-    auto *callExpr1 = dynamic_cast<FuncExpression *>(pointcut1->expression.get());
+    auto *callExpr1 = llvm::dyn_cast<FuncExpression>(pointcut1->expression);
     ASSERT_NOT_NULL(callExpr1);
     ASSERT_EQ(callExpr1->id, "myFunction");
 
     //myOtherPointcut = run(otherFunction);
     llvm::StringRef testInput2 = "myOtherPointcut = func(otherFunction);";
     Lexer lexer2(testInput2);
-    Parser parser2(lexer2);
+    Parser parser2(lexer2, TestContext);
     auto ast2 = parser2.parsePointcutList();
     ASSERT_EQ(ast2.size(), 1);
-    auto *pointcut2 = dynamic_cast<PointcutDeclaration *>(ast2[0].get());
+    auto *pointcut2 = llvm::dyn_cast<PointcutDeclaration>(ast2[0]);
     ASSERT_NOT_NULL(pointcut2);
     ASSERT_EQ(pointcut2->isExported, false);
     ASSERT_EQ(pointcut2->name, "myOtherPointcut");
-    auto *runExpr2 = dynamic_cast<FuncExpression *>(pointcut2->expression.get());
+    auto *runExpr2 = llvm::dyn_cast<FuncExpression>(pointcut2->expression);
     ASSERT_NOT_NULL(runExpr2);
     ASSERT_EQ(runExpr2->id, "otherFunction");
 
     // call_pointcut myPointcut = call(...);
     llvm::StringRef testInput3 = "call_pointcut myPointcut = func(...);";
     Lexer lexer3(testInput3);
-    Parser parser3(lexer3);
+    Parser parser3(lexer3, TestContext);
     auto ast3 = parser3.parsePointcutList();
     ASSERT_EQ(ast3.size(), 1);
-    auto *pointcut3 = dynamic_cast<PointcutDeclaration *>(ast3[0].get());
+    auto *pointcut3 = llvm::dyn_cast<PointcutDeclaration>(ast3[0]);
     ASSERT_NOT_NULL(pointcut3);
     ASSERT_EQ(pointcut3->isExported, true);
     ASSERT_EQ(pointcut3->name, "myPointcut");
-    auto *callExpr3 = dynamic_cast<FuncExpression *>(pointcut3->expression.get());
+    auto *callExpr3 = llvm::dyn_cast<FuncExpression>(pointcut3->expression);
     ASSERT_NOT_NULL(callExpr3);
     ASSERT_EQ(callExpr3->id, "...");
 
     // call_pointcut myPointcut = func(...) && (pragma_clang(bss, my_section) || pragma_clang(data, my_data));
     llvm::StringRef testInput4 = "run_pointcut myPointcut = func(...) && (pragma_clang(bss, my_section) || pragma_clang(data, my_data));";
     Lexer lexer4(testInput4);
-    Parser parser4(lexer4);
+    Parser parser4(lexer4, TestContext);
     auto ast4 = parser4.parsePointcutList();
     ASSERT_EQ(ast4.size(), 1);
-    auto *pointcut4 = dynamic_cast<PointcutDeclaration *>(ast4[0].get());
+    auto *pointcut4 = llvm::dyn_cast<PointcutDeclaration>(ast4[0]);
     ASSERT_NOT_NULL(pointcut4);
     ASSERT_EQ(pointcut4->isExported, true);
     ASSERT_EQ(pointcut4->name, "myPointcut");
     ASSERT_EQ(pointcut4->matchKind, MATCH_RUN);
-    auto *andExpr4 = dynamic_cast<AndExpression *>(pointcut4->expression.get());
+    auto *andExpr4 = llvm::dyn_cast<AndExpression>(pointcut4->expression);
     ASSERT_NOT_NULL(andExpr4);
-    auto *runExpr4 = dynamic_cast<FuncExpression *>(andExpr4->left.get());
+    auto *runExpr4 = llvm::dyn_cast<FuncExpression>(andExpr4->left);
     ASSERT_NOT_NULL(runExpr4);
     ASSERT_EQ(runExpr4->id, "...");
-    auto *parExpr4 = dynamic_cast<ParenthesizedExpression *>(andExpr4->right.get());
+    auto *parExpr4 = llvm::dyn_cast<ParenthesizedExpression>(andExpr4->right);
     ASSERT_NOT_NULL(parExpr4);
-    auto *orExpr4 = dynamic_cast<OrExpression *>(parExpr4->expr.get());
+    auto *orExpr4 = llvm::dyn_cast<OrExpression>(parExpr4->expr);
     ASSERT_NOT_NULL(orExpr4);
-    auto *pragma1 = dynamic_cast<PragmaClangExprNode *>(orExpr4->left.get());
+    auto *pragma1 = llvm::dyn_cast<PragmaClangExprNode>(orExpr4->left);
     ASSERT_NOT_NULL(pragma1);
     ASSERT_EQ(pragma1->pragmaKind.kind, TOK_BSS);
     ASSERT_EQ(pragma1->sectionName, "my_section");
-    auto *pragma2 = dynamic_cast<PragmaClangExprNode *>(orExpr4->right.get());
+    auto *pragma2 = llvm::dyn_cast<PragmaClangExprNode>(orExpr4->right);
     ASSERT_NOT_NULL(pragma2);
     ASSERT_EQ(pragma2->pragmaKind.kind, TOK_DATA);
     ASSERT_EQ(pragma2->sectionName, "my_data");
-    
 
+    // Syntax errors are reported to the caller, the process goes on
+    for (StringRef bad : {"run_pointcut a = func(f)", "run_pointcut a = ;", "run_pointcut = func(f);",
+                          "run_pointcut a = func(f) && b;", "run_pointcut a = pragma_clang(heap, x);"}) {
+        Lexer badLexer(bad);
+        Parser badParser(badLexer, TestContext);
+        ASSERT(badParser.parsePointcutList().empty());
+        ASSERT(badParser.hasError());
+    }
+    Lexer unknownLexer("run_pointcut a = func(f);\nrun_pointcut b = func(g) && c;");
+    Parser unknownParser(unknownLexer, TestContext);
+    ASSERT(unknownParser.parsePointcutList().empty());
+    ASSERT(StringRef(unknownParser.getError()).contains("Unknown pointcut c"));
+}
+
+void runArenaTests() {
+    PointcutContext context;
+    std::vector<PointcutDeclaration*> pointcuts;
+    {
+        // The AST outlives the text it was parsed from
+        std::string text = "run_pointcut a = func(f) && !annotation(w);\n"
+                           "call_pointcut b = func(f) || annotation(w);\n";
+        Lexer lexer(text);
+        Parser parser(lexer, context);
+        pointcuts = parser.parsePointcutList();
+        text.assign(text.size(), '#');
+    }
+    ASSERT_EQ(pointcuts.size(), 2u);
+    ASSERT_EQ(pointcuts[0]->name, "a");
+    ASSERT_GT(context.getBytesAllocated(), 0u);
+
+    auto *andExpr = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(andExpr);
+    ASSERT(llvm::isa<PairExpression>(andExpr));
+    ASSERT(!llvm::isa<OrExpression>(andExpr));
+    auto *notExpr = llvm::dyn_cast<NotExpression>(andExpr->right);
+    ASSERT_NOT_NULL(notExpr);
+    ASSERT(llvm::isa<Expression>(notExpr));
+    auto *orExpr = llvm::dyn_cast<OrExpression>(pointcuts[1]->expression);
+    ASSERT_NOT_NULL(orExpr);
+
+    // Equal identifiers share one interned copy
+    auto *func1 = llvm::cast<FuncExpression>(andExpr->left);
+    auto *func2 = llvm::cast<FuncExpression>(orExpr->left);
+    ASSERT_EQ(func1->id, "f");
+    ASSERT(func1->id.data() == func2->id.data());
+    auto *annotation1 = llvm::cast<IdExpression>(notExpr->expr);
+    auto *annotation2 = llvm::cast<IdExpression>(orExpr->right);
+    ASSERT(annotation1->id.data() == annotation2->id.data());
+    ASSERT(context.intern("w").data() == annotation1->id.data());
+}
+
+void runPointcutIndexTests() {
+    llvm::StringRef text =
+        "run_pointcut byAnnotation = annotation(wrap);\n"
+        "run_pointcut bySection = pragma_clang(text, hot) || func(start);\n"
+        "run_pointcut both = annotation(trace) && (func(stop) || func(ns::halt));\n"
+        "run_pointcut notWrapped = !annotation(wrap) && func(stop);\n"
+        "run_pointcut anything = !annotation(never);\n";
+    Lexer lexer(text);
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 5u);
+
+    PointcutIndex index;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        index.add(i, pointcuts[i]->expression);
+    }
+    ASSERT_EQ(index.needsQualifiedName(), true);
+
+    FunctionFacts facts;
+    facts.name = "helper";
+    facts.qualifiedName = "helper";
+    SmallVector<u32, 8> ids;
+    // only the unindexable pointcut is a candidate
+    index.candidates(facts, ids);
+    ASSERT_EQ(ids.size(), 1u);
+    ASSERT_EQ(ids[0], 4u);
+    ASSERT_EQ(*index.firstMatch(facts), 4u);
+
+    facts.annotations.push_back("wrap");
+    ASSERT_EQ(*index.firstMatch(facts), 0u);
+
+    facts.clear();
+    facts.name = "run";
+    facts.qualifiedName = "run";
+    facts.setSection(FACT_SECTION_TEXT, "hot");
+    facts.setSection(FACT_SECTION_TEXT, "cold"); // first section attribute wins
+    ASSERT_EQ(facts.section(FACT_SECTION_TEXT), "hot");
+    ASSERT_EQ(*index.firstMatch(facts), 1u);
+
+    // And is filed under its annotation side, then evaluated in full
+    facts.clear();
+    facts.name = "halt";
+    facts.qualifiedName = "app::ns::halt";
+    facts.annotations.push_back("trace");
+    index.candidates(facts, ids);
+    ASSERT_EQ(ids.size(), 2u);
+    ASSERT_EQ(ids[0], 2u);
+    ASSERT_EQ(*index.firstMatch(facts), 2u);
+    facts.qualifiedName = "app::xns::halt";
+    ASSERT_EQ(*index.firstMatch(facts), 4u);
+
+    facts.clear();
+    facts.name = "stop";
+    facts.qualifiedName = "stop";
+    ASSERT_EQ(*index.firstMatch(facts), 3u);
+    facts.annotations.push_back("never");
+    facts.annotations.push_back("wrap");
+    ASSERT_EQ(*index.firstMatch(facts), 0u);
+    facts.annotations.pop_back();
+    ASSERT_EQ(*index.firstMatch(facts), 3u);
+    facts.name = "other";
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+
+    ASSERT_EQ(matchesFunctionName("b::f", facts), false);
+    facts.qualifiedName = "a::b::f";
+    facts.name = "f";
+    ASSERT_EQ(matchesFunctionName("b::f", facts), true);
+    ASSERT_EQ(matchesFunctionName("::a::b::f", facts), true);
+    ASSERT_EQ(matchesFunctionName("::b::f", facts), false);
+    ASSERT_EQ(matchesFunctionName("ab::f", facts), false);
+}
+
+ASTNode *parseExpressionForTest(llvm::StringRef text) {
+    Lexer lexer(text);
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 1u);
+    return pointcuts[0]->expression;
+}
+
+void runOptimizerTests() {
+    struct Case {
+        const char *text;
+        const char *optimized;
+    };
+    const Case cases[] = {
+        // parentheses dropped, chains flattened, name compare moved first
+        {"p = annotation(a) && (func(f) && annotation(b));",
+         "&(&(func(f),annotation(a)),annotation(b))"},
+        // duplicates and double negation removed
+        {"p = annotation(a) || !!annotation(a) || (annotation(a));", "annotation(a)"},
+        {"p = !!(func(f) && func(g)) && func(h);", "&(&(func(f),func(g)),func(h))"},
+        // contradictions and tautologies fold
+        {"p = func(f) && annotation(a) && !annotation(a);", "false"},
+        {"p = !(func(f) || !func(f));", "false"},
+        {"p = annotation(a) || func(f) || !func(f);", "true"},
+        {"p = !(annotation(a) && !annotation(a)) && func(f);", "func(f)"},
+        // qualified names cost more than plain names, less than attributes
+        {"p = pragma_clang(text, hot) || func(a::f) || func(g);",
+         "|(|(func(g),func(a::f)),pragma(text,hot))"},
+    };
+    for (const Case &c : cases) {
+        ASTNode *optimized = optimizePointcut(parseExpressionForTest(c.text), TestContext);
+        ASSERT_EQ(pointcutKey(optimized), c.optimized);
+    }
+
+    // Same matches before and after over every combination of facts
+    const char *equivalence[] = {
+        "p = (annotation(a) || func(f)) && !(annotation(b) && !!func(g)) && (annotation(a) || func(f));",
+        "p = !(!annotation(a) || !pragma_clang(text, hot)) || (func(f) && !func(f)) || annotation(b);",
+        "p = ((func(f))) && (annotation(a) || annotation(b) || annotation(a)) && !!!func(g);",
+    };
+    for (const char *text : equivalence) {
+        ASTNode *original = parseExpressionForTest(text);
+        ASTNode *optimized = optimizePointcut(parseExpressionForTest(text), TestContext);
+        for (u32 bits = 0; bits < 32; ++bits) {
+            FunctionFacts facts;
+            facts.name = (bits & 1) ? "f" : ((bits & 2) ? "g" : "h");
+            if (bits & 4) facts.annotations.push_back("a");
+            if (bits & 8) facts.annotations.push_back("b");
+            if (bits & 16) facts.setSection(FACT_SECTION_TEXT, "hot");
+            ASSERT_EQ(evaluatePointcut(original, facts), evaluatePointcut(optimized, facts));
+        }
+    }
+}
+
+void runProgramTests() {
+    // a && b && c: both jumps go straight to the end
+    PointcutProgram chain;
+    ASTNode *chainExpr = parseExpressionForTest("p = func(a) && func(b) && func(c);");
+    u32 chainEntry = *chain.compile(chainExpr);
+    ASSERT_EQ(chainEntry, 0u);
+    ArrayRef<PointcutOp> ops = chain.getOps();
+    ASSERT_EQ(ops.size(), 6u);
+    ASSERT_EQ(ops[1].code, OP_JUMP_IF_FALSE);
+    ASSERT_EQ(ops[1].operand, 5u);
+    ASSERT_EQ(ops[3].code, OP_JUMP_IF_FALSE);
+    ASSERT_EQ(ops[3].operand, 5u);
+    ASSERT_EQ(ops[5].code, OP_RETURN);
+
+    // Strings are shared across pointcuts of one program
+    ASTNode *again = parseExpressionForTest("q = func(c) || annotation(a);");
+    u32 againEntry = *chain.compile(again);
+    ASSERT_EQ(againEntry, 6u);
+    ASSERT_EQ(chain.getStrings().size(), 3u);
+
+    // Same results as walking the tree, optimized or not
+    const char *texts[] = {
+        "p = (annotation(a) || func(f)) && !(annotation(b) && !!func(g)) && (annotation(a) || func(f));",
+        "p = !(!annotation(a) || !pragma_clang(text, hot)) || (func(f) && !func(f)) || annotation(b);",
+        "p = ((func(f) || func(g)) && (annotation(a) || pragma_clang(text, hot))) || !func(h);",
+        "p = func(x::f) || annotation_analysis(b);",
+    };
+    PointcutProgram program;
+    std::vector<ASTNode*> expressions;
+    std::vector<u32> entries;
+    for (const char *text : texts) {
+        expressions.push_back(parseExpressionForTest(text));
+        entries.push_back(*program.compile(expressions.back()));
+        expressions.push_back(optimizePointcut(parseExpressionForTest(text), TestContext));
+        entries.push_back(*program.compile(expressions.back()));
+    }
+    for (u32 bits = 0; bits < 64; ++bits) {
+        FunctionFacts facts;
+        facts.name = (bits & 1) ? "f" : ((bits & 2) ? "g" : "h");
+        facts.qualifiedName = (bits & 32) ? "x::f" : "y::f";
+        if (bits & 4) facts.annotations.push_back("a");
+        if (bits & 8) facts.annotations.push_back("b");
+        if (bits & 8) facts.typeAnnotations.push_back("b");
+        if (bits & 16) facts.setSection(FACT_SECTION_TEXT, "hot");
+        for (usize i = 0; i < expressions.size(); ++i) {
+            ASSERT_EQ(program.run(entries[i], facts), evaluatePointcut(expressions[i], facts));
+        }
+    }
+}
+
+void runCodegenTests() {
+    Lexer lexer("run_pointcut a = func(f) || func(g) || annotation(w);\n"
+                "call_pointcut b = func(x::f) && !pragma_clang(text, hot);\n"
+                "run_pointcut c = annotation(w);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    std::string code;
+    llvm::raw_string_ostream OS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", OS);
+    StringRef text(code);
+
+    // Names become one switch; strings are interned once across pointcuts
+    ASSERT(text.contains("switch (f.name)"));
+    ASSERT(text.contains("{\"w\", S_2}"));
+    ASSERT(!text.contains("S_4"));
+    ASSERT(text.contains("matchesFunctionName(\"x::f\", f.facts)"));
+    ASSERT(text.contains("!(f.section(FACT_SECTION_TEXT) == S_3)"));
+    // Positions are per match kind, in file order
+    ASSERT(text.contains("if (match2(f)) {\n            return 1;"));
+    ASSERT(text.contains("{\"b\", MATCH_CALL}"));
+    ASSERT(text.contains("ArrayRef<CompiledPointcut>(Pointcuts, 3),\n        true,"));
+}
+
+void runImageTests() {
+    const char *text =
+        "run_pointcut a = (func(f) || annotation(w)) && !pragma_clang(text, hot);\n"
+        "call_pointcut b = func(x::f) || annotation_analysis(w);\n"
+        "c = func(g) && !func(g);\n";
+    Lexer lexer(text);
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    PointcutImageBuilder builder;
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        pointcut->expression = optimizePointcut(pointcut->expression, TestContext);
+        builder.addPointcut(*pointcut);
+    }
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    u64 hash = hashPointcutText(text);
+    builder.write(OS, hash);
+
+    // Round trip; strings are shared ("w") and the tree is stored children first
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), hash);
+    ASSERT(image.has_value());
+    ASSERT_EQ(image->getPointcuts().size(), 3u);
+    ASSERT_EQ(image->getString(image->getPointcuts()[1].name), "b");
+    ASSERT_EQ(image->getPointcuts()[1].matchKind, u8(MATCH_CALL));
+    ASSERT_EQ(image->getPointcuts()[2].matchKind, u8(MATCH_NONE));
+    ASSERT_EQ(image->getNode(image->getPointcuts()[2].root).kind, IMAGE_CONST);
+    for (u32 i = 0; i < image->getNodes().size(); ++i) {
+        const ImageNode &node = image->getNode(i);
+        if (node.kind == IMAGE_AND || node.kind == IMAGE_OR) {
+            ASSERT_LT(node.b, i);
+        }
+    }
+
+    // Another text, a truncated file or a wrong version are rejected
+    ASSERT(!PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), hash + 1));
+    ASSERT(!PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size() - 1), hash));
+    SmallVector<char, 0> damaged(bytes);
+    damaged[4] ^= 1;
+    ASSERT(!PointcutImage::fromBytes(StringRef(damaged.data(), damaged.size()), hash));
+
+    // Programs compiled from the image match the AST
+    for (u32 i = 0; i < 3; ++i) {
+        PointcutProgram program;
+        u32 entry = *program.compile(*image, image->getPointcuts()[i].root);
+        for (u32 bits = 0; bits < 16; ++bits) {
+            FunctionFacts facts;
+            facts.name = (bits & 1) ? "f" : "g";
+            facts.qualifiedName = (bits & 2) ? "x::f" : "y::f";
+            if (bits & 4) facts.annotations.push_back("w");
+            if (bits & 4) facts.typeAnnotations.push_back("w");
+            if (bits & 8) facts.setSection(FACT_SECTION_TEXT, "hot");
+            ASSERT_EQ(program.run(entry, facts), evaluatePointcut(pointcuts[i]->expression, facts));
+        }
+    }
+
+    // The second load of the same text is served from the cache
+    SmallString<128> dir;
+    ASSERT(!llvm::sys::fs::createUniqueDirectory("pointcut-cache", dir));
+    {
+        PointcutCache first;
+        first.load("unused.pc", text, dir);
+        ASSERT(!first.hit());
+        PointcutCache second;
+        const PointcutImage &cached = second.load("unused.pc", text, dir);
+        ASSERT(second.hit());
+        ASSERT_EQ(cached.getPointcuts().size(), 3u);
+        ASSERT_EQ(cached.getString(cached.getPointcuts()[0].name), "a");
+        PointcutCache changed;
+        changed.load("unused.pc", "run_pointcut a = func(f);", dir);
+        ASSERT(!changed.hit());
+        ASSERT_EQ(changed.getImage().getPointcuts().size(), 1u);
+        // A syntax error leaves an empty image and nothing in the cache
+        PointcutCache broken;
+        ASSERT(broken.load("unused.pc", "run_pointcut a = func(;", dir).getPointcuts().empty());
+        ASSERT(broken.hasError());
+        PointcutCache again;
+        again.load("unused.pc", "run_pointcut a = func(;", dir);
+        ASSERT(!again.hit());
+        ASSERT(again.hasError());
+    }
+    llvm::sys::fs::remove_directories(dir);
+}
+
+void runWithinTests() {
+    // The trie finds exactly the patterns the reference matcher accepts
+    const char *patterns[] = {
+        "net/*.cpp", "/src/**", "src/**/impl/*.h", "**/test_?.cpp",
+        "a.cpp", "src/[a-c]*/x.cpp", "/src/net/io.cpp", "src/**/**/x.cpp",
+    };
+    const char *paths[] = {
+        "src/net/io.cpp", "/src/net/io.cpp", "/home/me/src/net/a.cpp",
+        "src/core/impl/x.h", "src/impl/x.h", "./test_1.cpp", "test_12.cpp",
+        "src/b/x.cpp", "src/d/x.cpp", "src/x.cpp", "C:\\src\\net\\io.cpp", "",
+    };
+    PathTrie trie;
+    for (const char *pattern : patterns) {
+        ASSERT(isValidPathPattern(pattern));
+        trie.add(pattern);
+    }
+    ASSERT_EQ(trie.add("a.cpp"), 4u);
+    ASSERT_EQ(trie.size(), 8u);
+    llvm::BitVector matches;
+    for (const char *path : paths) {
+        trie.match(path, matches);
+        for (u32 i = 0; i < trie.size(); ++i) {
+            ASSERT_EQ(matches.test(i), matchesPathPattern(patterns[i], path));
+        }
+    }
+    ASSERT_EQ(matchesPathPattern("net/*.cpp", "/home/me/src/net/a.cpp"), true);
+    ASSERT_EQ(matchesPathPattern("/src/**", "/home/src/a.cpp"), false);
+    ASSERT_EQ(matchesPathPattern("src/**/impl/*.h", "src/impl/x.h"), true);
+    ASSERT(!isValidPathPattern(""));
+    ASSERT(!isValidPathPattern("src/[a-"));
+
+    Lexer lexer("run_pointcut a = within(\"src/**/*.cpp\") && func(f);\n"
+                "run_pointcut b = within(namespace ::app::net) || within(namespace db);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 2u);
+    auto *andExpr = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(andExpr);
+    auto *file = llvm::dyn_cast<WithinFileExpression>(andExpr->left);
+    ASSERT_NOT_NULL(file);
+    ASSERT_EQ(file->id, "src/**/*.cpp");
+    auto *orExpr = llvm::dyn_cast<OrExpression>(pointcuts[1]->expression);
+    ASSERT_NOT_NULL(orExpr);
+    auto *ns = llvm::dyn_cast<WithinNamespaceExpression>(orExpr->left);
+    ASSERT_NOT_NULL(ns);
+    ASSERT_EQ(ns->id, "app::net");
+    // Scope tests are cheap: after the name compare, before attributes
+    ASSERT_EQ(pointcutKey(optimizePointcut(parseExpressionForTest(
+                  "p = annotation(w) && within(namespace a) && func(f);"), TestContext)),
+              "&(&(func(f),within(namespace a)),annotation(w))");
+
+    PointcutIndex index;
+    index.add(0, pointcuts[0]->expression);
+    index.add(1, pointcuts[1]->expression);
+    ASSERT(index.needsScope());
+    ASSERT(index.isScoped());
+    ASSERT(index.fileInScope("/work/src/a/b.cpp"));
+    ASSERT(!index.fileInScope("/work/src/a/b.h"));
+    ASSERT(index.namespaceInScope("app::net::detail"));
+    ASSERT(!index.namespaceInScope("app::network"));
+    // Any namespace may hold a function of a file in scope
+    ASSERT(index.mayEnterNamespace("ui"));
+    PointcutIndex namespaceOnly;
+    namespaceOnly.add(0, pointcuts[1]->expression);
+    ASSERT(namespaceOnly.mayEnterNamespace("app"));
+    ASSERT(namespaceOnly.mayEnterNamespace("app::net::io"));
+    ASSERT(namespaceOnly.mayEnterNamespace("db"));
+    ASSERT(!namespaceOnly.mayEnterNamespace("ui"));
+    ASSERT(!namespaceOnly.mayEnterNamespace("app::network"));
+
+    FunctionFacts facts;
+    facts.name = "f";
+    facts.file = "/work/src/main.cpp";
+    ASSERT_EQ(*index.firstMatch(facts), 0u);
+    facts.name = "g";
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+    facts.namespaceName = "db";
+    ASSERT_EQ(*index.firstMatch(facts), 1u);
+    facts.namespaceName = "dbx";
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+
+    // A pointcut with a way out of every scope leaves nothing to prune
+    PointcutIndex open;
+    open.add(0, parseExpressionForTest("p = within(namespace a) || annotation(w);"));
+    ASSERT(!open.isScoped());
+    PointcutIndex narrowed;
+    narrowed.add(0, parseExpressionForTest("p = !within(namespace a) && within(\"*.h\");"));
+    ASSERT(narrowed.isScoped());
+    ASSERT(narrowed.mayEnterNamespace("a"));
+
+    // Programs, built from the AST or from an image, agree with the tree
+    const char *texts[] = {
+        "p = within(\"src/**/*.cpp\") && !within(namespace app::net);",
+        "p = (within(namespace app) || within(\"/usr/include/**\")) && func(f);",
+        "p = !within(\"*_test.cpp\") || within(namespace app::net) || annotation(w);",
+    };
+    PointcutImageBuilder builder;
+    std::vector<ASTNode*> expressions;
+    for (const char *text : texts) {
+        PointcutDeclaration declaration(true, "p", MATCH_RUN,
+                                        optimizePointcut(parseExpressionForTest(text), TestContext));
+        builder.addPointcut(declaration);
+        expressions.push_back(parseExpressionForTest(text));
+    }
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 1);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 1);
+    ASSERT(image.has_value());
+
+    const char *files[] = {"/work/src/a.cpp", "src/net/x_test.cpp", "/usr/include/c.h", ""};
+    const char *namespaces[] = {"", "app", "app::net", "app::net::io", "appx"};
+    for (usize i = 0; i < std::size(texts); ++i) {
+        PointcutProgram fromTree;
+        u32 treeEntry = *fromTree.compile(expressions[i]);
+        PointcutProgram fromImage;
+        u32 imageEntry = *fromImage.compile(*image, image->getPointcuts()[i].root);
+        for (const char *path : files) {
+            for (const char *name : namespaces) {
+                for (u32 bits = 0; bits < 4; ++bits) {
+                    FunctionFacts facts;
+                    facts.name = (bits & 1) ? "f" : "g";
+                    if (bits & 2) facts.annotations.push_back("w");
+                    facts.file = path;
+                    facts.namespaceName = name;
+                    bool expected = evaluatePointcut(expressions[i], facts);
+                    ASSERT_EQ(fromTree.run(treeEntry, facts), expected);
+                    ASSERT_EQ(fromImage.run(imageEntry, facts), expected);
+                }
+            }
+        }
+    }
+}
+
+void runNamePatternTests() {
+    Lexer lexer("func(app::*::get?ow)");
+    ASSERT_EQ(lexer.next().kind, TOK_FUNC);
+    ASSERT_EQ(lexer.next().kind, TOK_LPAREN);
+    Token pattern = lexer.next();
+    ASSERT_EQ(pattern.kind, TOK_IDENTIFIER);
+    ASSERT_EQ(pattern.text, "app::*::get?ow");
+    ASSERT_EQ(lexer.next().kind, TOK_RPAREN);
+
+    FunctionFacts facts;
+    facts.name = "getRow";
+    facts.qualifiedName = "app::db::getRow";
+    ASSERT_EQ(matchesFunctionName("app::*::get*", facts), true);
+    ASSERT_EQ(matchesFunctionName("::app::*::get*", facts), true);
+    ASSERT_EQ(matchesFunctionName("app::get*", facts), false);
+    ASSERT_EQ(matchesFunctionName("app::**::get*", facts), true);
+    ASSERT_EQ(matchesFunctionName("**::getRow", facts), true);
+    ASSERT_EQ(matchesFunctionName("get*", facts), true);
+    ASSERT_EQ(matchesFunctionName("::get*", facts), false);
+    facts.qualifiedName = "v2::app::db::getRow";
+    ASSERT_EQ(matchesFunctionName("app::*::get*", facts), true);
+    ASSERT_EQ(matchesFunctionName("::app::*::get*", facts), false);
+
+    // The trie over qualified names agrees with the reference
+    const char *patterns[] = {
+        "app::*::get*", "::app::**", "**::serialize", "*::?et", "::f", "app::**::impl::*",
+    };
+    const char *names[] = {
+        "app::db::getRow", "app::serialize", "x::app::db::get", "f", "g::f",
+        "app::a::b::impl::run", "app::impl::run", "net::set", "app",
+    };
+    PathTrie trie(PATH_QUALIFIED_NAME);
+    for (const char *text : patterns) {
+        ASSERT(isValidPathPattern(text, PATH_QUALIFIED_NAME));
+        trie.add(text);
+    }
+    PathTrie copy(trie);
+    llvm::BitVector matches;
+    llvm::BitVector copyMatches;
+    for (const char *name : names) {
+        trie.match(name, matches);
+        copy.match(name, copyMatches);
+        ASSERT(matches == copyMatches);
+        for (u32 i = 0; i < trie.size(); ++i) {
+            ASSERT_EQ(matches.test(i), matchesPathPattern(patterns[i], name, PATH_QUALIFIED_NAME));
+        }
+    }
+
+    // Many globs: a function's candidates are only the pointcuts whose glob
+    // matches, found by one walk of the trie
+    std::string text;
+    for (u32 i = 0; i < 300; ++i) {
+        text += "run_pointcut p" + std::to_string(i) + " = func(m" + std::to_string(i) +
+                "::*::get*) && !annotation(skip);\n";
+    }
+    text += "run_pointcut s = func(**::serialize);\n";
+    text += "run_pointcut t = func(app::*::?et) || annotation(t);\n";
+    Lexer manyLexer(text);
+    Parser manyParser(manyLexer, TestContext);
+    auto pointcuts = manyParser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 302u);
+    PointcutIndex index;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        ASSERT(index.add(i, pointcuts[i]->expression));
+    }
+    ASSERT(index.needsQualifiedName());
+    SmallVector<u32, 8> ids;
+    facts.clear();
+    facts.name = "getX";
+    facts.qualifiedName = "m17::io::getX";
+    index.candidates(facts, ids);
+    ASSERT_EQ(ids.size(), 1u);
+    ASSERT_EQ(ids[0], 17u);
+    ASSERT_EQ(*index.firstMatch(facts), 17u);
+    facts.annotations.push_back("skip");
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+    // Filed under its plain last component
+    facts.clear();
+    facts.name = "serialize";
+    facts.qualifiedName = "m3::serialize";
+    index.candidates(facts, ids);
+    ASSERT_EQ(ids.size(), 1u);
+    ASSERT_EQ(*index.firstMatch(facts), 300u);
+
+    // Index, program and tree agree
+    const char *qualifiedNames[] = {"m1::a::getX", "m1::getX", "app::x::set", "app::x::y::get", "m299::q::get"};
+    const char *plainNames[] = {"getX", "getX", "set", "get", "get"};
+    for (usize n = 0; n < std::size(qualifiedNames); ++n) {
+        for (u32 bits = 0; bits < 4; ++bits) {
+            facts.clear();
+            facts.name = plainNames[n];
+            facts.qualifiedName = qualifiedNames[n];
+            if (bits & 1) facts.annotations.push_back("skip");
+            if (bits & 2) facts.annotations.push_back("t");
+            std::optional<u32> expected;
+            for (u32 i = 0; i < pointcuts.size() && !expected; ++i) {
+                if (evaluatePointcut(pointcuts[i]->expression, facts)) {
+                    expected = i;
+                }
+            }
+            ASSERT(index.firstMatch(facts) == expected);
+        }
+    }
+
+    PointcutProgram program;
+    u32 entry = *program.compile(parseExpressionForTest("p = func(a::*) || func(b::f);"));
+    ASSERT_EQ(program.getOps()[entry].code, OP_NAME_PATTERN);
+    ASSERT_EQ(program.getNamePatterns().size(), 1u);
+
+    Lexer codegenLexer("run_pointcut a = func(app::*::get*) || func(f) || func(g);\n"
+                       "run_pointcut b = func(**::serialize) && !func(app::*::get*);\n");
+    Parser codegenParser(codegenLexer, TestContext);
+    std::string code;
+    llvm::raw_string_ostream OS(code);
+    emitCompiledPointcuts(codegenParser.parsePointcutList(), "test.pc", OS);
+    StringRef generated(code);
+    ASSERT(generated.contains("trie.add(\"app::*::get*\");"));
+    ASSERT(generated.contains("!(f.namePattern(P_0))"));
+    ASSERT(generated.contains("f.namePattern(P_1)"));
+    ASSERT(!generated.contains("P_2"));
+    ASSERT(generated.contains("switch (f.name)"));
+}
+
+void runSignatureTests() {
+    ASSERT_EQ(normalizeTypeText(" const  Request & "), "const Request&");
+    ASSERT_EQ(normalizeTypeText("std::map<int, std::string> const *"), "std::map<int,std::string>const*");
+    ASSERT_EQ(normalizeTypeText("unsigned long long"), "unsigned long long");
+
+    Lexer lexer("run_pointcut a = const && returns(std::string) && param_count(0);\n"
+                "run_pointcut b = params(.., const Request &) && !static;\n"
+                "run_pointcut c = params(std::map<int, std::string>, void (*)(int, char)) || virtual;\n"
+                "run_pointcut d = params() && volatile;\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 4u);
+    auto *outer = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(outer);
+    auto *inner = llvm::dyn_cast<AndExpression>(outer->left);
+    ASSERT_NOT_NULL(inner);
+    auto *qualifier = llvm::dyn_cast<QualifierExpression>(inner->left);
+    ASSERT_NOT_NULL(qualifier);
+    ASSERT_EQ(qualifier->qualifier, TOK_CONST);
+    auto *returns = llvm::dyn_cast<ReturnsExpression>(inner->right);
+    ASSERT_NOT_NULL(returns);
+    ASSERT_EQ(returns->id, "std::string");
+    auto *count = llvm::dyn_cast<ParamCountExpression>(outer->right);
+    ASSERT_NOT_NULL(count);
+    ASSERT_EQ(count->count, 0u);
+    auto *params = llvm::dyn_cast<ParamsExpression>(llvm::cast<AndExpression>(pointcuts[1]->expression)->left);
+    ASSERT_NOT_NULL(params);
+    ASSERT_EQ(params->types.size(), 2u);
+    ASSERT_EQ(params->types[0], "..");
+    ASSERT_EQ(params->types[1], "const Request&");
+    // Commas and parentheses nested in a type do not end it
+    params = llvm::dyn_cast<ParamsExpression>(llvm::cast<OrExpression>(pointcuts[2]->expression)->left);
+    ASSERT_NOT_NULL(params);
+    ASSERT_EQ(params->types.size(), 2u);
+    ASSERT_EQ(params->types[0], "std::map<int,std::string>");
+    ASSERT_EQ(params->types[1], "void(*)(int,char)");
+    params = llvm::dyn_cast<ParamsExpression>(llvm::cast<AndExpression>(pointcuts[3]->expression)->left);
+    ASSERT_NOT_NULL(params);
+    ASSERT(params->types.empty());
+
+    FunctionFacts facts;
+    facts.paramTypes = {"int", "const Request&"};
+    StringRef anyThenRequest[] = {"..", "const Request&"};
+    StringRef requestThenAny[] = {"const Request&", ".."};
+    StringRef any[] = {".."};
+    StringRef exact[] = {"int", "const Request&"};
+    ASSERT(matchesParamTypes(anyThenRequest, facts));
+    ASSERT(!matchesParamTypes(requestThenAny, facts));
+    ASSERT(matchesParamTypes(any, facts));
+    ASSERT(matchesParamTypes(exact, facts));
+    ASSERT(!matchesParamTypes({}, facts));
+    facts.paramTypes.clear();
+    ASSERT(matchesParamTypes({}, facts));
+    ASSERT(matchesParamTypes(any, facts));
+
+    // The cheap flags are tested before the printed types
+    ASSERT_EQ(pointcutKey(optimizePointcut(parseExpressionForTest(
+                  "p = returns(int) && annotation(w) && static && param_count(2);"), TestContext)),
+              "&(&(&(static,param_count(2)),returns(int)),annotation(w))");
+
+    PointcutIndex index;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        ASSERT(index.add(i, pointcuts[i]->expression));
+    }
+    ASSERT(index.needsSignature());
+    PointcutIndex flagsOnly;
+    flagsOnly.add(0, parseExpressionForTest("p = const && param_count(1);"));
+    ASSERT(!flagsOnly.needsSignature());
+
+    // Tree, index, programs from the AST and from an image agree
+    PointcutImageBuilder builder;
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        builder.addPointcut(*pointcut);
+    }
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 2);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 2);
+    ASSERT(image.has_value());
+    PointcutProgram fromTree;
+    PointcutProgram fromImage;
+    std::vector<u32> treeEntries;
+    std::vector<u32> imageEntries;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        treeEntries.push_back(*fromTree.compile(pointcuts[i]->expression));
+        imageEntries.push_back(*fromImage.compile(*image, image->getPointcuts()[i].root));
+    }
+    const char *returnTypes[] = {"std::string", "void"};
+    std::vector<std::vector<std::string>> paramLists = {
+        {}, {"const Request&"}, {"int", "const Request&"}, {"std::map<int,std::string>", "void(*)(int,char)"},
+    };
+    for (const char *returnType : returnTypes) {
+        for (const auto &paramList : paramLists) {
+            for (u8 qualifiers = 0; qualifiers < 16; ++qualifiers) {
+                FunctionFacts facts;
+                facts.qualifiers = qualifiers;
+                facts.returnType = returnType;
+                facts.paramTypes.assign(paramList.begin(), paramList.end());
+                facts.paramCount = paramList.size();
+                std::optional<u32> expected;
+                for (u32 i = 0; i < pointcuts.size(); ++i) {
+                    bool matches = evaluatePointcut(pointcuts[i]->expression, facts);
+                    ASSERT_EQ(fromTree.run(treeEntries[i], facts), matches);
+                    ASSERT_EQ(fromImage.run(imageEntries[i], facts), matches);
+                    if (matches && !expected) {
+                        expected = i;
+                    }
+                }
+                ASSERT(index.firstMatch(facts) == expected);
+            }
+        }
+    }
+
+    std::string code;
+    llvm::raw_string_ostream codeOS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", codeOS);
+    StringRef generated(code);
+    ASSERT(generated.contains("(f.facts.qualifiers & QUALIFIER_CONST) != 0"));
+    ASSERT(generated.contains("f.facts.returnType == \"std::string\""));
+    ASSERT(generated.contains("matchesParamTypes({\"..\", \"const Request&\"}, f.facts)"));
+    ASSERT(generated.contains("matchesParamTypes({}, f.facts)"));
+    ASSERT(generated.contains("f.facts.paramCount == 0"));
+}
+
+void runHierarchyTests() {
+    ASSERT_EQ(unqualifiedName("app::net::Handler"), "Handler");
+    ASSERT_EQ(unqualifiedName("Handler"), "Handler");
+    ASSERT(matchesQualifiedName("Handler", "app::Handler"));
+    ASSERT(matchesQualifiedName("app::Handler", "v2::app::Handler"));
+    ASSERT(!matchesQualifiedName("::app::Handler", "v2::app::Handler"));
+    ASSERT(matchesQualifiedName("app::*Handler", "app::HttpHandler"));
+    ASSERT(!matchesQualifiedName("Handler", ""));
+
+    Lexer lexer("run_pointcut a = inherits(IHandler) && !method_of(app::*Base);\n"
+                "run_pointcut b = method_of(::app::Codec) || inherits(io::*Stream);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 2u);
+    auto *andExpr = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(andExpr);
+    auto *inherits = llvm::dyn_cast<InheritsExpression>(andExpr->left);
+    ASSERT_NOT_NULL(inherits);
+    ASSERT_EQ(inherits->id, "IHandler");
+    auto *methodOf = llvm::dyn_cast<MethodOfExpression>(llvm::cast<NotExpression>(andExpr->right)->expr);
+    ASSERT_NOT_NULL(methodOf);
+    ASSERT_EQ(methodOf->id, "app::*Base");
+
+    FunctionFacts facts;
+    StringRef bases[] = {"app::HandlerBase", "IHandler"};
+    facts.className = "app::HttpHandler";
+    facts.baseClasses = bases;
+    ASSERT(evaluatePointcut(pointcuts[0]->expression, facts));
+    ASSERT(!evaluatePointcut(pointcuts[1]->expression, facts));
+    facts.className = "app::HandlerBase";
+    facts.baseClasses = ArrayRef<StringRef>(bases).drop_front();
+    ASSERT(!evaluatePointcut(pointcuts[0]->expression, facts));
+    // Free functions have no class
+    facts.className = "";
+    facts.baseClasses = {};
+    ASSERT(!evaluatePointcut(pointcuts[0]->expression, facts));
+
+    // One pointcut per interface: a method is only checked against those of
+    // its own class and bases
+    std::string text;
+    for (u32 i = 0; i < 200; ++i) {
+        text += "run_pointcut i" + std::to_string(i) + " = inherits(ns::I" + std::to_string(i) + ");\n";
+    }
+    text += "run_pointcut m = method_of(Codec) && !const;\n";
+    text += "run_pointcut g = inherits(**::*Stream);\n";
+    Lexer manyLexer(text);
+    Parser manyParser(manyLexer, TestContext);
+    auto many = manyParser.parsePointcutList();
+    ASSERT_EQ(many.size(), 202u);
+    PointcutIndex index;
+    for (u32 i = 0; i < many.size(); ++i) {
+        ASSERT(index.add(i, many[i]->expression));
+    }
+    ASSERT(index.needsClass());
+    ASSERT(!index.needsQualifiedName());
+    StringRef derived[] = {"ns::I7", "ns::I42", "ns::I5x"};
+    facts.clear();
+    facts.className = "app::Impl";
+    facts.baseClasses = derived;
+    SmallVector<u32, 8> ids;
+    index.candidates(facts, ids);
+    // I7, I42 and the unindexed glob
+    ASSERT_EQ(ids.size(), 3u);
+    ASSERT_EQ(*index.firstMatch(facts), 7u);
+    facts.className = "codec::Codec";
+    facts.baseClasses = {};
+    ASSERT_EQ(*index.firstMatch(facts), 200u);
+    facts.qualifiers = QUALIFIER_CONST;
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+
+    // Tree, index, programs from the AST and from an image agree
+    const char *texts[] = {
+        "p = inherits(IHandler) && !method_of(app::*Base);",
+        "p = method_of(::app::Codec) || inherits(io::*Stream);",
+        "p = inherits(**::*Stream) && !inherits(io::*) || method_of(Hand?er);",
+    };
+    PointcutImageBuilder builder;
+    std::vector<ASTNode*> expressions;
+    PointcutIndex treeIndex;
+    for (const char *source : texts) {
+        ASTNode *expression = parseExpressionForTest(source);
+        PointcutDeclaration declaration(true, "p", MATCH_RUN, optimizePointcut(expression, TestContext));
+        builder.addPointcut(declaration);
+        treeIndex.add(expressions.size(), expression);
+        expressions.push_back(expression);
+    }
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 3);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 3);
+    ASSERT(image.has_value());
+    PointcutProgram fromTree;
+    PointcutProgram fromImage;
+    std::vector<u32> treeEntries;
+    std::vector<u32> imageEntries;
+    for (u32 i = 0; i < expressions.size(); ++i) {
+        treeEntries.push_back(*fromTree.compile(expressions[i]));
+        imageEntries.push_back(*fromImage.compile(*image, image->getPointcuts()[i].root));
+    }
+    const char *classNames[] = {"", "app::Codec", "v1::app::Codec", "app::HandlerBase", "Handler", "net::Conn"};
+    std::vector<std::vector<StringRef>> baseLists = {
+        {}, {"IHandler"}, {"io::FileStream", "IHandler"}, {"net::TcpStream"}, {"app::HandlerBase"},
+    };
+    for (const char *className : classNames) {
+        for (const auto &baseList : baseLists) {
+            FunctionFacts facts;
+            facts.className = className;
+            facts.baseClasses = baseList;
+            std::optional<u32> expected;
+            for (u32 i = 0; i < expressions.size(); ++i) {
+                bool matches = evaluatePointcut(expressions[i], facts);
+                ASSERT_EQ(fromTree.run(treeEntries[i], facts), matches);
+                ASSERT_EQ(fromImage.run(imageEntries[i], facts), matches);
+                if (matches && !expected) {
+                    expected = i;
+                }
+            }
+            ASSERT(treeIndex.firstMatch(facts) == expected);
+        }
+    }
+
+    std::string code;
+    llvm::raw_string_ostream codeOS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", codeOS);
+    StringRef generated(code);
+    ASSERT(generated.contains("inheritsFrom(\"IHandler\", f.facts)"));
+    ASSERT(generated.contains("isMethodOf(\"::app::Codec\", f.facts)"));
+}
+
+void runCallGraphTests() {
+    // main -> rpc::dispatch -> app::handle -> db::query -> db::exec
+    //                          app::handle -> log, helper -> helper
+    CallGraph graph;
+    u32 main = graph.addFunction("main");
+    u32 dispatch = graph.addFunction("rpc::dispatch");
+    u32 handle = graph.addFunction("app::handle");
+    u32 query = graph.addFunction("db::query");
+    u32 exec = graph.addFunction("db::exec");
+    u32 log = graph.addFunction("log");
+    u32 helper = graph.addFunction("app::helper");
+    graph.addCall(main, dispatch);
+    graph.addCall(dispatch, handle);
+    graph.addCall(handle, query);
+    graph.addCall(handle, query);
+    graph.addCall(handle, log);
+    graph.addCall(query, exec);
+    graph.addCall(helper, helper);
+    graph.finalize();
+    ASSERT_EQ(graph.size(), 7u);
+    ASSERT_EQ(graph.getCallees(handle).size(), 2u);
+    ASSERT_EQ(graph.getCallees(handle)[0], query);
+    ASSERT_EQ(graph.getCallers(query).size(), 1u);
+    ASSERT_EQ(graph.getCallers(main).size(), 0u);
+
+    FunctionFacts facts;
+    facts.callGraph = &graph;
+    auto calls = [&](u32 node, StringRef pattern, u32 depth) {
+        facts.callGraphNode = node;
+        return callsFunction(pattern, depth, facts);
+    };
+    auto calledBy = [&](u32 node, StringRef pattern, u32 depth) {
+        facts.callGraphNode = node;
+        return isCalledBy(pattern, depth, facts);
+    };
+    ASSERT(calls(handle, "db::query", 1));
+    ASSERT(calls(main, "db::query", 0));
+    ASSERT(!calls(main, "db::query", 2));
+    ASSERT(calls(main, "db::query", 3));
+    ASSERT(!calls(query, "db::query", 0));
+    ASSERT(calls(helper, "helper", 1));
+    ASSERT(calls(dispatch, "db::*", 0));
+    ASSERT(!calls(log, "db::*", 0));
+    ASSERT(calledBy(exec, "rpc::dispatch", 0));
+    ASSERT(!calledBy(exec, "rpc::dispatch", 2));
+    ASSERT(calledBy(log, "**::handle", 1));
+    ASSERT(!calledBy(main, "main", 0));
+    facts.callGraphNode = CallGraph::NO_NODE;
+    ASSERT(!callsFunction("db::query", 0, facts));
+    facts.callGraph = nullptr;
+    facts.callGraphNode = handle;
+    ASSERT(!callsFunction("db::query", 0, facts));
+
+    Lexer lexer("run_pointcut hot = calls(db::query) && called_by(rpc::dispatch, 2);\n"
+                "run_pointcut leaf = called_by(app::*) && !calls(**::*, 1);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 2u);
+    auto *andExpr = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(andExpr);
+    auto *callsExpr = llvm::dyn_cast<CallsExpression>(andExpr->left);
+    ASSERT_NOT_NULL(callsExpr);
+    ASSERT_EQ(callsExpr->id, "db::query");
+    ASSERT_EQ(callsExpr->depth, 0u);
+    auto *calledByExpr = llvm::dyn_cast<CalledByExpression>(andExpr->right);
+    ASSERT_NOT_NULL(calledByExpr);
+    ASSERT_EQ(calledByExpr->depth, 2u);
+
+    PointcutIndex index;
+    PointcutImageBuilder builder;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        ASSERT(index.add(i, pointcuts[i]->expression));
+        builder.addPointcut(*pointcuts[i]);
+    }
+    ASSERT(index.needsCallGraph());
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 4);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 4);
+    ASSERT(image.has_value());
+    PointcutProgram fromImage;
+    std::vector<u32> entries;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        entries.push_back(*fromImage.compile(*image, image->getPointcuts()[i].root));
+    }
+    facts.callGraph = &graph;
+    for (u32 node = 0; node < graph.size(); ++node) {
+        facts.callGraphNode = node;
+        std::optional<u32> expected;
+        for (u32 i = 0; i < pointcuts.size(); ++i) {
+            bool matches = evaluatePointcut(pointcuts[i]->expression, facts);
+            ASSERT_EQ(fromImage.run(entries[i], facts), matches);
+            if (matches && !expected) {
+                expected = i;
+            }
+        }
+        ASSERT(index.firstMatch(facts) == expected);
+    }
+    facts.callGraphNode = handle;
+    ASSERT_EQ(*index.firstMatch(facts), 0u);
+    facts.callGraphNode = log;
+    ASSERT_EQ(*index.firstMatch(facts), 1u);
+    facts.callGraphNode = query;
+    ASSERT_EQ(index.firstMatch(facts).has_value(), false);
+
+    std::string code;
+    llvm::raw_string_ostream codeOS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", codeOS);
+    StringRef generated(code);
+    ASSERT(generated.contains("callsFunction(\"db::query\", 0, f.facts)"));
+    ASSERT(generated.contains("isCalledBy(\"rpc::dispatch\", 2, f.facts)"));
+}
+
+void runBodyTests() {
+    Lexer lexer("run_pointcut heavy = body_weight(40) || has_loop;\n"
+                "run_pointcut small = stmt_count(1, 3) && !has_call;\n"
+                "run_pointcut exact = stmt_count(0, 0);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 3u);
+    auto *orExpr = llvm::dyn_cast<OrExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(orExpr);
+    auto *weight = llvm::dyn_cast<BodySizeExpression>(orExpr->left);
+    ASSERT_NOT_NULL(weight);
+    ASSERT_EQ(weight->measure, TOK_BODY_WEIGHT);
+    ASSERT_EQ(weight->min, 40u);
+    ASSERT_EQ(weight->max, UNBOUNDED);
+    auto *loop = llvm::dyn_cast<BodyFlagExpression>(orExpr->right);
+    ASSERT_NOT_NULL(loop);
+    ASSERT_EQ(loop->flag, TOK_HAS_LOOP);
+    auto *andExpr = llvm::dyn_cast<AndExpression>(pointcuts[1]->expression);
+    ASSERT_NOT_NULL(andExpr);
+    auto *count = llvm::dyn_cast<BodySizeExpression>(andExpr->left);
+    ASSERT_NOT_NULL(count);
+    ASSERT_EQ(count->measure, TOK_STMT_COUNT);
+    ASSERT_EQ(count->max, 3u);
+
+    FunctionFacts facts;
+    ASSERT(isBodySizeWithin(BODY_STMT_COUNT, 0, 0, facts));
+    facts.stmtCount = 3;
+    facts.bodyWeight = 40;
+    ASSERT(isBodySizeWithin(BODY_STMT_COUNT, 1, 3, facts));
+    ASSERT(!isBodySizeWithin(BODY_STMT_COUNT, 4, UNBOUNDED, facts));
+    ASSERT(isBodySizeWithin(BODY_WEIGHT, 40, 40, facts));
+    ASSERT(!isBodySizeWithin(BODY_WEIGHT, 0, 39, facts));
+
+    // The wrapper weighs WRAPPER_WEIGHT; ratio 0 and unknown weights never skip
+    ASSERT(!exceedsOverheadRatio(1, 0));
+    ASSERT(!exceedsOverheadRatio(0, 1));
+    ASSERT(exceedsOverheadRatio(3, 1));
+    ASSERT(!exceedsOverheadRatio(WRAPPER_WEIGHT, 1));
+    ASSERT(exceedsOverheadRatio(WRAPPER_WEIGHT - 1, 1));
+    ASSERT(!exceedsOverheadRatio(3, 8));
+    ASSERT(exceedsOverheadRatio(3, 7.9));
+    ASSERT(!exceedsOverheadRatio(48, 0.5));
+    ASSERT(exceedsOverheadRatio(47, 0.5));
+
+    PointcutIndex index;
+    PointcutImageBuilder builder;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        ASSERT(index.add(i, pointcuts[i]->expression));
+        builder.addPointcut(*pointcuts[i]);
+    }
+    ASSERT(index.needsBody());
+    ASSERT(!index.needsCallGraph());
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 5);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 5);
+    ASSERT(image.has_value());
+    PointcutProgram fromImage;
+    std::vector<u32> entries;
+    for (u32 i = 0; i < pointcuts.size(); ++i) {
+        entries.push_back(*fromImage.compile(*image, image->getPointcuts()[i].root));
+    }
+
+    struct Body {
+        u32 stmtCount;
+        u32 bodyWeight;
+        u8 bodyFlags;
+        std::optional<u32> expected;
+    };
+    const Body bodies[] = {
+        {0, 0, 0, 2u},                            // declaration only
+        {1, 3, 0, 1u},                            // getter
+        {2, 9, BODY_HAS_CALL, std::nullopt},      // forwards to another function
+        {3, 60, BODY_HAS_CALL, 0u},               // heavy
+        {2, 12, BODY_HAS_LOOP, 0u},               // small loop
+        {4, 20, 0, std::nullopt},                 // longer straight-line code
+    };
+    for (const Body &body : bodies) {
+        facts.stmtCount = body.stmtCount;
+        facts.bodyWeight = body.bodyWeight;
+        facts.bodyFlags = body.bodyFlags;
+        std::optional<u32> first;
+        for (u32 i = 0; i < pointcuts.size(); ++i) {
+            bool matches = evaluatePointcut(pointcuts[i]->expression, facts);
+            ASSERT_EQ(fromImage.run(entries[i], facts), matches);
+            if (matches && !first) {
+                first = i;
+            }
+        }
+        ASSERT(first == body.expected);
+        ASSERT(index.firstMatch(facts) == body.expected);
+    }
+
+    // Bounds are part of the optimizer's key: equal ranges dedup, others do not
+    Lexer dupLexer("run_pointcut p = (stmt_count(1, 3) && stmt_count(1, 3)) || stmt_count(1);\n");
+    Parser dupParser(dupLexer, TestContext);
+    auto dup = dupParser.parsePointcutList();
+    ASTNode *optimized = optimizePointcut(dup[0]->expression, TestContext);
+    auto *optimizedOr = llvm::dyn_cast<OrExpression>(optimized);
+    ASSERT_NOT_NULL(optimizedOr);
+    ASSERT(llvm::isa<BodySizeExpression>(optimizedOr->left));
+    ASSERT(llvm::isa<BodySizeExpression>(optimizedOr->right));
+
+    std::string code;
+    llvm::raw_string_ostream codeOS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", codeOS);
+    StringRef generated(code);
+    ASSERT(generated.contains("isBodySizeWithin(BODY_WEIGHT, 40, UNBOUNDED, f.facts)"));
+    ASSERT(generated.contains("isBodySizeWithin(BODY_STMT_COUNT, 1, 3, f.facts)"));
+    ASSERT(generated.contains("(f.facts.bodyFlags & BODY_HAS_CALL) != 0"));
+}
+
+void runReferenceTests() {
+    Lexer lexer("common = annotation(wrap) && within(\"src/**\");\n"
+                "run_pointcut getters = common && func(get*);\n"
+                "run_pointcut setters = func(set*) && common;\n"
+                "call_pointcut cold = !common && func(cold);\n"
+                "run_pointcut accessors = getters || setters;\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT_EQ(pointcuts.size(), 5u);
+    ASSERT_EQ(pointcuts[0]->matchKind, MATCH_NONE);
+    auto *getters = llvm::dyn_cast<AndExpression>(pointcuts[1]->expression);
+    ASSERT_NOT_NULL(getters);
+    auto *ref = llvm::dyn_cast<PointcutRefExpression>(getters->left);
+    ASSERT_NOT_NULL(ref);
+    ASSERT_EQ(ref->name, "common");
+    // Shared, not copied
+    ASSERT(ref->target == pointcuts[0]);
+    auto *accessors = llvm::dyn_cast<OrExpression>(pointcuts[4]->expression);
+    ASSERT_NOT_NULL(accessors);
+    ASSERT(llvm::cast<PointcutRefExpression>(accessors->left)->target == pointcuts[1]);
+    ASSERT(llvm::cast<PointcutRefExpression>(accessors->right)->target == pointcuts[2]);
+
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        pointcut->expression = optimizePointcut(pointcut->expression, TestContext);
+    }
+    // A reference stands for its pointcut, and costs what it does
+    ASSERT_EQ(pointcutKey(ref), "@common");
+    ASSERT_EQ(pointcutCost(ref), pointcutCost(pointcuts[0]->expression));
+    ASSERT(pointcutCost(pointcuts[4]->expression) > pointcutCost(pointcuts[1]->expression));
+
+    // The image stores common once; every reference points to its root
+    PointcutImageBuilder builder;
+    for (PointcutDeclaration *pointcut : pointcuts) {
+        builder.addPointcut(*pointcut);
+    }
+    SmallVector<char, 0> bytes;
+    llvm::raw_svector_ostream OS(bytes);
+    builder.write(OS, 9);
+    std::optional<PointcutImage> image = PointcutImage::fromBytes(StringRef(bytes.data(), bytes.size()), 9);
+    ASSERT(image.has_value());
+    u32 annotations = 0;
+    u32 refs = 0;
+    for (const ImageNode &node : image->getNodes()) {
+        annotations += node.kind == IMAGE_ANNOTATION;
+        if (node.kind == IMAGE_REF) {
+            ++refs;
+            ASSERT(node.a == image->getPointcuts()[0].root || node.a == image->getPointcuts()[1].root ||
+                   node.a == image->getPointcuts()[2].root);
+        }
+    }
+    ASSERT_EQ(annotations, 1u);
+    ASSERT_EQ(refs, 5u);
+
+    // ... and so does the program
+    PointcutProgram program;
+    std::vector<u32> entries(pointcuts.size());
+    for (u32 i = 1; i < pointcuts.size(); ++i) {
+        entries[i] = *program.compile(*image, image->getPointcuts()[i].root);
+    }
+    u32 annotationOps = 0;
+    for (const PointcutOp &op : program.getOps()) {
+        annotationOps += op.code == OP_ANNOTATION;
+    }
+    ASSERT_EQ(annotationOps, 1u);
+    entries[0] = *program.compile(*image, image->getPointcuts()[0].root);
+
+    PointcutIndex runIndex;
+    u32 runIds[] = {1, 2, 4};
+    for (u32 id = 0; id < 3; ++id) {
+        ASSERT(runIndex.add(id, *image, image->getPointcuts()[runIds[id]].root));
+    }
+    // Through common, the run pointcuts are all confined to src/
+    ASSERT(runIndex.needsScope());
+    ASSERT(runIndex.isScoped());
+    ASSERT(runIndex.fileInScope("/home/me/src/a.cpp"));
+    ASSERT(!runIndex.fileInScope("/home/me/test/a.cpp"));
+
+    struct Function {
+        const char *name;
+        bool annotated;
+        const char *file;
+        std::optional<u32> expected;
+    };
+    const Function functions[] = {
+        {"getX", true, "/p/src/a.cpp", 0u},
+        {"setX", true, "/p/src/a.cpp", 1u},
+        {"getX", false, "/p/src/a.cpp", std::nullopt},
+        {"setX", true, "/p/test/a.cpp", std::nullopt},
+        {"cold", false, "/p/src/a.cpp", std::nullopt},
+        {"run", true, "/p/src/a.cpp", std::nullopt},
+    };
+    for (const Function &function : functions) {
+        FunctionFacts facts;
+        facts.name = function.name;
+        facts.qualifiedName = function.name;
+        facts.file = function.file;
+        if (function.annotated) {
+            facts.annotations.push_back("wrap");
+        }
+        PointcutMemo memo;
+        for (u32 i = 0; i < pointcuts.size(); ++i) {
+            bool matches = evaluatePointcut(pointcuts[i]->expression, facts);
+            ASSERT_EQ(program.run(entries[i], facts), matches);
+            ASSERT_EQ(program.run(entries[i], facts, memo), matches);
+        }
+        ASSERT(runIndex.firstMatch(facts) == function.expected);
+    }
+
+    // A memo keeps the results of the referenced pointcuts until cleared
+    FunctionFacts facts;
+    facts.name = "getX";
+    facts.qualifiedName = "getX";
+    facts.file = "/p/src/a.cpp";
+    facts.annotations.push_back("wrap");
+    PointcutMemo memo;
+    ASSERT(program.run(entries[1], facts, memo));
+    facts.annotations.clear();
+    ASSERT(program.run(entries[1], facts, memo));
+    memo.clear();
+    ASSERT(!program.run(entries[1], facts, memo));
+
+    // A reference to a constant pointcut folds
+    Lexer constLexer("never = func(a) && !func(a);\n"
+                     "run_pointcut p = never || func(b);\n");
+    Parser constParser(constLexer, TestContext);
+    auto constant = constParser.parsePointcutList();
+    for (PointcutDeclaration *pointcut : constant) {
+        pointcut->expression = optimizePointcut(pointcut->expression, TestContext);
+    }
+    ASSERT(llvm::isa<FuncExpression>(constant[1]->expression));
+
+    // Generated code evaluates each referenced pointcut once per function
+    std::string code;
+    llvm::raw_string_ostream codeOS(code);
+    emitCompiledPointcuts(pointcuts, "test.pc", codeOS);
+    StringRef generated(code);
+    ASSERT(generated.contains("mutable u8 refs[3] = {};"));
+    ASSERT(generated.contains("bool ref0(const Facts &f) {"));
+    ASSERT(generated.contains("f.refs[0] = evaluate0(f) ? 2 : 1;"));
+    // getters is referenced, so its match function defers to its ref
+    ASSERT(generated.contains("bool match0(const Facts &f) {\n    return ref1(f);\n}"));
+    ASSERT(generated.contains("(ref1(f) || ref2(f))"));
+}
+
+void runContextualKeywordTests() {
+    // Names that predicates took later still name pointcuts, annotations,
+    // functions and classes
+    Lexer lexer("run_pointcut calls = annotation(inherits) && func(params);\n"
+                "run_pointcut has_loop = calls || method_of(returns);\n"
+                "run_pointcut within_ns = within(namespace calls) && calls(namespace, 2);\n"
+                "run_pointcut loops = has_loop && has_call && returns(int);\n");
+    Parser parser(lexer, TestContext);
+    auto pointcuts = parser.parsePointcutList();
+    ASSERT(!parser.hasError());
+    ASSERT_EQ(pointcuts.size(), 4u);
+    ASSERT_EQ(pointcuts[0]->name, "calls");
+    auto *first = llvm::dyn_cast<AndExpression>(pointcuts[0]->expression);
+    ASSERT_NOT_NULL(first);
+    ASSERT_EQ(llvm::cast<NotationExprNode>(first->left)->id, "inherits");
+    ASSERT_EQ(llvm::cast<FuncExpression>(first->right)->id, "params");
+    auto *second = llvm::dyn_cast<OrExpression>(pointcuts[1]->expression);
+    ASSERT_NOT_NULL(second);
+    ASSERT(llvm::cast<PointcutRefExpression>(second->left)->target == pointcuts[0]);
+    ASSERT_EQ(llvm::cast<MethodOfExpression>(second->right)->id, "returns");
+    auto *third = llvm::dyn_cast<AndExpression>(pointcuts[2]->expression);
+    ASSERT_NOT_NULL(third);
+    ASSERT_EQ(llvm::cast<WithinNamespaceExpression>(third->left)->id, "calls");
+    auto *callsExpr = llvm::dyn_cast<CallsExpression>(third->right);
+    ASSERT_NOT_NULL(callsExpr);
+    ASSERT_EQ(callsExpr->id, "namespace");
+    ASSERT_EQ(callsExpr->depth, 2u);
+    // Without arguments, a pointcut declared with the name wins over the
+    // predicate; has_call is still the predicate
+    auto *fourth = llvm::dyn_cast<AndExpression>(pointcuts[3]->expression);
+    ASSERT_NOT_NULL(fourth);
+    auto *flags = llvm::dyn_cast<AndExpression>(fourth->left);
+    ASSERT_NOT_NULL(flags);
+    ASSERT(llvm::cast<PointcutRefExpression>(flags->left)->target == pointcuts[1]);
+    ASSERT_EQ(llvm::cast<BodyFlagExpression>(flags->right)->flag, TOK_HAS_CALL);
+    ASSERT_EQ(llvm::cast<ReturnsExpression>(fourth->right)->id, "int");
+
+    // Reserved words from the start stay reserved
+    Lexer reservedLexer("run_pointcut within = func(f);");
+    Parser reservedParser(reservedLexer, TestContext);
+    ASSERT(reservedParser.parsePointcutList().empty());
+    ASSERT(reservedParser.hasError());
 }
 
 int main() {
+    runTokenTableTests();
+    llvm::outs() << "All token table tests passed!\n";
     runLexerTests();
     llvm::outs() << "All lexer tests passed!\n";
     runParserTests();
     llvm::outs() << "All parser tests passed!\n";
+    runArenaTests();
+    llvm::outs() << "All arena tests passed!\n";
+    runPointcutIndexTests();
+    llvm::outs() << "All pointcut index tests passed!\n";
+    runOptimizerTests();
+    llvm::outs() << "All optimizer tests passed!\n";
+    runProgramTests();
+    llvm::outs() << "All program tests passed!\n";
+    runCodegenTests();
+    llvm::outs() << "All codegen tests passed!\n";
+    runImageTests();
+    llvm::outs() << "All image tests passed!\n";
+    runWithinTests();
+    llvm::outs() << "All within tests passed!\n";
+    runNamePatternTests();
+    llvm::outs() << "All name pattern tests passed!\n";
+    runSignatureTests();
+    llvm::outs() << "All signature tests passed!\n";
+    runHierarchyTests();
+    llvm::outs() << "All hierarchy tests passed!\n";
+    runCallGraphTests();
+    llvm::outs() << "All call graph tests passed!\n";
+    runBodyTests();
+    llvm::outs() << "All body tests passed!\n";
+    runReferenceTests();
+    llvm::outs() << "All reference tests passed!\n";
+    runContextualKeywordTests();
+    llvm::outs() << "All contextual keyword tests passed!\n";
     return 0;
 }
\ No newline at end of file
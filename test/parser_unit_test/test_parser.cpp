@@ -31,7 +31,6 @@ protected:
 TEST_F(LexerTest, TestInput1) {
     llvm::StringRef testInput = "call_pointcut myPointcut = func(myFunction);";
     Lexer lexer(testInput);
-    lexer.updateDeclarationEnd();
 
     EXPECT_EQ(lexer.next().kind, TOK_CALL_POINTCUT);
     EXPECT_EQ(lexer.next().kind, TOK_IDENTIFIER);
@@ -61,17 +60,18 @@ protected:
 // Test cases for the Parser
 TEST_F(ParserTest, TestParserInput1) {
     llvm::StringRef testInput = "run_pointcut myPointcut = func(myFunction);";
+    PointcutContext context;
     Lexer lexer(testInput);
-    Parser parser(lexer);
+    Parser parser(lexer, context);
     auto ast = parser.parsePointcutList();
 
     ASSERT_EQ(ast.size(), 1);
-    auto *pointcut = dynamic_cast<PointcutDeclaration *>(ast[0].get());
+    auto *pointcut = llvm::dyn_cast<PointcutDeclaration>(ast[0]);
     ASSERT_NOT_NULL(pointcut);
     EXPECT_EQ(pointcut->isExported, true);
     EXPECT_EQ(pointcut->name, "myPointcut");
 
-    auto *callExpr = dynamic_cast<FuncExpression *>(pointcut->expression.get());
+    auto *callExpr = llvm::dyn_cast<FuncExpression>(pointcut->expression);
     ASSERT_NOT_NULL(callExpr);
     EXPECT_EQ(callExpr->id, "myFunction");
 }
@@ -0,0 +1,108 @@
+// Measures how long it takes from dlopen() of UTHelperPlugin until a
+// PluginASTAction can be created, i.e. the fixed cost every clang invocation
+// with -fplugin pays before it parses anything.
+//
+// Each sample runs in a freshly forked child so nothing is cached in-process
+// (the dynamic loader's page cache warm-up is shared, as it is for clang).
+//
+// usage: plugin_load_bench <path/to/UTHelperPlugin.so> [samples]
+
+#include "clang/Frontend/FrontendPluginRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <memory>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Child side: load, find and instantiate; returns elapsed ns or -1.
+long long loadOnce(const char *PluginPath) {
+  auto Start = std::chrono::steady_clock::now();
+
+  void *Handle = dlopen(PluginPath, RTLD_NOW | RTLD_LOCAL);
+  if (!Handle) {
+    std::fprintf(stderr, "dlopen failed: %s\n", dlerror());
+    return -1;
+  }
+
+  std::unique_ptr<clang::PluginASTAction> Action;
+  for (const auto &Entry : clang::FrontendPluginRegistry::entries()) {
+    if (Entry.getName() == "uthelper") {
+      Action = Entry.instantiate();
+      break;
+    }
+  }
+  if (!Action) {
+    std::fprintf(stderr, "plugin \"uthelper\" not registered\n");
+    return -1;
+  }
+
+  auto End = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start)
+      .count();
+}
+
+long long sample(const char *PluginPath) {
+  int Pipe[2];
+  if (pipe(Pipe) != 0)
+    return -1;
+
+  pid_t Pid = fork();
+  if (Pid < 0)
+    return -1;
+  if (Pid == 0) {
+    close(Pipe[0]);
+    long long Ns = loadOnce(PluginPath);
+    ssize_t Written = write(Pipe[1], &Ns, sizeof(Ns));
+    _exit(Written == sizeof(Ns) && Ns >= 0 ? 0 : 1);
+  }
+
+  close(Pipe[1]);
+  long long Ns = -1;
+  if (read(Pipe[0], &Ns, sizeof(Ns)) != sizeof(Ns))
+    Ns = -1;
+  close(Pipe[0]);
+  int Status = 0;
+  waitpid(Pid, &Status, 0);
+  if (!WIFEXITED(Status) || WEXITSTATUS(Status) != 0)
+    return -1;
+  return Ns;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <plugin.so> [samples]\n", argv[0]);
+    return 2;
+  }
+  const char *PluginPath = argv[1];
+  int Samples = argc > 2 ? std::atoi(argv[2]) : 50;
+  if (Samples <= 0)
+    Samples = 1;
+
+  std::vector<long long> Times;
+  Times.reserve(Samples);
+  for (int I = 0; I < Samples; ++I) {
+    long long Ns = sample(PluginPath);
+    if (Ns < 0) {
+      std::fprintf(stderr, "sample %d failed\n", I);
+      return 1;
+    }
+    Times.push_back(Ns);
+  }
+
+  std::sort(Times.begin(), Times.end());
+  auto Us = [](long long Ns) { return Ns / 1000.0; };
+  std::printf("dlopen-to-ready over %d samples: min %.1f us, median %.1f us, "
+              "max %.1f us\n",
+              Samples, Us(Times.front()), Us(Times[Times.size() / 2]),
+              Us(Times.back()));
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Counts what a woven function costs on top of a direct call when its
+// result travels back through around() and proceed(): heap allocations
+// (global operator new is replaced), copies and moves of the result, and
+// time per call. proceed() returns the result of the woven function
+// directly, so a woven call must allocate, copy and move exactly as much as
+// the direct call; the process fails otherwise.
+//
+// usage: proceed_bench [calls] [vector size]
+
+#include "saop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+enum class PointcutName {bench};
+
+namespace {
+
+unsigned long long allocations = 0;
+
+// Counts the copies and moves of the results
+struct Tracked {
+    static inline unsigned long long copies = 0;
+    static inline unsigned long long moves = 0;
+
+    explicit Tracked(std::size_t size) : values(size, 1) {}
+    Tracked(const Tracked& other) : values(other.values) { ++copies; }
+    Tracked(Tracked&& other) noexcept : values(std::move(other.values)) { ++moves; }
+
+    std::vector<int> values;
+};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// A no-op advice, so only the cost of the binding itself is measured
+template<typename RT, typename... Args>
+template<PointcutName Id>
+RT Pointcut<RT, Args...>::around(Args&&... args) {
+    return proceed(std::forward<Args>(args)...);
+}
+
+template<auto Func>
+template<PointcutName Id, typename... Args>
+typename StaticPointcut<Func>::ReturnType StaticPointcut<Func>::around(Args&&... args) {
+    return proceed(std::forward<Args>(args)...);
+}
+
+namespace {
+
+// noinline: every variant pays for the same out-of-line body
+__attribute__((noinline)) Tracked makeTracked(std::size_t size) {
+    return Tracked(size);
+}
+
+struct Factory {
+    std::size_t size;
+    __attribute__((noinline)) Tracked make() { return Tracked(size); }
+};
+
+// Sink for the results, so the calls are not optimized away
+volatile std::size_t checksum = 0;
+
+struct Result {
+    unsigned long long allocations;
+    unsigned long long copies;
+    unsigned long long moves;
+    double nsPerCall;
+};
+
+template<typename Call>
+Result measure(unsigned calls, Call call) {
+    allocations = 0;
+    Tracked::copies = 0;
+    Tracked::moves = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < calls; ++i) {
+        Tracked result = call();
+        checksum = checksum + result.values.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return {allocations, Tracked::copies, Tracked::moves, ns / calls};
+}
+
+bool report(const char* name, const Result& result, const Result& direct, unsigned calls) {
+    std::printf("%-22s %10.2f allocs/call %10.2f copies/call %10.2f moves/call %10.1f ns/call\n",
+                name, double(result.allocations) / calls, double(result.copies) / calls,
+                double(result.moves) / calls, result.nsPerCall);
+    return result.allocations == direct.allocations && result.copies == direct.copies &&
+           result.moves == direct.moves;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::size_t size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    if (calls == 0) {
+        std::fprintf(stderr, "usage: proceed_bench [calls] [vector size]\n");
+        return 1;
+    }
+
+    Factory factory{size};
+    Result direct = measure(calls, [&] { return makeTracked(size); });
+    Result woven = measure(calls, [&] {
+        return createPointcut(&makeTracked, nullptr, nullptr)
+            .template around<PointcutName::bench>(std::forward<std::size_t>(size));
+    });
+    Result wovenMember = measure(calls, [&] {
+        return createPointcut<&Factory::make>(&factory, nullptr, nullptr)
+            .template around<PointcutName::bench>();
+    });
+    Result bound = measure(calls, [&] {
+        return StaticPointcut<&makeTracked>().around<PointcutName::bench>(std::forward<std::size_t>(size));
+    });
+
+    bool ok = report("direct", direct, direct, calls);
+    ok &= report("Pointcut (free)", woven, direct, calls);
+    ok &= report("Pointcut (member)", wovenMember, direct, calls);
+    ok &= report("StaticPointcut", bound, direct, calls);
+    if (!ok) {
+        std::printf("FAILED: a woven call allocates, copies or moves more than a direct one\n");
+        return 1;
+    }
+    std::printf("OK: woven calls allocate, copy and move as much as direct ones\n");
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "saop.h"
+
+// The advice under test, as a saopImpl.h would define it
+enum class PointcutName {counted};
+
+namespace {
+
+int adviceRuns = 0;
+
+// Counts the copies and moves of the values passing through proceed()
+struct Tracked {
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    explicit Tracked(int value) : value(value) {}
+    Tracked(const Tracked& other) : value(other.value) { ++copies; }
+    Tracked(Tracked&& other) noexcept : value(other.value) { ++moves; }
+    Tracked& operator=(const Tracked&) = delete;
+    Tracked& operator=(Tracked&&) = delete;
+
+    int value;
+};
+
+struct NoDefault {
+    explicit NoDefault(int value) : value(value) {}
+    int value;
+};
+
+} // namespace
+
+template<typename RT, typename... Args>
+template<PointcutName Id>
+RT Pointcut<RT, Args...>::around(Args&&... args) {
+    AfterProceed after([] { ++adviceRuns; });
+    return proceed(std::forward<Args>(args)...);
+}
+
+template<auto Func>
+template<PointcutName Id, typename... Args>
+typename StaticPointcut<Func>::ReturnType StaticPointcut<Func>::around(Args&&... args) {
+    AfterProceed after([] { ++adviceRuns; });
+    return proceed(std::forward<Args>(args)...);
+}
+
+namespace {
+
+// Woven functions, called the way their wrappers would call them
+
+std::vector<int> makeVector(int size) {
+    return std::vector<int>(size, 7);
+}
+
+int& element(std::vector<int>& values, int index) {
+    return values[index];
+}
+
+std::string&& passString(std::string&& text) {
+    return std::move(text);
+}
+
+std::unique_ptr<int> makeUnique(int value) {
+    return std::make_unique<int>(value);
+}
+
+NoDefault makeNoDefault(int value) {
+    return NoDefault(value);
+}
+
+Tracked makeTracked(int value) {
+    return Tracked(value);
+}
+
+int throwing(int value) {
+    throw std::runtime_error("proceed failed " + std::to_string(value));
+}
+
+int sideEffect = 0;
+void setSideEffect(int value) {
+    sideEffect = value;
+}
+
+struct Holder {
+    Tracked tracked{1};
+    std::unique_ptr<int> owned = std::make_unique<int>(5);
+
+    Tracked& get() { return tracked; }
+    std::unique_ptr<int> release() { return std::move(owned); }
+    Tracked make(int value) { return Tracked(value); }
+};
+
+template<typename RT, typename... Args>
+RT callWoven(RT (*func)(Args...), std::type_identity_t<Args>... args) {
+    return createPointcut(func, nullptr, nullptr)
+        .template around<PointcutName::counted>(std::forward<Args>(args)...);
+}
+
+template<auto Method, typename Object, typename... Args>
+decltype(auto) callWoven(Object* object, Args&&... args) {
+    return createPointcut<Method>(object, nullptr, nullptr)
+        .template around<PointcutName::counted>(std::forward<Args>(args)...);
+}
+
+struct Shape {
+    virtual ~Shape() = default;
+    virtual int sides() const { return 0; }
+};
+
+struct Square : Shape {
+    int sides() const override { return 4; }
+};
+
+struct Named {
+    const char* name = "named";
+    const char* getName() const { return name; }
+};
+
+struct NamedSquare : Square, Named {
+    int id = 7;
+    int getId() { return id; }
+};
+
+class ProceedTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        adviceRuns = 0;
+        Tracked::copies = 0;
+        Tracked::moves = 0;
+    }
+};
+
+} // namespace
+
+TEST_F(ProceedTest, ReturnsValue) {
+    std::vector<int> values = callWoven(&makeVector, 3);
+    EXPECT_EQ(values, std::vector<int>({7, 7, 7}));
+    EXPECT_EQ(adviceRuns, 1);
+}
+
+TEST_F(ProceedTest, ReturnsLvalueReference) {
+    std::vector<int> values = {1, 2, 3};
+    int& second = callWoven(&element, values, 1);
+    EXPECT_EQ(&second, &values[1]);
+    second = 20;
+    EXPECT_EQ(values[1], 20);
+}
+
+TEST_F(ProceedTest, ReturnsRvalueReference) {
+    std::string text = "long enough to live on the heap, not in the string";
+    const char* buffer = text.data();
+    std::string&& passed = callWoven(&passString, std::move(text));
+    EXPECT_EQ(&passed, &text);
+    std::string moved = std::move(passed);
+    EXPECT_EQ(moved.data(), buffer);
+}
+
+TEST_F(ProceedTest, ReturnsMoveOnly) {
+    std::unique_ptr<int> owned = callWoven(&makeUnique, 42);
+    ASSERT_NE(owned, nullptr);
+    EXPECT_EQ(*owned, 42);
+}
+
+TEST_F(ProceedTest, ReturnsNonDefaultConstructible) {
+    NoDefault result = callWoven(&makeNoDefault, 9);
+    EXPECT_EQ(result.value, 9);
+}
+
+TEST_F(ProceedTest, ReturnsVoid) {
+    callWoven(&setSideEffect, 3);
+    EXPECT_EQ(sideEffect, 3);
+    EXPECT_EQ(adviceRuns, 1);
+}
+
+TEST_F(ProceedTest, SkipsAdviceWhenProceedThrows) {
+    EXPECT_THROW(callWoven(&throwing, 1), std::runtime_error);
+    EXPECT_EQ(adviceRuns, 0);
+}
+
+TEST_F(ProceedTest, RunsAdviceDuringUnwinding) {
+    // Woven functions called from a destructor during unwinding still get
+    // their advice: only exceptions raised after AfterProceed count
+    struct CallsOnUnwind {
+        ~CallsOnUnwind() { callWoven(&setSideEffect, 8); }
+    };
+    try {
+        CallsOnUnwind calls;
+        throw std::runtime_error("unwind");
+    } catch (const std::runtime_error&) {
+    }
+    EXPECT_EQ(sideEffect, 8);
+    EXPECT_EQ(adviceRuns, 1);
+}
+
+TEST_F(ProceedTest, ElidesCopiesAndMoves) {
+    Tracked result = callWoven(&makeTracked, 4);
+    EXPECT_EQ(result.value, 4);
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(Tracked::moves, 0);
+}
+
+TEST_F(ProceedTest, MemberFunctions) {
+    Holder holder;
+    Tracked& tracked = callWoven<&Holder::get>(&holder);
+    EXPECT_EQ(&tracked, &holder.tracked);
+
+    std::unique_ptr<int> owned = callWoven<&Holder::release>(&holder);
+    ASSERT_NE(owned, nullptr);
+    EXPECT_EQ(*owned, 5);
+    EXPECT_EQ(holder.owned, nullptr);
+
+    Tracked made = callWoven<&Holder::make>(&holder, 6);
+    EXPECT_EQ(made.value, 6);
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(Tracked::moves, 0);
+    EXPECT_EQ(adviceRuns, 3);
+}
+
+TEST_F(ProceedTest, VirtualMemberFunction) {
+    Square square;
+    Shape* shape = &square;
+    // Dispatches like shape->sides(), not to Shape::sides
+    EXPECT_EQ(callWoven<&Shape::sides>(shape), 4);
+    EXPECT_EQ(adviceRuns, 1);
+}
+
+TEST_F(ProceedTest, MultipleInheritance) {
+    NamedSquare square;
+    // Named is not the first base: the object is adjusted to its subobject
+    EXPECT_STREQ(callWoven<&Named::getName>(&square), "named");
+    EXPECT_EQ(callWoven<&NamedSquare::getId>(&square), 7);
+    EXPECT_EQ(callWoven<&Square::sides>(&square), 4);
+    EXPECT_EQ(adviceRuns, 3);
+}
+
+TEST_F(ProceedTest, StaticPointcut) {
+    Tracked result = StaticPointcut<&makeTracked>().around<PointcutName::counted>(std::forward<int>(8));
+    EXPECT_EQ(result.value, 8);
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(Tracked::moves, 0);
+
+    Holder holder;
+    Tracked& tracked = StaticPointcut<&Holder::get>(&holder).around<PointcutName::counted>();
+    EXPECT_EQ(&tracked, &holder.tracked);
+    std::unique_ptr<int> owned = StaticPointcut<&Holder::release>(&holder).around<PointcutName::counted>();
+    EXPECT_EQ(*owned, 5);
+    EXPECT_EQ(adviceRuns, 3);
+}
+
+namespace {
+
+// Stand-ins for woven code: the descriptors the plugin would emit
+char wovenCode[96];
+const WovenFunction firstWoven SAOP_WOVEN_FUNCTION = {"first", PointcutName::counted, wovenCode + 64, wovenCode + 96};
+const WovenFunction secondWoven SAOP_WOVEN_FUNCTION = {"second", PointcutName::counted, wovenCode, wovenCode + 32};
+
+} // namespace
+
+TEST(WovenRegistryTest, BuiltFromSection) {
+    const WovenRegistry& registry = WovenRegistry::instance();
+    ASSERT_EQ(registry.all().size(), 2u);
+    EXPECT_EQ(registry.all()[0], &secondWoven);
+    EXPECT_EQ(registry.all()[1], &firstWoven);
+
+    EXPECT_EQ(registry.find(wovenCode), &secondWoven);
+    EXPECT_EQ(registry.find(wovenCode + 31), &secondWoven);
+    EXPECT_EQ(registry.find(wovenCode + 70), &firstWoven);
+    EXPECT_STREQ(registry.find(wovenCode + 95)->name, "first");
+}
+
+TEST(WovenRegistryTest, AddressesOutsideWovenCode) {
+    const WovenRegistry& registry = WovenRegistry::instance();
+    // Before the first, between and after the functions
+    EXPECT_EQ(registry.find(&adviceRuns), nullptr);
+    EXPECT_EQ(registry.find(wovenCode + 32), nullptr);
+    EXPECT_EQ(registry.find(wovenCode + 63), nullptr);
+    EXPECT_EQ(registry.find(wovenCode + 96), nullptr);
+}
+
+TEST(WovenRegistryTest, Empty) {
+    WovenRegistry registry(nullptr, nullptr);
+    EXPECT_TRUE(registry.all().empty());
+    EXPECT_EQ(registry.find(wovenCode), nullptr);
+}
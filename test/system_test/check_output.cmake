@@ -0,0 +1,27 @@
+# Runs PROGRAM and fails unless it exits with 0 and its output contains each
+# line of EXPECTED_FILE. A test property cannot do both: ctest passes a test
+# as soon as one of its PASS_REGULAR_EXPRESSIONs matches, whatever the exit
+# code.
+#   cmake -DPROGRAM=<exe> -DEXPECTED_FILE=<file> -P check_output.cmake
+
+execute_process(
+  COMMAND ${PROGRAM}
+  OUTPUT_VARIABLE OUTPUT
+  ERROR_VARIABLE ERRORS
+  RESULT_VARIABLE RESULT
+)
+if(NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "${PROGRAM} exited with ${RESULT}\n${OUTPUT}${ERRORS}")
+endif()
+
+file(STRINGS ${EXPECTED_FILE} EXPECTED_LINES)
+set(MISSING "")
+foreach(LINE IN LISTS EXPECTED_LINES)
+  string(FIND "${OUTPUT}" "${LINE}" AT)
+  if(AT EQUAL -1)
+    string(APPEND MISSING "  ${LINE}\n")
+  endif()
+endforeach()
+if(MISSING)
+  message(FATAL_ERROR "Output of ${PROGRAM} lacks:\n${MISSING}Output:\n${OUTPUT}")
+endif()
@@ -2,19 +2,23 @@
 #include "saop.h"
 #include <iostream>
 
-enum class PointcutName {funcDecl};
+enum class PointcutName {funcDecl, traced, callSite};
 
 template<typename RT, typename... Args>
 template<PointcutName Id> 
 RT Pointcut<RT, Args...>::around(Args&&... args) {
     // Do your pre-processing here
-    std::cout << "Before proceeding in Pointcut::around." << std::endl;
-    if constexpr (!std::is_void_v<RT>) {
-        return proceed(std::forward<Args>(args)...);
-    } else {
-        proceed(std::forward<Args>(args)...);
+    if constexpr (Id == PointcutName::traced) {
+        std::cout << "Traced pointcut." << std::endl;
+    }
+    if constexpr (Id == PointcutName::callSite) {
+        std::cout << "Call-site pointcut." << std::endl;
     }
+    std::cout << "Before proceeding in Pointcut::around." << std::endl;
     //  Do your post-processing here
-    std::cout << "After proceeding in Pointcut::around." << std::endl;
+    AfterProceed after([] {
+        std::cout << "After proceeding in Pointcut::around." << std::endl;
+    });
+    return proceed(std::forward<Args>(args)...);
 }
 
@@ -0,0 +1,44 @@
+# cmake -DORIGINAL=<a.s> -DTRANSFORMED=<b.s> -DSYMBOLS=<sym,sym> -P compare_asm.cmake
+#
+# Fails unless every symbol has the same instructions in both assembly
+# files. Comments and directives are dropped and block labels renumbered,
+# as the woven file has more functions and puts wrappers in their own
+# section.
+
+function(extract_body FILE SYMBOL OUT)
+  file(STRINGS ${FILE} LINES)
+  set(INSIDE FALSE)
+  set(BODY "")
+  foreach(LINE IN LISTS LINES)
+    string(REGEX REPLACE "#.*" "" LINE "${LINE}")
+    string(STRIP "${LINE}" LINE)
+    if(LINE STREQUAL "${SYMBOL}:")
+      set(INSIDE TRUE)
+    elseif(INSIDE)
+      if(LINE MATCHES "^\\.Lfunc_end")
+        break()
+      endif()
+      if(LINE STREQUAL "" OR LINE MATCHES "^\\.[a-z]")
+        continue()
+      endif()
+      string(REGEX REPLACE "\\.LBB[0-9]+_" ".LBB_" LINE "${LINE}")
+      list(APPEND BODY "${LINE}")
+    endif()
+  endforeach()
+  if(NOT BODY)
+    message(FATAL_ERROR "${SYMBOL} not found in ${FILE}")
+  endif()
+  set(${OUT} "${BODY}" PARENT_SCOPE)
+endfunction()
+
+string(REPLACE "," ";" SYMBOLS "${SYMBOLS}")
+foreach(SYMBOL IN LISTS SYMBOLS)
+  extract_body(${ORIGINAL} ${SYMBOL} EXPECTED)
+  extract_body(${TRANSFORMED} ${SYMBOL} ACTUAL)
+  if(NOT EXPECTED STREQUAL ACTUAL)
+    string(REPLACE ";" "\n  " EXPECTED "${EXPECTED}")
+    string(REPLACE ";" "\n  " ACTUAL "${ACTUAL}")
+    message(FATAL_ERROR "${SYMBOL} differs after weaving\noriginal:\n  ${EXPECTED}\nwoven:\n  ${ACTUAL}")
+  endif()
+  message(STATUS "${SYMBOL}: identical")
+endforeach()
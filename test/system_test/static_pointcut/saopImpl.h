@@ -0,0 +1,11 @@
+#pragma once
+#include "saop.h"
+
+enum class PointcutName {inlined};
+
+// No-op advice: a statically bound wrapper must then cost nothing
+template<auto Func>
+template<PointcutName Id, typename... Args>
+typename StaticPointcut<Func>::ReturnType StaticPointcut<Func>::around(Args&&... args) {
+    return proceed(std::forward<Args>(args)...);
+}
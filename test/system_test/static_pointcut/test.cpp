@@ -0,0 +1,29 @@
+#include "saopImpl.h"
+
+// Woven with static-pointcut, each function below compiles (-O2) to the
+// same instructions as the unwoven source; see compare_asm.cmake.
+
+[[clang::annotate("wrap")]]
+int twice(int x) {
+    return 2 * x;
+}
+
+struct Accumulator {
+    int total = 0;
+    [[clang::annotate("wrap")]]
+    int add(int n) {
+        total += n;
+        return total;
+    }
+    [[clang::annotate("wrap")]]
+    int get() const {
+        return total;
+    }
+};
+
+int accumulate(Accumulator &acc, const int *values, int count) {
+    for (int i = 0; i < count; ++i) {
+        acc.add(twice(values[i]));
+    }
+    return acc.get();
+}
@@ -0,0 +1,12 @@
+template <typename T>
+T scale(T x) {
+    return 3 * x;
+}
+
+int triple(int x) {
+    return scale(x);
+}
+
+int main() {
+    return triple(1) + scale(2.0) > 0 ? 0 : 1;
+}
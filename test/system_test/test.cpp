@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include "saopImpl.h"
 
 void foo(int x);
@@ -13,12 +14,67 @@ struct Foo {
     void bar() ;
 };
 
+[[clang::annotate("trace")]]
+int twice(int x) {
+    std::cout << "Proceeding with original function logic. twice:" << x << std::endl;
+    return 2 * x;
+}
+
+int square(int x) {
+    return x * x;
+}
+
+struct Counter {
+    int value = 0;
+    int add(int n) {
+        value += n;
+        return value;
+    }
+};
+
+// By value: the wrapped body takes std::string&& to the wrapper's parameter
+[[clang::annotate("trace")]]
+std::size_t length(std::string text) {
+    std::cout << "Proceeding with original function logic. length:" << text << std::endl;
+    return text.size();
+}
+
+// Declared in the class and defined outside: both declarations of the
+// wrapped method keep std::string
+struct Greeter {
+    std::size_t greet(std::string name);
+};
+
 int main() {
     foo(42);
     Bar b;
     b.bar();
     Foo f;
     f.bar();
+    if (twice(21) != 42) {
+        return 1;
+    }
+    // call_pointcut: only these call sites go through around()
+    Counter c;
+    const int two = 2;
+    if (square(3) != 9 || c.add(two) != 2 || (&c)->add(square(2)) != 6) {
+        return 1;
+    }
+    if (length(std::string("woven")) != 5) {
+        return 1;
+    }
+    Greeter g;
+    if (g.greet(std::string("hi")) != 2) {
+        return 1;
+    }
+    // Each woven function is found by an address of its code
+    const WovenRegistry& registry = WovenRegistry::instance();
+    for (const WovenFunction* woven : registry.all()) {
+        if (registry.find(woven->start) != woven) {
+            return 1;
+        }
+        std::cout << "Registered woven function: " << woven->name << std::endl;
+    }
     std::cout << "Test Passed: Wrapped function executed correctly." << std::endl;
     return 0;
 }
@@ -34,3 +90,9 @@ void foo(int x) {
 void Foo::bar() {
     std::cout << "Proceeding with original function logic. Foo:"<< std::endl;
 }
+
+[[clang::annotate("trace")]]
+std::size_t Greeter::greet(std::string name) {
+    std::cout << "Proceeding with original function logic. greet:" << name << std::endl;
+    return name.size();
+}
@@ -0,0 +1,77 @@
+// Watch mode re-transforms a TU whose first transform failed once the user
+// saves the fix: the TU is in the dependency graph from its first transform.
+//
+// usage: watch_test
+
+#include "DependencyGraph.h"
+#include "IncrementalTransformer.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+namespace {
+
+void writeFile(llvm::StringRef Path, llvm::StringRef Text) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC);
+  OS << Text;
+}
+
+} // namespace
+
+int main() {
+  llvm::SmallString<128> Dir;
+  if (llvm::sys::fs::createUniqueDirectory("watch_test", Dir) ||
+      llvm::sys::fs::make_absolute(Dir)) {
+    llvm::errs() << "cannot create a directory\n";
+    return 1;
+  }
+  llvm::SmallString<128> Source(Dir), OutputDir(Dir);
+  llvm::sys::path::append(Source, "tu.cpp");
+  llvm::sys::path::append(OutputDir, "out");
+
+  UTHelperOptions Opts;
+  Opts.BaseFolder = Dir.str().str();
+  Opts.finalize();
+  IncrementalTransformer Transformer(Opts, OutputDir.str().str(), "");
+  DependencyGraph Graph;
+  clang::tooling::CompileCommand Command(Dir, "tu.cpp",
+                                         {"clang++", "-std=c++20", "-c", "tu.cpp"},
+                                         "tu.o");
+  std::string MainFile = IncrementalTransformer::mainFilePath(Command);
+
+  int Failures = 0;
+  writeFile(Source, "class Widget final { int f( };\n");
+  if (Transformer.transform(Command, Graph)) {
+    llvm::errs() << "FAILED: a TU with a syntax error transforms\n";
+    ++Failures;
+  }
+  // What the watcher does when the user saves the fix
+  writeFile(Source, "class Widget final { int f(); };\n");
+  std::vector<std::string> Affected = Graph.affectedTUs(MainFile);
+  if (!llvm::is_contained(Affected, MainFile)) {
+    llvm::errs() << "FAILED: the failed TU is not re-transformed on save\n";
+    ++Failures;
+  } else if (!Transformer.transform(Command, Graph)) {
+    llvm::errs() << "FAILED: the fixed TU does not transform\n";
+    ++Failures;
+  }
+
+  llvm::SmallString<128> Output(OutputDir);
+  llvm::sys::path::append(Output, "tu.cpp");
+  if (!Failures && !llvm::sys::fs::exists(Output)) {
+    llvm::errs() << "FAILED: no output for the fixed TU\n";
+    ++Failures;
+  }
+
+  llvm::sys::fs::remove_directories(Dir);
+  if (Failures)
+    return 1;
+  llvm::outs() << "OK: a failed TU is re-transformed once fixed\n";
+  return 0;
+}
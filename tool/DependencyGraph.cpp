@@ -0,0 +1,26 @@
+#include "DependencyGraph.h"
+
+void DependencyGraph::setDependencies(llvm::StringRef TU,
+                                      const llvm::StringSet<> &Headers) {
+  auto &Old = Forward[TU];
+  for (const auto &Header : Old) {
+    auto It = Reverse.find(Header.getKey());
+    if (It != Reverse.end())
+      It->second.erase(TU);
+  }
+  Old = Headers;
+  for (const auto &Header : Headers)
+    Reverse[Header.getKey()].insert(TU);
+}
+
+std::vector<std::string> DependencyGraph::affectedTUs(llvm::StringRef Path) const {
+  std::vector<std::string> Result;
+  if (Forward.count(Path))
+    Result.push_back(Path.str());
+  auto It = Reverse.find(Path);
+  if (It != Reverse.end()) {
+    for (const auto &TU : It->second)
+      Result.push_back(TU.getKey().str());
+  }
+  return Result;
+}
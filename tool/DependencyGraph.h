@@ -0,0 +1,28 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include <string>
+#include <vector>
+
+// Translation unit -> base-folder header graph used by watch mode to find
+// which TUs have to be re-transformed when a file changes.
+class DependencyGraph {
+public:
+  // Make TU known, keeping the headers recorded for it, so that it is
+  // affected by changes to itself even before a transform of it succeeds.
+  void addTU(llvm::StringRef TU) { Forward.try_emplace(TU); }
+
+  // Replace the recorded headers of TU with Headers.
+  void setDependencies(llvm::StringRef TU, const llvm::StringSet<> &Headers);
+
+  // TUs affected by a change to Path (the TU itself or its includers).
+  std::vector<std::string> affectedTUs(llvm::StringRef Path) const;
+
+  bool isTU(llvm::StringRef Path) const { return Forward.count(Path); }
+
+private:
+  llvm::StringMap<llvm::StringSet<>> Forward;
+  llvm::StringMap<llvm::StringSet<>> Reverse;
+};
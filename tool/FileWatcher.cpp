@@ -0,0 +1,124 @@
+#include "FileWatcher.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher() : Fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) {
+  if (Fd < 0)
+    llvm::errs() << "inotify_init1 failed\n";
+}
+
+FileWatcher::~FileWatcher() {
+  if (Fd >= 0)
+    close(Fd);
+}
+
+bool FileWatcher::isSupported() { return true; }
+
+bool FileWatcher::isExcluded(llvm::StringRef Path) const {
+  for (const auto &Prefix : Excluded) {
+    if (Path.starts_with(Prefix))
+      return true;
+  }
+  // Skip hidden directories such as .git
+  return llvm::sys::path::filename(Path).starts_with(".");
+}
+
+bool FileWatcher::addWatch(llvm::StringRef Dir) {
+  if (isExcluded(Dir))
+    return true;
+  int Wd = inotify_add_watch(Fd, Dir.str().c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (Wd < 0) {
+    llvm::errs() << "Failed to watch " << Dir << "\n";
+    return false;
+  }
+  WatchDirs[Wd] = Dir.str();
+
+  std::error_code EC;
+  for (llvm::sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC;
+       It.increment(EC)) {
+    if (It->type() == llvm::sys::fs::file_type::directory_file)
+      addWatch(It->path());
+  }
+  return true;
+}
+
+bool FileWatcher::watchTree(llvm::StringRef Root,
+                            std::vector<std::string> ExcludedPrefixes) {
+  if (Fd < 0)
+    return false;
+  Excluded = std::move(ExcludedPrefixes);
+  return addWatch(Root);
+}
+
+void FileWatcher::drainEvents(llvm::StringSet<> &Changed) {
+  alignas(struct inotify_event) char Buf[16 * 1024];
+  while (true) {
+    ssize_t Len = read(Fd, Buf, sizeof(Buf));
+    if (Len <= 0)
+      return;
+    for (char *P = Buf; P < Buf + Len;) {
+      auto *Event = reinterpret_cast<struct inotify_event *>(P);
+      P += sizeof(struct inotify_event) + Event->len;
+
+      auto Dir = WatchDirs.find(Event->wd);
+      if (Dir == WatchDirs.end() || Event->len == 0)
+        continue;
+      llvm::SmallString<256> Path(Dir->second);
+      llvm::sys::path::append(Path, Event->name);
+
+      if (Event->mask & IN_ISDIR) {
+        if (Event->mask & (IN_CREATE | IN_MOVED_TO))
+          addWatch(Path);
+        continue;
+      }
+      // IN_CREATE alone is followed by IN_CLOSE_WRITE once content is there
+      if (Event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+        Changed.insert(Path);
+    }
+  }
+}
+
+std::vector<std::string> FileWatcher::waitForChanges(int DebounceMs) {
+  llvm::StringSet<> Changed;
+  struct pollfd Pfd = {Fd, POLLIN, 0};
+  while (Changed.empty()) {
+    if (poll(&Pfd, 1, -1) < 0)
+      return {};
+    drainEvents(Changed);
+  }
+  // Collect the rest of the burst
+  while (poll(&Pfd, 1, DebounceMs) > 0)
+    drainEvents(Changed);
+
+  std::vector<std::string> Result;
+  for (const auto &Path : Changed)
+    Result.push_back(Path.getKey().str());
+  return Result;
+}
+
+#else
+
+FileWatcher::FileWatcher() {}
+FileWatcher::~FileWatcher() {}
+bool FileWatcher::isSupported() { return false; }
+bool FileWatcher::isExcluded(llvm::StringRef) const { return false; }
+bool FileWatcher::addWatch(llvm::StringRef) { return false; }
+bool FileWatcher::watchTree(llvm::StringRef, std::vector<std::string>) {
+  llvm::errs() << "Watch mode requires inotify (Linux)\n";
+  return false;
+}
+void FileWatcher::drainEvents(llvm::StringSet<> &) {}
+std::vector<std::string> FileWatcher::waitForChanges(int) { return {}; }
+
+#endif
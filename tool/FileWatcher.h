@@ -0,0 +1,36 @@
+#pragma once
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include <string>
+#include <vector>
+
+// Recursive directory watcher on top of inotify. inotify watches are not
+// recursive, so every directory below the root gets its own watch and newly
+// created directories are added as they appear.
+class FileWatcher {
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  static bool isSupported();
+
+  // Watch Root and all directories below it except those starting with one
+  // of the Excluded prefixes (e.g. the output directory).
+  bool watchTree(llvm::StringRef Root, std::vector<std::string> Excluded);
+
+  // Block until at least one file changed, then collect everything that
+  // changes within DebounceMs so an editor's write+rename is one batch.
+  // Returns absolute paths of modified files.
+  std::vector<std::string> waitForChanges(int DebounceMs = 30);
+
+private:
+  bool addWatch(llvm::StringRef Dir);
+  bool isExcluded(llvm::StringRef Path) const;
+  void drainEvents(llvm::StringSet<> &Changed);
+
+  int Fd = -1;
+  llvm::DenseMap<int, std::string> WatchDirs;
+  std::vector<std::string> Excluded;
+};
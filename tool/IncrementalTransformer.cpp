@@ -0,0 +1,255 @@
+#include "IncrementalTransformer.h"
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/Utils.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+
+namespace {
+
+std::string normalizePath(llvm::StringRef Path, llvm::StringRef Directory) {
+  llvm::SmallString<256> Abs(Path);
+  if (!llvm::sys::path::is_absolute(Abs)) {
+    llvm::SmallString<256> Joined(Directory);
+    llvm::sys::path::append(Joined, Abs);
+    Abs = Joined;
+  }
+  llvm::sys::path::remove_dots(Abs, /*remove_dot_dot=*/true);
+  return std::string(Abs.str());
+}
+
+// Records every base-folder file the preprocessor enters.
+class IncludeRecorder : public clang::PPCallbacks {
+public:
+  IncludeRecorder(clang::SourceManager &SM, llvm::StringRef BaseFolder,
+                  llvm::StringRef Directory, llvm::StringSet<> &Deps)
+      : SM(SM), BaseFolder(BaseFolder), Directory(Directory), Deps(Deps) {}
+
+  void FileChanged(clang::SourceLocation Loc, FileChangeReason Reason,
+                   clang::SrcMgr::CharacteristicKind FileType,
+                   clang::FileID PrevFID) override {
+    if (Reason != EnterFile || FileType != clang::SrcMgr::C_User)
+      return;
+    clang::FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+    if (FID == SM.getMainFileID())
+      return;
+    clang::OptionalFileEntryRef File = SM.getFileEntryRefForID(FID);
+    if (!File)
+      return;
+    std::string Path = normalizePath(File->getName(), Directory);
+    if (llvm::StringRef(Path).starts_with(BaseFolder))
+      Deps.insert(Path);
+  }
+
+private:
+  clang::SourceManager &SM;
+  llvm::StringRef BaseFolder;
+  llvm::StringRef Directory;
+  llvm::StringSet<> &Deps;
+};
+
+// Collects the includes seen while building a TU's preamble.
+class PreambleDepsCallbacks : public clang::PreambleCallbacks {
+public:
+  PreambleDepsCallbacks(llvm::StringRef BaseFolder, llvm::StringRef Directory,
+                        llvm::StringSet<> &Deps)
+      : BaseFolder(BaseFolder), Directory(Directory), Deps(Deps) {}
+
+  void BeforeExecute(clang::CompilerInstance &CI) override {
+    SM = &CI.getSourceManager();
+  }
+
+  std::unique_ptr<clang::PPCallbacks> createPPCallbacks() override {
+    return std::make_unique<IncludeRecorder>(*SM, BaseFolder, Directory, Deps);
+  }
+
+private:
+  clang::SourceManager *SM = nullptr;
+  llvm::StringRef BaseFolder;
+  llvm::StringRef Directory;
+  llvm::StringSet<> &Deps;
+};
+
+// Same transformation as the plugin, but the rewritten main file is captured
+// in Output instead of being printed, and includes of the main file body are
+// recorded on top of the preamble ones.
+class WatchTransformAction : public clang::ASTFrontendAction {
+public:
+  WatchTransformAction(const UTHelperOptions &Opts, llvm::StringRef Directory,
+                       llvm::StringSet<> &Deps, std::string &Output)
+      : Opts(Opts), Directory(Directory), Deps(Deps), Output(Output) {}
+
+  bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
+    CI.getPreprocessor().addPPCallbacks(std::make_unique<IncludeRecorder>(
+        CI.getSourceManager(), Opts.BaseFolder, Directory, Deps));
+    return true;
+  }
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override {
+    Rewrite.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
+    return createUTHelperConsumer(Rewrite, Opts);
+  }
+
+  void EndSourceFileAction() override {
+    clang::SourceManager &SM = Rewrite.getSourceMgr();
+    if (const llvm::RewriteBuffer *RewriteBuf =
+            Rewrite.getRewriteBufferFor(SM.getMainFileID())) {
+      Output.assign(RewriteBuf->begin(), RewriteBuf->end());
+    } else {
+      Output = SM.getBufferData(SM.getMainFileID()).str();
+    }
+  }
+
+private:
+  const UTHelperOptions &Opts;
+  llvm::StringRef Directory;
+  llvm::StringSet<> &Deps;
+  std::string &Output;
+  clang::Rewriter Rewrite;
+};
+
+} // namespace
+
+IncrementalTransformer::IncrementalTransformer(const UTHelperOptions &Opts,
+                                               std::string OutputDir,
+                                               std::string ResourceDir)
+    : Opts(Opts), OutputDir(std::move(OutputDir)),
+      ResourceDir(std::move(ResourceDir)),
+      PCHOps(std::make_shared<clang::PCHContainerOperations>()) {}
+
+std::string
+IncrementalTransformer::mainFilePath(const clang::tooling::CompileCommand &Command) {
+  return normalizePath(Command.Filename, Command.Directory);
+}
+
+std::string IncrementalTransformer::outputPathFor(llvm::StringRef MainFile) const {
+  llvm::SmallString<256> Out(OutputDir);
+  if (MainFile.starts_with(Opts.BaseFolder))
+    llvm::sys::path::append(Out, MainFile.drop_front(Opts.BaseFolder.size()));
+  else
+    llvm::sys::path::append(Out, llvm::sys::path::filename(MainFile));
+  return std::string(Out.str());
+}
+
+bool IncrementalTransformer::transform(const clang::tooling::CompileCommand &Command,
+                                       DependencyGraph &Graph) {
+  auto Start = std::chrono::steady_clock::now();
+  std::string MainFile = mainFilePath(Command);
+  // A TU that fails is watched too: saving the fix re-transforms it
+  Graph.addTU(MainFile);
+
+  // Only parse: no object file, no dependency file output
+  clang::tooling::CommandLineArguments Args = Command.CommandLine;
+  Args = clang::tooling::getClangStripOutputAdjuster()(Args, Command.Filename);
+  Args = clang::tooling::getClangStripDependencyFileAdjuster()(Args, Command.Filename);
+  Args = clang::tooling::getClangSyntaxOnlyAdjuster()(Args, Command.Filename);
+  if (!ResourceDir.empty())
+    Args.push_back("-resource-dir=" + ResourceDir);
+  std::vector<const char *> Argv;
+  for (const auto &Arg : Args)
+    Argv.push_back(Arg.c_str());
+
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> VFS =
+      llvm::vfs::createPhysicalFileSystem();
+  VFS->setCurrentWorkingDirectory(Command.Directory);
+
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> Diags =
+      clang::CompilerInstance::createDiagnostics(new clang::DiagnosticOptions());
+  clang::CreateInvocationOptions CIOpts;
+  CIOpts.Diags = Diags;
+  CIOpts.VFS = VFS;
+  std::shared_ptr<clang::CompilerInvocation> Invocation =
+      clang::createInvocation(Argv, CIOpts);
+  if (!Invocation) {
+    llvm::errs() << "Failed to create compiler invocation for " << MainFile << "\n";
+    return false;
+  }
+
+  auto MainBuf = VFS->getBufferForFile(MainFile);
+  if (!MainBuf) {
+    llvm::errs() << "Error reading file: " << MainFile << "\n";
+    return false;
+  }
+
+  // Reuse the preamble while the #include block and the headers it pulled in
+  // are unchanged; edits to the main file body then only reparse the body.
+  TUState &State = States[MainFile];
+  clang::PreambleBounds Bounds = clang::ComputePreambleBounds(
+      Invocation->getLangOpts(), (*MainBuf)->getMemBufferRef(), 0);
+  bool Reused = State.Preamble &&
+                State.Preamble->CanReuse(*Invocation, (*MainBuf)->getMemBufferRef(),
+                                         Bounds, *VFS);
+  if (!Reused) {
+    State.Preamble.reset();
+    State.PreambleDeps.clear();
+    PreambleDepsCallbacks Callbacks(Opts.BaseFolder, Command.Directory,
+                                    State.PreambleDeps);
+    auto Built = clang::PrecompiledPreamble::Build(
+        *Invocation, MainBuf->get(), Bounds, *Diags, VFS, PCHOps,
+        /*StoreInMemory=*/true, /*StoragePath=*/"", Callbacks);
+    if (Built) {
+      State.Preamble = std::make_unique<clang::PrecompiledPreamble>(std::move(*Built));
+    } else {
+      llvm::errs() << "Preamble build failed for " << MainFile << ": "
+                   << Built.getError().message() << "\n";
+    }
+  }
+
+  llvm::StringSet<> Deps = State.PreambleDeps;
+  std::unique_ptr<llvm::MemoryBuffer> Buffer =
+      llvm::MemoryBuffer::getMemBufferCopy((*MainBuf)->getBuffer(), MainFile);
+  if (State.Preamble)
+    State.Preamble->AddImplicitPreamble(*Invocation, VFS, Buffer.get());
+  else
+    Invocation->getPreprocessorOpts().addRemappedFile(MainFile, Buffer.get());
+  // The compiler instance owns remapped buffers from here on
+  Buffer.release();
+
+  clang::CompilerInstance Clang(PCHOps);
+  Clang.setInvocation(Invocation);
+  Clang.createDiagnostics();
+  Clang.createFileManager(VFS);
+
+  std::string Output;
+  WatchTransformAction Action(Opts, Command.Directory, Deps, Output);
+  bool Executed = Clang.ExecuteAction(Action);
+  // Also after an error: fixing a header it includes re-transforms the TU
+  Graph.setDependencies(MainFile, Deps);
+  if (!Executed || Clang.getDiagnostics().hasErrorOccurred()) {
+    llvm::errs() << "Transformation failed for " << MainFile << "\n";
+    return false;
+  }
+
+  std::string OutPath = outputPathFor(MainFile);
+  if (std::error_code EC = llvm::sys::fs::create_directories(
+          llvm::sys::path::parent_path(OutPath))) {
+    llvm::errs() << "Failed to create output directory: " << EC.message() << "\n";
+    return false;
+  }
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(OutPath, EC);
+  if (EC) {
+    llvm::errs() << "Failed to write " << OutPath << ": " << EC.message() << "\n";
+    return false;
+  }
+  OS << Output;
+
+  auto Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - Start);
+  llvm::errs() << "uthelper: " << MainFile << " -> " << OutPath << " ("
+               << Elapsed.count() << " ms" << (Reused ? ", preamble reused" : "")
+               << ")\n";
+  return true;
+}
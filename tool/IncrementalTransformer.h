@@ -0,0 +1,44 @@
+#pragma once
+
+#include "DependencyGraph.h"
+#include "UTHelperOptions.h"
+
+#include "clang/Frontend/PrecompiledPreamble.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <memory>
+#include <string>
+
+// Runs the UTHelper transformation on one TU at a time and keeps per-TU state
+// between runs: the precompiled preamble (reused while only the main file body
+// changes) and the base-folder headers the TU includes.
+class IncrementalTransformer {
+public:
+  IncrementalTransformer(const UTHelperOptions &Opts, std::string OutputDir,
+                         std::string ResourceDir);
+
+  // Transform Command.Filename, write the result below the output directory
+  // and record the TU's base-folder dependencies in Graph, whether or not
+  // the transform succeeds.
+  bool transform(const clang::tooling::CompileCommand &Command,
+                 DependencyGraph &Graph);
+
+  // Absolute, normalized path of Command's main file.
+  static std::string mainFilePath(const clang::tooling::CompileCommand &Command);
+
+private:
+  struct TUState {
+    std::unique_ptr<clang::PrecompiledPreamble> Preamble;
+    llvm::StringSet<> PreambleDeps;
+  };
+
+  std::string outputPathFor(llvm::StringRef MainFile) const;
+
+  const UTHelperOptions &Opts;
+  std::string OutputDir;
+  std::string ResourceDir;
+  std::shared_ptr<clang::PCHContainerOperations> PCHOps;
+  llvm::StringMap<TUState> States;
+};
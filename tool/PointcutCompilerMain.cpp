@@ -0,0 +1,68 @@
+// uthelper-pointcutc - compiles a pointcut file to C++ ahead of time.
+//
+// The output defines getCompiledPointcuts() (CompiledPointcuts.h). Built into
+// a plugin variant with UTHELPER_AOT_POINTCUTS, it replaces reading, parsing
+// and evaluating the pointcut file on every compiler invocation. Only the
+// pointcut parser is linked, so the tool runs early in a build.
+
+#include "Lexer.h"
+#include "Parser.h"
+#include "PointcutCodegen.h"
+#include "PointcutOptimizer.h"
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+static llvm::cl::opt<std::string> Input(llvm::cl::Positional, llvm::cl::Required,
+                                        llvm::cl::desc("<pointcut file>"));
+static llvm::cl::opt<std::string> Output("o", llvm::cl::init("-"),
+                                         llvm::cl::desc("Output C++ file"),
+                                         llvm::cl::value_desc("file"));
+
+int main(int argc, char **argv) {
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "Compile a pointcut file to C++\n");
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr =
+      llvm::MemoryBuffer::getFile(Input);
+  if (!FileOrErr) {
+    llvm::errs() << "Error reading file: " << Input << ": "
+                 << FileOrErr.getError().message() << "\n";
+    return 1;
+  }
+  llvm::StringRef Text = (*FileOrErr)->getBuffer();
+  if (Text.starts_with("\xEF\xBB\xBF"))
+    Text = Text.drop_front(3);
+
+  PointcutContext Context;
+  ::Lexer Lex(Text);
+  Parser Parse(Lex, Context);
+  std::vector<PointcutDeclaration *> Pointcuts = Parse.parsePointcutList();
+  if (Parse.hasError()) {
+    llvm::errs() << Input << ": " << Parse.getError() << "\n";
+    return 1;
+  }
+
+  llvm::StringSet<> Names;
+  for (PointcutDeclaration *Pointcut : Pointcuts) {
+    if (!Names.insert(Pointcut->name).second) {
+      llvm::errs() << Input << ": duplicate pointcut name: " << Pointcut->name
+                   << "\n";
+      return 1;
+    }
+    Pointcut->expression = optimizePointcut(Pointcut->expression, Context);
+  }
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Output, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    llvm::errs() << "Cannot write " << Output << ": " << EC.message() << "\n";
+    return 1;
+  }
+  emitCompiledPointcuts(Pointcuts, llvm::sys::path::filename(Input), OS);
+  return 0;
+}
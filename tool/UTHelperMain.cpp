@@ -0,0 +1,239 @@
+// uthelper - standalone driver for the UTHelper transformations.
+//
+// Transforms every source of a compilation database into --output-dir. With
+// --watch it stays resident, watches the base folder with inotify and
+// re-transforms only the TUs affected by each change, reusing the TU's
+// precompiled preamble when only the main file body was edited. With --query
+// it only lists the join points of the pointcuts in every TU.
+
+#include "DependencyGraph.h"
+#include "FileWatcher.h"
+#include "IncrementalTransformer.h"
+#include "UTHelperOptions.h"
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifndef UTHELPER_CLANG_RESOURCE_DIR
+#define UTHELPER_CLANG_RESOURCE_DIR ""
+#endif
+
+static llvm::cl::OptionCategory UTHelperCategory("uthelper options");
+
+static llvm::cl::opt<std::string>
+    BaseFolder("base-folder", llvm::cl::Required,
+               llvm::cl::desc("Only transform code below this folder"),
+               llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    OutputDir("output-dir",
+              llvm::cl::desc("Directory receiving the transformed sources "
+                             "(required unless --query)"),
+              llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    Pointcut("pointcut", llvm::cl::desc("Pointcut file (function wrapping mode)"),
+             llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<bool>
+    DisableRemoveFinal("disable-remove-final", llvm::cl::desc("Keep final keywords"),
+                       llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<bool>
+    DisableMakeVirtual("disable-make-virtual",
+                       llvm::cl::desc("Don't add virtual to methods"),
+                       llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<bool>
+    DisableAddFriend("disable-add-friend",
+                     llvm::cl::desc("Don't inject friend declarations"),
+                     llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    CustomFriends("custom-friends",
+                  llvm::cl::desc("Semicolon-separated custom friend templates"),
+                  llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    Engine("engine", llvm::cl::init("bytecode"),
+           llvm::cl::desc("Pointcut engine: bytecode or matcher"),
+           llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    MatcherPointcuts("matcher-pointcuts",
+                     llvm::cl::desc("Comma-separated pointcuts to match with "
+                                    "ASTMatchers under the bytecode engine"),
+                     llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    PointcutCache("pointcut-cache",
+                  llvm::cl::desc("Directory for cached parsed pointcuts "
+                                 "(default: next to the pointcut file)"),
+                  llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    MaxOverheadRatio("max-overhead-ratio",
+                     llvm::cl::desc("Leave functions unwrapped when the wrapper "
+                                    "would cost more than this many times "
+                                    "their body (default: wrap all)"),
+                     llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<bool>
+    StaticPointcut("static-pointcut",
+                   llvm::cl::desc("Bind wrapped functions statically so "
+                                  "proceed() can be inlined"),
+                   llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    Query("query",
+          llvm::cl::desc("Print the join points of the pointcuts (json or csv) "
+                         "instead of transforming"),
+          llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<bool>
+    Watch("watch",
+          llvm::cl::desc("Keep running and re-transform affected TUs on change"),
+          llvm::cl::cat(UTHelperCategory));
+static llvm::cl::opt<std::string>
+    ResourceDir("resource-dir", llvm::cl::init(UTHELPER_CLANG_RESOURCE_DIR),
+                llvm::cl::desc("Clang resource directory (builtin headers)"),
+                llvm::cl::cat(UTHelperCategory));
+
+static bool buildOptions(UTHelperOptions &Opts) {
+  std::vector<std::string> Args = {"base-folder=" + BaseFolder};
+  if (!Pointcut.empty())
+    Args.push_back("pointcut=" + Pointcut);
+  if (DisableRemoveFinal)
+    Args.push_back("disable-remove-final");
+  if (DisableMakeVirtual)
+    Args.push_back("disable-make-virtual");
+  if (DisableAddFriend)
+    Args.push_back("disable-add-friend");
+  if (!CustomFriends.empty())
+    Args.push_back("custom-friends=" + CustomFriends);
+  Args.push_back("engine=" + Engine);
+  if (!MatcherPointcuts.empty())
+    Args.push_back("matcher-pointcuts=" + MatcherPointcuts);
+  if (!PointcutCache.empty())
+    Args.push_back("pointcut-cache=" + PointcutCache);
+  if (!MaxOverheadRatio.empty())
+    Args.push_back("max-overhead-ratio=" + MaxOverheadRatio);
+  if (StaticPointcut)
+    Args.push_back("static-pointcut");
+  if (!Query.empty())
+    Args.push_back("query=" + Query);
+  for (const auto &Arg : Args) {
+    if (!Opts.parseArg(Arg))
+      return false;
+  }
+  return Opts.finalize();
+}
+
+namespace {
+
+// Query mode parses each TU once, without keeping a preamble, and the
+// consumer prints its join points; nothing is rewritten or written out.
+class QueryAction : public clang::ASTFrontendAction {
+public:
+  explicit QueryAction(const UTHelperOptions &Opts) : Opts(Opts) {}
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override {
+    Rewrite.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
+    return createUTHelperConsumer(Rewrite, Opts);
+  }
+
+private:
+  const UTHelperOptions &Opts;
+  clang::Rewriter Rewrite;
+};
+
+class QueryActionFactory : public clang::tooling::FrontendActionFactory {
+public:
+  explicit QueryActionFactory(const UTHelperOptions &Opts) : Opts(Opts) {}
+
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<QueryAction>(Opts);
+  }
+
+private:
+  const UTHelperOptions &Opts;
+};
+
+int runQuery(const UTHelperOptions &Opts,
+             clang::tooling::CommonOptionsParser &OptionsParser) {
+  // ClangTool already strips outputs and adds -fsyntax-only
+  clang::tooling::ClangTool Tool(OptionsParser.getCompilations(),
+                                 OptionsParser.getSourcePathList());
+  if (!ResourceDir.empty())
+    Tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+        ("-resource-dir=" + ResourceDir).c_str(),
+        clang::tooling::ArgumentInsertPosition::END));
+  QueryActionFactory Factory(Opts);
+  return Tool.run(&Factory) ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, const char **argv) {
+  auto OptionsParser =
+      clang::tooling::CommonOptionsParser::create(argc, argv, UTHelperCategory);
+  if (!OptionsParser) {
+    llvm::errs() << llvm::toString(OptionsParser.takeError());
+    return 1;
+  }
+
+  UTHelperOptions Opts;
+  if (!buildOptions(Opts))
+    return 1;
+
+  if (Opts.Query != QueryFormat::None) {
+    if (Watch) {
+      llvm::errs() << "--query cannot be combined with --watch\n";
+      return 1;
+    }
+    return runQuery(Opts, *OptionsParser);
+  }
+  if (OutputDir.empty()) {
+    llvm::errs() << "--output-dir is required\n";
+    return 1;
+  }
+
+  llvm::SmallString<256> AbsOutputDir(OutputDir);
+  llvm::sys::fs::make_absolute(AbsOutputDir);
+  llvm::sys::path::remove_dots(AbsOutputDir, /*remove_dot_dot=*/true);
+
+  const clang::tooling::CompilationDatabase &Compilations =
+      OptionsParser->getCompilations();
+  IncrementalTransformer Transformer(Opts, std::string(AbsOutputDir.str()),
+                                     ResourceDir);
+  DependencyGraph Graph;
+  llvm::StringMap<clang::tooling::CompileCommand> Commands;
+
+  int Failures = 0;
+  for (const auto &Source : OptionsParser->getSourcePathList()) {
+    for (const auto &Command : Compilations.getCompileCommands(Source)) {
+      std::string MainFile = IncrementalTransformer::mainFilePath(Command);
+      Commands[MainFile] = Command;
+      if (!Transformer.transform(Command, Graph))
+        ++Failures;
+    }
+  }
+  if (!Watch)
+    return Failures ? 1 : 0;
+
+  if (!FileWatcher::isSupported()) {
+    llvm::errs() << "Watch mode requires inotify (Linux)\n";
+    return 1;
+  }
+  FileWatcher Watcher;
+  if (!Watcher.watchTree(Opts.BaseFolder, {std::string(AbsOutputDir.str())}))
+    return 1;
+  llvm::errs() << "uthelper: watching " << Opts.BaseFolder << "\n";
+
+  while (true) {
+    llvm::StringSet<> Pending;
+    for (const auto &Path : Watcher.waitForChanges()) {
+      for (const auto &TU : Graph.affectedTUs(Path))
+        Pending.insert(TU);
+    }
+    for (const auto &TU : Pending) {
+      auto It = Commands.find(TU.getKey());
+      if (It != Commands.end())
+        Transformer.transform(It->second, Graph);
+    }
+  }
+}